@@ -0,0 +1,331 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include "Platform.h"
+#include "TraceRecorder.h"
+
+// ==========================================
+//  [DVR] Annotated clip recorder with non-blocking rotation
+// ==========================================
+// Rendered frames (already paced to DVR_FPS by the caller) go through a bounded queue to a
+// dedicated writer thread. An opener thread creates the next clip's cv::VideoWriter a couple of
+// seconds before the segment boundary and releases finished ones, so at the boundary the writer
+// thread only swaps pointers: directory creation, container setup and trailer writes never run
+// on the write path or under a lock anyone else takes.
+//
+// Clips are C:\locvideo\YYYYMMDD\camera_N\HHMMSS.webm (VP8), exactly DVR_CLIP_FRAMES long
+// unless the next writer was late; Current() gives the clip and position for event records.
+
+const double DVR_FPS = 10.0;
+const int DVR_CLIP_FRAMES = 600;        // 60 s at DVR_FPS
+const int DVR_QUEUE_FRAMES = 30;        // 3 s of frames before new ones are dropped
+const double DVR_PREOPEN_SECONDS = 2.0; // Lead time for opening the next clip
+
+struct DvrClipPosition {
+    std::string relPath;   // Relative to C:\locvideo, empty before the first clip opened
+    int framesWritten = 0; // In the current clip
+};
+
+class AnnotatedClipRecorder {
+public:
+    AnnotatedClipRecorder(int cameraId, cv::Size frameSize)
+        : cameraId_(cameraId), frameSize_(frameSize) {}
+
+    ~AnnotatedClipRecorder() { Stop(); }
+
+    // Hooks, set before Start(). onClipChanged gets the relative path and the steady-clock time
+    // (us) the clip's first frame was pushed, or an empty path once recording stops.
+    std::function<void(double seconds)> onWrite;
+    std::function<void(double seconds)> onRotate; // Boundary reached -> first frame in the next clip
+    std::function<void()> onDrop;
+    std::function<void(const std::string& relPath, long long startUs)> onClipChanged;
+
+    void Start() {
+        if (running_.exchange(true)) return;
+        openerRunning_ = true;
+        opener_ = std::thread(&AnnotatedClipRecorder::OpenerLoop, this);
+        writer_ = std::thread(&AnnotatedClipRecorder::WriterLoop, this);
+    }
+
+    // Writes whatever is queued, then finalizes every clip
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex_);
+            running_ = false;
+            queueCv_.notify_all();
+        }
+        if (writer_.joinable()) writer_.join();
+        {
+            std::lock_guard<std::mutex> lock(openerMutex_);
+            openerRunning_ = false;
+            openerCv_.notify_all();
+        }
+        if (opener_.joinable()) opener_.join();
+    }
+
+    // Pacing thread: never blocks on disk. False if the queue was full and the frame was dropped.
+    bool Push(const cv::Mat& frame) {
+        std::lock_guard<std::mutex> lock(queueMutex_);
+        if (!running_) return false;
+        if ((int)queue_.size() >= DVR_QUEUE_FRAMES) {
+            framesDropped_++;
+            if (onDrop) onDrop();
+            return false;
+        }
+        queue_.push_back(QueuedFrame{ frame, SteadyNowUs() });
+        queueCv_.notify_one();
+        return true;
+    }
+
+    DvrClipPosition Current() const {
+        std::lock_guard<std::mutex> lock(positionMutex_);
+        return position_;
+    }
+    double LastRotationMs() const { return lastRotationMs_.load(); }
+    long long FramesDropped() const { return framesDropped_.load(); }
+
+private:
+    struct QueuedFrame {
+        cv::Mat frame;
+        long long pushUs;
+    };
+    struct ClipWriter {
+        cv::VideoWriter* writer = nullptr;
+        std::string relPath;
+        std::string fullPath;
+        bool discard = false; // Never written to: delete the file after release
+    };
+
+    int cameraId_;
+    cv::Size frameSize_;
+
+    std::atomic<bool> running_{ false };
+    std::thread writer_;
+    std::mutex queueMutex_;
+    std::condition_variable queueCv_;
+    std::deque<QueuedFrame> queue_;
+    std::atomic<long long> framesDropped_{ 0 };
+
+    // Opener thread hand-off, guarded by openerMutex_
+    std::thread opener_;
+    std::mutex openerMutex_;
+    std::condition_variable openerCv_;
+    bool openerRunning_ = false;
+    std::string openRequest_; // Relative path of the clip to pre-open
+    ClipWriter next_;         // Ready to swap in once next_.writer is set
+    bool openFailed_ = false;
+    std::vector<ClipWriter> retired_;
+
+    // Writer-thread state
+    ClipWriter current_;
+    int framesInClip_ = 0;
+    bool nextRequested_ = false;
+    long long boundaryUs_ = 0;
+
+    mutable std::mutex positionMutex_;
+    DvrClipPosition position_;
+    std::atomic<double> lastRotationMs_{ 0.0 };
+
+    static long long SteadyNowUs() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void WriterLoop() {
+        g_traceRecorder.SetThreadName("camera " + std::to_string(cameraId_) + " dvr writer");
+        const int preopenFrames = (int)(DVR_PREOPEN_SECONDS * DVR_FPS);
+        while (true) {
+            QueuedFrame item;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex_);
+                queueCv_.wait(lock, [&]() { return !running_ || !queue_.empty(); });
+                if (queue_.empty()) break;
+                item = queue_.front();
+                queue_.pop_front();
+            }
+
+            if (!current_.writer) {
+                // First clip: nothing is being recorded yet, so open it inline
+                ClipWriter clip = OpenClip(ClipRelPathAt(0.0));
+                if (!clip.writer) continue;
+                InstallClip(clip, item.pushUs);
+            }
+
+            if (!nextRequested_ && framesInClip_ >= DVR_CLIP_FRAMES - preopenFrames) {
+                double secondsLeft = std::max(0, DVR_CLIP_FRAMES - framesInClip_) / DVR_FPS;
+                std::lock_guard<std::mutex> lock(openerMutex_);
+                openRequest_ = ClipRelPathAt(secondsLeft);
+                nextRequested_ = true;
+                openerCv_.notify_one();
+            }
+
+            if (framesInClip_ >= DVR_CLIP_FRAMES) {
+                if (boundaryUs_ == 0) boundaryUs_ = SteadyNowUs();
+                ClipWriter ready;
+                {
+                    std::lock_guard<std::mutex> lock(openerMutex_);
+                    if (next_.writer) {
+                        ready = next_;
+                        next_ = ClipWriter();
+                        retired_.push_back(current_);
+                        openerCv_.notify_one();
+                    } else if (openFailed_) {
+                        // The pre-open failed: ask again rather than growing this clip forever
+                        openFailed_ = false;
+                        openRequest_ = ClipRelPathAt(0.0);
+                        openerCv_.notify_one();
+                    }
+                }
+                if (ready.writer) {
+                    double rotationMs = (SteadyNowUs() - boundaryUs_) / 1000.0;
+                    InstallClip(ready, item.pushUs);
+                    lastRotationMs_ = rotationMs;
+                    if (onRotate) onRotate(rotationMs / 1000.0);
+                    if (rotationMs > 1000.0 / DVR_FPS) {
+                        OutputDebugStringA(("[DVR] Camera " + std::to_string(cameraId_) + ": rotation took "
+                            + std::to_string((int)rotationMs) + " ms (next clip opened late)\n").c_str());
+                    }
+                }
+            }
+
+            long long writeStart = SteadyNowUs();
+            {
+                TraceSpan writeSpan("VideoWriter::write", "recording", cameraId_);
+                current_.writer->write(item.frame);
+            }
+            if (onWrite) onWrite((SteadyNowUs() - writeStart) / 1e6);
+            framesInClip_++;
+            std::lock_guard<std::mutex> lock(positionMutex_);
+            position_.framesWritten = framesInClip_;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(openerMutex_);
+            if (current_.writer) retired_.push_back(current_);
+            current_ = ClipWriter();
+            openerCv_.notify_one();
+        }
+        {
+            std::lock_guard<std::mutex> lock(positionMutex_);
+            position_ = DvrClipPosition();
+        }
+        if (onClipChanged) onClipChanged("", 0);
+    }
+
+    void InstallClip(const ClipWriter& clip, long long startUs) {
+        current_ = clip;
+        current_.discard = false;
+        framesInClip_ = 0;
+        nextRequested_ = false;
+        boundaryUs_ = 0;
+        {
+            std::lock_guard<std::mutex> lock(positionMutex_);
+            position_.relPath = clip.relPath;
+            position_.framesWritten = 0;
+        }
+        if (onClipChanged) onClipChanged(clip.relPath, startUs);
+        OutputDebugStringA(("[VIDEO] New clip (10 FPS DVR): " + clip.fullPath + "\n").c_str());
+    }
+
+    void OpenerLoop() {
+        while (true) {
+            std::string request;
+            std::vector<ClipWriter> toRelease;
+            {
+                std::unique_lock<std::mutex> lock(openerMutex_);
+                openerCv_.wait(lock, [&]() { return !openerRunning_ || !openRequest_.empty() || !retired_.empty(); });
+                toRelease.swap(retired_);
+                if (!openerRunning_) {
+                    if (next_.writer) {
+                        next_.discard = true; // Pre-opened for a boundary that never came
+                        toRelease.push_back(next_);
+                        next_ = ClipWriter();
+                    }
+                } else {
+                    request.swap(openRequest_);
+                }
+            }
+
+            // Trailers first: a finished clip is what the dashboard may want to play
+            for (ClipWriter& clip : toRelease) ReleaseClip(clip);
+
+            if (!request.empty()) {
+                ClipWriter clip = OpenClip(request);
+                std::lock_guard<std::mutex> lock(openerMutex_);
+                if (clip.writer && openerRunning_ && !next_.writer) {
+                    next_ = clip;
+                } else if (clip.writer) {
+                    clip.discard = true;
+                    retired_.push_back(clip);
+                } else {
+                    openFailed_ = true; // The writer asks again at the boundary
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(openerMutex_);
+            if (!openerRunning_ && retired_.empty() && !next_.writer) break;
+        }
+    }
+
+    // YYYYMMDD/camera_N/HHMMSS.webm for a clip starting secondsFromNow from now
+    std::string ClipRelPathAt(double secondsFromNow) const {
+        SYSTEMTIME st;
+        GetLocalTime(&st);
+        std::tm t = {};
+        t.tm_year = st.wYear - 1900;
+        t.tm_mon = st.wMonth - 1;
+        t.tm_mday = st.wDay;
+        t.tm_hour = st.wHour;
+        t.tm_min = st.wMinute;
+        t.tm_sec = st.wSecond + (int)(secondsFromNow + 0.5);
+        t.tm_isdst = -1;
+        std::mktime(&t); // Normalizes minute/hour/day roll-over
+        char relPath[128];
+        sprintf_s(relPath, sizeof(relPath), "%04d%02d%02d/camera_%d/%02d%02d%02d.webm",
+            t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, cameraId_, t.tm_hour, t.tm_min, t.tm_sec);
+        return relPath;
+    }
+
+    ClipWriter OpenClip(const std::string& relPath) const {
+        ClipWriter clip;
+        clip.relPath = relPath;
+        clip.fullPath = "C:\\locvideo\\" + relPath;
+        std::replace(clip.fullPath.begin(), clip.fullPath.end(), '/', '\\');
+
+        std::string cameraFolder = clip.fullPath.substr(0, clip.fullPath.find_last_of('\\'));
+        std::string dateFolder = cameraFolder.substr(0, cameraFolder.find_last_of('\\'));
+        CreateDirectoryA("C:\\locvideo", NULL);
+        CreateDirectoryA(dateFolder.c_str(), NULL);
+        CreateDirectoryA(cameraFolder.c_str(), NULL);
+
+        // We force the writer to expect strictly 10.0 FPS
+        cv::VideoWriter* writer = new cv::VideoWriter(
+            PlatformPath(clip.fullPath), cv::VideoWriter::fourcc('V', 'P', '8', '0'), DVR_FPS, frameSize_);
+        if (writer->isOpened()) {
+            clip.writer = writer;
+        } else {
+            delete writer;
+            OutputDebugStringA(("[VIDEO] Failed to open VideoWriter for " + clip.fullPath + "\n").c_str());
+        }
+        return clip;
+    }
+
+    static void ReleaseClip(ClipWriter& clip) {
+        if (!clip.writer) return;
+        clip.writer->release();
+        delete clip.writer;
+        clip.writer = nullptr;
+        if (clip.discard) remove(PlatformPath(clip.fullPath).c_str());
+    }
+};
@@ -21,7 +21,7 @@ struct TrackedObject {
     int framesStill;         // ??????????????????????
     cv::Point lastCenter;    // ???????????????????????
     
-    TrackedObject() : id(-1), framesLost(0), isActive(true), confidence(0.0f), classId(-1), 
+    TrackedObject() : id(-1), classId(-1), confidence(0.0f), framesLost(0), isActive(true), 
                       velocity(0, 0), predictedBbox(), framesStill(0), lastCenter(0, 0) {}
     
     TrackedObject(int _id, cv::Rect _bbox, int _classId, float _conf) 
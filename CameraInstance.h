@@ -0,0 +1,2025 @@
+#pragma once
+#include "Platform.h"
+#include <string>
+#include <vector>
+#include <map>
+#include "BYTETracker.h"
+#include "ParkingSlot.h"
+#include "MjpegServer.h"
+#include "json.hpp"
+
+using json = nlohmann::json;
+
+// ==========================================
+//  [PORTABLE] Native camera pipeline
+// ==========================================
+// Capture -> ONNX inference -> ByteTrack -> parking/violation logic -> web server, with no .NET
+// or GDI dependency. online1.h includes this inside `#pragma managed(push, off)`; the headless
+// daemon (headless_main.cpp) uses it directly.
+
+#include <opencv2/opencv.hpp>
+#include <opencv2/dnn.hpp>
+#include <cstdlib>
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <set>
+#include <chrono> // [PHASE 1] Add for future use
+#include <atomic> // [PHASE 1] Add for atomic operations
+#include <thread>
+#include "OnnxYoloInference.h" // [GPU] ONNX Runtime GPU acceleration
+#include "LibavCapture.h" // [DECODE SKIP] Direct libav backend for network streams
+#include "LatencyTrace.h" // [LATENCY] Per-frame stage timestamps + histograms
+#include "MetricsRegistry.h" // [METRICS] Prometheus /api/metrics
+#include "TraceRecorder.h" // [TRACE] Chrome-trace export of pipeline spans
+#include "PassthroughRecorder.h" // [PASSTHROUGH] DVR remux of the camera's own packets
+#include "AnnotatedRecorder.h" // [DVR] Queued annotated clip writer with background rotation
+#include "MetadataTrack.h" // [METADATA] Per-frame detections stored next to each DVR clip
+#include "PersistenceService.h" // [PERSIST] Snapshot/event/stats files written off the processing thread
+#include "EventLog.h" // [EVENT LOG] Indexed JSONL logs behind /api/anomaly_events and /api/parking_areas
+#include "OccupancyStore.h" // [OCCUPANCY] Per-slot state history + minute/hour rollups behind /api/{id}/occupancy
+#include "ParkingSessions.h" // [SESSIONS] Arrival/departure sessions + per-slot dwell/turnover statistics
+#include "LiveEvents.h" // [LIVE] Coalesced slot/count/violation pushes behind /api/{id}/events
+
+// ==========================================
+//  LAYER 1: SHARED CONSTANTS & STRUCTS
+// ==========================================
+#include <fstream>
+#include <deque>
+#include <functional>
+
+const int YOLO_INPUT_SIZE = 640;
+const float CONF_THRESHOLD = 0.25f;
+const float NMS_THRESHOLD = 0.45f;
+const int VIOLATION_CHECK_INTERVAL_MS_ONLINE = 500;
+
+struct OnlineAppState {
+	std::vector<TrackedObject> cars;
+	std::set<int> violatingCarIds;
+	std::map<int, SlotStatus> slotStatuses;
+	std::map<int, float> slotOccupancy;
+	std::map<int, std::string> slotTypes; // [NEW] Track Car/Motorcycle
+	long long frameSequence = -1;
+};
+
+struct CachedLabel_Online {
+	std::string text;
+	cv::Size size;
+	int baseline;
+	bool isViolating;
+	int classId;
+	
+	CachedLabel_Online() : baseline(0), isViolating(false), classId(-1) {}
+};
+
+struct FPSMonitor_Online {
+	double alpha = 0.1;
+	double avgFPS = 0.0;
+	long long lastTick = 0;
+	
+	void update() {
+		long long currentTick = cv::getTickCount();
+		if (lastTick != 0) {
+			double timeSec = (currentTick - lastTick) / cv::getTickFrequency();
+			if (timeSec > 0) {
+				double fps = 1.0 / timeSec;
+				if (avgFPS == 0) avgFPS = fps;
+				else avgFPS = avgFPS * (1.0 - alpha) + fps * alpha;
+			}
+		}
+		lastTick = currentTick;
+	}
+};
+
+// [LOW LATENCY] Estimates how stale each captured frame is from its stream timestamp.
+// offset = wall clock at retrieve - stream position. The smallest offset seen belongs to the
+// frame that waited the least, so (offset - minOffset) is the delay added by buffering/decoding.
+struct FrameAgeMonitor_Online {
+	double alpha = 0.1;
+	double avgAgeMs = 0.0;
+	double lastAgeMs = 0.0;
+	double minOffsetMs = 0.0;
+	double lastStreamPosMs = -1.0;
+	bool hasBaseline = false;
+
+	void reset() {
+		avgAgeMs = 0.0;
+		lastAgeMs = 0.0;
+		minOffsetMs = 0.0;
+		lastStreamPosMs = -1.0;
+		hasBaseline = false;
+	}
+
+	// Returns false when the backend does not report stream timestamps
+	bool update(double streamPosMs, double wallMs) {
+		if (streamPosMs <= 0.0) return false;
+		// Stream restarted or timestamps wrapped -> start a new baseline
+		if (streamPosMs < lastStreamPosMs) hasBaseline = false;
+		lastStreamPosMs = streamPosMs;
+
+		double offset = wallMs - streamPosMs;
+		if (!hasBaseline || offset < minOffsetMs) {
+			minOffsetMs = offset;
+			hasBaseline = true;
+		}
+		lastAgeMs = offset - minOffsetMs;
+		if (avgAgeMs == 0) avgAgeMs = lastAgeMs;
+		else avgAgeMs = avgAgeMs * (1.0 - alpha) + lastAgeMs * alpha;
+		return true;
+	}
+};
+
+// [METRICS] Series for one camera, resolved once so hot-path updates are a single atomic add
+struct CameraMetrics_Online {
+	MetricCounter* framesCaptured = nullptr;
+	MetricCounter* framesDroppedReader = nullptr;     // Drained by the latest-frame grabber
+	MetricCounter* framesDroppedProcessing = nullptr; // Superseded before the AI thread got to them
+	MetricCounter* framesProcessed = nullptr;
+	MetricHistogram* inferenceSeconds = nullptr;
+	MetricHistogram* processingSeconds = nullptr;
+	MetricHistogram* recorderWriteSeconds = nullptr;
+	MetricHistogram* recorderRotationSeconds = nullptr;
+	MetricCounter* recorderFramesDropped = nullptr;
+	MetricGauge* frameQueueLag = nullptr;
+	MetricGauge* trackerTracks = nullptr;
+	MetricGauge* slotsEmpty = nullptr;
+	MetricGauge* slotsOccupied = nullptr;
+	MetricGauge* slotsIllegal = nullptr;
+	MetricGauge* decodePolicy = nullptr;
+
+	void init(int cameraId) {
+		std::string cam = CameraLabel(cameraId);
+		framesCaptured = &g_metrics.Counter("parking_frames_captured_total", "Frames retrieved from the capture backend", cam);
+		framesDroppedReader = &g_metrics.Counter("parking_frames_dropped_total", "Frames dropped before processing", cam + ",reason=\"reader_drain\"");
+		framesDroppedProcessing = &g_metrics.Counter("parking_frames_dropped_total", "Frames dropped before processing", cam + ",reason=\"superseded\"");
+		framesProcessed = &g_metrics.Counter("parking_frames_processed_total", "Frames that went through inference and rendering", cam);
+		inferenceSeconds = &g_metrics.Histogram("parking_inference_seconds", "ONNX Runtime Session::Run time", cam);
+		processingSeconds = &g_metrics.Histogram("parking_processing_seconds", "Preprocess + inference + decode + tracking per frame", cam);
+		recorderWriteSeconds = &g_metrics.Histogram("parking_recorder_write_seconds", "VideoWriter::write time per DVR frame", cam);
+		recorderRotationSeconds = &g_metrics.Histogram("parking_recorder_rotation_seconds", "DVR clip boundary to first frame in the next clip", cam);
+		recorderFramesDropped = &g_metrics.Counter("parking_recorder_frames_dropped_total", "DVR frames dropped because the writer queue was full", cam);
+		frameQueueLag = &g_metrics.Gauge("parking_frame_queue_lag", "Frames captured while the last frame was being processed", cam);
+		trackerTracks = &g_metrics.Gauge("parking_tracker_tracks", "Tracks held by BYTETracker", cam);
+		slotsEmpty = &g_metrics.Gauge("parking_slots", "Parking slots by state", cam + ",state=\"empty\"");
+		slotsOccupied = &g_metrics.Gauge("parking_slots", "Parking slots by state", cam + ",state=\"occupied\"");
+		slotsIllegal = &g_metrics.Gauge("parking_slots", "Parking slots by state", cam + ",state=\"illegal\"");
+		decodePolicy = &g_metrics.Gauge("parking_decode_policy", "0 = all frames, 1 = reference only, 2 = keyframes only", cam);
+	}
+};
+
+// ==========================================
+//  [PHASE 14] MULTI-CAMERA INFRASTRUCTURE
+// ==========================================
+struct CameraConfig {
+	int id;
+	std::string name;
+	std::string rtspUrl;
+	std::string templatePath; // Optional parking template loaded at startup by the daemon
+	std::string recording;    // DVR mode: "annotated" (default) or "passthrough"
+};
+
+class CameraManager {
+public:
+	static std::vector<CameraConfig> LoadCameras() {
+		std::vector<CameraConfig> cameras;
+		std::ifstream file(PlatformPath("C:\\camera_ids\\cameras.json"));
+		if (!file.is_open()) return cameras;
+
+		try {
+			json j;
+			file >> j;
+			for (const auto& item : j) {
+				CameraConfig cam;
+				cam.id = item.value("id", 0);
+				cam.name = item.value("name", "");
+				cam.rtspUrl = item.value("rtspUrl", "");
+				cam.templatePath = item.value("template", "");
+				cam.recording = item.value("recording", "");
+				if (cam.id > 0) cameras.push_back(cam);
+			}
+		} catch (...) {
+			// Catch JSON parsing errors
+		}
+		return cameras;
+	}
+
+	static void SaveCameras(const std::vector<CameraConfig>& cameras) {
+		CreateDirectoryA("C:\\camera_ids", NULL);
+		json j = json::array();
+		for (const auto& cam : cameras) {
+			json item = {
+				{"id", cam.id},
+				{"name", cam.name},
+				{"rtspUrl", cam.rtspUrl}
+			};
+			if (!cam.templatePath.empty()) item["template"] = cam.templatePath;
+			if (!cam.recording.empty()) item["recording"] = cam.recording;
+			j.push_back(item);
+		}
+		std::ofstream file(PlatformPath("C:\\camera_ids\\cameras.json"));
+		if (file.is_open()) {
+			file << j.dump(4);
+		}
+	}
+};
+
+extern MjpegServer* g_globalWebServer;
+const int NETWORK_BUFFER_SIZE = 5;    // Network jitter buffer
+const int LOW_LATENCY_BUFFER_SIZE = 1; // [LOW LATENCY] Backend queue when the latest-frame grabber is on
+const int MAX_DRAIN_GRABS_ONLINE = 30; // [LOW LATENCY] Upper bound of stale frames skipped per read
+const int DECODE_POLICY_CHECK_MS = 1000; // [DECODE SKIP] How often the decode policy is re-evaluated
+const int DECODE_POLICY_VOTES = 3;       // [DECODE SKIP] Consecutive checks needed before switching
+const int PROCESSING_WIDTH_ONLINE = YOLO_INPUT_SIZE; // [REDUCED RES] Width of the frame inference/rendering work on
+const int FULL_RES_RING_SIZE_ONLINE = 8;             // [REDUCED RES] Native frames kept for snapshots / raw_frame
+
+// [REDUCED RES] Native-resolution frame, converted only when someone asks for it
+struct FullResFrame_Online {
+	long long seq = 0;
+	std::function<cv::Mat()> materialize;
+};
+
+// [VIOLATIONS] One recorded violation, handed to the UI (if any) after it has been persisted
+struct ViolationEvent {
+	int cameraId = 0;
+	int carId = 0;
+	std::string type;         // "Overstay", "Wrong Parking" or "Wrong Vehicle Type"
+	long long epochMs = 0;
+	std::string timeText;     // HH:MM:SS local time
+	std::string snapshotPath; // Empty when no snapshot was written
+	cv::Mat crop;             // Vehicle crop from the processing frame
+	cv::Mat visualization;    // Darkened native frame with the vehicle highlighted
+};
+using ViolationCallback = void (*)(int cameraId, const ViolationEvent& ev);
+const int RECENT_VIOLATIONS_ONLINE = 20; // Kept per camera for /api/stats
+
+// CAMERA INSTANCE CLASS DEFINITION REPLACED
+
+
+PLATFORM_SELECTANY std::mutex g_aiMutex_online;
+PLATFORM_SELECTANY ViolationCallback g_onViolationRecorded = nullptr; // Set by the WinForms UI, null in the daemon
+extern int g_selectedGpuId;
+const int MAX_FRAME_LAG_ONLINE = 10; // Relaxed from 3 to 10 frames
+
+class CameraInstance {
+public:
+    int camera_id = 0;
+    CameraConfig config;
+    
+    CameraInstance(const CameraConfig& cfg) : config(cfg) {
+        camera_id = cfg.id;
+        g_recordingMode_online = ParseRecordingMode(cfg.recording);
+        g_latency_online = &g_latencyRegistry.Get(camera_id);
+        g_metrics_online.init(camera_id);
+        traceSourceToken_ = g_traceRecorder.AddExternalSource([this]() { return CollectOrtProfile_Online(); });
+    }
+    ~CameraInstance() {
+        g_traceRecorder.RemoveExternalSource(traceSourceToken_);
+        StopProcessing();
+        if (g_cap) {
+            if (g_cap->isOpened()) g_cap->release();
+            delete g_cap;
+            g_cap = nullptr;
+        }
+		if (g_onnx_net) { delete g_onnx_net; g_onnx_net = nullptr; }
+		if (g_tracker) { delete g_tracker; g_tracker = nullptr; }
+		if (g_pm_logic_online) { delete g_pm_logic_online; g_pm_logic_online = nullptr; }
+		if (g_pm_display_online) { delete g_pm_display_online; g_pm_display_online = nullptr; }
+		if (g_mjpegServer_online) { delete g_mjpegServer_online; g_mjpegServer_online = nullptr; }
+    }
+
+	OnlineAppState g_onlineState;
+	std::mutex g_onlineStateMutex;
+	int traceSourceToken_ = 0; // [TRACE] This camera's ORT profile source
+
+	// ==========================================
+	//  LAYER 2: LOGIC & BACKEND
+	// ==========================================
+
+	// cv::dnn::Net* g_net = nullptr; // [DEPRECATED] Old OpenCV DNN
+	OnnxYoloInference* g_onnx_net = nullptr; // [GPU] New ONNX Runtime
+	std::vector<std::string> g_classes;
+	std::vector<cv::Scalar> g_colors;
+	BYTETracker* g_tracker = nullptr;
+
+	ParkingManager* g_pm_logic_online = nullptr;
+
+	cv::VideoCapture* g_cap = nullptr;
+	cv::Mat g_latestRawFrame;            // Processing-resolution frame
+	long long g_frameSeq_online = 0;
+	std::deque<FullResFrame_Online> g_fullResRing_online; // Guarded by g_frameMutex
+	FrameTimestamps g_latestRawTs_online;                 // Guarded by g_frameMutex
+	std::atomic<bool> g_reducedResDecode_online{true};
+	std::mutex g_frameMutex;
+	std::atomic<int> g_connectionAttemptId_online{0}; // [NEW] Prevent race conditions on multiple connect clicks
+	double g_cameraFPS = 30.0;
+
+	// *** [NEW] PROCESSED FRAME SHARING ***
+	cv::Mat g_processedFrame_online;
+	long long g_processedSeq_online = 0;
+	FrameTimestamps g_processedTs_online; // Guarded by g_processedMutex_online
+	MetadataFrame g_processedMeta_online; // [WEBSOCKET] What g_processedFrame_online shows; guarded by g_processedMutex_online
+	std::mutex g_processedMutex_online;
+
+	// *** [LATENCY] ***
+	LatencyTracker* g_latency_online = nullptr; // Owned by g_latencyRegistry
+	FrameTimestamps g_frameTs_online;           // Frame currently in the processing thread
+	CameraMetrics_Online g_metrics_online;      // [METRICS]
+
+	// *** [TRACE] ORT profile, collected once per model load and kept for later dumps ***
+	std::vector<ExternalTraceEvent> g_ortProfileEvents_online;
+	std::mutex g_ortProfileMutex_online;
+
+	inline std::vector<ExternalTraceEvent> CollectOrtProfile_Online() {
+		std::string path;
+		long long startNs = 0;
+		{
+			std::lock_guard<std::mutex> lock(g_aiMutex_online);
+			if (g_onnx_net && g_onnx_net->isProfiling()) path = g_onnx_net->endProfiling(startNs);
+		}
+		std::lock_guard<std::mutex> lock(g_ortProfileMutex_online);
+		if (!path.empty()) {
+			g_ortProfileEvents_online = LoadOrtProfile(path, startNs, camera_id * 1000);
+			OutputDebugStringA(("[TRACE] Merged ORT profile " + path + " (" + std::to_string(g_ortProfileEvents_online.size()) + " events)\n").c_str());
+		}
+		return g_ortProfileEvents_online;
+	}
+	std::atomic<int> g_droppedFrames_online{0}; // Reader thread adds, UI/API threads read
+	int g_processedFramesCount_online = 0;
+	std::chrono::steady_clock::time_point g_lastViolationCheck_online;
+
+	// *** Threading for Headless Mode (Multi-camera safety) ***
+	std::thread* readerThread_online = nullptr;
+	std::thread* processingThread_online = nullptr;
+	std::atomic<bool> isProcessing{false};
+	std::atomic<bool> shouldStop{false};
+	long long lastProcessedSeq = -1;
+	bool g_modelReady = false; // [PHASE 14] Model ready flag moved to instance
+
+	// *** [LOW LATENCY] Latest-frame grabber ***
+	std::atomic<bool> g_lowLatencyCapture_online{true};
+	FrameAgeMonitor_Online g_frameAge_online;          // Reader thread only
+	std::atomic<double> g_avgCaptureAgeMs_online{-1.0}; // Published for overlay/stats (-1 = no timestamps)
+
+	// *** [DECODE SKIP] Decode-level frame dropping (LibavCapture only) ***
+	double g_avgProcessMs_online = 0.0;                  // Processing thread only
+	std::chrono::steady_clock::time_point g_lastPolicyCheck_online;
+	DecodePolicy g_pendingPolicy_online = DecodePolicy::ALL_FRAMES;
+	int g_pendingPolicyVotes_online = 0;
+	std::atomic<int> g_decodePolicy_online{(int)DecodePolicy::ALL_FRAMES};
+
+	// Drain everything the backend has already buffered and decode only the newest frame.
+	// A grab() that returns almost instantly came out of the buffer; one that blocks for a good
+	// part of a frame interval waited on the network, so that frame is the live edge.
+	inline bool GrabLatestFrame(cv::Mat& outFrame) {
+		double tickFreq = cv::getTickFrequency();
+		double liveEdgeMs = (std::max)(2.0, 250.0 / g_cameraFPS); // a quarter of a frame interval
+		int grabs = 0;
+
+		TraceSpan drainSpan("capture.grab", "capture", camera_id);
+		while (grabs < MAX_DRAIN_GRABS_ONLINE) {
+			long long t0 = cv::getTickCount();
+			if (!g_cap->grab()) {
+				if (grabs == 0) return false;
+				break;
+			}
+			grabs++;
+			double grabMs = (cv::getTickCount() - t0) * 1000.0 / tickFreq;
+			if (grabMs >= liveEdgeMs) break;
+		}
+		if (grabs > 1) {
+			g_droppedFrames_online += grabs - 1;
+			g_metrics_online.framesDroppedReader->inc(grabs - 1);
+		}
+
+		drainSpan.end();
+
+		{
+			TRACE_SPAN_CAM("capture.retrieve", camera_id);
+			if (!g_cap->retrieve(outFrame) || outFrame.empty()) return false;
+		}
+
+		double wallMs = cv::getTickCount() * 1000.0 / tickFreq;
+		if (g_frameAge_online.update(g_cap->get(cv::CAP_PROP_POS_MSEC), wallMs)) {
+			g_avgCaptureAgeMs_online.store(g_frameAge_online.avgAgeMs);
+			g_latency_online->recordCaptureAgeMs(g_frameAge_online.lastAgeMs);
+		}
+		return true;
+	}
+
+	// Pick how much of the stream the decoder may skip from the rate processing can sustain.
+	// Uses processing time rather than processed FPS: the latter is capped by whatever we decode.
+	inline void UpdateDecodePolicy_Online(double processMs) {
+		if (processMs <= 0) return;
+		if (g_avgProcessMs_online == 0) g_avgProcessMs_online = processMs;
+		else g_avgProcessMs_online = g_avgProcessMs_online * 0.9 + processMs * 0.1;
+
+		auto now = std::chrono::steady_clock::now();
+		if (std::chrono::duration_cast<std::chrono::milliseconds>(now - g_lastPolicyCheck_online).count() < DECODE_POLICY_CHECK_MS) return;
+		g_lastPolicyCheck_online = now;
+
+		std::lock_guard<std::mutex> lock(g_frameMutex); // g_cap is swapped under this mutex
+		LibavCapture* avCap = dynamic_cast<LibavCapture*>(g_cap);
+		if (!avCap) return;
+
+		double capacityFps = 1000.0 / g_avgProcessMs_online;
+		int gop = avCap->gopFrames();
+		double keyframeFps = gop > 0 ? g_cameraFPS / gop : 0.0;
+
+		DecodePolicy wanted = DecodePolicy::REFERENCE_ONLY;
+		if (capacityFps >= g_cameraFPS * 0.9) wanted = DecodePolicy::ALL_FRAMES;
+		else if (keyframeFps > 0 && capacityFps <= keyframeFps * 1.5) wanted = DecodePolicy::KEYFRAME_ONLY;
+
+		if (wanted == avCap->getDecodePolicy()) {
+			g_pendingPolicyVotes_online = 0;
+			return;
+		}
+		if (wanted != g_pendingPolicy_online) {
+			g_pendingPolicy_online = wanted;
+			g_pendingPolicyVotes_online = 0;
+		}
+		if (++g_pendingPolicyVotes_online < DECODE_POLICY_VOTES) return;
+
+		avCap->setDecodePolicy(wanted);
+		g_decodePolicy_online.store((int)wanted);
+		g_metrics_online.decodePolicy->set((double)wanted);
+		g_pendingPolicyVotes_online = 0;
+
+		char msg[256];
+		sprintf_s(msg, "[DECODE SKIP] Camera %d: policy -> %d (capacity %.1f FPS, camera %.1f FPS, GOP %d)\n",
+			camera_id, (int)wanted, capacityFps, g_cameraFPS, gop);
+		OutputDebugStringA(msg);
+	}
+
+	// Brings a captured frame down to processing width and returns how to get the native one back.
+	// LibavCapture already scaled during colour conversion; other backends are resized here.
+	inline std::function<cv::Mat()> PrepareCapturedFrame_Online(cv::Mat& frame) {
+		LibavCapture* avCap = dynamic_cast<LibavCapture*>(g_cap);
+		if (avCap && avCap->getOutputWidth() > 0) {
+			return avCap->fullResMaterializer();
+		}
+
+		cv::Mat native = frame;
+		if (g_reducedResDecode_online.load() && frame.cols > PROCESSING_WIDTH_ONLINE) {
+			double scale = (double)PROCESSING_WIDTH_ONLINE / frame.cols;
+			cv::Mat scaled;
+			cv::resize(frame, scaled, cv::Size(), scale, scale, cv::INTER_AREA);
+			frame = scaled;
+		}
+		return [native]() { return native; };
+	}
+
+	// Caller holds g_frameMutex
+	inline void PublishCapturedFrameLocked_Online(const cv::Mat& frame, std::function<cv::Mat()> fullRes) {
+		g_latestRawFrame = frame;
+		g_frameSeq_online++;
+		g_latestRawTs_online = FrameTimestamps();
+		g_latestRawTs_online.seq = g_frameSeq_online;
+		g_latestRawTs_online.mark(STAGE_CAPTURE);
+		g_metrics_online.framesCaptured->inc();
+
+		FullResFrame_Online entry;
+		entry.seq = g_frameSeq_online;
+		entry.materialize = std::move(fullRes);
+		g_fullResRing_online.push_back(std::move(entry));
+		while ((int)g_fullResRing_online.size() > FULL_RES_RING_SIZE_ONLINE) g_fullResRing_online.pop_front();
+	}
+
+	inline void PublishCapturedFrameLocked_Online(cv::Mat frame) {
+		std::function<cv::Mat()> fullRes = PrepareCapturedFrame_Online(frame);
+		PublishCapturedFrameLocked_Online(frame, std::move(fullRes));
+	}
+
+	// Native-resolution frame `seq` (newest when seq < 0). Empty once it has left the ring.
+	inline cv::Mat GetFullResFrame_Online(long long seq = -1) {
+		std::function<cv::Mat()> materialize;
+		{
+			std::lock_guard<std::mutex> lock(g_frameMutex);
+			for (auto it = g_fullResRing_online.rbegin(); it != g_fullResRing_online.rend(); ++it) {
+				if (seq < 0 || it->seq == seq) {
+					materialize = it->materialize;
+					break;
+				}
+			}
+		}
+		if (!materialize) return cv::Mat();
+		try { return materialize(); }
+		catch (...) { return cv::Mat(); }
+	}
+
+	// [METRICS] Per-frame gauges/histograms, processing thread only
+	inline void UpdatePipelineMetrics_Online(long long seq, double processMs) {
+		g_metrics_online.processingSeconds->observe(processMs / 1000.0);
+		long long inferenceUs = g_frameTs_online.stageUs(STAGE_INFERENCE);
+		if (inferenceUs >= 0) g_metrics_online.inferenceSeconds->observe(inferenceUs / 1e6);
+
+		long long latestSeq;
+		{
+			std::lock_guard<std::mutex> lock(g_frameMutex);
+			latestSeq = g_frameSeq_online;
+		}
+		g_metrics_online.frameQueueLag->set((double)(latestSeq > seq ? latestSeq - seq : 0));
+
+		{
+			std::lock_guard<std::mutex> lock(g_aiMutex_online);
+			if (g_tracker) g_metrics_online.trackerTracks->set(g_tracker->getTrackCount());
+		}
+
+		if (g_parkingEnabled_online.load() && g_pm_logic_online) {
+			int empty = 0, occupied = 0, illegal = 0;
+			for (const auto& slot : g_pm_logic_online->getSlots()) {
+				if (slot.status == SlotStatus::EMPTY) empty++;
+				else if (slot.status == SlotStatus::ILLEGAL) illegal++;
+				else occupied++;
+			}
+			g_metrics_online.slotsEmpty->set(empty);
+			g_metrics_online.slotsOccupied->set(occupied);
+			g_metrics_online.slotsIllegal->set(illegal);
+		}
+	}
+
+	inline void CameraReaderLoop() {
+		g_traceRecorder.SetThreadName("camera " + std::to_string(camera_id) + " reader");
+		g_frameAge_online.reset();
+		g_avgCaptureAgeMs_online.store(-1.0);
+
+		while (!shouldStop) {
+			cv::Mat tempFrame;
+			bool success = false;
+			bool lowLatency = g_lowLatencyCapture_online.load();
+
+			if (g_cap && g_cap->isOpened()) {
+				success = lowLatency ? GrabLatestFrame(tempFrame) : g_cap->read(tempFrame);
+				if (success && !tempFrame.empty()) {
+					std::function<cv::Mat()> fullRes = PrepareCapturedFrame_Online(tempFrame);
+					{
+						std::lock_guard<std::mutex> lock(g_frameMutex);
+						PublishCapturedFrameLocked_Online(tempFrame, std::move(fullRes));
+					}
+					// The blocking grab() already paces the low-latency path
+					if (!lowLatency) std::this_thread::sleep_for(std::chrono::milliseconds(5));
+					continue;
+				}
+			} else {
+				break;
+			}
+		}
+	}
+
+	inline void ProcessingLoopHeadless();
+
+	inline void StartProcessing() {
+		shouldStop = false;
+		isProcessing = true;
+		
+		g_droppedFrames_online = 0;
+		g_processedFramesCount_online = 0;
+		g_lastViolationCheck_online = std::chrono::steady_clock::now();
+		
+		{
+			std::lock_guard<std::mutex> lock(g_onlineStateMutex);
+			g_onlineState = OnlineAppState();
+		}
+		ResetParkingCache_Online();
+		ResetParkingSessions_Online();
+
+		if (processingThread_online == nullptr) {
+			processingThread_online = new std::thread(&CameraInstance::ProcessingLoopHeadless, this);
+		}
+		StartPassthroughRecording_Online();
+		if (readerThread_online == nullptr) {
+			readerThread_online = new std::thread(&CameraInstance::CameraReaderLoop, this);
+		}
+	}
+
+	inline void StopProcessing() {
+		shouldStop = true;
+		isProcessing = false;
+		
+		if (readerThread_online) {
+			if (readerThread_online->joinable()) readerThread_online->join();
+			delete readerThread_online;
+			readerThread_online = nullptr;
+		}
+		if (processingThread_online) {
+			if (processingThread_online->joinable()) processingThread_online->join();
+			delete processingThread_online;
+			processingThread_online = nullptr;
+		}
+		ResetParkingSessions_Online();
+		StopPassthroughRecording_Online();
+
+		if (g_mjpegServer_online) {
+			g_mjpegServer_online->Stop();
+			delete g_mjpegServer_online;
+			g_mjpegServer_online = nullptr;
+		}
+
+		StopVideoRecordingThread_Online();
+	}
+
+	// ============================================================
+	//  [PHASE 1] VIDEO DVR RECORDING (60-SECOND CHUNKS)
+	// ============================================================
+	// [DVR] Only guards the recorder pointers below; no disk I/O ever happens under it
+	std::mutex g_videoWriterMutex_online;
+	AnnotatedClipRecorder* g_annotatedRecorder_online = nullptr; // Owned by the recording thread
+
+	// [PASSTHROUGH] Set from cameras.json; falls back to annotated when the capture isn't LibavCapture
+	RecordingMode g_recordingMode_online = RecordingMode::ANNOTATED;
+	PassthroughRecorder* g_passthroughRecorder_online = nullptr; // Guarded by g_videoWriterMutex_online
+	std::atomic<bool> g_passthroughActive_online{false};         // Lock-free check for the AI thread
+
+	// [METADATA] Clip currently being recorded (either mode), published by whichever recorder opened it
+	std::mutex g_dvrClipMutex_online;
+	std::string g_dvrClipRelPath_online;
+	long long g_dvrClipStartUs_online = 0;     // Steady clock, the clip's t = 0
+	MetadataTrackWriter g_metadataTrack_online; // Processing thread only
+	std::string g_metadataClipRelPath_online;   // Clip the open track belongs to
+
+	// *** Async Video Recording (Frame Duplication System) ***
+	std::atomic<bool> g_videoRecordingRunning{false};
+	std::thread* g_videoRecordingThread = nullptr;
+	std::mutex g_videoCurrentFrameMutex;
+	cv::Mat g_videoCurrentFrame; 
+	std::atomic<bool> g_parkingEnabled_online{false}; 
+	bool templateSet_online = false;  
+
+	// ==========================================
+	//  LAYER 3: PRESENTATION (Frontend)
+	// ==========================================
+	// [FIX] Move these variables to public area
+	public: 
+	ParkingManager* g_pm_display_online = nullptr;
+	cv::Mat g_cachedParkingOverlay_online;
+	std::map<int, SlotStatus> g_lastDrawnStatus_online;
+	cv::Mat g_drawingBuffer_online; 
+
+	// Memory pool
+	std::map<int, CachedLabel_Online> g_labelCache_online;
+	cv::Mat g_redOverlayBuffer_online;
+	FPSMonitor_Online g_fpsMonitor_online;
+
+	// *** [NEW] MJPEG SERVER ***
+	MjpegServer* g_mjpegServer_online = nullptr;
+
+	// --- Helper Functions ---
+
+	void ResetParkingCache_Online() {
+		g_cachedParkingOverlay_online = cv::Mat();
+		g_lastDrawnStatus_online.clear();
+		g_labelCache_online.clear(); // [PHASE 3] Clear label cache
+		g_redOverlayBuffer_online = cv::Mat(); // [PHASE 3] Clear red overlay buffer
+	}
+
+	// [SESSIONS] A (re)connect neither continues the last run's open sessions nor its warm-up window
+	void ResetParkingSessions_Online() {
+		long long nowMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count();
+		g_parkingSessions.Reset(camera_id, nowMs);
+	}
+
+	cv::Mat GetRawFrame() {
+		std::lock_guard<std::mutex> lock(g_frameMutex);
+		return g_latestRawFrame.clone();
+	}
+
+	cv::Mat GetProcessedFrame(long long& seq) {
+		std::lock_guard<std::mutex> lock(g_processedMutex_online);
+		seq = g_processedSeq_online;
+		return g_processedFrame_online.clone();
+	}
+
+	void OpenGlobalCamera(int cameraIndex = 0) {
+		cv::VideoCapture* temp_cap = new cv::VideoCapture(cameraIndex);
+		double temp_fps = 30.0;
+		if (temp_cap->isOpened()) {
+			temp_fps = temp_cap->get(cv::CAP_PROP_FPS);
+			if (temp_fps <= 0) temp_fps = 30.0;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(g_frameMutex);
+			if (g_cap) { delete g_cap; g_cap = nullptr; }
+			g_cap = temp_cap;
+			g_frameSeq_online = 0;
+			g_fullResRing_online.clear();
+			g_cameraFPS = temp_fps;
+		}
+
+		ResetParkingCache_Online();
+		
+		std::lock_guard<std::mutex> slock(g_onlineStateMutex);
+		g_onlineState = OnlineAppState();
+	}
+
+	void OpenGlobalCameraFromIP(const std::string& rtspUrl, int attemptId = -1) {
+		cv::VideoCapture* temp_cap = nullptr;
+		double temp_fps = 30.0;
+
+		bool isNetwork = rtspUrl.find("http://") == 0 || rtspUrl.find("rtsp://") == 0 || rtspUrl.find("https://") == 0;
+		if (isNetwork) {
+			// [DECODE SKIP] Prefer the direct libav backend so the decoder can drop frames under overload
+			OutputDebugStringA(("[LIBAV] Opening network stream for camera " + std::to_string(camera_id) + ": " + rtspUrl + "\n").c_str());
+			LibavCapture* av_cap = new LibavCapture();
+			av_cap->set(cv::CAP_PROP_OPEN_TIMEOUT_MSEC, 5000);
+			if (av_cap->open(rtspUrl)) {
+				temp_cap = av_cap;
+			} else {
+				delete av_cap;
+				if (attemptId != -1 && attemptId != g_connectionAttemptId_online.load()) return;
+			}
+		}
+		if (isNetwork && !temp_cap) {
+			OutputDebugStringA(("[OPENCV] Opening network stream with timeout (Auto Backend) for camera " + std::to_string(camera_id) + ": " + rtspUrl + "\n").c_str());
+			temp_cap = new cv::VideoCapture();
+			
+			// [FIX] Set connection timeout to prevent hanging (5 seconds)
+			temp_cap->set(cv::CAP_PROP_OPEN_TIMEOUT_MSEC, 5000); // 5 second timeout
+			
+			bool opened = temp_cap->open(rtspUrl);
+			
+			if (attemptId != -1 && attemptId != g_connectionAttemptId_online.load()) {
+				delete temp_cap; return;
+			}
+
+			if (!opened || !temp_cap->isOpened()) {
+				OutputDebugStringA(("[OPENCV] Auto Backend failed or timeout for camera " + std::to_string(camera_id) + ". Trying CAP_FFMPEG explicitly...\n").c_str());
+				delete temp_cap;
+				
+				if (attemptId != -1 && attemptId != g_connectionAttemptId_online.load()) return;
+				
+				temp_cap = new cv::VideoCapture();
+				temp_cap->set(cv::CAP_PROP_OPEN_TIMEOUT_MSEC, 5000);
+				temp_cap->open(rtspUrl, cv::CAP_FFMPEG);
+			}
+		} else if (!isNetwork) {
+			OutputDebugStringA(("[OPENCV] Opening local stream for camera " + std::to_string(camera_id) + ": " + rtspUrl + "\n").c_str());
+			temp_cap = new cv::VideoCapture(rtspUrl);
+		}
+		
+		if (attemptId != -1 && attemptId != g_connectionAttemptId_online.load()) {
+			if (temp_cap) delete temp_cap;
+			return;
+		}
+
+		// [FIX] Network stream optimization
+		if (temp_cap && temp_cap->isOpened()) {
+			// getBackendName() throws for LibavCapture (no OpenCV backend behind it)
+			std::string backendName = dynamic_cast<LibavCapture*>(temp_cap) ? std::string("LIBAV (direct)") : std::string(temp_cap->getBackendName());
+			OutputDebugStringA(("[OPENCV] Stream opened successfully for camera " + std::to_string(camera_id) + "! Backend API used: " + backendName + "\n").c_str());
+			temp_cap->set(cv::CAP_PROP_BUFFERSIZE, g_lowLatencyCapture_online.load() ? LOW_LATENCY_BUFFER_SIZE : NETWORK_BUFFER_SIZE); // Reduce latency
+			if (LibavCapture* av = dynamic_cast<LibavCapture*>(temp_cap)) {
+				// [REDUCED RES] Scale inside the single sws pass instead of converting full-res first
+				av->setOutputWidth(g_reducedResDecode_online.load() ? PROCESSING_WIDTH_ONLINE : 0);
+			}
+			temp_fps = temp_cap->get(cv::CAP_PROP_FPS);
+			if (temp_fps <= 0) temp_fps = 30.0;
+		} else {
+			OutputDebugStringA(("[OPENCV ERROR] Failed to open stream (connection timeout or invalid URL) for camera " + std::to_string(camera_id) + ": " + rtspUrl + "\n").c_str());
+		}
+		
+		{
+			std::lock_guard<std::mutex> lock(g_frameMutex);
+			if (g_cap) { delete g_cap; g_cap = nullptr; }
+			g_cap = temp_cap;
+			g_frameSeq_online = 0;
+			g_fullResRing_online.clear();
+			g_cameraFPS = temp_fps;
+			g_decodePolicy_online.store((int)DecodePolicy::ALL_FRAMES);
+		}
+
+		ResetParkingCache_Online();
+		
+		std::lock_guard<std::mutex> slock(g_onlineStateMutex);
+		g_onlineState = OnlineAppState();
+	}
+
+	void InitGlobalModel(const std::string& modelPath) {
+		// Use the global ai mutex, it is defined far below
+		g_modelReady = false;
+		if (g_onnx_net) { delete g_onnx_net; g_onnx_net = nullptr; }
+		if (g_tracker) { delete g_tracker; g_tracker = nullptr; }
+
+		try {
+			// Use ONNX Runtime with GPU acceleration and user-selected Device ID
+			g_onnx_net = new OnnxYoloInference();
+			// [TRACE] PARKING_ORT_PROFILE=1 turns on ORT's profiler; merged into the next /api/trace dump
+			const char* ortProfile = std::getenv("PARKING_ORT_PROFILE");
+			if (ortProfile && ortProfile[0] == '1') {
+				CreateDirectoryA("C:\\smart_parking_trace", NULL);
+				g_onnx_net->setProfilingPrefix(PlatformPath("C:\\smart_parking_trace\\ort_camera_" + std::to_string(camera_id)));
+			}
+			if (!g_onnx_net->loadModel(modelPath, true, g_selectedGpuId)) { // true = use GPU, pass ID
+				delete g_onnx_net;
+				g_onnx_net = nullptr;
+				OutputDebugStringA(("[ERROR] Failed to load ONNX model with GPU for camera " + std::to_string(camera_id) + "\n").c_str());
+				return;
+			}
+			
+			g_tracker = new BYTETracker(90, 0.25f);
+			
+			OutputDebugStringA(("[INFO] Online mode with ONNX Runtime GPU + ByteTrack for camera " + std::to_string(camera_id) + "\n").c_str());
+
+			g_classes = {
+				"person", "bicycle", "Car", "Motorcycle", "airplane", "bus", "train", "Van"
+			}; // index 2=Car, 3=Motorcycle, 7=Van
+
+			g_colors.clear();
+			for (size_t i = 0; i < g_classes.size(); i++) {
+				g_colors.push_back(cv::Scalar(rand() % 255, rand() % 255, rand() % 255));
+			}
+			g_modelReady = true;
+		}
+		catch (...) {
+			if (g_onnx_net) { delete g_onnx_net; g_onnx_net = nullptr; }
+			if (g_tracker) { delete g_tracker; g_tracker = nullptr; }
+		}
+	}
+
+	// [NEW] โหลด Parking Template
+	bool LoadParkingTemplate_Online(const std::string& filename) {
+		ResetParkingCache_Online();
+		templateSet_online = false; // [FIX] Force the engine to register the new template frame geometry
+
+		if (!g_pm_logic_online) g_pm_logic_online = new ParkingManager();
+		if (!g_pm_display_online) g_pm_display_online = new ParkingManager();
+
+		bool s1 = g_pm_logic_online->loadTemplate(filename);
+		bool s2 = g_pm_display_online->loadTemplate(filename);
+
+		if (s1 && s2) {
+			g_parkingEnabled_online.store(true); // [PHASE 1 FIX] Use atomic store
+			return true;
+		}
+		return false;
+	}
+
+// ==========================================
+//  LAYER 3: PRESENTATION (Frontend)
+// ==========================================
+
+// *** [NEW] PROCESSED FRAME SHARING (Pipeline Output) moved to CameraInstance ***
+
+// *** [PHASE 2] PERFORMANCE OPTIMIZATION ***
+// We initialize g_lastViolationCheck_online below where the definition runs.
+
+// *** [PHASE 3] MEMORY OPTIMIZATION ***
+
+// --- Helper Functions ---
+
+inline cv::Mat FormatToLetterbox(const cv::Mat& source, int width, int height, float& ratio, int& dw, int& dh) {
+	if (source.empty()) return cv::Mat();
+
+	float r = (std::min)((float)width / source.cols, (float)height / source.rows);
+	int new_unpad_w = (int)round(source.cols * r);
+	int new_unpad_h = (int)round(source.rows * r);
+
+	dw = (width - new_unpad_w) / 2;
+    dh = (height - new_unpad_h) / 2;
+
+	cv::Mat resized;
+	if (source.cols != new_unpad_w || source.rows != new_unpad_h) {
+		cv::resize(source, resized, cv::Size(new_unpad_w, new_unpad_h));
+	}
+	else {
+		resized = source.clone();
+	}
+
+	cv::Mat result(height, width, CV_8UC3, cv::Scalar(114, 114, 114));
+	resized.copyTo(result(cv::Rect(dw, dh, new_unpad_w, new_unpad_h)));
+	ratio = r;
+	return result;
+}
+
+// [FIX] Moved the stray code away because it was causing compile errors.
+	
+/*
+	cv::Mat result = fullFrame.clone();
+	result = result * 0.3;
+	
+	cv::Rect safeBbox = carBox & cv::Rect(0, 0, fullFrame.cols, fullFrame.rows);
+	if (safeBbox.area() > 0) {
+		cv::Mat carROI = fullFrame(safeBbox).clone();
+		carROI.copyTo(result(safeBbox));
+		cv::rectangle(result, safeBbox, cv::Scalar(0, 255, 255), 3);
+	}
+	
+	return result;
+}
+*/
+
+// *** WORKER PROCESS (AI Thread) ***
+
+inline void ProcessFrameOnline(const cv::Mat& inputFrame, long long frameSeq) {
+	{
+		std::lock_guard<std::mutex> lock(g_aiMutex_online);
+		if (inputFrame.empty() || !g_onnx_net || !g_modelReady || !g_tracker) return;
+	}
+
+	try {
+		TraceSpan preprocessSpan("preprocess", "pipeline", camera_id);
+		cv::Mat workingImage = inputFrame.clone();
+		float ratio; int dw, dh;
+		cv::Mat input_image = FormatToLetterbox(workingImage, YOLO_INPUT_SIZE, YOLO_INPUT_SIZE, ratio, dw, dh);
+		if (input_image.empty()) return;
+
+		cv::Mat blob;
+		cv::dnn::blobFromImage(input_image, blob, 1.0 / 255.0, cv::Size(YOLO_INPUT_SIZE, YOLO_INPUT_SIZE), cv::Scalar(), true, false);
+		g_frameTs_online.mark(STAGE_PREPROCESS);
+		preprocessSpan.end();
+
+		std::vector<cv::Mat> outputs;
+		{
+			std::lock_guard<std::mutex> lock(g_aiMutex_online);
+			TRACE_SPAN_CAM("OrtSession::Run", camera_id);
+			if (!g_onnx_net->forward(blob, outputs)) return; // [GPU] ONNX Runtime inference
+		}
+		g_frameTs_online.mark(STAGE_INFERENCE);
+
+		if (outputs.empty() || outputs[0].empty()) return;
+
+		cv::Mat output_data = outputs[0];
+		int rows = output_data.size[1];
+		int dimensions = output_data.size[2];
+
+		if (output_data.dims == 3) {
+			output_data = output_data.reshape(1, rows);
+			// Only transpose if we have a format like YOLOv8 (e.g., 84x8400)
+			if (dimensions > rows) {
+				cv::transpose(output_data, output_data);
+			}
+			rows = output_data.rows;
+			dimensions = output_data.cols;
+		}
+		else {
+			output_data = output_data.reshape(1, output_data.size[1]);
+			if (output_data.cols > output_data.rows) {
+				cv::Mat output_t;
+				cv::transpose(output_data, output_t);
+				output_data = output_t;
+			}
+			rows = output_data.rows;
+			dimensions = output_data.cols;
+		}
+
+		TraceSpan decodeSpan("yolo.decode", "pipeline", camera_id);
+		float* data = (float*)output_data.data;
+		std::vector<int> class_ids;
+		std::vector<float> confs;
+		std::vector<cv::Rect> boxes;
+
+		// Check output format: yolo26s uses [cx, cy, w, h, conf, class] (6 cols)
+		bool is_yolo26s_format = (dimensions == 6);
+
+		for (int i = 0; i < rows; i++) {
+			if (is_yolo26s_format) {
+				// yolo26s format: [x1, y1, x2, y2, conf, class_id] (Absolute Coordinates)
+				float x1_lb = data[0];
+				float y1_lb = data[1];
+				float x2_lb  = data[2];
+				float y2_lb  = data[3];
+				float conf  = data[4];
+				int cls     = (int)data[5];
+
+				// Only detect: Car (2), Motorcycle (3), Van/Truck (7)
+				bool is_vehicle = (cls == 2 || cls == 3 || cls == 7);
+
+				if (conf > CONF_THRESHOLD && is_vehicle) {
+					// Convert from letterbox corner coordinates back to original image coordinates
+					float left   = (x1_lb - dw) / ratio;
+					float top    = (y1_lb - dh) / ratio;
+					float right  = (x2_lb - dw) / ratio;
+					float bottom = (y2_lb - dh) / ratio;
+
+					float width  = right - left;
+					float height = bottom - top;
+
+					// Sanity check
+					if (width > 0 && height > 0) {
+						boxes.push_back(cv::Rect((int)left, (int)top, (int)width, (int)height));
+						confs.push_back(conf);
+						class_ids.push_back(cls);
+					}
+				}
+			}
+			else {
+				// Standard YOLO format: [x_center, y_center, w, h, class_0_conf, class_1_conf, ...]
+				int num_classes = dimensions - 4;
+				if (num_classes > 0) {
+					float* classes_scores = data + 4;
+					cv::Mat scores(1, num_classes, CV_32FC1, classes_scores);
+					cv::Point class_id;
+					double max_class_score;
+					cv::minMaxLoc(scores, 0, &max_class_score, 0, &class_id);
+
+					// Only detect: Car (2), Motorcycle (3), Van/Truck (7)
+					bool is_vehicle = (class_id.x == 2 || class_id.x == 3 || class_id.x == 7);
+
+					if (max_class_score > CONF_THRESHOLD && is_vehicle) {
+						float x = data[0]; 
+						float y = data[1]; 
+						float w = data[2]; 
+						float h = data[3];
+
+						float left = (float)((x - 0.5 * w - dw) / ratio);
+						float top = (float)((y - 0.5 * h - dh) / ratio);
+						float width = w / ratio;
+						float height = h / ratio;
+
+						if (width > 0 && height > 0) {
+							boxes.push_back(cv::Rect((int)left, (int)top, (int)width, (int)height));
+							confs.push_back((float)max_class_score);
+							class_ids.push_back(class_id.x);
+						}
+					}
+				}
+			}
+			data += dimensions;
+		}
+		decodeSpan.end();
+
+		std::vector<int> nms;
+		{
+			TRACE_SPAN_CAM("NMSBoxes", camera_id);
+			cv::dnn::NMSBoxes(boxes, confs, CONF_THRESHOLD, NMS_THRESHOLD, nms);
+		}
+
+		std::vector<cv::Rect> nms_boxes;
+		std::vector<int> nms_class_ids;
+		std::vector<float> nms_confs;
+		
+		for (int idx : nms) {
+			nms_boxes.push_back(boxes[idx]);
+			nms_class_ids.push_back(class_ids[idx]);
+			nms_confs.push_back(confs[idx]);
+		}
+		g_frameTs_online.mark(STAGE_POSTPROCESS);
+
+		std::vector<TrackedObject> trackedObjs;
+		{
+			std::lock_guard<std::mutex> lock(g_aiMutex_online);
+			TRACE_SPAN_CAM("BYTETracker::update", camera_id);
+			trackedObjs = g_tracker->update(nms_boxes, nms_class_ids, nms_confs);
+		}
+
+		std::map<int, SlotStatus> calculatedStatuses;
+		std::map<int, float> calculatedOccupancy;
+		std::map<int, std::string> calculatedTypes;
+		std::set<int> violations;
+
+		bool parkingEnabled = g_parkingEnabled_online.load(); // [PHASE 1 FIX] Use atomic load
+		if (parkingEnabled && g_pm_logic_online) {
+			if (!templateSet_online) {
+				g_pm_logic_online->setTemplateFrame(inputFrame);
+				templateSet_online = true;
+			}
+			g_pm_logic_online->fitSlotsToFrame(inputFrame.size()); // [REDUCED RES] No-op unless the size changed
+
+			std::vector<SlotTransition> slotTransitions;
+			{
+				TRACE_SPAN_CAM("ParkingManager::updateSlotStatus", camera_id);
+				g_pm_logic_online->updateSlotStatus(trackedObjs, &slotTransitions);
+			}
+
+			for (const auto& slot : g_pm_logic_online->getSlots()) {
+				calculatedStatuses[slot.id] = slot.status;
+				calculatedOccupancy[slot.id] = slot.occupancyPercent;
+				calculatedTypes[slot.id] = slot.type;
+			}
+
+			if (!calculatedStatuses.empty()) {
+				long long nowMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+					std::chrono::system_clock::now().time_since_epoch()).count();
+				// [OCCUPANCY] A row per slot change; otherwise only the current minute/hour rollups are touched
+				g_occupancy.Update(camera_id, nowMs, calculatedStatuses);
+				// [SESSIONS] Arrivals open a session, departures close and log it
+				g_parkingSessions.Apply(camera_id, nowMs, slotTransitions, calculatedStatuses, calculatedTypes);
+			}
+
+			// ตรวจจับรถจอดผิด (จอดนอกช่อง หรือ จอดผิดประเภท)
+			for (const auto& car : trackedObjs) {
+				if (car.framesStill > 30) {
+					bool inAnySlot = false;
+                    bool inWrongTypeSlot = false;
+                    
+					for (const auto& slot : g_pm_logic_online->getSlots()) {
+						cv::Point center = (car.bbox.tl() + car.bbox.br()) * 0.5;
+						if (cv::pointPolygonTest(slot.polygon, center, false) >= 0) {
+							inAnySlot = true;
+                            if (slot.status == SlotStatus::ILLEGAL && slot.occupiedByTrackId == car.id) {
+                                inWrongTypeSlot = true;
+                            }
+							break;
+						}
+					}
+                    
+                    // Violation if either not in any slot OR parked in a wrong-type slot
+					if (!inAnySlot || inWrongTypeSlot) {
+						violations.insert(car.id);
+					}
+				}
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> stateLock(g_onlineStateMutex);
+			g_onlineState.cars = trackedObjs;
+			g_onlineState.slotStatuses = calculatedStatuses;
+			g_onlineState.slotOccupancy = calculatedOccupancy;
+			g_onlineState.slotTypes = calculatedTypes;
+			g_onlineState.violatingCarIds = violations;
+			g_onlineState.frameSequence = frameSeq;
+		}
+		// [LIVE] Only differences from the last published state are queued for the SSE subscribers
+		if (parkingEnabled) g_liveEvents.UpdateSlots(camera_id, calculatedStatuses, calculatedTypes, (int)violations.size());
+		g_frameTs_online.mark(STAGE_TRACK);
+	}
+	catch (...) {}
+}
+
+// *** DRAWING FUNCTION (UI Thread) - เหมือนออฟไลน์ ***
+
+inline void DrawSceneOnline(const cv::Mat& frame, long long displaySeq, cv::Mat& outResult) {
+	if (frame.empty()) return;
+
+	// [PHASE 3] Update FPS
+	g_fpsMonitor_online.update();
+
+	if (g_drawingBuffer_online.size() != frame.size() || g_drawingBuffer_online.type() != frame.type()) {
+		g_drawingBuffer_online.create(frame.size(), frame.type());
+	}
+	frame.copyTo(g_drawingBuffer_online);
+	outResult = g_drawingBuffer_online;
+
+	OnlineAppState state;
+	{
+		std::lock_guard<std::mutex> lock(g_onlineStateMutex);
+		state = g_onlineState;
+	}
+
+	bool isFuture = (state.frameSequence > displaySeq);
+
+	// Parking Layer
+	bool parkingEnabled = g_parkingEnabled_online.load(); // [PHASE 1 FIX] Use atomic load
+	if (parkingEnabled && g_pm_display_online) {
+		bool statusChanged = (state.slotStatuses != g_lastDrawnStatus_online);
+		bool noCache = g_cachedParkingOverlay_online.empty() || g_cachedParkingOverlay_online.size() != outResult.size();
+
+		if (statusChanged || noCache) {
+			g_pm_display_online->fitSlotsToFrame(outResult.size());
+			g_cachedParkingOverlay_online = cv::Mat::zeros(outResult.size(), CV_8UC3);
+			if (!state.slotStatuses.empty()) {
+				auto& displaySlots = g_pm_display_online->getSlots();
+				for (auto& slot : displaySlots) {
+					if (state.slotStatuses.count(slot.id)) {
+						slot.status = state.slotStatuses[slot.id];
+						slot.occupancyPercent = state.slotOccupancy[slot.id];
+					}
+				}
+			}
+			g_cachedParkingOverlay_online = g_pm_display_online->drawSlots(g_cachedParkingOverlay_online);
+			g_lastDrawnStatus_online = state.slotStatuses;
+		}
+
+		if (!g_cachedParkingOverlay_online.empty()) {
+			cv::add(outResult, g_cachedParkingOverlay_online, outResult);
+		}
+	}
+
+	// Car Layer
+	if (!isFuture) {
+		// [PHASE 3] Track cars in current frame for GC
+		std::set<int> currentFrameCarIds;
+		
+		for (const auto& obj : state.cars) {
+			if (obj.classId >= 0 && obj.classId < (int)g_classes.size()) {
+				currentFrameCarIds.insert(obj.id);
+				
+				cv::Rect box = obj.bbox;
+				bool isViolating = (state.violatingCarIds.count(obj.id) > 0);
+
+				if (isViolating) {
+					cv::Rect roi = box & cv::Rect(0, 0, outResult.cols, outResult.rows);
+					if (roi.area() > 0) {
+						cv::Mat roiMat = outResult(roi);
+						cv::Mat redBuf(roi.size(), CV_8UC3, cv::Scalar(0, 0, 255));
+						cv::addWeighted(roiMat, 0.6, redBuf, 0.4, 0, roiMat);
+					}
+					cv::rectangle(outResult, box, cv::Scalar(0, 0, 255), 2);
+				}
+				else {
+					cv::rectangle(outResult, box, g_colors[obj.classId], 2);
+				}
+
+				// [PHASE 3] Label Caching Logic
+				bool needsUpdate = false;
+				auto it = g_labelCache_online.find(obj.id);
+				
+				if (it == g_labelCache_online.end()) {
+					needsUpdate = true;
+				}
+				else {
+					CachedLabel_Online& cached = it->second;
+					if (cached.isViolating != isViolating || cached.classId != obj.classId) {
+						needsUpdate = true;
+					}
+					if (cached.text.empty()) needsUpdate = true;
+				}
+				
+				if (needsUpdate) {
+					CachedLabel_Online cl;
+					cl.isViolating = isViolating;
+					cl.classId = obj.classId;
+					cl.text = "ID:" + std::to_string(obj.id);
+					if (isViolating) cl.text += " [VIOLATION]";
+					else if (!parkingEnabled) cl.text += " " + g_classes[obj.classId];
+					
+					cl.size = cv::getTextSize(cl.text, cv::FONT_HERSHEY_SIMPLEX, 0.5, 1, &cl.baseline);
+					g_labelCache_online[obj.id] = cl;
+				}
+				
+				// Draw using Cache
+				CachedLabel_Online& labelInfo = g_labelCache_online[obj.id];
+				cv::Scalar labelBg = isViolating ? cv::Scalar(0, 0, 255) : g_colors[obj.classId];
+
+				cv::rectangle(outResult, cv::Point(box.x, box.y - labelInfo.size.height - 5), 
+							  cv::Point(box.x + labelInfo.size.width, box.y), labelBg, -1);
+				cv::putText(outResult, labelInfo.text, cv::Point(box.x, box.y - 5), 
+							cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(255, 255, 255), 1);
+			}
+		}
+		
+		// [PHASE 3] Cache Garbage Collection
+		if (g_labelCache_online.size() > 100 && g_labelCache_online.size() > currentFrameCarIds.size() * 2) {
+			auto it = g_labelCache_online.begin();
+			while (it != g_labelCache_online.end()) {
+				if (currentFrameCarIds.find(it->first) == currentFrameCarIds.end()) {
+					it = g_labelCache_online.erase(it);
+				}
+				else {
+					++it;
+				}
+			}
+		}
+	}
+
+	// [PHASE 3] Draw Stats (Obj count + FPS)
+	std::string stats = "Obj: " + std::to_string(state.cars.size()) + " | FPS: " + std::to_string((int)g_fpsMonitor_online.avgFPS);
+	double captureAgeMs = g_avgCaptureAgeMs_online.load();
+	if (captureAgeMs >= 0.0) stats += " | Lag: " + std::to_string((int)captureAgeMs) + "ms";
+	cv::putText(outResult, stats, cv::Point(10, 25), cv::FONT_HERSHEY_SIMPLEX, 0.7, cv::Scalar(0, 255, 0), 2);
+}
+
+// ============================================================
+//  [PHASE 1] [UNMANAGED] VIDEO RECORDING (DVR) & FPS SYNC
+// ============================================================
+
+// Paces the rendered frames to 10 FPS; the recorder's own threads encode and rotate the clips
+inline void VideoRecordingThreadFunc_Online(int width, int height) {
+	const int targetFPS = 10;
+	const int frameDelayMs = 1000 / targetFPS; // 100ms per frame
+	g_traceRecorder.SetThreadName("camera " + std::to_string(camera_id) + " recorder");
+
+	AnnotatedClipRecorder* recorder = new AnnotatedClipRecorder(camera_id, cv::Size(width, height));
+	recorder->onWrite = [this](double seconds) { g_metrics_online.recorderWriteSeconds->observe(seconds); };
+	recorder->onRotate = [this](double seconds) { g_metrics_online.recorderRotationSeconds->observe(seconds); };
+	recorder->onDrop = [this]() { g_metrics_online.recorderFramesDropped->inc(); };
+	recorder->onClipChanged = [this](const std::string& relPath, long long startUs) { SetDvrClip_Online(relPath, startUs); };
+	recorder->Start();
+	{
+		std::lock_guard<std::mutex> lock(g_videoWriterMutex_online);
+		g_annotatedRecorder_online = recorder;
+	}
+
+	auto nextFrameTime = std::chrono::steady_clock::now();
+
+	cv::Mat lastValidFrame;
+
+	while (g_videoRecordingRunning.load()) {
+		cv::Mat frameToWrite;
+		{
+			std::lock_guard<std::mutex> lock(g_videoCurrentFrameMutex);
+			if (!g_videoCurrentFrame.empty()) {
+				frameToWrite = g_videoCurrentFrame;
+				lastValidFrame = frameToWrite;
+			} else if (!lastValidFrame.empty()) {
+				frameToWrite = lastValidFrame; // Duplicate last frame to pad the timeline
+			}
+		}
+
+		// The queue only holds references: the processing thread replaces g_videoCurrentFrame, never writes into it
+		if (!frameToWrite.empty()) recorder->Push(frameToWrite);
+
+		// ALWAYS advance the clock by exactly 100ms and wait. This forces frame duplication if AI is slow
+		nextFrameTime += std::chrono::milliseconds(frameDelayMs);
+		auto now = std::chrono::steady_clock::now();
+		if (now < nextFrameTime) {
+			std::this_thread::sleep_until(nextFrameTime);
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(g_videoWriterMutex_online);
+		g_annotatedRecorder_online = nullptr;
+	}
+	recorder->Stop();
+	delete recorder;
+}
+
+// [PASSTHROUGH] Taps the capture's packets before the reader thread starts
+inline void StartPassthroughRecording_Online() {
+	LibavCapture* av = dynamic_cast<LibavCapture*>(g_cap);
+	if (g_recordingMode_online == RecordingMode::ANNOTATED || !av || !av->videoCodecParameters()) return;
+	std::lock_guard<std::mutex> lock(g_videoWriterMutex_online);
+	if (g_passthroughRecorder_online) return;
+	g_passthroughRecorder_online = new PassthroughRecorder(camera_id, av->videoCodecParameters(), av->videoTimeBase());
+	g_passthroughRecorder_online->onClipChanged = [this](const std::string& relPath, long long startUs) {
+		SetDvrClip_Online(relPath, startUs);
+	};
+	if (g_recordingMode_online == RecordingMode::EVENT) {
+		g_passthroughRecorder_online->SetEventMode(EVENT_PREROLL_SECONDS, EVENT_POSTROLL_SECONDS);
+	}
+	g_passthroughRecorder_online->Start();
+	g_passthroughActive_online.store(true);
+	PassthroughRecorder* recorder = g_passthroughRecorder_online;
+	av->setPacketTap([recorder](const AVPacket* packet) { recorder->Push(packet); });
+	OutputDebugStringA(("[PASSTHROUGH] Recording camera " + std::to_string(camera_id) + " without re-encoding"
+		+ (g_recordingMode_online == RecordingMode::EVENT ? " (event clips only)\n" : "\n")).c_str());
+}
+
+// Called once the reader thread has stopped
+inline void StopPassthroughRecording_Online() {
+	if (LibavCapture* av = dynamic_cast<LibavCapture*>(g_cap)) av->setPacketTap(nullptr);
+	PassthroughRecorder* recorder = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(g_videoWriterMutex_online);
+		recorder = g_passthroughRecorder_online;
+		g_passthroughRecorder_online = nullptr;
+		g_passthroughActive_online.store(false);
+	}
+	if (recorder) {
+		recorder->Stop();
+		delete recorder;
+		SetDvrClip_Online("", 0);
+	}
+}
+
+// [METADATA] Recorder threads announce each new clip; the processing thread follows it
+inline void SetDvrClip_Online(const std::string& relPath, long long startUs) {
+	std::lock_guard<std::mutex> lock(g_dvrClipMutex_online);
+	g_dvrClipRelPath_online = relPath;
+	g_dvrClipStartUs_online = startUs;
+}
+
+// Appends the state ProcessFrameOnline just published to the current clip's .meta track.
+// Passthrough clips are timed by packet arrival, so the frame's capture time lines up with them;
+// annotated clips show the frame from the moment it is rendered, i.e. about now.
+inline void AppendMetadataTrack_Online(long long seq, const cv::Size& frameSize) {
+	std::string clipRelPath;
+	long long clipStartUs = 0;
+	{
+		std::lock_guard<std::mutex> lock(g_dvrClipMutex_online);
+		clipRelPath = g_dvrClipRelPath_online;
+		clipStartUs = g_dvrClipStartUs_online;
+	}
+	if (clipRelPath.empty()) {
+		g_metadataTrack_online.Close();
+		g_metadataClipRelPath_online.clear();
+		return;
+	}
+
+	long long nowUs = FrameTimestamps::NowUs();
+	if (clipRelPath != g_metadataClipRelPath_online) {
+		g_metadataClipRelPath_online = clipRelPath;
+		MetadataTrackHeader header;
+		header.cameraId = camera_id;
+		header.frameWidth = frameSize.width;
+		header.frameHeight = frameSize.height;
+		header.clipStartEpochMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count() - (nowUs - clipStartUs) / 1000;
+		std::string clipPath = "C:\\locvideo\\" + clipRelPath;
+		std::replace(clipPath.begin(), clipPath.end(), '/', '\\');
+		if (!g_metadataTrack_online.Open(MetadataPathForClip(clipPath), header)) {
+			OutputDebugStringA(("[METADATA] Cannot open track for " + clipPath + "\n").c_str());
+		}
+	}
+	if (!g_metadataTrack_online.IsOpen()) return;
+
+	long long frameUs = g_passthroughActive_online.load() && g_frameTs_online.has(STAGE_CAPTURE) ? g_frameTs_online.t[STAGE_CAPTURE] : nowUs;
+	if (frameUs < clipStartUs) return; // Captured before the clip's first keyframe
+
+	MetadataFrame frame;
+	if (!SnapshotMetadata_Online(seq, frame)) return; // Nothing new was published for this frame
+	frame.tMs = (frameUs - clipStartUs) / 1000;
+	g_metadataTrack_online.Append(frame);
+}
+
+// Boxes and slot states ProcessFrameOnline published for `seq` (false if it published nothing for it)
+inline bool SnapshotMetadata_Online(long long seq, MetadataFrame& frame) {
+	frame.seq = seq;
+	{
+		std::lock_guard<std::mutex> lock(g_onlineStateMutex);
+		if (g_onlineState.frameSequence != seq) return false;
+		frame.boxes.reserve(g_onlineState.cars.size());
+		for (const auto& car : g_onlineState.cars) {
+			MetadataBox box;
+			box.trackId = car.id;
+			box.classId = car.classId;
+			box.x = car.bbox.x;
+			box.y = car.bbox.y;
+			box.w = car.bbox.width;
+			box.h = car.bbox.height;
+			box.violating = g_onlineState.violatingCarIds.count(car.id) > 0;
+			frame.boxes.push_back(box);
+		}
+		frame.slots.reserve(g_onlineState.slotStatuses.size());
+		for (const auto& entry : g_onlineState.slotStatuses) {
+			MetadataSlot slot;
+			slot.slotId = entry.first;
+			slot.status = (int)entry.second;
+			auto occ = g_onlineState.slotOccupancy.find(entry.first);
+			slot.occupancy = occ != g_onlineState.slotOccupancy.end() ? (int)(occ->second + 0.5f) : 0;
+			frame.slots.push_back(slot);
+		}
+	}
+	return true;
+}
+
+inline void StartVideoRecordingThread_Online(int width, int height) {
+	if (g_videoRecordingThread) return;
+	g_videoRecordingRunning.store(true);
+	g_videoRecordingThread = new std::thread(&CameraInstance::VideoRecordingThreadFunc_Online, this, width, height);
+}
+
+inline void StopVideoRecordingThread_Online() {
+	g_videoRecordingRunning.store(false);
+	if (g_videoRecordingThread && g_videoRecordingThread->joinable()) {
+		g_videoRecordingThread->join();
+	}
+	delete g_videoRecordingThread;
+	g_videoRecordingThread = nullptr;
+}
+
+// *** GET RAW FRAME ***
+inline void GetRawFrameOnline(cv::Mat& outFrame, long long& outSeq, FrameTimestamps* outTs = nullptr) {
+	std::lock_guard<std::mutex> lock(g_frameMutex);
+
+	if (!g_latestRawFrame.empty()) {
+		outFrame = g_latestRawFrame; // [FIX] Shallow copy for speed (AI thread clones if needed)
+		outSeq = g_frameSeq_online;
+		if (outTs) *outTs = g_latestRawTs_online;
+	}
+}
+
+// *** [NEW] GET PROCESSED FRAME (For UI) ***
+inline void GetProcessedFrameOnline(cv::Mat& outFrame, long long& outSeq, FrameTimestamps* outTs = nullptr, MetadataFrame* outMeta = nullptr) {
+	std::lock_guard<std::mutex> lock(g_processedMutex_online);
+	if (!g_processedFrame_online.empty()) {
+		outFrame = g_processedFrame_online; // [FIX] Shallow copy for speed
+		outSeq = g_processedSeq_online;
+		if (outTs) *outTs = g_processedTs_online;
+		if (outMeta) *outMeta = g_processedMeta_online;
+	}
+}
+
+// *** [NEW] CREATE VIOLATION VISUALIZATION ***
+inline cv::Mat CreateViolationVisualization(cv::Mat fullFrame, cv::Rect carBox) {
+	if (fullFrame.empty()) return cv::Mat();
+	
+	cv::Mat result = fullFrame.clone();
+	result = result * 0.3;
+	
+	cv::Rect safeBbox = carBox & cv::Rect(0, 0, fullFrame.cols, fullFrame.rows);
+	if (safeBbox.area() > 0) {
+		cv::Mat carROI = fullFrame(safeBbox).clone();
+		carROI.copyTo(result(safeBbox));
+		cv::rectangle(result, safeBbox, cv::Scalar(0, 255, 255), 3);
+	}
+	
+	return result;
+}
+
+	// ============================================================
+	//  [VIOLATIONS] Detection, snapshots and JSON export (processing thread)
+	// ============================================================
+	std::set<int> g_overstayReported_online;
+	std::set<std::pair<int, std::string>> g_violationsReported_online;
+	std::atomic<bool> g_clearViolationHistory_online{false};
+	std::deque<ViolationEvent> g_recentViolations_online; // Newest last, guarded by g_violationLogMutex_online
+	std::mutex g_violationLogMutex_online;
+	std::string g_lastStatsJson_online;
+	int g_lastAreaCounts_online[5] = { -1, -1, -1, -1, -1 }; // Car empty/occupied, moto empty/occupied, violations last logged
+
+	// Lets cars that were already reported be captured again (UI "Clear")
+	inline void ClearViolationHistory_Online() {
+		g_clearViolationHistory_online.store(true);
+	}
+
+	inline void CheckViolations_Online(const cv::Mat& currentFrame) {
+		// [PHASE 2] Throttle violation checks to 500ms
+		auto now = std::chrono::steady_clock::now();
+		auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - g_lastViolationCheck_online).count();
+		if (elapsed < VIOLATION_CHECK_INTERVAL_MS_ONLINE) return;
+		g_lastViolationCheck_online = now;
+
+		if (g_clearViolationHistory_online.exchange(false)) {
+			g_overstayReported_online.clear();
+			g_violationsReported_online.clear();
+			std::lock_guard<std::mutex> lock(g_violationLogMutex_online);
+			g_recentViolations_online.clear();
+		}
+
+		OnlineAppState state;
+		{
+			std::lock_guard<std::mutex> lock(g_onlineStateMutex);
+			state = g_onlineState;
+		}
+
+		for (const auto& car : state.cars) {
+			if (car.framesStill > 300 && g_overstayReported_online.insert(car.id).second) {
+				RecordViolation_Online(car.id, "Overstay", currentFrame, car.bbox);
+			}
+		}
+
+		for (int violatingId : state.violatingCarIds) {
+			// Determine specific violation type
+			std::string specificViolation = "Wrong Parking"; // Default: parked outside slots
+			if (g_pm_logic_online) {
+				for (const auto& slot : g_pm_logic_online->getSlots()) {
+					if (slot.status == SlotStatus::ILLEGAL && slot.occupiedByTrackId == violatingId) {
+						specificViolation = "Wrong Vehicle Type";
+						break;
+					}
+				}
+			}
+			if (g_violationsReported_online.count(std::make_pair(violatingId, specificViolation))) continue;
+
+			for (const auto& car : state.cars) {
+				if (car.id == violatingId) {
+					if (RecordViolation_Online(violatingId, specificViolation, currentFrame, car.bbox)) {
+						g_violationsReported_online.insert(std::make_pair(violatingId, specificViolation));
+					}
+					break;
+				}
+			}
+		}
+
+		UpdateWebStats_Online();
+	}
+
+	// Saves the snapshot + JSON records and notifies the UI. False if the car is outside the frame.
+	inline bool RecordViolation_Online(int carId, const std::string& violationType, const cv::Mat& frame, cv::Rect carBox) {
+		cv::Rect safeBbox = carBox & cv::Rect(0, 0, frame.cols, frame.rows);
+		if (safeBbox.area() <= 0) return false;
+
+		ViolationEvent ev;
+		ev.cameraId = camera_id;
+		ev.carId = carId;
+		ev.type = violationType;
+		ev.crop = frame(safeBbox).clone();
+
+		// [REDUCED RES] Snapshot from the native frame the detections came from, while the ring still has it
+		long long detectionSeq = 0;
+		{
+			std::lock_guard<std::mutex> stateLock(g_onlineStateMutex);
+			detectionSeq = g_onlineState.frameSequence;
+		}
+		cv::Mat fullFrame = frame;
+		cv::Mat nativeFrame = GetFullResFrame_Online(detectionSeq);
+		if (!nativeFrame.empty() && nativeFrame.size() != frame.size()) {
+			double sx = (double)nativeFrame.cols / frame.cols;
+			double sy = (double)nativeFrame.rows / frame.rows;
+			carBox = cv::Rect(cvRound(carBox.x * sx), cvRound(carBox.y * sy), cvRound(carBox.width * sx), cvRound(carBox.height * sy));
+			fullFrame = nativeFrame;
+		}
+		ev.visualization = CreateViolationVisualization(fullFrame, carBox);
+
+		SYSTEMTIME st;
+		GetLocalTime(&st);
+		char timeText[16];
+		sprintf_s(timeText, sizeof(timeText), "%02d:%02d:%02d", st.wHour, st.wMinute, st.wSecond);
+		ev.timeText = timeText;
+		ev.epochMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count();
+
+		if (!ev.visualization.empty()) {
+			// [PHASE 2] SAVE DARKENED SNAPSHOT TO DISK (WITH DATE FOLDER)
+			char dateFolder[256];
+			sprintf_s(dateFolder, sizeof(dateFolder),
+				"C:\\smart_parking_violations\\%04d%02d%02d\\camera_%d", st.wYear, st.wMonth, st.wDay, camera_id);
+
+			std::string violationFileName = "camera_" + std::to_string(camera_id) + "_event_" + std::to_string(ev.epochMs) + "_car_" + std::to_string(carId) + ".jpg";
+			std::string violationFilePath = std::string(dateFolder) + "\\" + violationFileName;
+
+			// [PERSIST] Encoded and written by the persistence workers; ev.visualization is never modified after this
+			if (g_persistence.SubmitImage(PersistKind::SNAPSHOT, violationFilePath, ev.visualization)) {
+				OutputDebugStringA(("[SNAPSHOT] Queued violation snapshot: " + violationFilePath + "\n").c_str());
+			}
+			ev.snapshotPath = violationFilePath;
+
+			// [PHASE 3] Trigger JSON generation
+			SaveAnomalyEventJson_Online(carId, violationType, ev.epochMs, violationFilePath);
+			SaveParkingAreaJson_Online();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(g_violationLogMutex_online);
+			g_recentViolations_online.push_back(ev);
+			while ((int)g_recentViolations_online.size() > RECENT_VIOLATIONS_ONLINE) g_recentViolations_online.pop_front();
+		}
+		DumpLog("[VIOLATION] Camera " + std::to_string(camera_id) + ": car " + std::to_string(carId) + " | Type: " + violationType);
+		g_liveEvents.AddViolation(camera_id, carId, violationType, ev.timeText, ev.epochMs, ev.snapshotPath);
+
+		if (g_onViolationRecorded) g_onViolationRecorded(camera_id, ev);
+		return true;
+	}
+
+	// ==========================================================
+	// [PHASE 3] JSON REGISTRY & MONGOENGINE EXPORT ([EVENT LOG] one JSONL line per event/change)
+	// ==========================================================
+	inline void SaveAnomalyEventJson_Online(int carId, const std::string& violationType, long long epochMs, std::string snapshotPath) {
+		SYSTEMTIME st;
+		GetLocalTime(&st);
+
+		// Calculate seconds into the clip for media_seek_time_seconds based on exact frame count (10 FPS)
+		double seekSeconds = 0.0;
+		std::string videoRelPath;
+		{
+			std::lock_guard<std::mutex> vl(g_videoWriterMutex_online);
+			if (g_passthroughRecorder_online && g_passthroughRecorder_online->IsEventMode()) {
+				// [EVENT REC] The violation starts (or extends) a pre-roll + post-roll clip
+				EventClipRef ref = g_passthroughRecorder_online->Trigger();
+				seekSeconds = ref.seekSeconds;
+				videoRelPath = ref.relPath;
+			} else if (g_passthroughRecorder_online) {
+				seekSeconds = g_passthroughRecorder_online->CurrentClipSeconds();
+				videoRelPath = g_passthroughRecorder_online->CurrentClipRelPath();
+			} else if (g_annotatedRecorder_online) {
+				DvrClipPosition pos = g_annotatedRecorder_online->Current();
+				seekSeconds = pos.framesWritten / DVR_FPS;
+				videoRelPath = pos.relPath;
+			}
+		}
+		if (seekSeconds < 0) seekSeconds = 0.0;
+
+		// Format timestamp as ISO-8601 string for MongoEngine DateTimeField
+		char timeBuf[64];
+		sprintf_s(timeBuf, sizeof(timeBuf), "%04d-%02d-%02dT%02d:%02d:%02d",
+                  st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond);
+
+		// Dynamic Camera ID string representation
+		std::string camId = "camera_" + std::to_string(camera_id);
+
+		// Replace backslashes with forward slashes for cross-platform JSON API usage
+		std::replace(snapshotPath.begin(), snapshotPath.end(), '\\', '/');
+		std::string videoPath = "C:/locvideo/" + videoRelPath;
+
+		json newEvent = {
+			{"camera_id", camId},
+			{"timestamp", std::string(timeBuf)},
+			{"event_type", violationType},
+			{"confidence", 0.95},
+			{"media_snapshot_url", snapshotPath},
+			{"media_video_url", videoPath},
+			{"media_seek_time_seconds", (int)seekSeconds},
+			{"media_seek_time_ms", (long long)(seekSeconds * 1000.0)},
+			{"media_metadata_url", videoRelPath.empty() ? std::string() : "/api/" + std::to_string(camera_id) + "/metadata?clip=" + videoRelPath}, // [METADATA] Served by MjpegServer
+			{"is_reviewed", false},
+			{"car_id", carId},
+			{"epoch_ms", epochMs}
+		};
+
+		// [EVENT LOG] One line in today's anomaly_events log for this camera
+		g_eventLog.Append("anomaly_events", camera_id, epochMs, violationType, newEvent.dump());
+	}
+
+	inline void SaveParkingAreaJson_Online() {
+		OnlineAppState state;
+		{
+			std::lock_guard<std::mutex> lock(g_onlineStateMutex);
+			state = g_onlineState;
+		}
+
+		int carEmptyCount = 0;
+		int carOccupiedCount = 0;
+		int motoEmptyCount = 0;
+		int motoOccupiedCount = 0;
+
+		for (const auto& slotEntry : state.slotStatuses) {
+			int slotId = slotEntry.first;
+			std::string type = "Car";
+			if (state.slotTypes.find(slotId) != state.slotTypes.end()) {
+				type = state.slotTypes[slotId];
+			}
+
+			if (type == "Motorcycle") {
+				if (slotEntry.second == SlotStatus::EMPTY) motoEmptyCount++;
+				else motoOccupiedCount++;
+			} else {
+				if (slotEntry.second == SlotStatus::EMPTY) carEmptyCount++;
+				else carOccupiedCount++;
+			}
+		}
+
+		int totalSlots = carEmptyCount + carOccupiedCount + motoEmptyCount + motoOccupiedCount;
+		int violationCount = (int)state.violatingCarIds.size();
+
+		// Track state changes to prevent bloat (per camera: these used to be function statics shared by every instance)
+		int counts[5] = { carEmptyCount, carOccupiedCount, motoEmptyCount, motoOccupiedCount, violationCount };
+		if (std::equal(counts, counts + 5, g_lastAreaCounts_online)) {
+			return; // No change in numbers, do not log a record
+		}
+		std::copy(counts, counts + 5, g_lastAreaCounts_online);
+
+		SYSTEMTIME st;
+		GetLocalTime(&st);
+		long long epoch = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+		char timeBuf[64];
+		sprintf_s(timeBuf, sizeof(timeBuf), "%04d-%02d-%02dT%02d:%02d:%02d",
+                  st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond);
+
+		std::string camId = "camera_" + std::to_string(camera_id);
+
+		// MongoEngine ParkingArea representation
+		json areaStats = {
+			{"name", "Main Zone A"},
+			{"description", "Front Parking Monitoring"},
+			{"camera_id", camId},
+			{"total_slots", totalSlots},
+			{"total_car_slots", carEmptyCount + carOccupiedCount},
+			{"available_car_slots", carEmptyCount},
+			{"occupied_car_slots", carOccupiedCount},
+			{"total_motorcycle_slots", motoEmptyCount + motoOccupiedCount},
+			{"available_motorcycle_slots", motoEmptyCount},
+			{"occupied_motorcycle_slots", motoOccupiedCount},
+			{"violation_slots", violationCount},
+			{"created_date", std::string(timeBuf)},
+			{"updated_date", std::string(timeBuf)},
+			{"epoch_ms", epoch}
+		};
+
+		g_eventLog.Append("parking_areas", camera_id, epoch, "stats", areaStats.dump());
+	}
+
+	// Parking counts + the 5 most recent violations for /api/stats
+	inline void UpdateWebStats_Online() {
+		if (!g_globalWebServer) return;
+		OnlineAppState state;
+		{
+			std::lock_guard<std::mutex> lock(g_onlineStateMutex);
+			state = g_onlineState;
+		}
+		if (state.slotStatuses.empty()) return;
+
+		int emptyCount = 0, occupiedCount = 0, carEmpty = 0, carNormal = 0, motoEmpty = 0, motoNormal = 0;
+		for (const auto& slotEntry : state.slotStatuses) {
+			int slotId = slotEntry.first;
+			std::string type = "Car";
+			if (state.slotTypes.find(slotId) != state.slotTypes.end())
+				type = state.slotTypes.at(slotId);
+			if (slotEntry.second == SlotStatus::EMPTY) {
+				emptyCount++;
+				if (type == "Motorcycle") motoEmpty++; else carEmpty++;
+			} else {
+				occupiedCount++;
+				if (type == "Motorcycle") motoNormal++; else carNormal++;
+			}
+		}
+		int violationCount = (int)state.violatingCarIds.size();
+
+		std::string json = "{\"empty\":" + std::to_string(emptyCount) +
+		                   ",\"normal\":" + std::to_string(occupiedCount) +
+		                   ",\"carEmpty\":" + std::to_string(carEmpty) +
+		                   ",\"carNormal\":" + std::to_string(carNormal) +
+		                   ",\"motoEmpty\":" + std::to_string(motoEmpty) +
+		                   ",\"motoNormal\":" + std::to_string(motoNormal) +
+		                   ",\"violation\":" + std::to_string(violationCount) + ",\"logs\":[";
+		{
+			std::lock_guard<std::mutex> lock(g_violationLogMutex_online);
+			int logCount = 0;
+			for (auto it = g_recentViolations_online.rbegin(); it != g_recentViolations_online.rend() && logCount < 5; ++it, ++logCount) {
+				if (logCount > 0) json += ",";
+				json += "{\"id\":" + std::to_string(it->carId) + ",\"time\":\"" + it->timeText + "\",\"type\":\"" + it->type + "\"}";
+			}
+		}
+		json += "]}";
+
+		if (json != g_lastStatsJson_online) {
+			g_lastStatsJson_online = json;
+			g_globalWebServer->SetStats(camera_id, json);
+		}
+	}
+
+}; // ---- END OF CameraInstance CLASS ----
+
+PLATFORM_SELECTANY std::map<int, CameraInstance*> g_cameras;
+PLATFORM_SELECTANY std::mutex g_camerasMutex; // Cameras are looked up from HTTP threads too
+PLATFORM_SELECTANY int g_activeCameraId = 1;
+
+static CameraInstance* GetCam(int id = -1) {
+    if (id == -1) id = g_activeCameraId;
+    std::lock_guard<std::mutex> lock(g_camerasMutex);
+    if (g_cameras.find(id) == g_cameras.end()) {
+        std::vector<CameraConfig> confs = CameraManager::LoadCameras();
+        CameraConfig curr;
+        curr.id = id;
+        for (auto& c : confs) if(c.id == id) curr = c;
+        g_cameras[id] = new CameraInstance(curr);
+    }
+    return g_cameras[id];
+}
+
+// Stream URLs tried for a phone / IP camera given as ip + port + path, most specific first
+inline std::vector<std::string> CandidateStreamUrls_Online(const std::string& ip, const std::string& port, std::string path) {
+	if (path.empty() || path[0] != '/') path = "/" + path;
+	return {
+		"http://" + ip + ":" + port + path,
+		"http://" + ip + ":" + port + "/videofeed",
+		"http://" + ip + ":" + port + "/video",
+		"rtsp://" + ip + ":" + port
+	};
+}
+
+// Connects to the first URL that delivers a frame, loads the model if needed and starts the
+// pipeline threads. A newer call for the same camera aborts this one.
+inline bool StartCameraFromUrls_Online(int cameraId, const std::vector<std::string>& urls, const std::string& modelPath) {
+	CameraInstance* cam = GetCam(cameraId);
+	int currentAttemptId = ++cam->g_connectionAttemptId_online;
+
+	// [FIX CRASH] Stop any existing reader threads to prevent AccessViolation
+	// when OpenGlobalCameraFromIP deletes g_cap while the thread is still reading.
+	cam->StopProcessing();
+
+	bool connected = false;
+	for (const std::string& url : urls) {
+		if (currentAttemptId != cam->g_connectionAttemptId_online.load()) {
+			DumpLog("[INFO] Aborting previous connection attempt because a new one started.");
+			return false;
+		}
+
+		DumpLog("[INFO] Headless trying to connect: " + url);
+
+		// [FIX] Use attempt ID to allow early abort
+		cam->OpenGlobalCameraFromIP(url, currentAttemptId);
+
+		for (int i = 0; i < 5; i++) {
+			if (currentAttemptId != cam->g_connectionAttemptId_online.load()) return false;
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		}
+
+		if (cam->g_cap && cam->g_cap->isOpened()) {
+			cv::Mat testFrame;
+			for (int i = 0; i < 10 && !connected; ++i) {
+				// Abort! Another attempt will clean up g_cap if needed, or it's holding a valid stream.
+				if (currentAttemptId != cam->g_connectionAttemptId_online.load()) return false;
+				{
+					std::lock_guard<std::mutex> lock(cam->g_frameMutex);
+					if (cam->g_cap && cam->g_cap->read(testFrame) && !testFrame.empty()) {
+						connected = true;
+						cam->PublishCapturedFrameLocked_Online(testFrame.clone());
+					}
+				}
+				if (connected) {
+					DumpLog("[SUCCESS] Headless Connected successfully!");
+					break;
+				}
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			}
+			if (!connected) {
+				DumpLog("[WARNING] Camera opened but failed to read first frame after 1 second.");
+			}
+		}
+		if (connected) break;
+
+		std::lock_guard<std::mutex> lock(cam->g_frameMutex);
+		if (cam->g_cap) { delete cam->g_cap; cam->g_cap = nullptr; }
+	}
+
+	if (!connected) {
+		DumpLog("[ERROR] Headless could not connect to camera (timeout or invalid IP).");
+		return false;
+	}
+
+	// If this camera was dynamically created/restarted from web config,
+	// the AI model won't be loaded yet. Initialize it now before processing starts.
+	if (!cam->g_modelReady || !cam->g_onnx_net) {
+		DumpLog("[INFO] Initializing AI model for camera " + std::to_string(cameraId));
+		cam->InitGlobalModel(modelPath);
+	}
+	cam->StartProcessing();
+	return true;
+}
+
+// Writes a template posted by the web editor to parking_templates/<name>.xml and loads it
+inline bool SaveParkingTemplateXml_Online(int cameraId, const std::string& xmlContent) {
+    std::string templateName = "web_template_" + std::to_string(cameraId);
+    size_t nameStart = xmlContent.find("<name>");
+    if (nameStart != std::string::npos) {
+        size_t nameEnd = xmlContent.find("</name>", nameStart);
+        if (nameEnd != std::string::npos) {
+            templateName = xmlContent.substr(nameStart + 6, nameEnd - nameStart - 6);
+            templateName.erase(std::remove(templateName.begin(), templateName.end(), '\"'), templateName.end());
+        }
+    }
+
+    CreateDirectoryA("parking_templates", NULL);
+    std::string filename = "parking_templates/" + templateName + ".xml";
+    DumpLog("[API] Extracted template name: " + templateName + " -> Saving to: " + filename);
+    std::ofstream out(filename);
+    if (!out) {
+        DumpLog("[API] ERROR: Could not open " + filename + " for writing!");
+        return false;
+    }
+    out << xmlContent;
+    out.close();
+
+    bool loadResult = GetCam(cameraId)->LoadParkingTemplate_Online(filename);
+    DumpLog("[API] LoadParkingTemplate_Online returned: " + std::string(loadResult ? "true" : "false"));
+    return loadResult;
+}
+
+inline void CameraInstance::ProcessingLoopHeadless() {
+	g_traceRecorder.SetThreadName("camera " + std::to_string(camera_id) + " ai");
+	lastProcessedSeq = -1;
+	while (!shouldStop) {
+		try {
+			cv::Mat frameToProcess;
+			long long seq = 0;
+			FrameTimestamps frameTs;
+			GetRawFrameOnline(frameToProcess, seq, &frameTs);
+
+			if (!frameToProcess.empty() && seq > lastProcessedSeq) {
+				g_frameTs_online = frameTs;
+				g_frameTs_online.mark(STAGE_DEQUEUE);
+				if (lastProcessedSeq >= 0 && seq > lastProcessedSeq + 1) {
+					g_metrics_online.framesDroppedProcessing->inc(seq - lastProcessedSeq - 1);
+				}
+				long long procStart = cv::getTickCount();
+				ProcessFrameOnline(frameToProcess, seq);
+				AppendMetadataTrack_Online(seq, frameToProcess.size());
+				double processMs = (cv::getTickCount() - procStart) * 1000.0 / cv::getTickFrequency();
+				UpdateDecodePolicy_Online(processMs);
+				UpdatePipelineMetrics_Online(seq, processMs);
+				
+				cv::Mat renderedFrame;
+				{
+					TRACE_SPAN_CAM("DrawSceneOnline", camera_id);
+					DrawSceneOnline(frameToProcess, seq, renderedFrame);
+				}
+				g_frameTs_online.mark(STAGE_RENDER);
+
+				if (!renderedFrame.empty()) {
+					// [WEBSOCKET] The boxes/slots drawn on this frame travel with it to /api/{id}/ws
+					MetadataFrame liveMeta;
+					SnapshotMetadata_Online(seq, liveMeta);
+					liveMeta.tMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+						std::chrono::system_clock::now().time_since_epoch()).count();
+					{
+						std::lock_guard<std::mutex> lock(g_processedMutex_online);
+						g_processedFrame_online = renderedFrame;
+						g_processedSeq_online = seq;
+						g_processedTs_online = g_frameTs_online;
+						g_processedMeta_online = liveMeta;
+						g_processedFramesCount_online++;
+					}
+					g_metrics_online.framesProcessed->inc();
+
+					// [PHASE 3] Violations are detected and persisted here, with or without the UI
+					if (g_parkingEnabled_online.load()) {
+						CheckViolations_Online(frameToProcess);
+					}
+
+					if (g_mjpegServer_online) {
+						g_mjpegServer_online->SetLatestFrame(camera_id, renderedFrame, g_frameTs_online, &liveMeta);
+					}
+
+					// [PASSTHROUGH] The camera's own packets are being remuxed: nothing to encode here
+					if (!g_passthroughActive_online.load()) {
+						cv::Mat scaledFrame;
+						double maxW = 1280.0;
+						if (renderedFrame.cols > maxW) {
+							double scale = maxW / renderedFrame.cols;
+							cv::resize(renderedFrame, scaledFrame, cv::Size(), scale, scale);
+						} else {
+							scaledFrame = renderedFrame;
+						}
+
+						StartVideoRecordingThread_Online(scaledFrame.cols, scaledFrame.rows);
+
+						{
+							std::lock_guard<std::mutex> vidLock(g_videoCurrentFrameMutex);
+							g_videoCurrentFrame = scaledFrame.clone();
+						}
+					}
+				}
+				lastProcessedSeq = seq;
+			} else {
+				std::this_thread::sleep_for(std::chrono::milliseconds(2));
+			}
+		}
+		catch (...) { std::this_thread::sleep_for(std::chrono::milliseconds(5)); }
+	}
+	g_metadataTrack_online.Close();
+	g_metadataClipRelPath_online.clear();
+}
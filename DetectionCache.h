@@ -0,0 +1,275 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "Platform.h"
+
+// ==========================================
+//  [DET CACHE] Content-addressed cache of post-NMS detections
+// ==========================================
+// Re-running a recording with another parking template only changes tracking and parking logic,
+// so the batch analyzer stores each run's detections under
+//   C:\smart_parking_offline\detection_cache\<key>\<start>_<end>_s<stride>[_eof].det
+// where <key> hashes the video content, the model file and every setting that changes the
+// detections (input size, confidence and NMS thresholds). A later run over a covered frame range
+// replays the file instead of decoding and running the model.
+//
+// File layout (little-endian, columnar so every column is one fread):
+//   header  magic, version, frame width/height, frame count, detection count
+//   frames  int64 index[frames], uint16 count[frames]
+//   boxes   int16 x[dets], y[dets], w[dets], h[dets], uint8 class[dets], float conf[dets]
+
+const uint32_t DET_CACHE_MAGIC = 0x43544544; // "DETC"
+const uint32_t DET_CACHE_VERSION = 1;
+const size_t DET_CACHE_VIDEO_SAMPLE_BYTES = 1 << 20; // Hashed at the start, middle and end of the video
+
+// FNV-1a, 64 bit
+inline uint64_t DetCacheHash(const void* data, size_t size, uint64_t hash = 1469598103934665603ULL) {
+    const unsigned char* p = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Hashes `length` bytes from `offset` (the whole file when length < 0). Returns false if unreadable.
+inline bool DetCacheHashFile(const std::string& path, long long offset, long long length, uint64_t& hash) {
+    FILE* f = nullptr;
+    if (fopen_s(&f, path.c_str(), "rb") != 0 || !f) return false;
+#ifdef _WIN32
+    _fseeki64(f, offset, SEEK_SET);
+#else
+    fseeko(f, (off_t)offset, SEEK_SET);
+#endif
+    std::vector<char> buf(1 << 16);
+    while (length != 0) {
+        size_t want = length < 0 ? buf.size() : (size_t)std::min<long long>(length, (long long)buf.size());
+        size_t got = fread(buf.data(), 1, want, f);
+        if (got == 0) break;
+        hash = DetCacheHash(buf.data(), got, hash);
+        if (length > 0) length -= (long long)got;
+    }
+    fclose(f);
+    return true;
+}
+
+inline long long DetCacheFileSize(const std::string& path) {
+    FILE* f = nullptr;
+    if (fopen_s(&f, path.c_str(), "rb") != 0 || !f) return -1;
+#ifdef _WIN32
+    _fseeki64(f, 0, SEEK_END);
+    long long size = _ftelli64(f);
+#else
+    fseeko(f, 0, SEEK_END);
+    long long size = (long long)ftello(f);
+#endif
+    fclose(f);
+    return size;
+}
+
+// Cache folder for this video/model/settings combination, "" when either file can't be read.
+// The video is sampled (size + three 1 MiB blocks) so keying a multi-GB recording stays cheap;
+// the model is hashed in full.
+inline std::string DetectionCacheDir(const std::string& videoPath, const std::string& modelPath,
+                                     int inputSize, float confThreshold, float nmsThreshold) {
+    long long videoSize = DetCacheFileSize(videoPath);
+    if (videoSize <= 0) return "";
+    uint64_t hash = DetCacheHash(&videoSize, sizeof(videoSize));
+    long long sample = (long long)DET_CACHE_VIDEO_SAMPLE_BYTES;
+    long long offsets[3] = { 0, std::max(0LL, videoSize / 2 - sample / 2), std::max(0LL, videoSize - sample) };
+    for (long long offset : offsets) {
+        if (!DetCacheHashFile(videoPath, offset, sample, hash)) return "";
+    }
+    if (!DetCacheHashFile(modelPath, 0, -1, hash)) return "";
+    hash = DetCacheHash(&inputSize, sizeof(inputSize), hash);
+    hash = DetCacheHash(&confThreshold, sizeof(confThreshold), hash);
+    hash = DetCacheHash(&nmsThreshold, sizeof(nmsThreshold), hash);
+
+    char key[17];
+    snprintf(key, sizeof(key), "%016llx", (unsigned long long)hash);
+    return std::string("C:\\smart_parking_offline\\detection_cache\\") + key;
+}
+
+// Columns of one cached range, in frame order
+struct DetectionColumns {
+    int width = 0;
+    int height = 0;
+    std::vector<int64_t> frameIndex;
+    std::vector<uint16_t> frameCount;
+    std::vector<int16_t> x, y, w, h;
+    std::vector<uint8_t> classId;
+    std::vector<float> conf;
+
+    void Append(long long index, const std::vector<cv::Rect>& boxes, const std::vector<int>& classIds, const std::vector<float>& confs) {
+        size_t n = std::min<size_t>(boxes.size(), 65535);
+        frameIndex.push_back(index);
+        frameCount.push_back((uint16_t)n);
+        for (size_t i = 0; i < n; i++) {
+            x.push_back(Clamp16(boxes[i].x));
+            y.push_back(Clamp16(boxes[i].y));
+            w.push_back(Clamp16(boxes[i].width));
+            h.push_back(Clamp16(boxes[i].height));
+            classId.push_back((uint8_t)std::max(0, std::min(255, classIds[i])));
+            conf.push_back(confs[i]);
+        }
+    }
+
+    static int16_t Clamp16(int v) { return (int16_t)std::max(-32768, std::min(32767, v)); }
+};
+
+class DetectionCacheWriter {
+public:
+    void SetFrameSize(cv::Size size) {
+        columns_.width = size.width;
+        columns_.height = size.height;
+    }
+
+    // Frames must arrive in increasing index order
+    void Add(long long index, const std::vector<cv::Rect>& boxes, const std::vector<int>& classIds, const std::vector<float>& confs) {
+        columns_.Append(index, boxes, classIds, confs);
+    }
+
+    // A frame whose inference failed would replay as "no cars": such a run is never committed
+    void Invalidate() { valid_ = false; }
+
+    // Writes the range [start, end); `eof` = the video ended before `end` was requested
+    bool Commit(const std::string& dir, long long start, long long end, bool eof, int stride) {
+        if (!valid_ || dir.empty() || columns_.frameIndex.empty()) return false;
+        CreateDirectoryA("C:\\smart_parking_offline", NULL);
+        CreateDirectoryA("C:\\smart_parking_offline\\detection_cache", NULL);
+        CreateDirectoryA(dir.c_str(), NULL);
+
+        char name[96];
+        snprintf(name, sizeof(name), "%lld_%lld_s%d%s.det", start, end, stride, eof ? "_eof" : "");
+        std::string path = dir + "\\" + name;
+        std::string tmpPath = path + ".tmp";
+
+        FILE* f = nullptr;
+        if (fopen_s(&f, tmpPath.c_str(), "wb") != 0 || !f) return false;
+        const DetectionColumns& c = columns_;
+        uint64_t frames = c.frameIndex.size();
+        uint64_t dets = c.conf.size();
+        bool ok = fwrite(&DET_CACHE_MAGIC, sizeof(uint32_t), 1, f) == 1
+            && fwrite(&DET_CACHE_VERSION, sizeof(uint32_t), 1, f) == 1
+            && fwrite(&c.width, sizeof(int), 1, f) == 1
+            && fwrite(&c.height, sizeof(int), 1, f) == 1
+            && fwrite(&frames, sizeof(uint64_t), 1, f) == 1
+            && fwrite(&dets, sizeof(uint64_t), 1, f) == 1
+            && WriteColumn(f, c.frameIndex) && WriteColumn(f, c.frameCount)
+            && WriteColumn(f, c.x) && WriteColumn(f, c.y) && WriteColumn(f, c.w) && WriteColumn(f, c.h)
+            && WriteColumn(f, c.classId) && WriteColumn(f, c.conf);
+        fclose(f);
+
+        // Readers only ever see complete files
+        std::string finalPath = PlatformPath(path);
+        std::string tmpFinal = PlatformPath(tmpPath);
+        if (!ok) {
+            remove(tmpFinal.c_str());
+            return false;
+        }
+        remove(finalPath.c_str());
+        if (rename(tmpFinal.c_str(), finalPath.c_str()) != 0) return false;
+        OutputDebugStringA(("[DET CACHE] Stored " + std::to_string(frames) + " frames in " + path + "\n").c_str());
+        return true;
+    }
+
+private:
+    DetectionColumns columns_;
+    bool valid_ = true;
+
+    template <typename T>
+    static bool WriteColumn(FILE* f, const std::vector<T>& column) {
+        return column.empty() || fwrite(column.data(), sizeof(T), column.size(), f) == column.size();
+    }
+};
+
+class DetectionCacheReader {
+public:
+    // Loads a cached range that covers every frame of [start, end) sampled with `stride`
+    // (end < 0 = to the end of the video)
+    bool Open(const std::string& dir, long long start, long long end, int stride) {
+        if (dir.empty()) return false;
+        for (const std::string& name : PlatformListDirectory(dir, false)) {
+            long long cachedStart = 0, cachedEnd = 0;
+            int cachedStride = 0;
+            if (name.size() < 4 || name.compare(name.size() - 4, 4, ".det") != 0) continue;
+            if (sscanf(name.c_str(), "%lld_%lld_s%d", &cachedStart, &cachedEnd, &cachedStride) != 3) continue;
+            bool eof = name.find("_eof") != std::string::npos;
+            // Frames are sampled by absolute index, so a run with stride k holds every frame a multiple of k needs
+            if (cachedStride < 1 || stride % cachedStride != 0 || cachedStart > start) continue;
+            if (!eof && (end < 0 || cachedEnd < end)) continue;
+            if (Load(dir + "\\" + name)) {
+                OutputDebugStringA(("[DET CACHE] Replaying " + dir + "\\" + name + "\n").c_str());
+                return true;
+            }
+        }
+        return false;
+    }
+
+    cv::Size FrameSize() const { return cv::Size(columns_.width, columns_.height); }
+    size_t FrameCount() const { return columns_.frameIndex.size(); }
+    long long FrameIndex(size_t i) const { return (long long)columns_.frameIndex[i]; }
+
+    // Detections of the i-th cached frame. Call with increasing i (offsets are accumulated).
+    long long Frame(size_t i, std::vector<cv::Rect>& boxes, std::vector<int>& classIds, std::vector<float>& confs) {
+        const DetectionColumns& c = columns_;
+        if (i < nextFrame_) { nextFrame_ = 0; nextDet_ = 0; }
+        for (; nextFrame_ < i; nextFrame_++) nextDet_ += c.frameCount[nextFrame_];
+
+        boxes.clear();
+        classIds.clear();
+        confs.clear();
+        size_t n = c.frameCount[i];
+        for (size_t d = nextDet_; d < nextDet_ + n; d++) {
+            boxes.push_back(cv::Rect(c.x[d], c.y[d], c.w[d], c.h[d]));
+            classIds.push_back(c.classId[d]);
+            confs.push_back(c.conf[d]);
+        }
+        return (long long)c.frameIndex[i];
+    }
+
+private:
+    DetectionColumns columns_;
+    size_t nextFrame_ = 0;
+    size_t nextDet_ = 0;
+
+    bool Load(const std::string& path) {
+        FILE* f = nullptr;
+        if (fopen_s(&f, path.c_str(), "rb") != 0 || !f) return false;
+        DetectionColumns c;
+        uint32_t magic = 0, version = 0;
+        uint64_t frames = 0, dets = 0;
+        bool ok = fread(&magic, sizeof(uint32_t), 1, f) == 1 && magic == DET_CACHE_MAGIC
+            && fread(&version, sizeof(uint32_t), 1, f) == 1 && version == DET_CACHE_VERSION
+            && fread(&c.width, sizeof(int), 1, f) == 1
+            && fread(&c.height, sizeof(int), 1, f) == 1
+            && fread(&frames, sizeof(uint64_t), 1, f) == 1
+            && fread(&dets, sizeof(uint64_t), 1, f) == 1
+            && ReadColumn(f, c.frameIndex, frames) && ReadColumn(f, c.frameCount, frames)
+            && ReadColumn(f, c.x, dets) && ReadColumn(f, c.y, dets) && ReadColumn(f, c.w, dets) && ReadColumn(f, c.h, dets)
+            && ReadColumn(f, c.classId, dets) && ReadColumn(f, c.conf, dets);
+        fclose(f);
+        if (!ok) return false;
+
+        uint64_t total = 0;
+        for (uint16_t n : c.frameCount) total += n;
+        if (total != dets) return false;
+
+        columns_ = std::move(c);
+        nextFrame_ = 0;
+        nextDet_ = 0;
+        return true;
+    }
+
+    template <typename T>
+    static bool ReadColumn(FILE* f, std::vector<T>& column, uint64_t count) {
+        if (count > (1ULL << 32)) return false;
+        column.resize((size_t)count);
+        return column.empty() || fread(column.data(), sizeof(T), column.size(), f) == column.size();
+    }
+};
@@ -0,0 +1,510 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Platform.h"
+#include "PersistenceService.h"
+
+// ==========================================
+//  [EVENT LOG] Append-only, indexed JSONL logs for anomaly events and parking stats
+// ==========================================
+// One log per stream, day and camera:
+//   C:\loc_json\<stream>\YYYYMMDD\camera_N\log_0000.jsonl, log_0001.jsonl, ...
+// Each line is one record (the same JSON the per-event files used to hold, plus "epoch_ms").
+// Segments roll over at EVENT_LOG_SEGMENT_BYTES. Every open log keeps an in-memory index
+// (time, type, segment, offset, length) built once by scanning its segments, so a query is a
+// binary search plus one read per returned record instead of a directory listing and a file
+// open per event.
+// Append() only indexes the record and queues it; the persistence workers write pending records
+// in order, and a query writes out whatever is still pending first. A record's segment and offset
+// are taken from the file's real size when it is written. After a failed write the writer moves on
+// to a fresh segment, so a torn line never shifts or merges with the records after it.
+// Every indexed record also gets a per-log sequence number; Generation() is the next one, so a
+// reader that remembers it can later ask for just the records added since (EventResponseCache.h).
+// Select() returns record references only; EventLogReader then reads them one at a time, so a large
+// result can be streamed without ever holding it in memory.
+// No file stays open between write batches, and a past day's log is dropped from memory once it has
+// been idle for EVENT_LOG_IDLE_MS (references keep it alive until they are released).
+
+const long long EVENT_LOG_SEGMENT_BYTES = 16LL << 20;
+const size_t EVENT_STREAM_CHUNK_BYTES = 16u << 10; // Body bytes per chunk when the event API streams a result
+const long long EVENT_LOG_IDLE_MS = 10 * 60 * 1000;
+const long long EVENT_LOG_SWEEP_MS = 60 * 1000;
+
+struct EventLogQuery {
+    long long fromMs = 0;         // Inclusive, epoch ms
+    long long toMs = LLONG_MAX;   // Inclusive
+    std::string type;             // Empty = every type
+    int limit = -1;               // Newest records first; -1 = all
+};
+
+class EventLog;
+
+// Where one record lives, so large results can be selected first and read one record at a time
+struct EventLogRef {
+    std::shared_ptr<EventLog> log;
+    long long epochMs = 0;
+    long long offset = 0;
+    uint32_t length = 0;
+    int segment = 0;
+};
+
+class EventLog : public std::enable_shared_from_this<EventLog> {
+public:
+    EventLog(const std::string& dir) : dir_(dir) { Load(); }
+
+    ~EventLog() { WritePending(); }
+
+    const std::string& Dir() const { return dir_; }
+
+    // True if the caller should queue a WritePending() job (none is queued for this log yet)
+    bool Append(long long epochMs, const std::string& type, std::string line) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        line += "\n";
+        Entry e;
+        e.epochMs = epochMs;
+        e.typeId = TypeId(type);
+        e.offset = -1; // Placed by WritePending()
+        e.length = (uint32_t)line.size();
+        e.seq = nextSeq_++;
+
+        // Records arrive in time order; a clock step back is placed where it belongs
+        if (index_.empty() || index_.back().epochMs <= epochMs) {
+            index_.push_back(e);
+        } else {
+            auto at = std::upper_bound(index_.begin(), index_.end(), epochMs,
+                [](long long t, const Entry& x) { return t < x.epochMs; });
+            index_.insert(at, e);
+        }
+        pending_.push_back(Pending{ e.seq, std::move(line) });
+        return !writeQueued_.exchange(true);
+    }
+
+    void WriteNotQueued() { writeQueued_ = false; }
+
+    // Appends every pending record to the current segment, one write per segment touched, and
+    // indexes each at the offset it really landed at. Runs on a persistence worker (or a query).
+    bool WritePending() {
+        std::lock_guard<std::mutex> writeLock(writeMutex_);
+        writeQueued_ = false; // Records appended from here on need another job
+        std::deque<Pending> batch;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            batch.swap(pending_);
+        }
+        if (batch.empty()) return true;
+        g_persistence.EnsureDirectory(dir_); // The stream and day folders may not exist yet either
+
+        std::map<uint32_t, std::pair<int, long long>> placed; // seq -> (segment, offset); offset -1 = lost
+        size_t next = 0;
+        bool retried = false;
+        while (next < batch.size()) {
+            FILE* file = nullptr;
+            long long size = 0;
+            if (!OpenSegment(segment_, file, size)) break;
+            std::string chunk;
+            size_t end = next;
+            while (end < batch.size() && ((size == 0 && chunk.empty()) ||
+                   size + (long long)(chunk.size() + batch[end].line.size()) <= EVENT_LOG_SEGMENT_BYTES)) {
+                chunk += batch[end++].line;
+            }
+            bool written = !chunk.empty() && fwrite(chunk.data(), 1, chunk.size(), file) == chunk.size();
+            written = fclose(file) == 0 && written; // Nothing stays open between batches
+            if (!written) {
+                // Segment full, or a failed write that may have left a torn line: go on in a fresh one
+                segment_++;
+                if (chunk.empty()) continue;
+                if (retried) break;
+                retried = true;
+                continue;
+            }
+            g_persistence.MarkWritten(SegmentPath(segment_));
+            for (long long offset = size; next < end; next++) {
+                placed[batch[next].seq] = std::make_pair(segment_, offset);
+                offset += (long long)batch[next].line.size();
+            }
+        }
+        size_t lost = batch.size() - next;
+        for (; next < batch.size(); next++) placed[batch[next].seq] = std::make_pair(segment_, -1LL);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t found = 0;
+        for (size_t i = index_.size(); i > 0 && found < placed.size(); i--) { // Unplaced records are the newest
+            auto it = placed.find(index_[i - 1].seq);
+            if (it == placed.end() || index_[i - 1].offset >= 0) continue;
+            found++;
+            if (it->second.second < 0) {
+                index_.erase(index_.begin() + (i - 1));
+            } else {
+                index_[i - 1].segment = (uint16_t)it->second.first;
+                index_[i - 1].offset = it->second.second;
+            }
+        }
+        if (lost > 0) OutputDebugStringA(("[EVENT LOG] Dropped " + std::to_string(lost) + " record(s) after write errors in " + dir_ + "\n").c_str());
+        return lost == 0;
+    }
+
+    bool HasPending() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return !pending_.empty();
+    }
+
+    // Sequence number the next appended record will get
+    uint32_t Generation() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return nextSeq_;
+    }
+
+    // Matching records, newest first, as (epoch ms, JSON line) pairs.
+    // [sinceSeq, untilSeq) restricts the result to records indexed within that generation range.
+    void Query(const EventLogQuery& q, std::vector<std::pair<long long, std::string>>& out,
+               uint32_t sinceSeq = 0, uint32_t untilSeq = UINT32_MAX);
+
+    // References to the matching records, newest first. With a limit, records sharing the last
+    // record's timestamp are included too, so a page never ends halfway through a millisecond.
+    void Select(const EventLogQuery& q, std::vector<EventLogRef>& out,
+                uint32_t sinceSeq = 0, uint32_t untilSeq = UINT32_MAX) {
+        WritePending();
+        std::lock_guard<std::mutex> lock(mutex_);
+        int typeId = -1;
+        if (!q.type.empty()) {
+            auto it = std::find(types_.begin(), types_.end(), q.type);
+            if (it == types_.end()) return;
+            typeId = (int)(it - types_.begin());
+        }
+        auto end = std::upper_bound(index_.begin(), index_.end(), q.toMs,
+            [](long long t, const Entry& x) { return t < x.epochMs; });
+        std::shared_ptr<EventLog> self = shared_from_this();
+        int count = 0;
+        long long lastEpochMs = 0;
+        for (auto it = end; it != index_.begin();) {
+            --it;
+            if (it->epochMs < q.fromMs) break;
+            if (it->offset < 0) continue; // Appended after our WritePending()
+            if (typeId >= 0 && it->typeId != typeId) continue;
+            if (it->seq < sinceSeq || it->seq >= untilSeq) continue;
+            if (q.limit > 0 && count >= q.limit && it->epochMs != lastEpochMs) break;
+            EventLogRef ref;
+            ref.log = self;
+            ref.epochMs = it->epochMs;
+            ref.offset = it->offset;
+            ref.length = it->length;
+            ref.segment = it->segment;
+            out.push_back(ref);
+            lastEpochMs = it->epochMs;
+            count++;
+        }
+    }
+
+    std::string SegmentPath(int segment) const {
+        char name[32];
+        sprintf_s(name, sizeof(name), "log_%04d.jsonl", segment);
+        return dir_ + "\\" + name;
+    }
+
+private:
+    // Opens a segment for appending; `size` is where the next byte will land
+    bool OpenSegment(int segment, FILE*& file, long long& size) const {
+        if (fopen_s(&file, SegmentPath(segment).c_str(), "ab") != 0 || !file) return false;
+#ifdef _WIN32
+        _fseeki64(file, 0, SEEK_END);
+        size = _ftelli64(file);
+#else
+        fseeko(file, 0, SEEK_END);
+        size = (long long)ftello(file);
+#endif
+        if (size >= 0) return true;
+        fclose(file);
+        return false;
+    }
+
+    struct Entry {
+        long long epochMs = 0;
+        long long offset = 0;    // -1 while the record is still pending
+        uint32_t length = 0;
+        uint32_t seq = 0;
+        uint16_t typeId = 0;
+        uint16_t segment = 0;
+    };
+    struct Pending {
+        uint32_t seq;
+        std::string line;
+    };
+
+    std::string dir_;
+    std::mutex mutex_;         // index_, types_, pending_, nextSeq_
+    std::mutex writeMutex_;    // segment_; one WritePending() at a time
+    std::vector<Entry> index_; // Sorted by epochMs
+    std::vector<std::string> types_;
+    std::deque<Pending> pending_;
+    int segment_ = 0;          // Where the next write goes
+    uint32_t nextSeq_ = 0;
+    std::atomic<bool> writeQueued_{ false };
+
+    uint16_t TypeId(const std::string& type) {
+        auto it = std::find(types_.begin(), types_.end(), type);
+        if (it != types_.end()) return (uint16_t)(it - types_.begin());
+        types_.push_back(type);
+        return (uint16_t)(types_.size() - 1);
+    }
+
+    // "key":value from a compact JSON line, without a full parse
+    static bool FindField(const std::string& line, const char* key, std::string& value) {
+        std::string needle = std::string("\"") + key + "\":";
+        size_t pos = line.find(needle);
+        if (pos == std::string::npos) return false;
+        pos += needle.size();
+        if (pos < line.size() && line[pos] == '"') {
+            size_t end = line.find('"', pos + 1);
+            if (end == std::string::npos) return false;
+            value = line.substr(pos + 1, end - pos - 1);
+        } else {
+            size_t end = line.find_first_of(",}", pos);
+            value = line.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+        }
+        return true;
+    }
+
+    // Rebuilds the index from the segments already on disk (once, when the log is first opened)
+    void Load() {
+        for (int segment = 0;; segment++) {
+            FILE* f = nullptr;
+            if (fopen_s(&f, SegmentPath(segment).c_str(), "rb") != 0 || !f) break;
+            segment_ = segment;
+            std::vector<char> buf(1 << 16);
+            std::string line;
+            long long lineStart = 0;
+            size_t got;
+            while ((got = fread(buf.data(), 1, buf.size(), f)) > 0) {
+                for (size_t i = 0; i < got; i++) {
+                    line += buf[i];
+                    if (buf[i] != '\n') continue;
+                    IndexLine(line, segment, lineStart);
+                    lineStart += (long long)line.size();
+                    line.clear();
+                }
+            }
+            fclose(f);
+            if (!line.empty()) {
+                // Cut short by a crash: left out of the index, and new records start a fresh segment
+                segment_ = segment + 1;
+            }
+        }
+        std::stable_sort(index_.begin(), index_.end(), [](const Entry& a, const Entry& b) { return a.epochMs < b.epochMs; });
+    }
+
+    void IndexLine(const std::string& line, int segment, long long offset) {
+        std::string epoch, type;
+        if (!FindField(line, "epoch_ms", epoch)) return;
+        if (!FindField(line, "event_type", type)) type = "stats";
+        Entry e;
+        try { e.epochMs = std::stoll(epoch); } catch (...) { return; }
+        e.typeId = TypeId(type);
+        e.segment = (uint16_t)segment;
+        e.offset = offset;
+        e.length = (uint32_t)line.size();
+        e.seq = nextSeq_++;
+        index_.push_back(e);
+    }
+};
+
+// Reads records by reference, keeping each segment it touches open until destroyed
+class EventLogReader {
+public:
+    ~EventLogReader() {
+        for (auto& f : files_) if (f.second) fclose(f.second);
+    }
+
+    // The record's JSON line without its newline
+    bool Read(const EventLogRef& ref, std::string& line) {
+        auto key = std::make_pair(ref.log.get(), ref.segment);
+        auto it = files_.find(key);
+        if (it == files_.end()) {
+            FILE* f = nullptr;
+            if (fopen_s(&f, ref.log->SegmentPath(ref.segment).c_str(), "rb") != 0) f = nullptr;
+            it = files_.emplace(key, f).first;
+        }
+        FILE* f = it->second;
+        if (!f) return false;
+        line.resize(ref.length);
+#ifdef _WIN32
+        _fseeki64(f, ref.offset, SEEK_SET);
+#else
+        fseeko(f, (off_t)ref.offset, SEEK_SET);
+#endif
+        if (fread(&line[0], 1, ref.length, f) != ref.length) return false;
+        while (!line.empty() && (line.back() == '\n' || line.back() == '\r')) line.pop_back();
+        return true;
+    }
+
+private:
+    std::map<std::pair<EventLog*, int>, FILE*> files_;
+};
+
+inline void EventLog::Query(const EventLogQuery& q, std::vector<std::pair<long long, std::string>>& out,
+                            uint32_t sinceSeq, uint32_t untilSeq) {
+    std::vector<EventLogRef> refs;
+    Select(q, refs, sinceSeq, untilSeq);
+    EventLogReader reader;
+    std::string line;
+    for (const EventLogRef& ref : refs) {
+        if (reader.Read(ref, line)) out.push_back(std::make_pair(ref.epochMs, line));
+    }
+}
+
+// Process-wide set of logs, opened lazily per stream / day / camera
+class EventLogStore {
+public:
+    // Queued writes point at the logs below: finish them before the logs go away
+    ~EventLogStore() { g_persistence.Stop(); }
+
+    // Called from the processing thread: indexes the record and hands the write to the persistence workers
+    void Append(const std::string& stream, int cameraId, long long epochMs, const std::string& type, const std::string& line) {
+        std::string date = Today();
+        std::shared_ptr<EventLog> log = Get(stream, date, cameraId, true);
+        if (!log->Append(epochMs, type, line)) return; // A queued job will pick this record up
+        PersistKind kind = stream == "parking_areas" ? PersistKind::STATS : PersistKind::EVENT;
+        if (!g_persistence.SubmitTask(kind, DayDir(stream, date) + " log", [log]() { return log->WritePending(); })) {
+            log->WriteNotQueued(); // Stays pending until the next append or query writes it
+        }
+    }
+
+    // Records of one day (YYYYMMDD), newest first, merged across cameras (cameraId < 0) or for one.
+    // False when the day has no log at all (e.g. data from before the log existed).
+    bool Query(const std::string& stream, const std::string& date, int cameraId, const EventLogQuery& q,
+               std::vector<std::pair<long long, std::string>>& out) {
+        std::vector<std::shared_ptr<EventLog>> logs = Logs(stream, date, cameraId);
+        for (const auto& log : logs) log->Query(q, out);
+        SortNewestFirst(out, q.limit);
+        return !logs.empty();
+    }
+
+    // Query() without reading anything: references to the matching records of one day, newest first.
+    // A limited selection ends with every record sharing the last one's timestamp (see EventLog::Select).
+    bool Select(const std::string& stream, const std::string& date, int cameraId, const EventLogQuery& q,
+                std::vector<EventLogRef>& out) {
+        std::vector<std::shared_ptr<EventLog>> logs = Logs(stream, date, cameraId);
+        for (const auto& log : logs) log->Select(q, out);
+        std::stable_sort(out.begin(), out.end(), [](const EventLogRef& a, const EventLogRef& b) { return a.epochMs > b.epochMs; });
+        if (q.limit > 0 && (int)out.size() > q.limit) {
+            size_t keep = q.limit;
+            while (keep < out.size() && out[keep].epochMs == out[q.limit - 1].epochMs) keep++;
+            out.resize(keep);
+        }
+        return !logs.empty();
+    }
+
+    // The logs a query for one day covers: one camera (cameraId >= 0) or every camera with a log
+    std::vector<std::shared_ptr<EventLog>> Logs(const std::string& stream, const std::string& date, int cameraId) {
+        std::vector<int> cameras;
+        if (cameraId >= 0) {
+            cameras.push_back(cameraId);
+        } else {
+            for (const std::string& name : PlatformListDirectory(DayDir(stream, date), true)) {
+                if (name.compare(0, 7, "camera_") == 0) {
+                    try { cameras.push_back(std::stoi(name.substr(7))); } catch (...) {}
+                }
+            }
+            // Logs opened by Append() whose directory the workers have not created yet
+            std::string prefix = DayDir(stream, date) + "\\camera_";
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto it = logs_.lower_bound(prefix); it != logs_.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it) {
+                try { cameras.push_back(std::stoi(it->first.substr(prefix.size()))); } catch (...) {}
+            }
+        }
+        std::sort(cameras.begin(), cameras.end());
+        cameras.erase(std::unique(cameras.begin(), cameras.end()), cameras.end());
+        std::vector<std::shared_ptr<EventLog>> logs;
+        for (int cam : cameras) {
+            std::shared_ptr<EventLog> log = Get(stream, date, cam, false);
+            if (log) logs.push_back(log);
+        }
+        return logs;
+    }
+
+    static void SortNewestFirst(std::vector<std::pair<long long, std::string>>& records, int limit) {
+        std::stable_sort(records.begin(), records.end(), [](const std::pair<long long, std::string>& a, const std::pair<long long, std::string>& b) {
+            return a.first > b.first;
+        });
+        if (limit > 0 && (int)records.size() > limit) records.resize(limit);
+    }
+
+    static std::string DayDir(const std::string& stream, const std::string& date) {
+        return "C:\\loc_json\\" + stream + "\\" + date;
+    }
+
+    // YYYYMMDD, local time
+    static std::string Today() {
+        SYSTEMTIME st;
+        GetLocalTime(&st);
+        char date[16];
+        sprintf_s(date, sizeof(date), "%04d%02d%02d", st.wYear, st.wMonth, st.wDay);
+        return date;
+    }
+
+private:
+    struct OpenLog {
+        std::shared_ptr<EventLog> log;
+        std::string date;
+        long long lastUsedMs = 0;
+    };
+    std::mutex mutex_;
+    std::map<std::string, OpenLog> logs_;
+    long long lastSweepMs_ = 0;
+
+    std::shared_ptr<EventLog> Get(const std::string& stream, const std::string& date, int cameraId, bool create) {
+        std::string dir = DayDir(stream, date) + "\\camera_" + std::to_string(cameraId);
+        long long nowMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (nowMs - lastSweepMs_ >= EVENT_LOG_SWEEP_MS) Sweep(nowMs);
+            auto it = logs_.find(dir);
+            if (it != logs_.end()) {
+                it->second.lastUsedMs = nowMs;
+                return it->second.log;
+            }
+        }
+        if (!create) {
+            FILE* f = nullptr;
+            if (fopen_s(&f, (dir + "\\log_0000.jsonl").c_str(), "rb") != 0 || !f) return nullptr;
+            fclose(f);
+        }
+
+        // Loading reads every segment, so other cameras' lookups must not wait behind it
+        std::shared_ptr<EventLog> log = std::make_shared<EventLog>(dir);
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto inserted = logs_.emplace(dir, OpenLog());
+        OpenLog& open = inserted.first->second;
+        if (inserted.second) { // Otherwise another thread loaded it first; keep the one already in use
+            open.log = log;
+            open.date = date;
+        }
+        open.lastUsedMs = nowMs;
+        return open.log;
+    }
+
+    // Drops past days' logs nobody has used for a while; today's stay open for appends
+    void Sweep(long long nowMs) {
+        lastSweepMs_ = nowMs;
+        std::string today = Today();
+        for (auto it = logs_.begin(); it != logs_.end();) {
+            if (it->second.date != today && nowMs - it->second.lastUsedMs >= EVENT_LOG_IDLE_MS && !it->second.log->HasPending()) {
+                it = logs_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+};
+
+PLATFORM_SELECTANY EventLogStore g_eventLog;
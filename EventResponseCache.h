@@ -0,0 +1,239 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Platform.h"
+#include "MetricsRegistry.h"
+#include "EventLog.h"
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+// ==========================================
+//  [EVENT CACHE] Ready-made JSON bodies for /api/anomaly_events and /api/parking_areas
+// ==========================================
+// The dashboard polls the same few queries every couple of seconds. Each distinct query
+// (stream, date, camera, type, from, to, limit) keeps its last JSON array here, together with the
+// generation of every event log it was built from:
+//  - nothing appended since -> the cached body (or a 304 if the client already has its ETag)
+//  - records appended       -> only those records are read and spliced in front of the cached body,
+//                              older ones falling off the end when a limit applies
+//  - anything else (a clock step back puts a record in the middle) -> rebuilt from the logs
+// The ETag is a hash of the query and the log generations it was built at; appends the query filters
+// out keep the old body and ETag.
+// Built with HAVE_ZLIB, a body is also gzipped once per version after a client asked for gzip.
+
+const int EVENT_CACHE_MAX_ENTRIES = 64;
+const size_t EVENT_CACHE_MAX_BYTES = 64u << 20; // Bodies (plain + gzip) across all entries
+
+struct EventResponse {
+    std::string etag;     // Quoted, ready for the ETag header
+    std::string body;     // JSON array, newest first
+    std::string gzipBody; // Empty when not compressed (yet)
+};
+
+class EventResponseCache {
+public:
+    // Null when the day has no event log (served from the legacy per-event files instead)
+    std::shared_ptr<const EventResponse> Get(const std::string& stream, const std::string& date, int cameraId,
+                                             const EventLogQuery& q, bool wantGzip) {
+        std::vector<std::shared_ptr<EventLog>> logs = g_eventLog.Logs(stream, date, cameraId);
+        if (logs.empty()) return nullptr;
+        std::string key = stream + "|" + date + "|" + std::to_string(cameraId) + "|" + q.type + "|" +
+                          std::to_string(q.fromMs) + "|" + std::to_string(q.toMs) + "|" + std::to_string(q.limit);
+
+        std::shared_ptr<Entry> entry;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!requests_[0]) {
+                const char* results[] = { "hit", "incremental", "rebuild" };
+                for (int i = 0; i < 3; i++) {
+                    requests_[i] = &g_metrics.Counter("parking_event_cache_requests_total", "Event API queries by how the cached body was obtained",
+                                                      std::string("result=\"") + results[i] + "\"");
+                }
+            }
+            auto it = entries_.find(key);
+            if (it == entries_.end()) {
+                it = entries_.emplace(key, std::make_shared<Entry>()).first;
+                lru_.push_front(key);
+                it->second->lruPos = lru_.begin();
+            } else {
+                lru_.splice(lru_.begin(), lru_, it->second->lruPos);
+            }
+            entry = it->second;
+        }
+
+        size_t bytesBefore, bytesAfter;
+        std::shared_ptr<const EventResponse> response;
+        {
+            // One refresh per query at a time; different queries refresh in parallel
+            std::lock_guard<std::mutex> lock(entry->mutex);
+            bytesBefore = entry->Bytes();
+            Refresh(*entry, key, logs, q);
+            if (wantGzip) entry->wantsGzip = true;
+#ifdef HAVE_ZLIB
+            if (entry->wantsGzip && entry->response->gzipBody.empty()) {
+                auto compressed = std::make_shared<EventResponse>(*entry->response);
+                compressed->gzipBody = Gzip(compressed->body);
+                entry->response = compressed;
+            }
+#endif
+            bytesAfter = entry->Bytes();
+            response = entry->response;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(key);
+        if (it != entries_.end() && it->second == entry) { // Not evicted meanwhile
+            totalBytes_ += bytesAfter;
+            totalBytes_ -= std::min(totalBytes_, bytesBefore);
+            Evict(key);
+        }
+        return response;
+    }
+
+private:
+    struct Entry {
+        std::mutex mutex;
+        std::vector<std::pair<std::string, uint32_t>> generations; // Each log's (Dir(), Generation()) when last read
+        std::vector<std::pair<long long, uint32_t>> records;     // (epoch ms, bytes in body), newest first
+        std::shared_ptr<const EventResponse> response;
+        bool wantsGzip = false;
+        std::list<std::string>::iterator lruPos;
+
+        size_t Bytes() const { return response ? response->body.size() + response->gzipBody.size() : 0; }
+    };
+
+    std::mutex mutex_; // entries_, lru_, totalBytes_
+    std::map<std::string, std::shared_ptr<Entry>> entries_;
+    std::list<std::string> lru_; // Most recently used first
+    size_t totalBytes_ = 0;
+    MetricCounter* requests_[3] = {};
+
+    void Refresh(Entry& entry, const std::string& key, const std::vector<std::shared_ptr<EventLog>>& logs, const EventLogQuery& q) {
+        // Logs are known by directory: a past day's log reopened after eviction numbers its records the same way
+        std::vector<std::pair<std::string, uint32_t>> now;
+        for (const auto& log : logs) now.push_back(std::make_pair(log->Dir(), log->Generation()));
+        if (entry.response && now == entry.generations) {
+            requests_[0]->inc();
+            return;
+        }
+
+        // Records indexed since the last refresh (every record, for a log not seen before)
+        std::vector<std::pair<long long, std::string>> added;
+        for (size_t i = 0; i < logs.size(); i++) {
+            uint32_t since = 0;
+            for (const auto& seen : entry.generations) {
+                if (seen.first == now[i].first) since = seen.second;
+            }
+            logs[i]->Query(q, added, since, now[i].second);
+        }
+        EventLogStore::SortNewestFirst(added, q.limit);
+        if (entry.response && added.empty()) {
+            // Only records this query filters out: same body, same ETag
+            entry.generations.swap(now);
+            requests_[0]->inc();
+            return;
+        }
+
+        std::string body;
+        if (entry.response && (entry.records.empty() || added.back().first >= entry.records.front().first)) {
+            // Everything new is at least as recent as the cached head: prepend, trim the tail
+            size_t keep = entry.records.size();
+            if (q.limit > 0) keep = std::min(keep, (size_t)std::max(0, q.limit - (int)added.size()));
+            size_t keptBytes = 0;
+            for (size_t i = 0; i < keep; i++) keptBytes += entry.records[i].second + (i ? 1 : 0);
+
+            std::vector<std::pair<long long, uint32_t>> records;
+            body = "[";
+            for (const auto& r : added) {
+                if (records.size()) body += ",";
+                body += r.second;
+                records.push_back(std::make_pair(r.first, (uint32_t)r.second.size()));
+            }
+            if (keep > 0) {
+                if (records.size()) body += ",";
+                body.append(entry.response->body, 1, keptBytes);
+                records.insert(records.end(), entry.records.begin(), entry.records.begin() + keep);
+            }
+            body += "]";
+            entry.records.swap(records);
+            requests_[1]->inc();
+        } else {
+            // First request for this query, or a record landed behind the cached head
+            std::vector<std::pair<long long, std::string>> all;
+            for (size_t i = 0; i < logs.size(); i++) logs[i]->Query(q, all, 0, now[i].second);
+            EventLogStore::SortNewestFirst(all, q.limit);
+            entry.records.clear();
+            body = "[";
+            for (const auto& r : all) {
+                if (entry.records.size()) body += ",";
+                body += r.second;
+                entry.records.push_back(std::make_pair(r.first, (uint32_t)r.second.size()));
+            }
+            body += "]";
+            requests_[2]->inc();
+        }
+
+        auto response = std::make_shared<EventResponse>();
+        response->etag = ETag(key, now);
+        response->body = std::move(body);
+        entry.response = response;
+        entry.generations.swap(now);
+    }
+
+    static std::string ETag(const std::string& key, const std::vector<std::pair<std::string, uint32_t>>& generations) {
+        // FNV-1a over the query and the generations: cheap, and stable across restarts for unchanged days
+        uint64_t h = 1469598103934665603ULL;
+        auto mix = [&](const void* data, size_t size) {
+            const unsigned char* p = (const unsigned char*)data;
+            for (size_t i = 0; i < size; i++) h = (h ^ p[i]) * 1099511628211ULL;
+        };
+        mix(key.data(), key.size());
+        for (const auto& gen : generations) mix(&gen.second, sizeof(gen.second));
+        char etag[24];
+        sprintf_s(etag, sizeof(etag), "\"%016llx\"", (unsigned long long)h);
+        return etag;
+    }
+
+    // Drops least recently used entries (never `keep`, the one just served) until within the limits
+    void Evict(const std::string& keep) {
+        while ((entries_.size() > (size_t)EVENT_CACHE_MAX_ENTRIES || totalBytes_ > EVENT_CACHE_MAX_BYTES) && lru_.size() > 1) {
+            std::string victim = lru_.back();
+            if (victim == keep) break;
+            lru_.pop_back();
+            auto it = entries_.find(victim);
+            if (it == entries_.end()) continue;
+            {
+                std::lock_guard<std::mutex> lock(it->second->mutex);
+                totalBytes_ -= std::min(totalBytes_, it->second->Bytes());
+            }
+            entries_.erase(it);
+        }
+    }
+
+#ifdef HAVE_ZLIB
+    static std::string Gzip(const std::string& data) {
+        z_stream zs = {};
+        if (deflateInit2(&zs, Z_BEST_SPEED, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) return "";
+        std::string out(deflateBound(&zs, (uLong)data.size()), '\0');
+        zs.next_in = (Bytef*)data.data();
+        zs.avail_in = (uInt)data.size();
+        zs.next_out = (Bytef*)&out[0];
+        zs.avail_out = (uInt)out.size();
+        int rc = deflate(&zs, Z_FINISH);
+        out.resize(zs.total_out);
+        deflateEnd(&zs);
+        return rc == Z_STREAM_END ? out : "";
+    }
+#endif
+};
+
+PLATFORM_SELECTANY EventResponseCache g_eventResponseCache;
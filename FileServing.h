@@ -0,0 +1,294 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Platform.h"
+#ifdef _WIN32
+#include <mswsock.h> // TransmitFile; winsock2.h is already in (MjpegServer.h includes it first)
+#ifdef _MSC_VER
+#pragma comment(lib, "mswsock.lib")
+#endif
+#else
+#include <fcntl.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+#endif
+
+// ==========================================
+//  [FILES] Static file and DVR clip serving for MjpegServer
+// ==========================================
+// Clips and snapshots go from the page cache straight to the socket (sendfile / TransmitFile),
+// never through a user-space buffer. HTML pages and small files (snapshots) are kept in memory by
+// StaticAssetCache and re-checked against the file's size and mtime at most once a second.
+// Both carry an ETag ("size-mtime") and Last-Modified, so revalidations end in a 304, and Range
+// requests are answered per RFC 7233: one range -> 206, several -> multipart/byteranges,
+// none satisfiable -> 416.
+
+const size_t STATIC_CACHE_MAX_FILE = 256 * 1024;   // Larger files are always sent from disk
+const size_t STATIC_CACHE_MAX_PAGE = 4u << 20;     // HTML pages are always cached, up to this size
+const size_t STATIC_CACHE_MAX_BYTES = 32u << 20;
+const long long STATIC_CACHE_RECHECK_MS = 1000;
+const int HTTP_MAX_RANGES = 16;                     // More than this is treated as a plain GET
+const char* const HTTP_BYTERANGES_BOUNDARY = "parkingbyteranges";
+const int HTTP_KEEPALIVE_IDLE_SECONDS = 5;          // [KEEPALIVE] An idle kept-alive connection is closed after this
+const int HTTP_KEEPALIVE_MAX_REQUESTS = 100;       // ...or after this many requests
+
+// Read-only file handle with size and modification time
+class ServedFile {
+public:
+    ~ServedFile() { Close(); }
+
+    bool Open(const std::string& path) {
+        Close();
+#ifdef _WIN32
+        handle_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (handle_ == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER size;
+        FILETIME written;
+        if (!GetFileSizeEx(handle_, &size) || !GetFileTime(handle_, NULL, NULL, &written)) { Close(); return false; }
+        size_ = size.QuadPart;
+        ULARGE_INTEGER t;
+        t.LowPart = written.dwLowDateTime;
+        t.HighPart = written.dwHighDateTime;
+        mtime_ = (long long)(t.QuadPart / 10000000ULL) - 11644473600LL; // 100 ns since 1601 -> s since 1970
+#else
+        fd_ = open(PlatformPath(path).c_str(), O_RDONLY);
+        if (fd_ < 0) return false;
+        struct stat st;
+        if (fstat(fd_, &st) != 0 || !S_ISREG(st.st_mode)) { Close(); return false; }
+        size_ = (long long)st.st_size;
+        mtime_ = (long long)st.st_mtime;
+#endif
+        return true;
+    }
+
+    void Close() {
+#ifdef _WIN32
+        if (handle_ != INVALID_HANDLE_VALUE) CloseHandle(handle_);
+        handle_ = INVALID_HANDLE_VALUE;
+#else
+        if (fd_ >= 0) close(fd_);
+        fd_ = -1;
+#endif
+    }
+
+    long long Size() const { return size_; }
+    long long ModifiedTime() const { return mtime_; }
+
+    // Bytes [offset, offset + length) to the socket without copying them through user space
+    bool SendRange(SOCKET socket, long long offset, long long length) {
+        const long long maxChunk = 1LL << 30;
+        while (length > 0) {
+            long long chunk = std::min(length, maxChunk);
+#ifdef _WIN32
+            LARGE_INTEGER pos;
+            pos.QuadPart = offset;
+            if (!SetFilePointerEx(handle_, pos, NULL, FILE_BEGIN)) return false;
+            if (!TransmitFile(socket, handle_, (DWORD)chunk, 0, NULL, NULL, 0)) return false;
+            long long sent = chunk;
+#elif defined(__linux__)
+            off_t at = (off_t)offset;
+            ssize_t sent = sendfile(socket, fd_, &at, (size_t)chunk);
+            if (sent < 0 && errno == EINTR) continue;
+            if (sent <= 0) return false;
+#else
+            char buffer[64 * 1024];
+            ssize_t got = pread(fd_, buffer, (size_t)std::min<long long>(chunk, sizeof(buffer)), (off_t)offset);
+            if (got <= 0) return false;
+            ssize_t sent = send(socket, buffer, (size_t)got, 0);
+            if (sent <= 0) return false;
+#endif
+            offset += sent;
+            length -= sent;
+        }
+        return true;
+    }
+
+private:
+#ifdef _WIN32
+    HANDLE handle_ = INVALID_HANDLE_VALUE;
+#else
+    int fd_ = -1;
+#endif
+    long long size_ = 0;
+    long long mtime_ = 0;
+};
+
+// "Sun, 06 Nov 1994 08:49:37 GMT"
+inline std::string HttpDate(long long epochSeconds) {
+    time_t t = (time_t)epochSeconds;
+    tm utc;
+#ifdef _WIN32
+    gmtime_s(&utc, &t);
+#else
+    gmtime_r(&t, &utc);
+#endif
+    char text[40];
+    strftime(text, sizeof(text), "%a, %d %b %Y %H:%M:%S GMT", &utc);
+    return text;
+}
+
+inline std::string FileETag(long long size, long long mtime) {
+    char etag[48];
+    sprintf_s(etag, sizeof(etag), "\"%llx-%llx\"", (unsigned long long)size, (unsigned long long)mtime);
+    return etag;
+}
+
+// Routes map a URL prefix onto a folder ("C:" + /locvideo/...): false when `path` could climb out
+// of it, names a second drive or alternate data stream past the "C:", or holds a NUL that would
+// cut it short when opened
+inline bool IsConfinedPath(const std::string& path) {
+    return path.find("..") == std::string::npos && path.find(':', 2) == std::string::npos &&
+           path.find('\0') == std::string::npos;
+}
+
+// Parses a Range header value ("bytes=0-99,200-,-500") against a file of `size` bytes.
+// Returns 0 to ignore it (absent, malformed, not bytes, too many ranges), 1 with `ranges` filled
+// (inclusive [first, last], in request order), -1 when no range is satisfiable (416).
+inline int ParseByteRanges(const std::string& header, long long size, std::vector<std::pair<long long, long long>>& ranges) {
+    ranges.clear();
+    std::string value = header;
+    value.erase(std::remove(value.begin(), value.end(), ' '), value.end());
+    if (value.compare(0, 6, "bytes=") != 0) return 0;
+    size_t pos = 6;
+    int specs = 0;
+    while (pos <= value.size()) {
+        size_t comma = value.find(',', pos);
+        if (comma == std::string::npos) comma = value.size();
+        std::string spec = value.substr(pos, comma - pos);
+        pos = comma + 1;
+        if (spec.empty()) continue;
+        if (++specs > HTTP_MAX_RANGES) return 0;
+        size_t dash = spec.find('-');
+        if (dash == std::string::npos) return 0;
+        std::string firstText = spec.substr(0, dash), lastText = spec.substr(dash + 1);
+        if (firstText.find_first_not_of("0123456789") != std::string::npos || lastText.find_first_not_of("0123456789") != std::string::npos) return 0;
+        if (firstText.size() > 18 || lastText.size() > 18) return 0;
+        long long first, last;
+        if (firstText.empty()) { // Suffix: the last N bytes
+            if (lastText.empty()) return 0;
+            long long n = std::stoll(lastText);
+            if (n == 0) continue;
+            first = std::max(0LL, size - n);
+            last = size - 1;
+        } else {
+            first = std::stoll(firstText);
+            last = lastText.empty() ? size - 1 : std::min(std::stoll(lastText), size - 1);
+            if (!lastText.empty() && std::stoll(lastText) < first) return 0;
+        }
+        if (first >= size || size == 0) continue; // Unsatisfiable on its own; others may still be fine
+        ranges.push_back(std::make_pair(first, last));
+    }
+    if (specs == 0) return 0;
+    return ranges.empty() ? -1 : 1;
+}
+
+struct StaticAsset {
+    std::string body;
+    long long size = 0;
+    long long mtime = 0;
+    std::string etag;
+    std::string lastModified;
+};
+
+// HTML pages and small files, kept in memory and revalidated against the disk at most once a second
+class StaticAssetCache {
+public:
+    // Null when the file is missing or larger than `maxFile`
+    std::shared_ptr<const StaticAsset> Get(const std::string& path, size_t maxFile = STATIC_CACHE_MAX_FILE) {
+        long long nowMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        std::shared_ptr<const StaticAsset> cached;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = entries_.find(path);
+            if (it != entries_.end()) {
+                it->second.lastUsedMs = nowMs;
+                cached = it->second.asset;
+                if (cached && nowMs - it->second.checkedMs < STATIC_CACHE_RECHECK_MS) return cached;
+            }
+        }
+
+        // Revalidate and read without the lock, so a slow disk only holds up requests for this file
+        ServedFile file;
+        if (!file.Open(path) || file.Size() > (long long)maxFile) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            Drop(path);
+            return nullptr;
+        }
+        std::shared_ptr<const StaticAsset> result = cached;
+        if (!cached || cached->size != file.Size() || cached->mtime != file.ModifiedTime()) {
+            auto asset = std::make_shared<StaticAsset>();
+            if (!ReadAll(path, file.Size(), asset->body)) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                Drop(path);
+                return nullptr;
+            }
+            asset->size = file.Size();
+            asset->mtime = file.ModifiedTime();
+            asset->etag = FileETag(asset->size, asset->mtime);
+            asset->lastModified = HttpDate(asset->mtime);
+            result = asset;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        Entry& entry = entries_[path];
+        if (entry.asset != result) { // Another request may have published a copy meanwhile; either is current
+            totalBytes_ += result->body.size();
+            totalBytes_ -= std::min(totalBytes_, entry.asset ? entry.asset->body.size() : 0);
+            entry.asset = result;
+        }
+        entry.checkedMs = nowMs;
+        entry.lastUsedMs = nowMs;
+        Evict(path);
+        return result;
+    }
+
+private:
+    struct Entry {
+        std::shared_ptr<const StaticAsset> asset;
+        long long checkedMs = 0;
+        long long lastUsedMs = 0;
+    };
+    std::mutex mutex_;
+    std::map<std::string, Entry> entries_;
+    size_t totalBytes_ = 0;
+
+    static bool ReadAll(const std::string& path, long long size, std::string& out) {
+        FILE* f = nullptr;
+        if (fopen_s(&f, path.c_str(), "rb") != 0 || !f) return false;
+        out.resize((size_t)size);
+        bool ok = size == 0 || fread(&out[0], 1, (size_t)size, f) == (size_t)size;
+        fclose(f);
+        return ok;
+    }
+
+    void Drop(const std::string& path) {
+        auto it = entries_.find(path);
+        if (it == entries_.end()) return;
+        if (it->second.asset) totalBytes_ -= std::min(totalBytes_, it->second.asset->body.size());
+        entries_.erase(it);
+    }
+
+    // Least recently used first, never `keep`
+    void Evict(const std::string& keep) {
+        while (totalBytes_ > STATIC_CACHE_MAX_BYTES && entries_.size() > 1) {
+            auto victim = entries_.end();
+            for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+                if (it->first != keep && (victim == entries_.end() || it->second.lastUsedMs < victim->second.lastUsedMs)) victim = it;
+            }
+            if (victim == entries_.end()) break;
+            Drop(victim->first);
+        }
+    }
+};
+
+PLATFORM_SELECTANY StaticAssetCache g_staticAssets;
@@ -0,0 +1,254 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <cstdio>
+#include "Platform.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// ==========================================
+//  [LATENCY] Per-frame pipeline timestamps + per-camera latency histograms
+// ==========================================
+
+// Points a frame passes through, in pipeline order. Each holds the time the stage *finished*.
+enum LatencyStage {
+    STAGE_CAPTURE = 0,  // Retrieved from the capture backend
+    STAGE_DEQUEUE,      // Picked up by the processing thread
+    STAGE_PREPROCESS,   // Letterbox + blob done
+    STAGE_INFERENCE,    // Session::Run returned
+    STAGE_POSTPROCESS,  // Decode + NMS done
+    STAGE_TRACK,        // Tracker + parking logic done
+    STAGE_RENDER,       // Overlay drawn
+    STAGE_PUBLISH,      // Handed to the web server
+    STAGE_FIRST_BYTE,   // First byte of the frame written to a viewer socket
+    STAGE_COUNT
+};
+
+// Histograms kept per camera
+enum LatencyMetric {
+    LAT_QUEUE_WAIT = 0,         // capture -> dequeue
+    LAT_PREPROCESS,
+    LAT_INFERENCE,
+    LAT_POSTPROCESS,
+    LAT_TRACK,
+    LAT_RENDER,
+    LAT_PUBLISH,                // render -> publish (hand-off to the streaming thread)
+    LAT_SEND,                   // publish -> first byte (encode + socket)
+    LAT_CAPTURE_TO_PUBLISH,
+    LAT_CAPTURE_TO_FIRST_BYTE,
+    LAT_CAPTURE_AGE,            // Buffering before capture, from stream PTS (see FrameAgeMonitor_Online)
+    LAT_METRIC_COUNT
+};
+
+inline const char* LatencyMetricName(int metric) {
+    static const char* names[LAT_METRIC_COUNT] = {
+        "queue_wait", "preprocess", "inference", "postprocess", "track", "render",
+        "publish", "send", "capture_to_publish", "capture_to_first_byte", "capture_age"
+    };
+    return (metric >= 0 && metric < LAT_METRIC_COUNT) ? names[metric] : "unknown";
+}
+
+struct FrameTimestamps {
+    long long seq = 0;
+    long long t[STAGE_COUNT] = { 0 }; // Microseconds on the steady clock, 0 = stage not reached
+
+    static long long NowUs() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void mark(LatencyStage stage) { t[stage] = NowUs(); }
+    bool has(LatencyStage stage) const { return t[stage] != 0; }
+
+    // Time spent reaching `stage` from the last stage that was reached before it (-1 if unknown)
+    long long stageUs(LatencyStage stage) const {
+        if (!has(stage)) return -1;
+        for (int prev = (int)stage - 1; prev >= 0; prev--) {
+            if (t[prev] != 0) return t[stage] - t[prev];
+        }
+        return -1;
+    }
+
+    long long spanUs(LatencyStage from, LatencyStage to) const {
+        return (has(from) && has(to)) ? t[to] - t[from] : -1;
+    }
+};
+
+// Log-linear bucketed histogram (HDR style): 16 sub-buckets per power of two, so any
+// recorded value is reported within ~6% of its true value. Lock-free, safe to record
+// from any thread.
+class LatencyHistogram {
+public:
+    static const int SUB_BITS = 4;
+    static const int SUB_COUNT = 1 << SUB_BITS;
+    static const int MAGNITUDES = 36; // Up to ~2^39 us, far beyond anything sane
+    static const int BUCKET_COUNT = SUB_COUNT * MAGNITUDES;
+
+    LatencyHistogram() { reset(); }
+
+    void record(long long valueUs) {
+        if (valueUs < 0) return;
+        buckets_[BucketIndex((unsigned long long)valueUs)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(valueUs, std::memory_order_relaxed);
+        long long prevMax = max_.load(std::memory_order_relaxed);
+        while (valueUs > prevMax && !max_.compare_exchange_weak(prevMax, valueUs, std::memory_order_relaxed)) {}
+    }
+
+    void reset() {
+        for (int i = 0; i < BUCKET_COUNT; i++) buckets_[i].store(0, std::memory_order_relaxed);
+        count_.store(0);
+        sum_.store(0);
+        max_.store(0);
+    }
+
+    long long count() const { return count_.load(std::memory_order_relaxed); }
+    long long maxUs() const { return max_.load(std::memory_order_relaxed); }
+    double meanUs() const {
+        long long n = count();
+        return n > 0 ? (double)sum_.load(std::memory_order_relaxed) / n : 0.0;
+    }
+
+    // p in [0, 100]. Returns the midpoint of the bucket holding that rank.
+    double percentileUs(double p) const {
+        long long n = count();
+        if (n <= 0) return 0.0;
+        long long rank = (long long)(p / 100.0 * n + 0.5);
+        if (rank < 1) rank = 1;
+        if (rank > n) rank = n;
+
+        long long seen = 0;
+        for (int i = 0; i < BUCKET_COUNT; i++) {
+            seen += buckets_[i].load(std::memory_order_relaxed);
+            if (seen >= rank) {
+                double lo = (double)BucketLowerBound(i);
+                double hi = (double)BucketLowerBound(i + 1);
+                double mid = (lo + hi) * 0.5;
+                double mx = (double)maxUs();
+                return mid > mx ? mx : mid;
+            }
+        }
+        return (double)maxUs();
+    }
+
+private:
+    std::atomic<long long> buckets_[BUCKET_COUNT];
+    std::atomic<long long> count_{ 0 };
+    std::atomic<long long> sum_{ 0 };
+    std::atomic<long long> max_{ 0 };
+
+    static int HighestBit(unsigned long long v) {
+#ifdef _MSC_VER
+        unsigned long idx = 0;
+        _BitScanReverse64(&idx, v);
+        return (int)idx;
+#else
+        return 63 - __builtin_clzll(v);
+#endif
+    }
+
+    // Values below SUB_COUNT are exact; above that, magnitude m covers [2^(m+3), 2^(m+4))
+    static int BucketIndex(unsigned long long v) {
+        if (v < (unsigned long long)SUB_COUNT) return (int)v;
+        int shift = HighestBit(v) - SUB_BITS;
+        int magnitude = shift + 1;
+        if (magnitude >= MAGNITUDES) return BUCKET_COUNT - 1;
+        int sub = (int)((v >> shift) & (SUB_COUNT - 1));
+        return magnitude * SUB_COUNT + sub;
+    }
+
+    static long long BucketLowerBound(int idx) {
+        int magnitude = idx / SUB_COUNT;
+        int sub = idx % SUB_COUNT;
+        if (magnitude == 0) return sub;
+        return (long long)(SUB_COUNT + sub) << (magnitude - 1);
+    }
+};
+
+// All latency histograms of one camera
+class LatencyTracker {
+public:
+    // Everything up to the hand-off to the web server (called once per published frame)
+    void recordPipeline(const FrameTimestamps& ts) {
+        RecordSpan(LAT_QUEUE_WAIT, ts.stageUs(STAGE_DEQUEUE));
+        RecordSpan(LAT_PREPROCESS, ts.stageUs(STAGE_PREPROCESS));
+        RecordSpan(LAT_INFERENCE, ts.stageUs(STAGE_INFERENCE));
+        RecordSpan(LAT_POSTPROCESS, ts.stageUs(STAGE_POSTPROCESS));
+        RecordSpan(LAT_TRACK, ts.stageUs(STAGE_TRACK));
+        RecordSpan(LAT_RENDER, ts.stageUs(STAGE_RENDER));
+        RecordSpan(LAT_PUBLISH, ts.stageUs(STAGE_PUBLISH));
+        RecordSpan(LAT_CAPTURE_TO_PUBLISH, ts.spanUs(STAGE_CAPTURE, STAGE_PUBLISH));
+        framesPublished_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Called by every viewer that sends the frame; only the first one per frame counts
+    void recordFirstByte(const FrameTimestamps& ts) {
+        long long prev = lastFirstByteSeq_.load(std::memory_order_relaxed);
+        while (ts.seq > prev) {
+            if (lastFirstByteSeq_.compare_exchange_weak(prev, ts.seq)) {
+                RecordSpan(LAT_SEND, ts.spanUs(STAGE_PUBLISH, STAGE_FIRST_BYTE));
+                RecordSpan(LAT_CAPTURE_TO_FIRST_BYTE, ts.spanUs(STAGE_CAPTURE, STAGE_FIRST_BYTE));
+                return;
+            }
+        }
+    }
+
+    void recordCaptureAgeMs(double ageMs) {
+        if (ageMs >= 0) histograms_[LAT_CAPTURE_AGE].record((long long)(ageMs * 1000.0));
+    }
+
+    const LatencyHistogram& histogram(LatencyMetric metric) const { return histograms_[metric]; }
+
+    void reset() {
+        for (auto& h : histograms_) h.reset();
+        framesPublished_.store(0);
+    }
+
+    std::string ToJson(int cameraId) const {
+        std::string json = "{\"camera_id\":" + std::to_string(cameraId) +
+            ",\"frames_published\":" + std::to_string(framesPublished_.load()) + ",\"unit\":\"ms\",\"stages\":{";
+        for (int m = 0; m < LAT_METRIC_COUNT; m++) {
+            const LatencyHistogram& h = histograms_[m];
+            char buf[384];
+            snprintf(buf, sizeof(buf),
+                "%s\"%s\":{\"count\":%lld,\"mean\":%.3f,\"p50\":%.3f,\"p90\":%.3f,\"p99\":%.3f,\"p999\":%.3f,\"max\":%.3f}",
+                m == 0 ? "" : ",", LatencyMetricName(m), h.count(), h.meanUs() / 1000.0,
+                h.percentileUs(50) / 1000.0, h.percentileUs(90) / 1000.0,
+                h.percentileUs(99) / 1000.0, h.percentileUs(99.9) / 1000.0, h.maxUs() / 1000.0);
+            json += buf;
+        }
+        json += "}}";
+        return json;
+    }
+
+private:
+    LatencyHistogram histograms_[LAT_METRIC_COUNT];
+    std::atomic<long long> framesPublished_{ 0 };
+    std::atomic<long long> lastFirstByteSeq_{ 0 };
+
+    void RecordSpan(LatencyMetric metric, long long us) {
+        if (us >= 0) histograms_[metric].record(us);
+    }
+};
+
+// Trackers are created on first use and never destroyed, so references stay valid
+class LatencyRegistry {
+public:
+    LatencyTracker& Get(int cameraId) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::unique_ptr<LatencyTracker>& slot = trackers_[cameraId];
+        if (!slot) slot.reset(new LatencyTracker());
+        return *slot;
+    }
+
+private:
+    std::mutex mutex_;
+    std::map<int, std::unique_ptr<LatencyTracker>> trackers_;
+};
+
+PLATFORM_SELECTANY LatencyRegistry g_latencyRegistry;
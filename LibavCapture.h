@@ -0,0 +1,367 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <cstdio>
+#include "Platform.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libswscale/swscale.h>
+#include <libavutil/imgutils.h>
+}
+
+#ifdef _MSC_VER
+#pragma comment(lib, "avformat.lib")
+#pragma comment(lib, "avcodec.lib")
+#pragma comment(lib, "avutil.lib")
+#pragma comment(lib, "swscale.lib")
+#endif
+
+// How much of the stream the decoder is allowed to skip.
+// Set by the processing side from the inference rate it actually achieves.
+enum class DecodePolicy {
+    ALL_FRAMES = 0,     // Decode everything
+    REFERENCE_ONLY = 1, // Drop non-reference frames before decoding (AVDISCARD_NONREF)
+    KEYFRAME_ONLY = 2   // Decode I-frames only (AVDISCARD_NONKEY)
+};
+
+// Network stream capture built directly on libavformat/libavcodec.
+// Derives from cv::VideoCapture so it can sit behind the existing cv::VideoCapture* pointers:
+// grab() demuxes + decodes (honouring the DecodePolicy), retrieve() does the BGR conversion,
+// so frames that are grabbed but never retrieved never pay for sws_scale.
+// With setOutputWidth() retrieve() scales and converts in the same sws pass; the native picture
+// stays available through fullResMaterializer() without being converted.
+class LibavCapture : public cv::VideoCapture {
+public:
+    LibavCapture() {}
+
+    ~LibavCapture() override {
+        release();
+    }
+
+    using cv::VideoCapture::open;
+
+    bool open(const cv::String& url, int apiPreference = cv::CAP_ANY) override {
+        (void)apiPreference;
+        release();
+
+        AVDictionary* opts = nullptr;
+        if (url.find("rtsp://") == 0) {
+            av_dict_set(&opts, "rtsp_transport", "tcp", 0);
+        }
+        // Don't let libavformat build its own jitter buffer in front of us
+        av_dict_set(&opts, "fflags", "nobuffer", 0);
+        av_dict_set(&opts, "flags", "low_delay", 0);
+        av_dict_set(&opts, "rw_timeout", std::to_string((long long)readTimeoutMs_ * 1000).c_str(), 0);
+
+        fmtCtx_ = avformat_alloc_context();
+        if (!fmtCtx_) { av_dict_free(&opts); return false; }
+        fmtCtx_->interrupt_callback.callback = &LibavCapture::InterruptCallback;
+        fmtCtx_->interrupt_callback.opaque = this;
+
+        ArmDeadline(openTimeoutMs_);
+        int ret = avformat_open_input(&fmtCtx_, url.c_str(), nullptr, &opts);
+        av_dict_free(&opts);
+        if (ret < 0) {
+            LogError("avformat_open_input", ret);
+            fmtCtx_ = nullptr; // freed by avformat_open_input on failure
+            return false;
+        }
+
+        ArmDeadline(openTimeoutMs_);
+        if ((ret = avformat_find_stream_info(fmtCtx_, nullptr)) < 0) {
+            LogError("avformat_find_stream_info", ret);
+            release();
+            return false;
+        }
+
+        const AVCodec* decoder = nullptr;
+        videoStream_ = av_find_best_stream(fmtCtx_, AVMEDIA_TYPE_VIDEO, -1, -1, &decoder, 0);
+        if (videoStream_ < 0 || !decoder) {
+            LogError("av_find_best_stream", videoStream_);
+            release();
+            return false;
+        }
+
+        AVStream* stream = fmtCtx_->streams[videoStream_];
+        codecCtx_ = avcodec_alloc_context3(decoder);
+        if (!codecCtx_ || avcodec_parameters_to_context(codecCtx_, stream->codecpar) < 0) {
+            release();
+            return false;
+        }
+        // Slice threading only: frame threading would hold back N frames of latency
+        codecCtx_->thread_count = 0;
+        codecCtx_->thread_type = FF_THREAD_SLICE;
+        codecCtx_->flags |= AV_CODEC_FLAG_LOW_DELAY;
+
+        if ((ret = avcodec_open2(codecCtx_, decoder, nullptr)) < 0) {
+            LogError("avcodec_open2", ret);
+            release();
+            return false;
+        }
+
+        AVRational rate = stream->avg_frame_rate.num > 0 ? stream->avg_frame_rate : stream->r_frame_rate;
+        fps_ = (rate.num > 0 && rate.den > 0) ? av_q2d(rate) : 0.0;
+        if (fps_ <= 0 || fps_ > 120) fps_ = 30.0;
+
+        packet_ = av_packet_alloc();
+        frame_ = av_frame_alloc();
+        if (!packet_ || !frame_) {
+            release();
+            return false;
+        }
+
+        appliedPolicy_ = DecodePolicy::ALL_FRAMES;
+        hasFrame_ = false;
+        framesSinceKey_ = 0;
+        gopFrames_ = 0;
+        return true;
+    }
+
+    bool isOpened() const override {
+        return fmtCtx_ != nullptr && codecCtx_ != nullptr;
+    }
+
+    void release() override {
+        if (swsCtx_) { sws_freeContext(swsCtx_); swsCtx_ = nullptr; }
+        if (frame_) av_frame_free(&frame_);
+        if (packet_) av_packet_free(&packet_);
+        if (codecCtx_) avcodec_free_context(&codecCtx_);
+        if (fmtCtx_) avformat_close_input(&fmtCtx_);
+        videoStream_ = -1;
+        hasFrame_ = false;
+    }
+
+    // Demux + decode until the next picture is available. No colour conversion here.
+    bool grab() override {
+        if (!isOpened()) return false;
+        hasFrame_ = false;
+        ApplyPolicy();
+
+        while (true) {
+            int ret = avcodec_receive_frame(codecCtx_, frame_);
+            if (ret == 0) {
+                hasFrame_ = true;
+                framesDecoded_++;
+                return true;
+            }
+            if (ret != AVERROR(EAGAIN)) return false;
+
+            ArmDeadline(readTimeoutMs_);
+            ret = av_read_frame(fmtCtx_, packet_);
+            if (ret < 0) {
+                LogError("av_read_frame", ret);
+                return false;
+            }
+            if (packet_->stream_index != videoStream_) {
+                av_packet_unref(packet_);
+                continue;
+            }
+            {
+                std::lock_guard<std::mutex> lock(tapMutex_);
+                if (packetTap_) packetTap_(packet_);
+            }
+
+            bool isKey = (packet_->flags & AV_PKT_FLAG_KEY) != 0;
+            TrackGop(isKey);
+
+            // Keyframe-only: the decoder would discard these anyway, skip the send entirely
+            if (appliedPolicy_ == DecodePolicy::KEYFRAME_ONLY && !isKey) {
+                av_packet_unref(packet_);
+                packetsSkipped_++;
+                continue;
+            }
+
+            ret = avcodec_send_packet(codecCtx_, packet_);
+            av_packet_unref(packet_);
+            if (ret < 0 && ret != AVERROR(EAGAIN)) {
+                LogError("avcodec_send_packet", ret);
+                // Corrupt packet on a lossy network: keep going, the next keyframe recovers
+                continue;
+            }
+        }
+    }
+
+    // Convert the last grabbed picture to BGR (downscaled to the output width, if one is set)
+    bool retrieve(cv::OutputArray image, int flag = 0) override {
+        (void)flag;
+        if (!hasFrame_ || !frame_ || frame_->width <= 0 || frame_->height <= 0) return false;
+
+        int dstW = frame_->width;
+        int dstH = frame_->height;
+        int outW = outputWidth_.load();
+        if (outW > 0 && outW < frame_->width) {
+            dstW = outW;
+            dstH = ((int)((long long)frame_->height * outW / frame_->width)) & ~1;
+            if (dstH <= 0) dstH = 2;
+        }
+
+        swsCtx_ = sws_getCachedContext(swsCtx_,
+            frame_->width, frame_->height, (AVPixelFormat)frame_->format,
+            dstW, dstH, AV_PIX_FMT_BGR24,
+            dstW == frame_->width ? SWS_BILINEAR : SWS_AREA, nullptr, nullptr, nullptr);
+        if (!swsCtx_) return false;
+
+        image.create(dstH, dstW, CV_8UC3);
+        cv::Mat dst = image.getMat();
+        return ConvertToBgr(swsCtx_, frame_, dst);
+    }
+
+    // Deferred native-resolution BGR conversion of the last grabbed picture.
+    // Holds a reference to the decoded planes only; conversion happens when (and if) it is called,
+    // on the caller's thread.
+    std::function<cv::Mat()> fullResMaterializer() const {
+        if (!hasFrame_ || !frame_) return std::function<cv::Mat()>();
+        AVFrame* ref = av_frame_clone(frame_);
+        if (!ref) return std::function<cv::Mat()>();
+        std::shared_ptr<AVFrame> shared(ref, [](AVFrame* f) { av_frame_free(&f); });
+
+        return [shared]() -> cv::Mat {
+            AVFrame* f = shared.get();
+            SwsContext* ctx = sws_getContext(f->width, f->height, (AVPixelFormat)f->format,
+                f->width, f->height, AV_PIX_FMT_BGR24, SWS_BILINEAR, nullptr, nullptr, nullptr);
+            if (!ctx) return cv::Mat();
+            cv::Mat out(f->height, f->width, CV_8UC3);
+            bool ok = ConvertToBgr(ctx, f, out);
+            sws_freeContext(ctx);
+            return ok ? out : cv::Mat();
+        };
+    }
+
+    bool read(cv::OutputArray image) override {
+        if (grab()) return retrieve(image);
+        image.release();
+        return false;
+    }
+
+    bool set(int propId, double value) override {
+        switch (propId) {
+            case cv::CAP_PROP_OPEN_TIMEOUT_MSEC: openTimeoutMs_ = (int)value; return true;
+            case cv::CAP_PROP_READ_TIMEOUT_MSEC: readTimeoutMs_ = (int)value; return true;
+            default: return false; // CAP_PROP_BUFFERSIZE etc.: we never buffer decoded frames
+        }
+    }
+
+    double get(int propId) const override {
+        switch (propId) {
+            case cv::CAP_PROP_FPS: return fps_;
+            case cv::CAP_PROP_FRAME_WIDTH: return codecCtx_ ? codecCtx_->width : 0;
+            case cv::CAP_PROP_FRAME_HEIGHT: return codecCtx_ ? codecCtx_->height : 0;
+            case cv::CAP_PROP_POS_MSEC: return CurrentPtsMs();
+            case cv::CAP_PROP_OPEN_TIMEOUT_MSEC: return openTimeoutMs_;
+            case cv::CAP_PROP_READ_TIMEOUT_MSEC: return readTimeoutMs_;
+            case cv::CAP_PROP_BUFFERSIZE: return 0;
+            default: return 0;
+        }
+    }
+
+    // 0 = native size. Only ever downscales; the aspect ratio is kept.
+    void setOutputWidth(int width) { outputWidth_.store(width); }
+    int getOutputWidth() const { return outputWidth_.load(); }
+
+    void setDecodePolicy(DecodePolicy policy) { requestedPolicy_.store((int)policy); }
+    DecodePolicy getDecodePolicy() const { return (DecodePolicy)requestedPolicy_.load(); }
+
+    // [PASSTHROUGH] Sees every demuxed video packet before any decode-skip decision.
+    // Runs on the reading thread; must not block.
+    void setPacketTap(std::function<void(const AVPacket*)> tap) {
+        std::lock_guard<std::mutex> lock(tapMutex_);
+        packetTap_ = std::move(tap);
+    }
+    const AVCodecParameters* videoCodecParameters() const {
+        return isOpened() ? fmtCtx_->streams[videoStream_]->codecpar : nullptr;
+    }
+    AVRational videoTimeBase() const {
+        return isOpened() ? fmtCtx_->streams[videoStream_]->time_base : AVRational{ 1, 90000 };
+    }
+
+    // Frames between the last two keyframes (0 until two keyframes were seen)
+    int gopFrames() const { return gopFrames_.load(); }
+    long long framesDecoded() const { return framesDecoded_.load(); }
+    long long packetsSkipped() const { return packetsSkipped_.load(); }
+
+private:
+    AVFormatContext* fmtCtx_ = nullptr;
+    AVCodecContext* codecCtx_ = nullptr;
+    SwsContext* swsCtx_ = nullptr;
+    AVPacket* packet_ = nullptr;
+    AVFrame* frame_ = nullptr;
+    int videoStream_ = -1;
+    bool hasFrame_ = false;
+    double fps_ = 30.0;
+
+    int openTimeoutMs_ = 5000;
+    int readTimeoutMs_ = 5000;
+    std::chrono::steady_clock::time_point deadline_;
+
+    std::atomic<int> outputWidth_{ 0 };
+    std::atomic<int> requestedPolicy_{ (int)DecodePolicy::ALL_FRAMES };
+    DecodePolicy appliedPolicy_ = DecodePolicy::ALL_FRAMES;
+
+    int framesSinceKey_ = 0;
+    std::atomic<int> gopFrames_{ 0 };
+    std::atomic<long long> framesDecoded_{ 0 };
+    std::atomic<long long> packetsSkipped_{ 0 };
+
+    std::mutex tapMutex_;
+    std::function<void(const AVPacket*)> packetTap_;
+
+    static int InterruptCallback(void* opaque) {
+        LibavCapture* self = static_cast<LibavCapture*>(opaque);
+        return std::chrono::steady_clock::now() > self->deadline_ ? 1 : 0;
+    }
+
+    void ArmDeadline(int timeoutMs) {
+        deadline_ = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs > 0 ? timeoutMs : 5000);
+    }
+
+    // skip_frame is only touched from the reader thread, between decode calls
+    void ApplyPolicy() {
+        DecodePolicy wanted = (DecodePolicy)requestedPolicy_.load();
+        if (wanted == appliedPolicy_) return;
+        switch (wanted) {
+            case DecodePolicy::ALL_FRAMES: codecCtx_->skip_frame = AVDISCARD_DEFAULT; break;
+            case DecodePolicy::REFERENCE_ONLY: codecCtx_->skip_frame = AVDISCARD_NONREF; break;
+            case DecodePolicy::KEYFRAME_ONLY: codecCtx_->skip_frame = AVDISCARD_NONKEY; break;
+        }
+        appliedPolicy_ = wanted;
+    }
+
+    void TrackGop(bool isKey) {
+        if (isKey) {
+            if (framesSinceKey_ > 0) gopFrames_.store(framesSinceKey_);
+            framesSinceKey_ = 1;
+        } else if (framesSinceKey_ > 0) {
+            framesSinceKey_++;
+        }
+    }
+
+    static bool ConvertToBgr(SwsContext* ctx, const AVFrame* src, cv::Mat& dst) {
+        uint8_t* dstData[4] = { dst.data, nullptr, nullptr, nullptr };
+        int dstStride[4] = { (int)dst.step, 0, 0, 0 };
+        return sws_scale(ctx, src->data, src->linesize, 0, src->height, dstData, dstStride) > 0;
+    }
+
+    double CurrentPtsMs() const {
+        if (!frame_ || !hasFrame_ || videoStream_ < 0) return 0.0;
+        long long pts = frame_->best_effort_timestamp;
+        if (pts == AV_NOPTS_VALUE) return 0.0;
+        AVStream* stream = fmtCtx_->streams[videoStream_];
+        if (stream->start_time != AV_NOPTS_VALUE) pts -= stream->start_time;
+        return pts * av_q2d(stream->time_base) * 1000.0;
+    }
+
+    static void LogError(const char* what, int err) {
+        char errBuf[AV_ERROR_MAX_STRING_SIZE] = { 0 };
+        av_strerror(err, errBuf, sizeof(errBuf));
+        char msg[512];
+        snprintf(msg, sizeof(msg), "[LIBAV] %s failed: %s\n", what, errBuf);
+        OutputDebugStringA(msg);
+    }
+};
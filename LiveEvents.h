@@ -0,0 +1,293 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Platform.h"
+#include "ParkingSlot.h"
+#include "MetricsRegistry.h"
+
+// ==========================================
+//  [LIVE] Server-Sent Events behind /api/{id}/events
+// ==========================================
+// The processing thread reports slot states every frame and violations as they are recorded.
+// The hub keeps the last published state per camera and collects only what changed; a flusher
+// thread turns each camera's pending changes into one SSE message every LIVE_EVENTS_COALESCE_MS
+// and hands the same serialized string to every subscriber of that camera.
+//   event: snapshot  {"seq","slots":{"<id>":"empty|occupied|wrong_type"},"counts":{...},"violations":[]}
+//   event: update    {"seq","slots":{changed slots only},"counts":{...} when changed,"violations":[new ones]}
+// counts has the /api/stats fields (empty, normal, carEmpty, carNormal, motoEmpty, motoNormal, violation).
+// A subscriber that falls LIVE_EVENTS_MAX_QUEUE messages behind has its backlog replaced by a snapshot.
+
+const int LIVE_EVENTS_COALESCE_MS = 200;
+const int LIVE_EVENTS_MAX_QUEUE = 64;
+const int LIVE_EVENTS_PING_MS = 15000;
+
+using LiveMessage = std::shared_ptr<const std::string>;
+
+class LiveSubscriber {
+public:
+    explicit LiveSubscriber(int cameraId) : cameraId(cameraId) {}
+    const int cameraId;
+
+    // Waits up to `timeoutMs` for messages; false on timeout, or at once once closed (check Closed())
+    bool Wait(std::vector<LiveMessage>& out, int timeoutMs) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait_for(lock, std::chrono::milliseconds(timeoutMs), [&]() { return !queue_.empty() || closed_; });
+        if (queue_.empty()) return false;
+        out.assign(queue_.begin(), queue_.end());
+        queue_.clear();
+        return true;
+    }
+
+    // False when the subscriber is too far behind (its backlog is dropped; the caller sends a snapshot)
+    bool Push(const LiveMessage& message) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if ((int)queue_.size() >= LIVE_EVENTS_MAX_QUEUE) {
+            queue_.clear();
+            return false;
+        }
+        queue_.push_back(message);
+        cv_.notify_one();
+        return true;
+    }
+
+    void Close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        cv_.notify_all();
+    }
+
+    bool Closed() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return closed_;
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<LiveMessage> queue_;
+    bool closed_ = false;
+};
+
+class LiveEventHub {
+public:
+    ~LiveEventHub() { Stop(); }
+
+    // Every processed frame. slotTypes: "Car" / "Motorcycle" per slot.
+    void UpdateSlots(int cameraId, const std::map<int, SlotStatus>& statuses, const std::map<int, std::string>& slotTypes, int violatingCars) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Channel& ch = channels_[cameraId];
+        for (const auto& entry : statuses) {
+            const char* state = StateName(entry.second);
+            auto it = ch.slots.find(entry.first);
+            if (it != ch.slots.end() && it->second.state == state) continue;
+            SlotState& s = ch.slots[entry.first];
+            s.state = state;
+            auto type = slotTypes.find(entry.first);
+            if (type != slotTypes.end()) s.moto = type->second == "Motorcycle";
+            ch.changedSlots.insert(entry.first);
+        }
+        if (ch.slots.size() != statuses.size()) {
+            for (auto it = ch.slots.begin(); it != ch.slots.end();) {
+                if (statuses.count(it->first)) { ++it; continue; }
+                ch.changedSlots.insert(it->first); // Sent as "removed"
+                it = ch.slots.erase(it);
+            }
+        }
+        if (ch.violatingCars != violatingCars) {
+            ch.violatingCars = violatingCars;
+            ch.countsChanged = true;
+        }
+        if (!ch.changedSlots.empty()) ch.countsChanged = true;
+        if (ch.countsChanged) StartLocked();
+    }
+
+    void AddViolation(int cameraId, int carId, const std::string& type, const std::string& timeText, long long epochMs, std::string snapshotPath) {
+        std::replace(snapshotPath.begin(), snapshotPath.end(), '\\', '/');
+        std::string json = "{\"id\":" + std::to_string(carId) + ",\"type\":\"" + Escape(type) + "\",\"time\":\"" + Escape(timeText) +
+                           "\",\"epoch_ms\":" + std::to_string(epochMs) + ",\"snapshot\":\"" + Escape(snapshotPath) + "\"}";
+        std::lock_guard<std::mutex> lock(mutex_);
+        Channel& ch = channels_[cameraId];
+        ch.newViolations.push_back(json);
+        ch.recentViolations.push_back(json);
+        while (ch.recentViolations.size() > 5) ch.recentViolations.pop_front();
+        StartLocked();
+    }
+
+    // The first message queued is a snapshot of the camera's current state
+    std::shared_ptr<LiveSubscriber> Subscribe(int cameraId) {
+        auto sub = std::make_shared<LiveSubscriber>(cameraId);
+        std::lock_guard<std::mutex> lock(mutex_);
+        Channel& ch = channels_[cameraId];
+        sub->Push(std::make_shared<const std::string>(Message("snapshot", ch.seq, SnapshotJson(ch))));
+        ch.subscribers.push_back(sub);
+        Subscribers().set((double)++subscriberCount_);
+        return sub;
+    }
+
+    void Unsubscribe(const std::shared_ptr<LiveSubscriber>& sub) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& subs = channels_[sub->cameraId].subscribers;
+        auto it = std::find(subs.begin(), subs.end(), sub);
+        if (it == subs.end()) return;
+        subs.erase(it);
+        Subscribers().set((double)--subscriberCount_);
+    }
+
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            running_ = false;
+            cv_.notify_all();
+            for (auto& entry : channels_) {
+                for (auto& sub : entry.second.subscribers) sub->Close();
+            }
+        }
+        if (flusher_.joinable()) flusher_.join();
+    }
+
+private:
+    struct SlotState {
+        const char* state = "empty";
+        bool moto = false;
+    };
+    struct Channel {
+        std::map<int, SlotState> slots;
+        int violatingCars = 0;
+        long long seq = 0;
+        std::set<int> changedSlots;
+        bool countsChanged = false;
+        std::vector<std::string> newViolations;
+        std::deque<std::string> recentViolations; // For snapshots
+        std::vector<std::shared_ptr<LiveSubscriber>> subscribers;
+    };
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::map<int, Channel> channels_;
+    std::thread flusher_;
+    bool running_ = true;
+    bool started_ = false;
+    int subscriberCount_ = 0;
+
+    static MetricGauge& Subscribers() {
+        static MetricGauge& gauge = g_metrics.Gauge("parking_live_subscribers", "Connected /api/{id}/events streams");
+        return gauge;
+    }
+
+    static const char* StateName(SlotStatus status) {
+        if (status == SlotStatus::EMPTY) return "empty";
+        if (status == SlotStatus::ILLEGAL) return "wrong_type";
+        return "occupied";
+    }
+
+    static std::string Escape(const std::string& s) {
+        std::string out;
+        for (char c : s) {
+            if (c == '"' || c == '\\') out += '\\';
+            if ((unsigned char)c >= 0x20) out += c;
+        }
+        return out;
+    }
+
+    static std::string Message(const char* event, long long seq, const std::string& data) {
+        return "id: " + std::to_string(seq) + "\nevent: " + event + "\ndata: " + data + "\n\n";
+    }
+
+    // The flusher starts with the first change, so processes without cameras spawn no thread
+    void StartLocked() {
+        if (started_ || !running_) return;
+        started_ = true;
+        flusher_ = std::thread(&LiveEventHub::FlushLoop, this);
+    }
+
+    static std::string CountsJson(const Channel& ch) {
+        int empty = 0, occupied = 0, carEmpty = 0, carNormal = 0, motoEmpty = 0, motoNormal = 0;
+        for (const auto& entry : ch.slots) {
+            bool isEmpty = std::string(entry.second.state) == "empty";
+            if (isEmpty) empty++; else occupied++;
+            if (entry.second.moto) (isEmpty ? motoEmpty : motoNormal)++;
+            else (isEmpty ? carEmpty : carNormal)++;
+        }
+        return "{\"empty\":" + std::to_string(empty) + ",\"normal\":" + std::to_string(occupied) +
+               ",\"carEmpty\":" + std::to_string(carEmpty) + ",\"carNormal\":" + std::to_string(carNormal) +
+               ",\"motoEmpty\":" + std::to_string(motoEmpty) + ",\"motoNormal\":" + std::to_string(motoNormal) +
+               ",\"violation\":" + std::to_string(ch.violatingCars) + "}";
+    }
+
+    static std::string SnapshotJson(const Channel& ch) {
+        std::ostringstream out;
+        out << "{\"seq\":" << ch.seq << ",\"slots\":{";
+        bool first = true;
+        for (const auto& entry : ch.slots) {
+            out << (first ? "" : ",") << "\"" << entry.first << "\":\"" << entry.second.state << "\"";
+            first = false;
+        }
+        out << "},\"counts\":" << CountsJson(ch) << ",\"violations\":[";
+        first = true;
+        for (const std::string& v : ch.recentViolations) {
+            out << (first ? "" : ",") << v;
+            first = false;
+        }
+        out << "]}";
+        return out.str();
+    }
+
+    std::string UpdateJson(Channel& ch) {
+        std::ostringstream out;
+        out << "{\"seq\":" << ch.seq << ",\"slots\":{";
+        bool first = true;
+        for (int id : ch.changedSlots) {
+            auto it = ch.slots.find(id);
+            out << (first ? "" : ",") << "\"" << id << "\":\"" << (it != ch.slots.end() ? it->second.state : "removed") << "\"";
+            first = false;
+        }
+        out << "}";
+        if (ch.countsChanged) out << ",\"counts\":" << CountsJson(ch);
+        out << ",\"violations\":[";
+        for (size_t i = 0; i < ch.newViolations.size(); i++) out << (i ? "," : "") << ch.newViolations[i];
+        out << "]}";
+        ch.changedSlots.clear();
+        ch.countsChanged = false;
+        ch.newViolations.clear();
+        return out.str();
+    }
+
+    void FlushLoop() {
+        MetricCounter& messages = g_metrics.Counter("parking_live_messages_total", "SSE messages serialized (each is shared by all subscribers of a camera)");
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (running_) {
+            cv_.wait_for(lock, std::chrono::milliseconds(LIVE_EVENTS_COALESCE_MS));
+            for (auto& entry : channels_) {
+                Channel& ch = entry.second;
+                if (ch.changedSlots.empty() && !ch.countsChanged && ch.newViolations.empty()) continue;
+                ch.seq++;
+                if (ch.subscribers.empty()) { // Nobody listening: state stays current for the next snapshot
+                    ch.changedSlots.clear();
+                    ch.countsChanged = false;
+                    ch.newViolations.clear();
+                    continue;
+                }
+                LiveMessage update = std::make_shared<const std::string>(Message("update", ch.seq, UpdateJson(ch)));
+                messages.inc();
+                LiveMessage snapshot;
+                for (auto& sub : ch.subscribers) {
+                    if (sub->Push(update)) continue;
+                    if (!snapshot) snapshot = std::make_shared<const std::string>(Message("snapshot", ch.seq, SnapshotJson(ch)));
+                    sub->Push(snapshot);
+                }
+            }
+        }
+    }
+};
+
+PLATFORM_SELECTANY LiveEventHub g_liveEvents;
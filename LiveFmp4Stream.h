@@ -0,0 +1,439 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Platform.h"
+#include "MetricsRegistry.h"
+#include "TraceRecorder.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/opt.h>
+#include <libswscale/swscale.h>
+}
+
+// ==========================================
+//  [FMP4] Live H.264 in fragmented MP4 behind /api/{id}/live.mp4
+// ==========================================
+// One encoder per camera, shared by every viewer: the rendered frames MjpegServer receives are
+// encoded once (libx264 ultrafast / zerolatency, no B-frames, so each frame leaves the encoder
+// as soon as it goes in) and muxed to fMP4 in memory, one moof+mdat fragment per frame.
+// A viewer gets the init segment (ftyp+moov), then fragments from the next keyframe on; joining
+// asks the encoder for a keyframe so nobody waits a whole GOP. The output plays in <video> via
+// Media Source Extensions (the X-Codecs response header is the codecs string for addSourceBuffer).
+// The encoder runs only while someone is watching; a viewer more than FMP4_MAX_QUEUE fragments
+// behind loses its backlog and resumes at the next keyframe.
+
+const int FMP4_MAX_QUEUE = 90;        // ~3-6 s of fragments
+const int FMP4_GOP_FRAMES = 60;       // Keyframe at least every 60 frames (plus one per joining viewer)
+const int FMP4_MAX_WIDTH = 1920;      // Larger frames are scaled down before encoding
+const char* const FMP4_CRF = "27";    // Quality target for libx264 (lower = better / bigger)
+
+using Fmp4Chunk = std::shared_ptr<const std::string>;
+
+class Fmp4Viewer {
+public:
+    // Waits up to `timeoutMs` for data; false on timeout or once the stream stopped
+    bool Wait(std::vector<Fmp4Chunk>& out, int timeoutMs) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait_for(lock, std::chrono::milliseconds(timeoutMs), [&]() { return !queue_.empty() || closed_; });
+        if (queue_.empty()) return false;
+        out.assign(queue_.begin(), queue_.end());
+        queue_.clear();
+        return true;
+    }
+
+    bool Closed() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return closed_;
+    }
+
+private:
+    friend class LiveFmp4Stream;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Fmp4Chunk> queue_;
+    bool closed_ = false;
+    // Owned by LiveFmp4Stream (under its mutex)
+    bool sentInit_ = false;
+    bool waitKeyframe_ = true;
+
+    bool Push(const Fmp4Chunk& chunk) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if ((int)queue_.size() >= FMP4_MAX_QUEUE) {
+            queue_.clear();
+            return false;
+        }
+        queue_.push_back(chunk);
+        cv_.notify_one();
+        return true;
+    }
+
+    void Close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        cv_.notify_all();
+    }
+};
+
+class LiveFmp4Stream {
+public:
+    explicit LiveFmp4Stream(int cameraId) : cameraId_(cameraId) {}
+    ~LiveFmp4Stream() { StopEncoder(); }
+
+    // Every rendered frame. Costs one atomic load when nobody is watching; the Mat is only
+    // referenced (callers hand over a frame nobody writes to any more).
+    void Push(const cv::Mat& bgr) {
+        if (viewers_.load() == 0 || bgr.empty() || bgr.type() != CV_8UC3) return;
+        std::lock_guard<std::mutex> lock(frameMutex_);
+        pending_ = bgr;
+        frameCv_.notify_one();
+    }
+
+    // Null once the server is shutting down
+    std::shared_ptr<Fmp4Viewer> Subscribe() {
+        auto viewer = std::make_shared<Fmp4Viewer>();
+        std::thread finished;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stop_) return nullptr;
+            viewerList_.push_back(viewer);
+            viewers_++;
+            forceKeyframe_ = true;
+            if (!encoderRunning_) {
+                finished.swap(encoder_); // Left over from the previous session, already exiting
+                encoderRunning_ = true;
+            }
+        }
+        if (finished.joinable()) finished.join();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!encoder_.joinable()) encoder_ = std::thread(&LiveFmp4Stream::EncoderLoop, this);
+        }
+        return viewer;
+    }
+
+    void Unsubscribe(const std::shared_ptr<Fmp4Viewer>& viewer) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = std::find(viewerList_.begin(), viewerList_.end(), viewer);
+        if (it == viewerList_.end()) return;
+        viewerList_.erase(it);
+        viewers_--;
+        frameCv_.notify_one(); // The encoder exits once the last viewer is gone
+    }
+
+    // avc1.PPCCLL for MediaSource.addSourceBuffer, "" before the encoder produced its first frame
+    std::string Codecs() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return codecs_;
+    }
+
+    void StopEncoder() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+            for (auto& viewer : viewerList_) viewer->Close();
+        }
+        frameCv_.notify_all();
+        if (encoder_.joinable()) encoder_.join();
+    }
+
+private:
+    int cameraId_;
+    std::atomic<int> viewers_{0};
+
+    std::mutex frameMutex_; // pending_
+    std::condition_variable frameCv_;
+    cv::Mat pending_;
+
+    std::mutex mutex_; // Everything below
+    std::vector<std::shared_ptr<Fmp4Viewer>> viewerList_;
+    std::thread encoder_;
+    bool encoderRunning_ = false;
+    std::atomic<bool> stop_{false};
+    bool forceKeyframe_ = false;
+    Fmp4Chunk init_;
+    std::string codecs_;
+
+    // Encoder-thread state
+    AVCodecContext* enc_ = nullptr;
+    AVFormatContext* mux_ = nullptr;
+    SwsContext* sws_ = nullptr;
+    AVFrame* frame_ = nullptr;
+    AVPacket* packet_ = nullptr;
+    cv::Size inputSize_;
+    long long startMs_ = 0;
+    long long lastPts_ = -1;
+    std::string output_; // Bytes the muxer wrote since the last fragment was taken
+
+    static long long NowMs() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void EncoderLoop() {
+        g_traceRecorder.SetThreadName("camera " + std::to_string(cameraId_) + " fmp4");
+        MetricHistogram& encodeSeconds = g_metrics.Histogram("parking_fmp4_encode_seconds", "H.264 encode + mux time per frame (shared by all viewers)", CameraLabel(cameraId_));
+        MetricCounter& bytes = g_metrics.Counter("parking_fmp4_bytes_total", "fMP4 bytes produced by the live encoder", CameraLabel(cameraId_));
+        while (true) {
+            cv::Mat frame;
+            {
+                std::unique_lock<std::mutex> lock(frameMutex_);
+                frameCv_.wait_for(lock, std::chrono::milliseconds(500), [&]() { return !pending_.empty() || viewers_.load() == 0 || stop_; });
+                frame = pending_;
+                pending_ = cv::Mat();
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (viewerList_.empty() || stop_) {
+                    encoderRunning_ = false;
+                    break;
+                }
+            }
+            if (frame.empty()) continue;
+
+            long long encodeStart = cv::getTickCount();
+            size_t produced = 0;
+            {
+                TraceSpan span("fmp4.encode", "streaming", cameraId_);
+                if (frame.size() != inputSize_ && !OpenEncoder(frame.size())) {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    for (auto& viewer : viewerList_) viewer->Close(); // No usable H.264 encoder
+                    encoderRunning_ = false;
+                    break;
+                }
+                produced = EncodeFrame(frame);
+            }
+            encodeSeconds.observe((cv::getTickCount() - encodeStart) / cv::getTickFrequency());
+            bytes.inc((long long)produced);
+        }
+        CloseEncoder();
+    }
+
+    bool OpenEncoder(cv::Size size) {
+        CloseEncoder();
+        const AVCodec* codec = avcodec_find_encoder_by_name("libx264");
+        if (!codec) codec = avcodec_find_encoder(AV_CODEC_ID_H264);
+        if (!codec) {
+            OutputDebugStringA("[FMP4] No H.264 encoder in this libavcodec build\n");
+            return false;
+        }
+        int width = size.width, height = size.height;
+        if (width > FMP4_MAX_WIDTH) {
+            height = height * FMP4_MAX_WIDTH / width;
+            width = FMP4_MAX_WIDTH;
+        }
+        width &= ~1; // 4:2:0 needs even dimensions
+        height &= ~1;
+
+        enc_ = avcodec_alloc_context3(codec);
+        enc_->width = width;
+        enc_->height = height;
+        enc_->pix_fmt = AV_PIX_FMT_YUV420P;
+        enc_->time_base = AVRational{ 1, 1000 }; // Frames arrive at the processing rate, stamped in ms
+        enc_->framerate = AVRational{ 15, 1 };   // Rate-control hint only
+        enc_->gop_size = FMP4_GOP_FRAMES;
+        enc_->max_b_frames = 0;
+        enc_->flags |= AV_CODEC_FLAG_GLOBAL_HEADER; // SPS/PPS go into the moov's avcC
+        av_opt_set(enc_->priv_data, "preset", "ultrafast", 0);
+        av_opt_set(enc_->priv_data, "tune", "zerolatency", 0);
+        av_opt_set(enc_->priv_data, "profile", "baseline", 0);
+        av_opt_set(enc_->priv_data, "crf", FMP4_CRF, 0);
+        av_opt_set(enc_->priv_data, "forced-idr", "1", 0); // Keyframes requested for joining viewers must be IDRs
+        int ret = avcodec_open2(enc_, codec, nullptr);
+        if (ret < 0) {
+            LogError("avcodec_open2", ret);
+            CloseEncoder();
+            return false;
+        }
+
+        frame_ = av_frame_alloc();
+        frame_->format = AV_PIX_FMT_YUV420P;
+        frame_->width = width;
+        frame_->height = height;
+        packet_ = av_packet_alloc();
+        if (av_frame_get_buffer(frame_, 0) < 0 || !packet_) {
+            CloseEncoder();
+            return false;
+        }
+        sws_ = sws_getContext(size.width, size.height, AV_PIX_FMT_BGR24, width, height, AV_PIX_FMT_YUV420P, SWS_FAST_BILINEAR, nullptr, nullptr, nullptr);
+
+        // fMP4 into output_: frag_custom + a null packet after each frame emits its fragment right away
+        if (avformat_alloc_output_context2(&mux_, nullptr, "mp4", nullptr) < 0 || !mux_ || !sws_) {
+            CloseEncoder();
+            return false;
+        }
+        AVStream* stream = avformat_new_stream(mux_, nullptr);
+        avcodec_parameters_from_context(stream->codecpar, enc_);
+        stream->time_base = enc_->time_base;
+        const int ioSize = 64 * 1024;
+        mux_->pb = avio_alloc_context((unsigned char*)av_malloc(ioSize), ioSize, 1, this, nullptr, &LiveFmp4Stream::WriteCallback, nullptr);
+        AVDictionary* opts = nullptr;
+        av_dict_set(&opts, "movflags", "frag_custom+empty_moov+default_base_moof", 0);
+        ret = avformat_write_header(mux_, &opts);
+        av_dict_free(&opts);
+        if (ret < 0) {
+            LogError("avformat_write_header", ret);
+            CloseEncoder();
+            return false;
+        }
+        avio_flush(mux_->pb);
+
+        inputSize_ = size;
+        startMs_ = NowMs();
+        lastPts_ = -1;
+        std::lock_guard<std::mutex> lock(mutex_);
+        init_ = std::make_shared<const std::string>(std::move(output_));
+        output_.clear();
+        codecs_ = CodecsString(enc_->extradata, enc_->extradata_size);
+        for (auto& viewer : viewerList_) { // New parameters: everyone starts over with the new init segment
+            viewer->sentInit_ = false;
+            viewer->waitKeyframe_ = true;
+        }
+        OutputDebugStringA(("[FMP4] Camera " + std::to_string(cameraId_) + ": encoding " + std::to_string(width) + "x" +
+                            std::to_string(height) + " with " + codec->name + "\n").c_str());
+        return true;
+    }
+
+    // Encodes, muxes and fans out one frame; returns the bytes produced
+    size_t EncodeFrame(const cv::Mat& bgr) {
+        if (av_frame_make_writable(frame_) < 0) return 0;
+        const uint8_t* src[1] = { bgr.data };
+        int srcStride[1] = { (int)bgr.step };
+        sws_scale(sws_, src, srcStride, 0, bgr.rows, frame_->data, frame_->linesize);
+
+        long long pts = NowMs() - startMs_;
+        if (pts <= lastPts_) pts = lastPts_ + 1;
+        lastPts_ = pts;
+        frame_->pts = pts;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            frame_->pict_type = forceKeyframe_ ? AV_PICTURE_TYPE_I : AV_PICTURE_TYPE_NONE;
+            forceKeyframe_ = false;
+        }
+
+        size_t produced = 0;
+        if (avcodec_send_frame(enc_, frame_) < 0) return 0;
+        while (avcodec_receive_packet(enc_, packet_) == 0) {
+            bool keyframe = (packet_->flags & AV_PKT_FLAG_KEY) != 0;
+            av_packet_rescale_ts(packet_, enc_->time_base, mux_->streams[0]->time_base);
+            packet_->stream_index = 0;
+            int ret = av_write_frame(mux_, packet_);
+            av_packet_unref(packet_);
+            if (ret < 0) { LogError("av_write_frame", ret); continue; }
+            av_write_frame(mux_, nullptr); // Close the fragment now instead of at the next frame
+            avio_flush(mux_->pb);
+            if (output_.empty()) continue;
+            produced += output_.size();
+            Fmp4Chunk fragment = std::make_shared<const std::string>(std::move(output_));
+            output_.clear();
+            Publish(fragment, keyframe);
+        }
+        return produced;
+    }
+
+    void Publish(const Fmp4Chunk& fragment, bool keyframe) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& viewer : viewerList_) {
+            if (viewer->waitKeyframe_) {
+                if (!keyframe) continue;
+                viewer->waitKeyframe_ = false;
+            }
+            if (!viewer->sentInit_) {
+                viewer->Push(init_);
+                viewer->sentInit_ = true;
+            }
+            if (!viewer->Push(fragment)) { // Too far behind: drop its backlog, resume at a keyframe
+                viewer->sentInit_ = false;
+                viewer->waitKeyframe_ = true;
+                forceKeyframe_ = true;
+            }
+        }
+    }
+
+    void CloseEncoder() {
+        if (mux_) {
+            if (mux_->pb) {
+                av_freep(&mux_->pb->buffer);
+                avio_context_free(&mux_->pb);
+            }
+            avformat_free_context(mux_);
+            mux_ = nullptr;
+        }
+        if (enc_) avcodec_free_context(&enc_);
+        if (frame_) av_frame_free(&frame_);
+        if (packet_) av_packet_free(&packet_);
+        if (sws_) { sws_freeContext(sws_); sws_ = nullptr; }
+        inputSize_ = cv::Size();
+        output_.clear();
+    }
+
+#if LIBAVFORMAT_VERSION_MAJOR >= 61
+    static int WriteCallback(void* opaque, const uint8_t* data, int size) {
+#else
+    static int WriteCallback(void* opaque, uint8_t* data, int size) {
+#endif
+        ((LiveFmp4Stream*)opaque)->output_.append((const char*)data, size);
+        return size;
+    }
+
+    // Profile / constraints / level from the SPS, in avcC (libx264 with a global header) or Annex B form
+    static std::string CodecsString(const uint8_t* extradata, int size) {
+        const uint8_t* sps = nullptr;
+        if (size >= 4 && extradata[0] == 1) {
+            sps = extradata + 1;
+        } else {
+            for (int i = 0; i + 4 < size; i++) {
+                if (extradata[i] == 0 && extradata[i + 1] == 0 && extradata[i + 2] == 1 && (extradata[i + 3] & 0x1F) == 7 && i + 6 < size) {
+                    sps = extradata + i + 4;
+                    break;
+                }
+            }
+        }
+        if (!sps) return "avc1.42E01F"; // Constrained Baseline 3.1
+        char codecs[16];
+        sprintf_s(codecs, sizeof(codecs), "avc1.%02X%02X%02X", sps[0], sps[1], sps[2]);
+        return codecs;
+    }
+
+    static void LogError(const char* what, int err) {
+        char errBuf[AV_ERROR_MAX_STRING_SIZE] = { 0 };
+        av_strerror(err, errBuf, sizeof(errBuf));
+        OutputDebugStringA(("[FMP4] " + std::string(what) + " failed: " + errBuf + "\n").c_str());
+    }
+};
+
+// Process-wide per-camera streams, created by the first viewer
+class LiveFmp4Store {
+public:
+    void Push(int cameraId, const cv::Mat& bgr) {
+        LiveFmp4Stream* stream = Get(cameraId, false);
+        if (stream) stream->Push(bgr);
+    }
+
+    LiveFmp4Stream* Get(int cameraId, bool create) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = streams_.find(cameraId);
+        if (it != streams_.end()) return it->second.get();
+        if (!create) return nullptr;
+        LiveFmp4Stream* stream = new LiveFmp4Stream(cameraId);
+        streams_[cameraId].reset(stream);
+        return stream;
+    }
+
+private:
+    std::mutex mutex_;
+    std::map<int, std::unique_ptr<LiveFmp4Stream>> streams_;
+};
+
+PLATFORM_SELECTANY LiveFmp4Store g_liveFmp4;
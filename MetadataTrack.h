@@ -0,0 +1,321 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "Platform.h"
+
+// ==========================================
+//  [METADATA] Per-frame metadata track recorded alongside each DVR clip
+// ==========================================
+// Every processed frame appends what the AI saw (tracked boxes, IDs, classes, violation flags and
+// slot statuses) to <clip>.meta next to the .webm/.mp4 clip, stamped with milliseconds since the
+// clip started so it lines up with the video. Overlays can then be drawn client-side over the
+// passthrough video and analytics can run without decoding anything.
+//
+// <clip>.meta (little-endian, append-only):
+//   header  magic, version, camera id, frame width/height (boxes are in these coordinates),
+//           clip start as epoch ms
+//   records uint32 size (bytes that follow), int64 t_ms, int64 seq, uint16 boxes, uint16 slots,
+//           boxes: int32 track id, int16 x/y/w/h, uint8 class, uint8 flags
+//           slots: uint16 slot id, uint8 status (SlotStatus), uint8 occupancy %
+// <clip>.midx holds (int64 t_ms, int64 offset) about once per second, so a time range query
+// reads only the records it returns. A record cut short by a crash is ignored by the reader.
+
+const uint32_t METADATA_MAGIC = 0x4154454D;       // "META"
+const uint32_t METADATA_INDEX_MAGIC = 0x5844494D; // "MIDX"
+const uint32_t METADATA_VERSION = 1;
+const long long METADATA_INDEX_INTERVAL_MS = 1000;
+const uint8_t METADATA_FLAG_VIOLATING = 1;
+const uint32_t METADATA_MAX_RECORD_BYTES = 20 + 0xFFFF * 14 + 0xFFFF * 4; // Largest record Encode can produce
+
+struct MetadataBox {
+    int trackId = 0;
+    int classId = 0;
+    int x = 0, y = 0, w = 0, h = 0;
+    bool violating = false;
+};
+
+struct MetadataSlot {
+    int slotId = 0;
+    int status = 0;    // SlotStatus as int
+    int occupancy = 0; // 0-100
+};
+
+struct MetadataFrame {
+    long long tMs = 0; // Since the clip started
+    long long seq = 0; // Capture frame sequence
+    std::vector<MetadataBox> boxes;
+    std::vector<MetadataSlot> slots;
+};
+
+struct MetadataTrackHeader {
+    int cameraId = 0;
+    int frameWidth = 0;
+    int frameHeight = 0;
+    long long clipStartEpochMs = 0;
+};
+
+// C:\locvideo\20250101\camera_1\120000.mp4 -> ...\120000.meta (works for relative paths too)
+inline std::string MetadataPathForClip(const std::string& clipPath, const char* extension = ".meta") {
+    size_t slash = clipPath.find_last_of("/\\");
+    size_t dot = clipPath.find_last_of('.');
+    std::string base = (dot != std::string::npos && (slash == std::string::npos || dot > slash)) ? clipPath.substr(0, dot) : clipPath;
+    return base + extension;
+}
+
+inline void MetadataSeek(FILE* f, long long offset) {
+#ifdef _WIN32
+    _fseeki64(f, offset, SEEK_SET);
+#else
+    fseeko(f, (off_t)offset, SEEK_SET);
+#endif
+}
+
+inline long long MetadataTell(FILE* f) {
+#ifdef _WIN32
+    return _ftelli64(f);
+#else
+    return (long long)ftello(f);
+#endif
+}
+
+// Length of the file, leaving the read position where it was
+inline long long MetadataFileSize(FILE* f) {
+    long long position = MetadataTell(f);
+#ifdef _WIN32
+    _fseeki64(f, 0, SEEK_END);
+#else
+    fseeko(f, 0, SEEK_END);
+#endif
+    long long size = MetadataTell(f);
+    MetadataSeek(f, position);
+    return size;
+}
+
+class MetadataTrackWriter {
+public:
+    ~MetadataTrackWriter() { Close(); }
+
+    bool Open(const std::string& metaPath, const MetadataTrackHeader& header) {
+        Close();
+        if (fopen_s(&file_, metaPath.c_str(), "wb") != 0 || !file_) { file_ = nullptr; return false; }
+        std::string indexPath = MetadataPathForClip(metaPath, ".midx");
+        if (fopen_s(&index_, indexPath.c_str(), "wb") != 0 || !index_) index_ = nullptr;
+
+        bool ok = fwrite(&METADATA_MAGIC, sizeof(uint32_t), 1, file_) == 1
+            && fwrite(&METADATA_VERSION, sizeof(uint32_t), 1, file_) == 1
+            && fwrite(&header.cameraId, sizeof(int), 1, file_) == 1
+            && fwrite(&header.frameWidth, sizeof(int), 1, file_) == 1
+            && fwrite(&header.frameHeight, sizeof(int), 1, file_) == 1
+            && fwrite(&header.clipStartEpochMs, sizeof(long long), 1, file_) == 1;
+        if (index_) {
+            fwrite(&METADATA_INDEX_MAGIC, sizeof(uint32_t), 1, index_);
+            fwrite(&METADATA_VERSION, sizeof(uint32_t), 1, index_);
+        }
+        if (!ok) { Close(); return false; }
+        offset_ = 4 + 4 + 4 + 4 + 4 + 8;
+        lastIndexedMs_ = -1;
+        path_ = metaPath;
+        return true;
+    }
+
+    // Called once per processed frame; the data reaches the disk at every index point
+    void Append(const MetadataFrame& frame) {
+        if (!file_) return;
+        buffer_.clear();
+        Encode(frame, buffer_);
+
+        bool indexPoint = lastIndexedMs_ < 0 || frame.tMs - lastIndexedMs_ >= METADATA_INDEX_INTERVAL_MS;
+        if (fwrite(buffer_.data(), 1, buffer_.size(), file_) != buffer_.size()) return;
+        if (indexPoint) {
+            if (index_) {
+                fwrite(&frame.tMs, sizeof(long long), 1, index_);
+                fwrite(&offset_, sizeof(long long), 1, index_);
+                fflush(index_);
+            }
+            fflush(file_); // Readers of a clip still being recorded see up to here
+            lastIndexedMs_ = frame.tMs;
+        }
+        offset_ += (long long)buffer_.size();
+    }
+
+    void Close() {
+        if (file_) { fclose(file_); file_ = nullptr; }
+        if (index_) { fclose(index_); index_ = nullptr; }
+        path_.clear();
+    }
+
+    bool IsOpen() const { return file_ != nullptr; }
+    const std::string& Path() const { return path_; }
+
+    // Appends one size-prefixed record to `out` (also the payload of the live WebSocket metadata messages)
+    static void Encode(const MetadataFrame& frame, std::vector<unsigned char>& out) {
+        size_t start = out.size();
+        Put<uint32_t>(out, 0); // Patched below
+        Put<long long>(out, frame.tMs);
+        Put<long long>(out, frame.seq);
+        Put<uint16_t>(out, (uint16_t)std::min<size_t>(frame.boxes.size(), 0xFFFF));
+        Put<uint16_t>(out, (uint16_t)std::min<size_t>(frame.slots.size(), 0xFFFF));
+        for (size_t i = 0; i < frame.boxes.size() && i < 0xFFFF; i++) {
+            const MetadataBox& b = frame.boxes[i];
+            Put<int32_t>(out, b.trackId);
+            Put<int16_t>(out, Clamp16(b.x));
+            Put<int16_t>(out, Clamp16(b.y));
+            Put<int16_t>(out, Clamp16(b.w));
+            Put<int16_t>(out, Clamp16(b.h));
+            Put<uint8_t>(out, (uint8_t)b.classId);
+            Put<uint8_t>(out, b.violating ? METADATA_FLAG_VIOLATING : 0);
+        }
+        for (size_t i = 0; i < frame.slots.size() && i < 0xFFFF; i++) {
+            const MetadataSlot& s = frame.slots[i];
+            Put<uint16_t>(out, (uint16_t)s.slotId);
+            Put<uint8_t>(out, (uint8_t)s.status);
+            Put<uint8_t>(out, (uint8_t)std::max(0, std::min(100, s.occupancy)));
+        }
+        uint32_t size = (uint32_t)(out.size() - start - sizeof(uint32_t));
+        memcpy(out.data() + start, &size, sizeof(size));
+    }
+
+private:
+    FILE* file_ = nullptr;
+    FILE* index_ = nullptr;
+    std::string path_;
+    long long offset_ = 0;
+    long long lastIndexedMs_ = -1;
+    std::vector<unsigned char> buffer_;
+
+    template <typename T> static void Put(std::vector<unsigned char>& out, T value) {
+        size_t at = out.size();
+        out.resize(at + sizeof(T));
+        memcpy(out.data() + at, &value, sizeof(T));
+    }
+    static int16_t Clamp16(int v) { return (int16_t)std::max(-32768, std::min(32767, v)); }
+};
+
+class MetadataTrackReader {
+public:
+    // Frames with fromMs <= t_ms <= toMs (clip-relative). False if the file is missing or not a track.
+    static bool Query(const std::string& metaPath, long long fromMs, long long toMs,
+                      MetadataTrackHeader& header, std::vector<MetadataFrame>& out) {
+        FILE* f = nullptr;
+        if (fopen_s(&f, metaPath.c_str(), "rb") != 0 || !f) return false;
+        uint32_t magic = 0, version = 0;
+        bool ok = fread(&magic, sizeof(uint32_t), 1, f) == 1 && magic == METADATA_MAGIC
+            && fread(&version, sizeof(uint32_t), 1, f) == 1 && version == METADATA_VERSION
+            && fread(&header.cameraId, sizeof(int), 1, f) == 1
+            && fread(&header.frameWidth, sizeof(int), 1, f) == 1
+            && fread(&header.frameHeight, sizeof(int), 1, f) == 1
+            && fread(&header.clipStartEpochMs, sizeof(long long), 1, f) == 1;
+        if (!ok) { fclose(f); return false; }
+
+        long long fileSize = MetadataFileSize(f);
+        long long start = StartOffset(metaPath, fromMs);
+        if (start > 0) MetadataSeek(f, start);
+        long long position = MetadataTell(f);
+
+        std::vector<unsigned char> record;
+        while (true) {
+            uint32_t size = 0;
+            if (fread(&size, sizeof(uint32_t), 1, f) != 1 || size < 20) break;
+            position += sizeof(uint32_t);
+            // A corrupt size must not drive the allocation; anything past the end is still being written
+            if (size > METADATA_MAX_RECORD_BYTES || (long long)size > fileSize - position) break;
+            record.resize(size);
+            if (fread(record.data(), 1, size, f) != size) break; // Still being written, or truncated
+            position += size;
+
+            size_t at = 0;
+            MetadataFrame frame;
+            frame.tMs = Get<long long>(record, at);
+            if (frame.tMs > toMs) break;
+            frame.seq = Get<long long>(record, at);
+            uint16_t boxCount = Get<uint16_t>(record, at);
+            uint16_t slotCount = Get<uint16_t>(record, at);
+            if (at + (size_t)boxCount * 14 + (size_t)slotCount * 4 > record.size()) break;
+            if (frame.tMs < fromMs) continue;
+
+            frame.boxes.resize(boxCount);
+            for (MetadataBox& b : frame.boxes) {
+                b.trackId = Get<int32_t>(record, at);
+                b.x = Get<int16_t>(record, at);
+                b.y = Get<int16_t>(record, at);
+                b.w = Get<int16_t>(record, at);
+                b.h = Get<int16_t>(record, at);
+                b.classId = Get<uint8_t>(record, at);
+                b.violating = (Get<uint8_t>(record, at) & METADATA_FLAG_VIOLATING) != 0;
+            }
+            frame.slots.resize(slotCount);
+            for (MetadataSlot& s : frame.slots) {
+                s.slotId = Get<uint16_t>(record, at);
+                s.status = Get<uint8_t>(record, at);
+                s.occupancy = Get<uint8_t>(record, at);
+            }
+            out.push_back(std::move(frame));
+        }
+        fclose(f);
+        return true;
+    }
+
+    // {"camera_id":1,"width":640,"height":360,"clip_start_epoch_ms":...,"frames":[{"t":1.2,"seq":5,
+    //   "boxes":[[id,class,x,y,w,h,violating],...],"slots":[[id,status,occupancy],...]},...]}
+    static std::string ToJson(const MetadataTrackHeader& header, const std::vector<MetadataFrame>& frames) {
+        std::string json = "{\"camera_id\":" + std::to_string(header.cameraId)
+            + ",\"width\":" + std::to_string(header.frameWidth)
+            + ",\"height\":" + std::to_string(header.frameHeight)
+            + ",\"clip_start_epoch_ms\":" + std::to_string(header.clipStartEpochMs)
+            + ",\"frames\":[";
+        char num[32];
+        for (size_t i = 0; i < frames.size(); i++) {
+            const MetadataFrame& fr = frames[i];
+            if (i) json += ",";
+            sprintf_s(num, sizeof(num), "%.3f", fr.tMs / 1000.0);
+            json += "{\"t\":" + std::string(num) + ",\"seq\":" + std::to_string(fr.seq) + ",\"boxes\":[";
+            for (size_t b = 0; b < fr.boxes.size(); b++) {
+                const MetadataBox& box = fr.boxes[b];
+                if (b) json += ",";
+                json += "[" + std::to_string(box.trackId) + "," + std::to_string(box.classId) + ","
+                    + std::to_string(box.x) + "," + std::to_string(box.y) + ","
+                    + std::to_string(box.w) + "," + std::to_string(box.h) + ","
+                    + (box.violating ? "1" : "0") + "]";
+            }
+            json += "],\"slots\":[";
+            for (size_t s = 0; s < fr.slots.size(); s++) {
+                const MetadataSlot& slot = fr.slots[s];
+                if (s) json += ",";
+                json += "[" + std::to_string(slot.slotId) + "," + std::to_string(slot.status) + "," + std::to_string(slot.occupancy) + "]";
+            }
+            json += "]}";
+        }
+        json += "]}";
+        return json;
+    }
+
+private:
+    // Offset of the last index point at or before fromMs; 0 (scan from the header) without an index
+    static long long StartOffset(const std::string& metaPath, long long fromMs) {
+        FILE* f = nullptr;
+        if (fopen_s(&f, MetadataPathForClip(metaPath, ".midx").c_str(), "rb") != 0 || !f) return 0;
+        uint32_t magic = 0, version = 0;
+        long long best = 0;
+        if (fread(&magic, sizeof(uint32_t), 1, f) == 1 && magic == METADATA_INDEX_MAGIC
+            && fread(&version, sizeof(uint32_t), 1, f) == 1 && version == METADATA_VERSION) {
+            long long entry[2];
+            while (fread(entry, sizeof(long long), 2, f) == 2) {
+                if (entry[0] > fromMs) break;
+                best = entry[1];
+            }
+        }
+        fclose(f);
+        return best;
+    }
+
+    template <typename T> static T Get(const std::vector<unsigned char>& buf, size_t& at) {
+        T value;
+        memcpy(&value, buf.data() + at, sizeof(T));
+        at += sizeof(T);
+        return value;
+    }
+};
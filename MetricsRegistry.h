@@ -0,0 +1,232 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include "Platform.h"
+
+// ==========================================
+//  [METRICS] Lightweight Prometheus-style metrics
+// ==========================================
+// Counters and histograms are sharded per thread: each thread maps to a fixed shard and only
+// touches that cache line, so hot-path updates from different threads rarely contend. Reads (scrapes)
+// sum the shards. Series are created once and never freed; callers cache the returned reference.
+
+const int METRIC_SHARDS = 16;
+
+// Hash of the thread id rather than thread_local: this header is also pulled into /clr code
+inline int MetricShardIndex() {
+    return (int)(std::hash<std::thread::id>()(std::this_thread::get_id()) % METRIC_SHARDS);
+}
+
+struct alignas(64) PaddedMetricCell {
+    std::atomic<long long> value{ 0 };
+};
+
+class MetricCounter {
+public:
+    void inc(long long n = 1) {
+        cells_[MetricShardIndex()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+    long long value() const {
+        long long total = 0;
+        for (const auto& c : cells_) total += c.value.load(std::memory_order_relaxed);
+        return total;
+    }
+private:
+    PaddedMetricCell cells_[METRIC_SHARDS];
+};
+
+class MetricGauge {
+public:
+    void set(double v) { value_.store(v, std::memory_order_relaxed); }
+    double value() const { return value_.load(std::memory_order_relaxed); }
+private:
+    std::atomic<double> value_{ 0.0 };
+};
+
+// Fixed upper bounds (seconds unless the name says otherwise), Prometheus cumulative buckets on output
+class MetricHistogram {
+public:
+    explicit MetricHistogram(const std::vector<double>& bounds) : bounds_(bounds) {
+        shards_.reset(new Shard[METRIC_SHARDS]);
+        for (int i = 0; i < METRIC_SHARDS; i++) {
+            shards_[i].buckets.reset(new std::atomic<long long>[bounds_.size() + 1]);
+            for (size_t b = 0; b <= bounds_.size(); b++) shards_[i].buckets[b].store(0);
+        }
+    }
+
+    void observe(double v) {
+        size_t b = 0;
+        while (b < bounds_.size() && v > bounds_[b]) b++;
+        Shard& shard = shards_[MetricShardIndex()];
+        shard.buckets[b].fetch_add(1, std::memory_order_relaxed);
+        shard.count.fetch_add(1, std::memory_order_relaxed);
+        shard.sumNano.fetch_add((long long)(v * 1e9), std::memory_order_relaxed);
+    }
+
+    const std::vector<double>& bounds() const { return bounds_; }
+
+    // Non-cumulative per-bucket counts (last entry is +Inf)
+    std::vector<long long> bucketCounts() const {
+        std::vector<long long> out(bounds_.size() + 1, 0);
+        for (int i = 0; i < METRIC_SHARDS; i++) {
+            for (size_t b = 0; b <= bounds_.size(); b++) out[b] += shards_[i].buckets[b].load(std::memory_order_relaxed);
+        }
+        return out;
+    }
+
+    long long count() const {
+        long long total = 0;
+        for (int i = 0; i < METRIC_SHARDS; i++) total += shards_[i].count.load(std::memory_order_relaxed);
+        return total;
+    }
+
+    double sum() const {
+        long long total = 0;
+        for (int i = 0; i < METRIC_SHARDS; i++) total += shards_[i].sumNano.load(std::memory_order_relaxed);
+        return total / 1e9;
+    }
+
+private:
+    struct alignas(64) Shard {
+        std::unique_ptr<std::atomic<long long>[]> buckets;
+        std::atomic<long long> count{ 0 };
+        std::atomic<long long> sumNano{ 0 };
+    };
+    std::vector<double> bounds_;
+    std::unique_ptr<Shard[]> shards_;
+};
+
+// Default latency buckets: 1 ms .. 10 s
+inline const std::vector<double>& LatencyBucketsSeconds() {
+    static const std::vector<double> buckets = { 0.001, 0.0025, 0.005, 0.01, 0.02, 0.035, 0.05, 0.075, 0.1, 0.15, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0 };
+    return buckets;
+}
+
+class MetricsRegistry {
+public:
+    // labels are pre-formatted, e.g. camera="1"  (empty for none)
+    MetricCounter& Counter(const std::string& name, const std::string& help, const std::string& labels = "") {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Family& f = GetFamily(name, help, "counter");
+        auto& series = f.counters[labels];
+        if (!series) series.reset(new MetricCounter());
+        return *series;
+    }
+
+    MetricGauge& Gauge(const std::string& name, const std::string& help, const std::string& labels = "") {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Family& f = GetFamily(name, help, "gauge");
+        auto& series = f.gauges[labels];
+        if (!series) series.reset(new MetricGauge());
+        return *series;
+    }
+
+    MetricHistogram& Histogram(const std::string& name, const std::string& help, const std::string& labels = "",
+                               const std::vector<double>& bounds = LatencyBucketsSeconds()) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Family& f = GetFamily(name, help, "histogram");
+        auto& series = f.histograms[labels];
+        if (!series) series.reset(new MetricHistogram(bounds));
+        return *series;
+    }
+
+    // Runs right before every scrape; use it for values that are cheaper to sample than to push
+    void AddCollector(std::function<void()> collector) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        collectors_.push_back(collector);
+    }
+
+    // Prometheus text exposition format 0.0.4
+    std::string Render() {
+        std::vector<std::function<void()>> collectors;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            collectors = collectors_;
+        }
+        for (auto& c : collectors) {
+            try { c(); } catch (...) {}
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::string out;
+        out.reserve(8192);
+        char buf[256];
+        for (auto& entry : families_) {
+            const std::string& name = entry.first;
+            const Family& f = entry.second;
+            out += "# HELP " + name + " " + f.help + "\n";
+            out += "# TYPE " + name + " " + f.type + "\n";
+
+            for (auto& s : f.counters) {
+                snprintf(buf, sizeof(buf), " %lld\n", s.second->value());
+                out += name + Braces(s.first) + buf;
+            }
+            for (auto& s : f.gauges) {
+                snprintf(buf, sizeof(buf), " %.6g\n", s.second->value());
+                out += name + Braces(s.first) + buf;
+            }
+            for (auto& s : f.histograms) {
+                const MetricHistogram& h = *s.second;
+                std::vector<long long> counts = h.bucketCounts();
+                std::string sep = s.first.empty() ? "" : ",";
+                long long cumulative = 0;
+                for (size_t b = 0; b < counts.size(); b++) {
+                    cumulative += counts[b];
+                    std::string le;
+                    if (b < h.bounds().size()) {
+                        snprintf(buf, sizeof(buf), "%g", h.bounds()[b]);
+                        le = buf;
+                    } else {
+                        le = "+Inf";
+                    }
+                    snprintf(buf, sizeof(buf), " %lld\n", cumulative);
+                    out += name + "_bucket{" + s.first + sep + "le=\"" + le + "\"}" + buf;
+                }
+                snprintf(buf, sizeof(buf), " %.6f\n", h.sum());
+                out += name + "_sum" + Braces(s.first) + buf;
+                snprintf(buf, sizeof(buf), " %lld\n", cumulative);
+                out += name + "_count" + Braces(s.first) + buf;
+            }
+        }
+        return out;
+    }
+
+private:
+    struct Family {
+        std::string help;
+        std::string type;
+        std::map<std::string, std::unique_ptr<MetricCounter>> counters;
+        std::map<std::string, std::unique_ptr<MetricGauge>> gauges;
+        std::map<std::string, std::unique_ptr<MetricHistogram>> histograms;
+    };
+
+    std::mutex mutex_;
+    std::map<std::string, Family> families_;
+    std::vector<std::function<void()>> collectors_;
+
+    Family& GetFamily(const std::string& name, const std::string& help, const char* type) {
+        Family& f = families_[name];
+        if (f.type.empty()) {
+            f.help = help;
+            f.type = type;
+        }
+        return f;
+    }
+
+    static std::string Braces(const std::string& labels) {
+        return labels.empty() ? std::string() : "{" + labels + "}";
+    }
+};
+
+inline std::string CameraLabel(int cameraId) {
+    return "camera=\"" + std::to_string(cameraId) + "\"";
+}
+
+PLATFORM_SELECTANY MetricsRegistry g_metrics;
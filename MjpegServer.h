@@ -1,4 +1,5 @@
 #pragma once
+#ifdef _WIN32
 #define NOMINMAX
 #ifndef WIN32_LEAN_AND_MEAN
 #define WIN32_LEAN_AND_MEAN
@@ -6,6 +7,8 @@
 #include <winsock2.h>
 #include <ws2tcpip.h>
 #include <windows.h>
+#endif
+#include "Platform.h"
 #include <opencv2/opencv.hpp>
 #include <thread>
 #include <mutex>
@@ -15,9 +18,26 @@
 #include <iostream>
 #include <functional>
 #include <fstream>
-#include <mutex>
 #include <algorithm>
 #include <cctype>
+#include <condition_variable>
+#include <map>
+#include <sstream>
+#include <climits>
+#include <cerrno>
+#include <cmath>
+#include "LatencyTrace.h"
+#include "MetricsRegistry.h"
+#include "TraceRecorder.h"
+#include "MetadataTrack.h"
+#include "EventLog.h"
+#include "EventResponseCache.h"
+#include "OccupancyStore.h"
+#include "ParkingSessions.h"
+#include "LiveEvents.h"
+#include "WebSocketChannel.h"
+#include "LiveFmp4Stream.h"
+#include "FileServing.h"
 static std::mutex g_logMutex;
 inline void DumpLog(const std::string& msg) {
     std::lock_guard<std::mutex> lock(g_logMutex);
@@ -25,10 +45,12 @@ inline void DumpLog(const std::string& msg) {
 }
 
 class MjpegServer;
-__declspec(selectany) MjpegServer* g_globalWebServer = nullptr;
+PLATFORM_SELECTANY MjpegServer* g_globalWebServer = nullptr;
 using ConnectOnlineCallback = std::function<bool(int, std::string, std::string, std::string)>;
 
+#ifdef _MSC_VER
 #pragma comment(lib, "ws2_32.lib")
+#endif
 
 class MjpegServer {
 private:
@@ -43,6 +65,20 @@ private:
     std::mutex frameMutex;
     std::map<int, std::unique_ptr<std::condition_variable>> frameCVs; // Need unique_ptr because cv isn't copyable
     std::map<int, bool> newFrameAvailable;
+    std::map<int, FrameTimestamps> latestTimestamps; // [LATENCY] Guarded by frameMutex
+    std::map<int, uint64_t> frameVersions;           // [WEBSOCKET] Bumped per SetLatestFrame; guarded by frameMutex
+    std::map<int, MetadataFrame> latestMetadata;     // [WEBSOCKET] Boxes/slots of latestFrames; guarded by frameMutex
+
+    // [WEBSOCKET] Last JPEG per camera, encoded once and shared by every /ws viewer
+    struct EncodedFrame {
+        std::mutex mutex; // Held while encoding, so one camera's encode doesn't hold up another's viewers
+        uint64_t version = 0;
+        std::shared_ptr<const std::vector<uchar>> jpeg;
+    };
+    std::map<int, std::unique_ptr<EncodedFrame>> encodedFrames; // unique_ptr: entries hold a mutex
+    std::mutex encodeMutex; // Guards the map only
+    std::atomic<int> webSocketClients{0};
+    std::atomic<int> fmp4Viewers{0};
     
     int port;
 
@@ -76,7 +112,7 @@ private:
             timeout.tv_sec = 0;
             timeout.tv_usec = 100000; // 100ms timeout
             
-            int activity = select(0, &readfds, NULL, NULL, &timeout);
+            int activity = select((int)serverSocket + 1, &readfds, NULL, NULL, &timeout); // nfds is ignored by Winsock
             
             if (activity > 0 && FD_ISSET(serverSocket, &readfds)) {
                 SOCKET clientSocket = accept(serverSocket, NULL, NULL);
@@ -87,12 +123,45 @@ private:
         }
     }
 
+    // [KEEPALIVE] Files and pages may leave the connection open; further requests on it are served
+    // by this same thread (a scrubbing <video> reuses one connection for all its range requests)
     void HandleClient(SOCKET clientSocket) {
+        for (int requestIndex = 0;; requestIndex++) {
+            bool keepAlive = false;
+            try {
+                keepAlive = HandleRequest(clientSocket, requestIndex);
+            } catch (const std::exception& e) {
+                // Handlers close the socket as their last step, so one that threw has not yet.
+                // Letting the exception out of this detached thread would end the process.
+                DumpLog(std::string("[HTTP] Request failed: ") + e.what());
+                closesocket(clientSocket);
+                return;
+            } catch (...) {
+                DumpLog("[HTTP] Request failed");
+                closesocket(clientSocket);
+                return;
+            }
+            if (!keepAlive) return;
+            fd_set readfds;
+            FD_ZERO(&readfds);
+            FD_SET(clientSocket, &readfds);
+            timeval timeout;
+            timeout.tv_sec = HTTP_KEEPALIVE_IDLE_SECONDS;
+            timeout.tv_usec = 0;
+            if (!isRunning || select((int)clientSocket + 1, &readfds, NULL, NULL, &timeout) <= 0) {
+                closesocket(clientSocket);
+                return;
+            }
+        }
+    }
+
+    // True when the response left the connection open for another request; otherwise the socket is closed
+    bool HandleRequest(SOCKET clientSocket, int requestIndex) {
         char buffer[4096];
         int bytesRead = recv(clientSocket, buffer, sizeof(buffer) - 1, 0);
         if (bytesRead <= 0) {
             closesocket(clientSocket);
-            return;
+            return false;
         }
         buffer[bytesRead] = '\0';
         std::string request(buffer);
@@ -131,7 +200,7 @@ private:
         size_t secondSpace = request.find(' ', firstSpace + 1);
         if (firstSpace == std::string::npos || secondSpace == std::string::npos) {
             closesocket(clientSocket);
-            return;
+            return false;
         }
         
         std::string method = request.substr(0, firstSpace);
@@ -164,10 +233,26 @@ private:
             }
         }
 
+        g_metrics.Counter("parking_http_requests_total", "HTTP requests accepted by the web server").inc();
+        bool keepAlive = WantsKeepAlive(request, requestIndex);
+        if (requestIndex > 0) g_metrics.Counter("parking_http_keepalive_reuses_total", "Requests served on an already open connection").inc();
+
         if (actionPath == "/video") {
             ServeMjpegStream(clientSocket, cameraId);
+        } else if (actionPath == "/api/ws") {
+            ServeWebSocket(clientSocket, request, cameraId);
+        } else if (actionPath == "/api/live.mp4") {
+            ServeFmp4Stream(clientSocket, cameraId);
         } else if (actionPath == "/api/stats") {
             ServeStats(clientSocket, cameraId);
+        } else if (actionPath == "/api/events") {
+            ServeLiveEvents(clientSocket, cameraId);
+        } else if (actionPath == "/api/trace") {
+            ServeTrace(clientSocket, request);
+        } else if (actionPath == "/api/metrics") {
+            ServeMetrics(clientSocket);
+        } else if (actionPath == "/api/latency") {
+            ServeLatency(clientSocket, cameraId, request);
         } else if (actionPath == "/api/current_frame") {
             ServeCurrentFrame(clientSocket, cameraId);
         } else if (actionPath == "/api/raw_frame") {
@@ -186,29 +271,72 @@ private:
             ServeAnomalyEvents(clientSocket, request);
         } else if (actionPath == "/api/parking_areas") {
             ServeParkingAreas(clientSocket, request);
+        } else if (actionPath == "/api/metadata") {
+            ServeMetadataTrack(clientSocket, request);
+        } else if (actionPath == "/api/occupancy") {
+            ServeOccupancy(clientSocket, request, cameraId);
+        } else if (actionPath == "/api/sessions") {
+            ServeEventLog(clientSocket, request, "parking_sessions", cameraId);
+        } else if (actionPath == "/api/slot_stats") {
+            ServeSlotStats(clientSocket, cameraId);
         } else if (actionPath.find("/locvideo/") == 0) {
-            ServeFileDirectly(clientSocket, "C:" + actionPath, request);
+            return ServeFileDirectly(clientSocket, "C:" + actionPath, request, keepAlive);
         } else if (actionPath.find("/smart_parking_violations/") == 0) {
-            ServeFileDirectly(clientSocket, "C:" + actionPath, request);
+            return ServeFileDirectly(clientSocket, "C:" + actionPath, request, keepAlive);
         } else if (actionPath.find("/violations/") == 0) {
             std::string realPath = actionPath;
             realPath.replace(0, 12, "/smart_parking_violations/");
-            ServeFileDirectly(clientSocket, "C:" + realPath, request);
+            return ServeFileDirectly(clientSocket, "C:" + realPath, request, keepAlive);
         } else if (actionPath == "/setup_online" || actionPath == "/setup_online.html") {
-            ServeHtml(clientSocket, "setup_online.html");
+            return ServeHtml(clientSocket, "setup_online.html", request, keepAlive);
         } else if (actionPath == "/setup_parking" || actionPath == "/setup_parking.html") {
-            ServeHtml(clientSocket, "setup_parking.html");
+            return ServeHtml(clientSocket, "setup_parking.html", request, keepAlive);
         } else if (actionPath == "/camera" || actionPath == "/camera.html") {
-            ServeHtml(clientSocket, "camera.html");
+            return ServeHtml(clientSocket, "camera.html", request, keepAlive);
         } else if (actionPath == "/dashboard") {
-            ServeHtml(clientSocket, "index.html");
+            return ServeHtml(clientSocket, "index.html", request, keepAlive);
         } else if (actionPath == "/" || actionPath == "/index.html" || actionPath == "/home" || actionPath == "/home.html") {
-            ServeHtml(clientSocket, "home.html");
+            return ServeHtml(clientSocket, "home.html", request, keepAlive);
         } else {
             std::string notFound = "HTTP/1.1 404 Not Found\r\nContent-Length: 9\r\n\r\nNot Found";
             send(clientSocket, notFound.c_str(), (int)notFound.length(), 0);
             closesocket(clientSocket);
         }
+        return false;
+    }
+
+    // HTTP/1.1 keeps the connection unless the client says close; HTTP/1.0 only when it asks
+    static bool WantsKeepAlive(const std::string& request, int requestIndex) {
+        if (requestIndex + 1 >= HTTP_KEEPALIVE_MAX_REQUESTS) return false;
+        std::string connection = HeaderValue(request, "Connection");
+        std::transform(connection.begin(), connection.end(), connection.begin(), ::tolower);
+        size_t lineEnd = request.find("\r\n");
+        bool http11 = request.rfind("HTTP/1.1", lineEnd) != std::string::npos;
+        if (connection.find("close") != std::string::npos) return false;
+        return http11 || connection.find("keep-alive") != std::string::npos;
+    }
+
+    static std::string ConnectionHeaders(bool keepAlive) {
+        if (!keepAlive) return "Connection: close\r\n";
+        return "Connection: keep-alive\r\nKeep-Alive: timeout=" + std::to_string(HTTP_KEEPALIVE_IDLE_SECONDS) +
+               ", max=" + std::to_string(HTTP_KEEPALIVE_MAX_REQUESTS) + "\r\n";
+    }
+
+    // Sends a complete response; closes the socket unless it is kept alive. Returns whether it was.
+    static bool FinishResponse(SOCKET clientSocket, bool sentOk, bool keepAlive) {
+        if (sentOk && keepAlive) return true;
+        closesocket(clientSocket);
+        return false;
+    }
+
+    static bool SendAll(SOCKET clientSocket, const char* data, size_t size) {
+        while (size > 0) {
+            int sent = send(clientSocket, data, (int)std::min<size_t>(size, 1 << 30), 0);
+            if (sent <= 0) return false;
+            data += sent;
+            size -= sent;
+        }
+        return true;
     }
 
     // ==========================================
@@ -216,7 +344,7 @@ private:
     // ==========================================
     void ServeCamerasList(SOCKET clientSocket) {
         std::string filePath = "C:\\camera_ids\\cameras.json";
-        std::ifstream file(filePath, std::ios::binary | std::ios::ate);
+        std::ifstream file(PlatformPath(filePath), std::ios::binary | std::ios::ate);
         std::string jsonContent = "[]"; // Default
 
         if (file.is_open()) {
@@ -249,9 +377,9 @@ private:
         if (bodyPos != std::string::npos) {
             std::string body = request.substr(bodyPos + 4);
             // Ensure folder exists
-            system("mkdir C:\\camera_ids 2>nul");
+            CreateDirectoryA("C:\\camera_ids", NULL);
             
-            std::ofstream outFile("C:\\camera_ids\\cameras.json");
+            std::ofstream outFile(PlatformPath("C:\\camera_ids\\cameras.json"));
             if (outFile.is_open()) {
                 outFile << body;
                 outFile.close();
@@ -275,91 +403,266 @@ private:
     // [PHASE 3] NEW ENDPOINTS FOR JSON API
     // ==========================================
     void ServeAnomalyEvents(SOCKET clientSocket, const std::string& request) {
-        // Default to today
+        ServeEventLog(clientSocket, request, "anomaly_events");
+    }
+
+    void ServeParkingAreas(SOCKET clientSocket, const std::string& request) {
+        ServeEventLog(clientSocket, request, "parking_areas");
+    }
+
+
+    // Value of a request header (name matched case-insensitively), "" if absent
+    static std::string HeaderValue(const std::string& request, const std::string& name) {
+        size_t headersEnd = request.find("\r\n\r\n");
+        std::string headers = request.substr(0, headersEnd);
+        std::string lower = headers;
+        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        std::string needle = name;
+        std::transform(needle.begin(), needle.end(), needle.begin(), ::tolower);
+        size_t pos = lower.find("\r\n" + needle + ":");
+        if (pos == std::string::npos) return "";
+        size_t start = headers.find_first_not_of(' ', pos + needle.size() + 3);
+        size_t end = headers.find("\r\n", pos + 2);
+        if (start == std::string::npos || start >= end) return "";
+        return headers.substr(start, end - start);
+    }
+
+    // [EVENT LOG] ?date=YYYY-MM-DD (default today) &limit=N &camera=N &type=Overstay &from=ms &to=ms &after=ms
+    // Newest first. Days recorded before the event log existed are served from the per-event files.
+    // [EVENT CACHE] Polls with a limit come from g_eventResponseCache: ETag / If-None-Match -> 304, gzip when accepted.
+    // [EVENT PAGING] after=<epoch_ms of the previous page's last record> continues with older records;
+    // pages and unlimited queries are streamed (chunked) record by record instead of cached.
+    // defaultCamera: camera to filter on when the query has no camera= (-1 = all)
+    void ServeEventLog(SOCKET clientSocket, const std::string& request, const std::string& stream, int defaultCamera = -1) {
         SYSTEMTIME st;
         GetLocalTime(&st);
         char defaultDate[32];
         sprintf_s(defaultDate, sizeof(defaultDate), "%04d%02d%02d", st.wYear, st.wMonth, st.wDay);
         std::string dateTarget = defaultDate;
-
-        // Extract ?date=YYYY-MM-DD to YYYYMMDD
-        size_t queryPos = request.find("date=");
-        if (queryPos != std::string::npos) {
-            size_t spacePos = request.find(' ', queryPos);
-            size_t ampPos = request.find('&', queryPos);
-            size_t endPos = (ampPos != std::string::npos && ampPos < spacePos) ? ampPos : spacePos;
-            
-            std::string dateStr = request.substr(queryPos + 5, endPos - (queryPos + 5));
+        std::string dateStr = GetQueryParam(request, "date");
+        if (!dateStr.empty()) {
             dateTarget = "";
-            for(char c : dateStr) if (c != '-') dateTarget += c;
+            for (char c : dateStr) if (c != '-') dateTarget += c;
         }
 
-        int limit = -1;
-        size_t limitPos = request.find("limit=");
-        if (limitPos != std::string::npos) {
-            size_t spacePos = request.find(' ', limitPos);
-            size_t ampPos = request.find('&', limitPos);
-            size_t endPos = (ampPos != std::string::npos && ampPos < spacePos) ? ampPos : spacePos;
-            
-            try {
-                limit = std::stoi(request.substr(limitPos + 6, endPos - (limitPos + 6)));
-            } catch(...) {}
+        EventLogQuery q;
+        int cameraFilter = defaultCamera;
+        long long after = 0;
+        bool paging = GetQueryInt(request, "after", after);
+        GetQueryInt(request, "limit", q.limit);
+        GetQueryInt(request, "camera", cameraFilter);
+        GetQueryInt(request, "from", q.fromMs);
+        GetQueryInt(request, "to", q.toMs);
+        if (paging) q.toMs = std::min(q.toMs, after - 1);
+        q.type = GetQueryParam(request, "type");
+        for (size_t i = 0; (i = q.type.find("%20", i)) != std::string::npos;) q.type.replace(i, 3, " ");
+
+        if (q.limit <= 0 || paging) {
+            StreamEventLog(clientSocket, stream, dateTarget, cameraFilter, q);
+            return;
         }
 
-        std::string dirPath = "C:\\loc_json\\anomaly_events\\" + dateTarget;
-        ServeJsonDirectoryAsArray(clientSocket, dirPath, limit);
+        bool acceptsGzip = HeaderValue(request, "Accept-Encoding").find("gzip") != std::string::npos;
+        std::shared_ptr<const EventResponse> cached = g_eventResponseCache.Get(stream, dateTarget, cameraFilter, q, acceptsGzip);
+        if (!cached) {
+            ServeJsonDirectoryAsArray(clientSocket, EventLogStore::DayDir(stream, dateTarget), q.limit);
+            return;
+        }
+
+        // no-cache: browsers revalidate every poll, and an unchanged result costs a header only
+        std::string common = "ETag: " + cached->etag + "\r\n"
+                             "Cache-Control: no-cache\r\n"
+                             "Vary: Accept-Encoding\r\n"
+                             "Access-Control-Allow-Origin: *\r\n"
+                             "Access-Control-Expose-Headers: ETag\r\n"
+                             "Connection: close\r\n";
+        std::string ifNoneMatch = HeaderValue(request, "If-None-Match");
+        if (!ifNoneMatch.empty() && (ifNoneMatch == "*" || ifNoneMatch.find(cached->etag) != std::string::npos)) {
+            std::string response = "HTTP/1.1 304 Not Modified\r\n" + common + "\r\n";
+            send(clientSocket, response.c_str(), (int)response.length(), 0);
+            closesocket(clientSocket);
+            return;
+        }
+
+        bool gzip = acceptsGzip && !cached->gzipBody.empty();
+        const std::string& body = gzip ? cached->gzipBody : cached->body;
+        std::string header = "HTTP/1.1 200 OK\r\n"
+                             "Content-Type: application/json; charset=utf-8\r\n" + common +
+                             (gzip ? "Content-Encoding: gzip\r\n" : "") +
+                             "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n";
+        send(clientSocket, header.c_str(), (int)header.length(), 0);
+        send(clientSocket, body.data(), (int)body.size(), 0);
+        closesocket(clientSocket);
     }
 
-    void ServeParkingAreas(SOCKET clientSocket, const std::string& request) {
-        // Default to today
-        SYSTEMTIME st;
-        GetLocalTime(&st);
-        char defaultDate[32];
-        sprintf_s(defaultDate, sizeof(defaultDate), "%04d%02d%02d", st.wYear, st.wMonth, st.wDay);
-        std::string dateTarget = defaultDate;
+    // [EVENT PAGING] Selects the page from the in-memory index, sends the headers straight away, then reads
+    // and sends one record at a time in ~EVENT_STREAM_CHUNK_BYTES chunks. X-Next-Cursor is set when the
+    // page is full (pass it back as ?after=); a page may run past the limit to finish a millisecond.
+    void StreamEventLog(SOCKET clientSocket, const std::string& stream, const std::string& date, int cameraId, const EventLogQuery& q) {
+        std::vector<EventLogRef> refs;
+        if (!g_eventLog.Select(stream, date, cameraId, q, refs)) {
+            ServeJsonDirectoryAsArray(clientSocket, EventLogStore::DayDir(stream, date), q.limit);
+            return;
+        }
 
-        // Extract ?date=YYYY-MM-DD
-        size_t queryPos = request.find("date=");
-        if (queryPos != std::string::npos) {
-            size_t spacePos = request.find(' ', queryPos);
-            size_t ampPos = request.find('&', queryPos);
-            size_t endPos = (ampPos != std::string::npos && ampPos < spacePos) ? ampPos : spacePos;
-            
-            std::string dateStr = request.substr(queryPos + 5, endPos - (queryPos + 5));
-            dateTarget = "";
-            for(char c : dateStr) if (c != '-') dateTarget += c;
+        std::string header = "HTTP/1.1 200 OK\r\n"
+                             "Content-Type: application/json; charset=utf-8\r\n"
+                             "Transfer-Encoding: chunked\r\n"
+                             "Access-Control-Allow-Origin: *\r\n"
+                             "Access-Control-Expose-Headers: X-Next-Cursor\r\n";
+        if (q.limit > 0 && (int)refs.size() >= q.limit) header += "X-Next-Cursor: " + std::to_string(refs.back().epochMs) + "\r\n";
+        header += "Connection: close\r\n\r\n";
+        bool ok = send(clientSocket, header.c_str(), (int)header.length(), 0) > 0;
+
+        EventLogReader reader;
+        std::string chunk = "[";
+        std::string line;
+        bool first = true;
+        for (size_t i = 0; ok && i < refs.size(); i++) {
+            if (!reader.Read(refs[i], line)) continue;
+            if (!first) chunk += ",";
+            chunk += line;
+            first = false;
+            if (chunk.size() >= EVENT_STREAM_CHUNK_BYTES) {
+                ok = SendChunk(clientSocket, chunk);
+                chunk.clear();
+            }
         }
+        chunk += "]";
+        if (ok && SendChunk(clientSocket, chunk)) SendChunk(clientSocket, "");
+        closesocket(clientSocket);
+    }
 
-        int limit = -1;
-        size_t limitPos = request.find("limit=");
-        if (limitPos != std::string::npos) {
-            size_t spacePos = request.find(' ', limitPos);
-            size_t ampPos = request.find('&', limitPos);
-            size_t endPos = (ampPos != std::string::npos && ampPos < spacePos) ? ampPos : spacePos;
-            
-            try {
-                limit = std::stoi(request.substr(limitPos + 6, endPos - (limitPos + 6)));
-            } catch(...) {}
+    // One HTTP/1.1 chunk; an empty one ends the body. False once the client has gone away.
+    static bool SendChunk(SOCKET clientSocket, const std::string& data) {
+        char size[16];
+        sprintf_s(size, sizeof(size), "%zx\r\n", data.size());
+        std::string frame = size + data + "\r\n";
+        return send(clientSocket, frame.c_str(), (int)frame.length(), 0) == (int)frame.length();
+    }
+
+    // [METADATA] /api/{id}/metadata?clip=YYYYMMDD/camera_N/HHMMSS.mp4&from=S&to=S
+    // Per-frame boxes and slot states recorded with a DVR clip, for client-side overlays.
+    // from/to are seconds into the clip (default: the whole clip).
+    void ServeMetadataTrack(SOCKET clientSocket, const std::string& request) {
+        std::string clip = GetQueryParam(request, "clip");
+        if (clip.find("C:/locvideo/") == 0) clip = clip.substr(12); // Accept media_video_url as-is
+        std::string body;
+        std::string status = "200 OK";
+        MetadataTrackHeader header;
+        std::vector<MetadataFrame> frames;
+        long long fromMs = 0, toMs = LLONG_MAX;
+        double seconds = 0;
+        if (GetQueryDouble(request, "from", seconds)) fromMs = (long long)(seconds * 1000.0);
+        if (GetQueryDouble(request, "to", seconds)) toMs = (long long)(seconds * 1000.0);
+
+        if (clip.empty() || clip.find("..") != std::string::npos) {
+            status = "400 Bad Request";
+            body = "{\"error\":\"clip=YYYYMMDD/camera_N/HHMMSS.mp4 required\"}";
+        } else {
+            std::string clipPath = "C:\\locvideo\\" + clip;
+            std::replace(clipPath.begin(), clipPath.end(), '/', '\\');
+            if (MetadataTrackReader::Query(MetadataPathForClip(clipPath), fromMs, toMs, header, frames)) {
+                body = MetadataTrackReader::ToJson(header, frames);
+            } else {
+                status = "404 Not Found";
+                body = "{\"error\":\"no metadata track for this clip\"}";
+            }
+        }
+
+        std::string response = "HTTP/1.1 " + status + "\r\n"
+                               "Content-Type: application/json; charset=utf-8\r\n"
+                               "Access-Control-Allow-Origin: *\r\n"
+                               "Connection: close\r\n"
+                               "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+        send(clientSocket, response.c_str(), (int)response.length(), 0);
+        closesocket(clientSocket);
+    }
+
+    // [SESSIONS] /api/{id}/slot_stats: today's per-slot dwell / turnover statistics, live
+    void ServeSlotStats(SOCKET clientSocket, int cameraId) {
+        long long nowMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        std::string body;
+        std::string status = "200 OK";
+        if (!g_parkingSessions.StatsJson(cameraId, nowMs, body)) {
+            status = "404 Not Found";
+            body = "{\"error\":\"camera has not reported slot states\"}";
+        }
+        std::string response = "HTTP/1.1 " + status + "\r\n"
+                               "Content-Type: application/json; charset=utf-8\r\n"
+                               "Access-Control-Allow-Origin: *\r\n"
+                               "Connection: close\r\n"
+                               "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+        send(clientSocket, response.c_str(), (int)response.length(), 0);
+        closesocket(clientSocket);
+    }
+
+    // [OCCUPANCY] /api/{id}/occupancy?from=ms&to=ms&step=ms&slot=N
+    // Occupancy curve from the camera's time-series store: default the last 24 h in ~500 steps.
+    // Without slot: [t, mean, min, max occupied slots, total slots] per step; with slot: [t, fraction occupied].
+    // Steps with no data (camera not running) are null.
+    void ServeOccupancy(SOCKET clientSocket, const std::string& request, int cameraId) {
+        long long nowMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        long long toMs = nowMs, fromMs = nowMs - 24LL * 3600 * 1000, stepMs = 0;
+        int slot = -1;
+        GetQueryInt(request, "from", fromMs);
+        GetQueryInt(request, "to", toMs);
+        GetQueryInt(request, "step", stepMs);
+        GetQueryInt(request, "slot", slot);
+        // Nothing is recorded before the epoch or after today, so the difference below can't overflow
+        long long latestMs = nowMs + 24LL * 3600 * 1000;
+        fromMs = std::max(0LL, std::min(fromMs, latestMs));
+        toMs = std::max(0LL, std::min(toMs, latestMs));
+        if (toMs <= fromMs) toMs = fromMs + 1;
+        if (stepMs <= 0) stepMs = std::max(1000LL, (toMs - fromMs) / 500);
+        stepMs = std::min(std::max(stepMs, (toMs - fromMs + OCCUPANCY_MAX_POINTS - 1) / OCCUPANCY_MAX_POINTS), toMs - fromMs);
+
+        std::vector<OccupancyPoint> points;
+        std::string source;
+        std::string body;
+        std::string status = "200 OK";
+        if (toMs - fromMs > OCCUPANCY_MAX_SPAN_MS) {
+            status = "400 Bad Request";
+            body = "{\"error\":\"range longer than " + std::to_string(OCCUPANCY_MAX_SPAN_MS / (24LL * 3600 * 1000)) + " days\"}";
+        } else if (!g_occupancy.Curve(cameraId, fromMs, toMs, stepMs, slot, points, source)) {
+            status = "404 Not Found";
+            body = "{\"error\":\"no occupancy history for this camera\"}";
+        } else {
+            std::ostringstream out;
+            out << "{\"camera_id\":" << cameraId << ",\"slot\":" << slot << ",\"from\":" << fromMs << ",\"to\":" << toMs
+                << ",\"step_ms\":" << stepMs << ",\"source\":\"" << source << "\",\"points\":[";
+            for (size_t i = 0; i < points.size(); i++) {
+                const OccupancyPoint& p = points[i];
+                if (i) out << ",";
+                out << "[" << p.tMs << ",";
+                if (p.coveredMs <= 0) out << "null";
+                else if (slot >= 0) out << p.mean;
+                else out << p.mean << "," << p.minOccupied << "," << p.maxOccupied << "," << p.slots;
+                out << "]";
+            }
+            out << "]}";
+            body = out.str();
         }
 
-        std::string dirPath = "C:\\loc_json\\parking_areas\\" + dateTarget;
-        ServeJsonDirectoryAsArray(clientSocket, dirPath, limit);
+        std::string response = "HTTP/1.1 " + status + "\r\n"
+                               "Content-Type: application/json; charset=utf-8\r\n"
+                               "Access-Control-Allow-Origin: *\r\n"
+                               "Connection: close\r\n"
+                               "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+        send(clientSocket, response.c_str(), (int)response.length(), 0);
+        closesocket(clientSocket);
     }
 
     void ServeJsonDirectoryAsArray(SOCKET clientSocket, const std::string& dirPath, int limit = -1) {
         std::vector<std::string> fileNames;
 
         auto scanDirectory = [&](const std::string& path) {
-            WIN32_FIND_DATAA findData;
-            HANDLE hFind = FindFirstFileA((path + "\\*.json").c_str(), &findData);
-            
-            if (hFind != INVALID_HANDLE_VALUE) {
-                do {
-                    if (!(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
-                        fileNames.push_back(path + "\\" + findData.cFileName);
-                    }
-                } while (FindNextFileA(hFind, &findData));
-                FindClose(hFind);
+            for (const std::string& name : PlatformListDirectory(path, false)) {
+                if (name.size() > 5 && name.compare(name.size() - 5, 5, ".json") == 0) {
+                    fileNames.push_back(path + "\\" + name);
+                }
             }
         };
 
@@ -367,58 +670,54 @@ private:
         scanDirectory(dirPath);
 
         // 2. Scan subdirectories (camera_1, camera_2, etc.)
-        WIN32_FIND_DATAA subFindData;
-        HANDLE hSubFind = FindFirstFileA((dirPath + "\\*").c_str(), &subFindData);
-        if (hSubFind != INVALID_HANDLE_VALUE) {
-            do {
-                if ((subFindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
-                    std::string subDirName = subFindData.cFileName;
-                    if (subDirName != "." && subDirName != "..") {
-                        scanDirectory(dirPath + "\\" + subDirName);
-                    }
-                }
-            } while (FindNextFileA(hSubFind, &subFindData));
-            FindClose(hSubFind);
+        for (const std::string& subDirName : PlatformListDirectory(dirPath, true)) {
+            scanDirectory(dirPath + "\\" + subDirName);
         }
         
         // Sort descending (newest epoch first)
         std::sort(fileNames.begin(), fileNames.end(), std::greater<std::string>());
         
-        std::string jsonContent = "[";
+        // [EVENT PAGING] Streamed file by file (chunked) rather than concatenated first
+        std::string header = "HTTP/1.1 200 OK\r\n"
+                             "Content-Type: application/json; charset=utf-8\r\n"
+                             "Transfer-Encoding: chunked\r\n"
+                             "Access-Control-Allow-Origin: *\r\n"
+                             "Connection: close\r\n\r\n";
+        bool ok = send(clientSocket, header.c_str(), (int)header.length(), 0) > 0;
+
+        std::string chunk = "[";
         bool first = true;
         int count = 0;
         
         for (const std::string& filePath : fileNames) {
-            if (limit > 0 && count >= limit) break;
+            if (!ok || (limit > 0 && count >= limit)) break;
             
-            std::ifstream inFile(filePath);
+            std::ifstream inFile(PlatformPath(filePath));
             if (inFile.is_open()) {
                 std::stringstream buffer;
                 buffer << inFile.rdbuf();
                 
-                if (!first) jsonContent += ",";
-                jsonContent += buffer.str();
+                if (!first) chunk += ",";
+                chunk += buffer.str();
                 first = false;
                 
                 inFile.close();
                 count++;
             }
+            if (chunk.size() >= EVENT_STREAM_CHUNK_BYTES) {
+                ok = SendChunk(clientSocket, chunk);
+                chunk.clear();
+            }
         }
         
-        jsonContent += "]";
-
-        std::string header = "HTTP/1.1 200 OK\r\n"
-                             "Content-Type: application/json; charset=utf-8\r\n"
-                             "Access-Control-Allow-Origin: *\r\n"
-                             "Connection: close\r\n"
-                             "Content-Length: " + std::to_string(jsonContent.size()) + "\r\n\r\n";
-        
-        send(clientSocket, header.c_str(), (int)header.length(), 0);
-        send(clientSocket, jsonContent.c_str(), (int)jsonContent.length(), 0);
+        chunk += "]";
+        if (ok && SendChunk(clientSocket, chunk)) SendChunk(clientSocket, "");
         closesocket(clientSocket);
     }
 
-    void ServeFileDirectly(SOCKET clientSocket, const std::string& fsPath, const std::string& httpRequest) {
+    // [FILES] Clips and snapshots: ETag / Last-Modified revalidation, single and multi-range requests.
+    // Small files come from g_staticAssets, the rest is sent straight from the page cache (see FileServing.h).
+    bool ServeFileDirectly(SOCKET clientSocket, const std::string& fsPath, const std::string& httpRequest, bool keepAlive) {
         // Strip out the query param safely (e.g. ?time=45)
         std::string cleanPath = fsPath;
         size_t queryPos = cleanPath.find("?");
@@ -427,82 +726,99 @@ private:
         }
         // Force replace / with \\ for windows paths just in case
         std::replace(cleanPath.begin(), cleanPath.end(), '/', '\\');
-
-        std::ifstream file(cleanPath, std::ios::binary | std::ios::ate);
-        if (!file.is_open()) {
-            std::string notFound = "HTTP/1.1 404 Not Found\r\nAccess-Control-Allow-Origin: *\r\nContent-Length: 9\r\n\r\nNot Found";
-            send(clientSocket, notFound.c_str(), (int)notFound.length(), 0);
-            closesocket(clientSocket);
-            return;
+        if (!IsConfinedPath(cleanPath)) {
+            std::string forbidden = "HTTP/1.1 403 Forbidden\r\nAccess-Control-Allow-Origin: *\r\nContent-Length: 9\r\n" +
+                                    ConnectionHeaders(keepAlive) + "\r\nForbidden";
+            return FinishResponse(clientSocket, SendAll(clientSocket, forbidden.data(), forbidden.size()), keepAlive);
         }
 
-        std::streamsize fileSize = file.tellg();
-        file.seekg(0, std::ios::beg);
-
         std::string contentType = "application/octet-stream";
         if (cleanPath.find(".jpg") != std::string::npos || cleanPath.find(".jpeg") != std::string::npos) contentType = "image/jpeg";
         else if (cleanPath.find(".webm") != std::string::npos) contentType = "video/webm";
         else if (cleanPath.find(".mp4") != std::string::npos) contentType = "video/mp4";
 
-        long long start = 0;
-        long long end = fileSize - 1;
-        bool isRange = false;
-
-        size_t rangePos = httpRequest.find("Range: bytes=");
-        if (rangePos != std::string::npos) {
-            isRange = true;
-            size_t startPos = rangePos + 13;
-            size_t dashPos = httpRequest.find("-", startPos);
-            size_t endLinePos = httpRequest.find("\r", startPos);
-            if (endLinePos == std::string::npos) endLinePos = httpRequest.find("\n", startPos);
-            
-            if (dashPos != std::string::npos && dashPos < endLinePos) {
-                std::string startStr = httpRequest.substr(startPos, dashPos - startPos);
-                std::string endStr = httpRequest.substr(dashPos + 1, endLinePos - dashPos - 1);
-                try { if (!startStr.empty()) start = std::stoll(startStr); } catch (...) {}
-                try { if (!endStr.empty() && endStr != " ") end = std::stoll(endStr); } catch (...) {}
-            }
+        ServedFile file;
+        if (!file.Open(cleanPath)) {
+            std::string notFound = "HTTP/1.1 404 Not Found\r\nAccess-Control-Allow-Origin: *\r\nContent-Length: 9\r\n" +
+                                   ConnectionHeaders(keepAlive) + "\r\nNot Found";
+            return FinishResponse(clientSocket, SendAll(clientSocket, notFound.data(), notFound.size()), keepAlive);
         }
-        
-        if (end >= fileSize) end = fileSize - 1;
-        if (start < 0) start = 0;
-        long long contentLength = end - start + 1;
-
-        std::string responseHeader;
-        if (isRange) {
-            responseHeader = "HTTP/1.1 206 Partial Content\r\n"
-                             "Content-Type: " + contentType + "\r\n"
-                             "Accept-Ranges: bytes\r\n"
-                             "Content-Range: bytes " + std::to_string(start) + "-" + std::to_string(end) + "/" + std::to_string(fileSize) + "\r\n"
-                             "Access-Control-Allow-Origin: *\r\n"
-                             "Connection: close\r\n"
-                             "Content-Length: " + std::to_string(contentLength) + "\r\n\r\n";
-        } else {
-            responseHeader = "HTTP/1.1 200 OK\r\n"
-                             "Content-Type: " + contentType + "\r\n"
-                             "Accept-Ranges: bytes\r\n"
-                             "Access-Control-Allow-Origin: *\r\n"
-                             "Connection: close\r\n"
-                             "Content-Length: " + std::to_string(contentLength) + "\r\n\r\n";
+        std::shared_ptr<const StaticAsset> asset;
+        if (file.Size() <= (long long)STATIC_CACHE_MAX_FILE) {
+            asset = g_staticAssets.Get(cleanPath);
+            if (asset) file.Close();
         }
+        long long size = asset ? asset->size : file.Size();
+        long long mtime = asset ? asset->mtime : file.ModifiedTime();
+        auto sendBody = [&](long long offset, long long length) {
+            if (asset) return SendAll(clientSocket, asset->body.data() + offset, (size_t)length);
+            return file.SendRange(clientSocket, offset, length);
+        };
+        std::string extraHeaders = "Accept-Ranges: bytes\r\nAccess-Control-Allow-Origin: *\r\n";
+        return SendFileResponse(clientSocket, httpRequest, contentType, extraHeaders, size, mtime, sendBody, keepAlive);
+    }
 
-        send(clientSocket, responseHeader.c_str(), (int)responseHeader.length(), 0);
-
-        file.seekg(start, std::ios::beg);
-        char buffer[8192];
-        long long bytesToRead = contentLength;
-        while (bytesToRead > 0 && file.read(buffer, (std::streamsize)std::min((long long)sizeof(buffer), bytesToRead))) {
-            long long readBytes = file.gcount();
-            send(clientSocket, buffer, (int)readBytes, 0);
-            bytesToRead -= readBytes;
+    // Status line, validators and ranges for a body of `size` bytes that sendBody(offset, length) can produce
+    template <typename SendBody>
+    bool SendFileResponse(SOCKET clientSocket, const std::string& request, const std::string& contentType, const std::string& extraHeaders,
+                          long long size, long long mtime, SendBody& sendBody, bool keepAlive) {
+        std::string etag = FileETag(size, mtime);
+        std::string lastModified = HttpDate(mtime);
+        std::string validators = "ETag: " + etag + "\r\nLast-Modified: " + lastModified + "\r\n";
+        std::string connection = ConnectionHeaders(keepAlive);
+
+        std::string ifNoneMatch = HeaderValue(request, "If-None-Match");
+        bool notModified = !ifNoneMatch.empty() ? ifNoneMatch.find(etag) != std::string::npos || ifNoneMatch == "*"
+                                                : HeaderValue(request, "If-Modified-Since") == lastModified;
+        if (notModified) {
+            std::string response = "HTTP/1.1 304 Not Modified\r\n" + validators + extraHeaders + connection + "\r\n";
+            return FinishResponse(clientSocket, SendAll(clientSocket, response.data(), response.size()), keepAlive);
         }
 
-        if (bytesToRead > 0 && file.gcount() > 0) {
-            send(clientSocket, buffer, (int)file.gcount(), 0);
+        std::vector<std::pair<long long, long long>> ranges;
+        int rangeResult = ParseByteRanges(HeaderValue(request, "Range"), size, ranges);
+        std::string ifRange = HeaderValue(request, "If-Range");
+        if (rangeResult != 0 && !ifRange.empty() && ifRange != etag && ifRange != lastModified) rangeResult = 0; // Changed: send it all
+
+        if (rangeResult < 0) {
+            std::string response = "HTTP/1.1 416 Range Not Satisfiable\r\nContent-Range: bytes */" + std::to_string(size) + "\r\n" +
+                                   extraHeaders + "Content-Length: 0\r\n" + connection + "\r\n";
+            return FinishResponse(clientSocket, SendAll(clientSocket, response.data(), response.size()), keepAlive);
         }
 
-        file.close();
-        closesocket(clientSocket);
+        bool ok;
+        if (rangeResult == 0) {
+            std::string header = "HTTP/1.1 200 OK\r\nContent-Type: " + contentType + "\r\n" + validators + extraHeaders +
+                                 "Content-Length: " + std::to_string(size) + "\r\n" + connection + "\r\n";
+            ok = SendAll(clientSocket, header.data(), header.size()) && sendBody(0, size);
+        } else if (ranges.size() == 1) {
+            long long first = ranges[0].first, last = ranges[0].second;
+            std::string header = "HTTP/1.1 206 Partial Content\r\nContent-Type: " + contentType + "\r\n" + validators + extraHeaders +
+                                 "Content-Range: bytes " + std::to_string(first) + "-" + std::to_string(last) + "/" + std::to_string(size) + "\r\n"
+                                 "Content-Length: " + std::to_string(last - first + 1) + "\r\n" + connection + "\r\n";
+            ok = SendAll(clientSocket, header.data(), header.size()) && sendBody(first, last - first + 1);
+        } else {
+            // multipart/byteranges: the length is known up front, so the connection can stay open
+            std::vector<std::string> partHeaders;
+            long long contentLength = 0;
+            for (const auto& range : ranges) {
+                partHeaders.push_back(std::string(partHeaders.empty() ? "" : "\r\n") + "--" + HTTP_BYTERANGES_BOUNDARY + "\r\n"
+                                      "Content-Type: " + contentType + "\r\n"
+                                      "Content-Range: bytes " + std::to_string(range.first) + "-" + std::to_string(range.second) + "/" + std::to_string(size) + "\r\n\r\n");
+                contentLength += (long long)partHeaders.back().size() + range.second - range.first + 1;
+            }
+            std::string closing = std::string("\r\n--") + HTTP_BYTERANGES_BOUNDARY + "--\r\n";
+            contentLength += (long long)closing.size();
+            std::string header = "HTTP/1.1 206 Partial Content\r\nContent-Type: multipart/byteranges; boundary=" + std::string(HTTP_BYTERANGES_BOUNDARY) + "\r\n" +
+                                 validators + extraHeaders + "Content-Length: " + std::to_string(contentLength) + "\r\n" + connection + "\r\n";
+            ok = SendAll(clientSocket, header.data(), header.size());
+            for (size_t i = 0; ok && i < ranges.size(); i++) {
+                ok = SendAll(clientSocket, partHeaders[i].data(), partHeaders[i].size()) &&
+                     sendBody(ranges[i].first, ranges[i].second - ranges[i].first + 1);
+            }
+            ok = ok && SendAll(clientSocket, closing.data(), closing.size());
+        }
+        return FinishResponse(clientSocket, ok, keepAlive);
     }
 
     void ServeStats(SOCKET clientSocket, int cameraId) {
@@ -521,6 +837,167 @@ private:
         closesocket(clientSocket);
     }
 
+    // [LIVE] /api/{id}/events: text/event-stream of slot / count / violation changes (see LiveEvents.h).
+    // Replaces polling /api/stats; one long-lived connection per dashboard.
+    void ServeLiveEvents(SOCKET clientSocket, int cameraId) {
+        std::string header = "HTTP/1.1 200 OK\r\n"
+                             "Content-Type: text/event-stream\r\n"
+                             "Cache-Control: no-cache\r\n"
+                             "Access-Control-Allow-Origin: *\r\n"
+                             "X-Accel-Buffering: no\r\n"
+                             "Connection: keep-alive\r\n\r\n"
+                             "retry: 2000\n\n";
+        if (send(clientSocket, header.c_str(), (int)header.length(), 0) != (int)header.length()) {
+            closesocket(clientSocket);
+            return;
+        }
+
+        std::shared_ptr<LiveSubscriber> sub = g_liveEvents.Subscribe(cameraId);
+        std::vector<LiveMessage> batch;
+        int idleMs = 0;
+        while (isRunning) {
+            if (!sub->Wait(batch, 1000)) {
+                if (sub->Closed()) break; // Hub stopped: Wait() no longer blocks
+                idleMs += 1000;
+                if (idleMs < LIVE_EVENTS_PING_MS) continue;
+                idleMs = 0;
+                static const std::string ping = ": ping\n\n"; // Comment line: keeps proxies open, detects dead clients
+                if (send(clientSocket, ping.c_str(), (int)ping.length(), 0) != (int)ping.length()) break;
+                continue;
+            }
+            idleMs = 0;
+            bool ok = true;
+            for (const LiveMessage& message : batch) {
+                if (send(clientSocket, message->c_str(), (int)message->length(), 0) != (int)message->length()) {
+                    ok = false;
+                    break;
+                }
+            }
+            if (!ok) break;
+        }
+        g_liveEvents.Unsubscribe(sub);
+        closesocket(clientSocket);
+    }
+
+    // Value of ?key=... in the request line ("" if absent)
+    static std::string GetQueryParam(const std::string& request, const std::string& key) {
+        size_t lineEnd = request.find("\r\n");
+        std::string line = request.substr(0, lineEnd);
+        size_t q = line.find('?');
+        if (q == std::string::npos) return "";
+        size_t end = line.find(' ', q);
+        std::string query = line.substr(q + 1, end == std::string::npos ? std::string::npos : end - q - 1);
+
+        size_t pos = 0;
+        while (pos < query.size()) {
+            size_t amp = query.find('&', pos);
+            std::string pair = query.substr(pos, amp == std::string::npos ? std::string::npos : amp - pos);
+            size_t eq = pair.find('=');
+            if (pair.substr(0, eq) == key) return eq == std::string::npos ? "" : pair.substr(eq + 1);
+            if (amp == std::string::npos) break;
+            pos = amp + 1;
+        }
+        return "";
+    }
+
+    // ?key=<whole number>. False, with `value` untouched, when absent, malformed or out of range.
+    static bool GetQueryInt(const std::string& request, const std::string& key, long long& value) {
+        std::string text = GetQueryParam(request, key);
+        if (text.empty()) return false;
+        char* end = nullptr;
+        errno = 0;
+        long long parsed = strtoll(text.c_str(), &end, 10);
+        if (errno != 0 || *end != '\0') return false;
+        value = parsed;
+        return true;
+    }
+    static bool GetQueryInt(const std::string& request, const std::string& key, int& value) {
+        long long parsed = 0;
+        if (!GetQueryInt(request, key, parsed) || parsed < INT_MIN || parsed > INT_MAX) return false;
+        value = (int)parsed;
+        return true;
+    }
+    static bool GetQueryDouble(const std::string& request, const std::string& key, double& value) {
+        std::string text = GetQueryParam(request, key);
+        if (text.empty()) return false;
+        char* end = nullptr;
+        double parsed = strtod(text.c_str(), &end);
+        if (*end != '\0' || !std::isfinite(parsed)) return false;
+        value = parsed;
+        return true;
+    }
+
+    // [TRACE] /api/trace?seconds=N  -> Chrome/Perfetto JSON of the last N seconds.
+    // Unless continuous tracing is on, the request captures for N seconds first (at most
+    // TRACE_MAX_CAPTURE_SECONDS). ?mode=on|off toggles continuous tracing.
+    void ServeTrace(SOCKET clientSocket, const std::string& request) {
+        std::string mode = GetQueryParam(request, "mode");
+        if (mode == "on" || mode == "off") {
+            g_traceRecorder.SetEnabled(mode == "on");
+            std::string body = std::string("{\"tracing\":") + (mode == "on" ? "true" : "false") + "}";
+            std::string response = "HTTP/1.1 200 OK\r\n"
+                                   "Content-Type: application/json\r\n"
+                                   "Connection: close\r\n"
+                                   "Content-Length: " + std::to_string(body.length()) + "\r\n\r\n" + body;
+            send(clientSocket, response.c_str(), (int)response.length(), 0);
+            closesocket(clientSocket);
+            return;
+        }
+
+        double seconds = 5.0;
+        GetQueryDouble(request, "seconds", seconds);
+        seconds = (std::max)(0.1, (std::min)(seconds, 60.0));
+
+        if (!g_traceRecorder.IsContinuous()) {
+            // Overlapping captures each hold tracing on for their own window
+            seconds = (std::min)(seconds, TRACE_MAX_CAPTURE_SECONDS);
+            g_traceRecorder.BeginCapture();
+            std::this_thread::sleep_for(std::chrono::milliseconds((int)(seconds * 1000)));
+            g_traceRecorder.EndCapture();
+        }
+
+        std::string body = g_traceRecorder.DumpChromeJson(seconds);
+        std::string header = "HTTP/1.1 200 OK\r\n"
+                             "Content-Type: application/json\r\n"
+                             "Content-Disposition: attachment; filename=\"parking_trace.json\"\r\n"
+                             "Access-Control-Allow-Origin: *\r\n"
+                             "Connection: close\r\n"
+                             "Content-Length: " + std::to_string(body.length()) + "\r\n\r\n";
+        send(clientSocket, header.c_str(), (int)header.length(), 0);
+        send(clientSocket, body.c_str(), (int)body.length(), 0);
+        closesocket(clientSocket);
+    }
+
+    // [METRICS] Prometheus text format for every registered series (all cameras)
+    void ServeMetrics(SOCKET clientSocket) {
+        std::string body = g_metrics.Render();
+        std::string header = "HTTP/1.1 200 OK\r\n"
+                             "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                             "Cache-Control: no-cache\r\n"
+                             "Connection: close\r\n"
+                             "Content-Length: " + std::to_string(body.length()) + "\r\n\r\n";
+        send(clientSocket, header.c_str(), (int)header.length(), 0);
+        send(clientSocket, body.c_str(), (int)body.length(), 0);
+        closesocket(clientSocket);
+    }
+
+    // [LATENCY] Stage + end-to-end percentiles for one camera. ?reset=1 clears after reading.
+    void ServeLatency(SOCKET clientSocket, int cameraId, const std::string& request) {
+        LatencyTracker& tracker = g_latencyRegistry.Get(cameraId);
+        std::string json = tracker.ToJson(cameraId);
+        if (GetQueryParam(request, "reset") == "1") tracker.reset();
+
+        std::string header = "HTTP/1.1 200 OK\r\n"
+                             "Content-Type: application/json; charset=utf-8\r\n"
+                             "Access-Control-Allow-Origin: *\r\n"
+                             "Cache-Control: no-cache\r\n"
+                             "Connection: close\r\n"
+                             "Content-Length: " + std::to_string(json.length()) + "\r\n\r\n";
+        send(clientSocket, header.c_str(), (int)header.length(), 0);
+        send(clientSocket, json.c_str(), (int)json.length(), 0);
+        closesocket(clientSocket);
+    }
+
     void ServeDisconnect(SOCKET clientSocket, int cameraId) {
         DumpLog("[HTTP] Received /api/disconnect");
         if (onDisconnect) {
@@ -671,34 +1148,19 @@ private:
         closesocket(clientSocket);
     }
 
-    void ServeHtml(SOCKET clientSocket, const std::string& filename) {
-        FILE* f = nullptr;
-        fopen_s(&f, filename.c_str(), "rb");
-        if (!f) {
-            std::string msg = "HTTP/1.1 404 Not Found\r\n\r\nFile not found. Please create index.html in the app directory.";
-            send(clientSocket, msg.c_str(), (int)msg.length(), 0);
-            closesocket(clientSocket);
-            return;
-        }
-        fseek(f, 0, SEEK_END);
-        long fsize = ftell(f);
-        fseek(f, 0, SEEK_SET);
-
-        std::vector<char> content(fsize);
-        if (fsize > 0) {
-            fread(content.data(), 1, fsize, f);
+    // [FILES] Pages are served from g_staticAssets (re-read only when the file changes on disk)
+    bool ServeHtml(SOCKET clientSocket, const std::string& filename, const std::string& request, bool keepAlive) {
+        std::shared_ptr<const StaticAsset> asset = g_staticAssets.Get(filename, STATIC_CACHE_MAX_PAGE);
+        if (!asset) {
+            std::string body = "File not found. Please create index.html in the app directory.";
+            std::string msg = "HTTP/1.1 404 Not Found\r\nContent-Length: " + std::to_string(body.size()) + "\r\n" + ConnectionHeaders(keepAlive) + "\r\n" + body;
+            return FinishResponse(clientSocket, SendAll(clientSocket, msg.data(), msg.size()), keepAlive);
         }
-        fclose(f);
-
-        std::string header = "HTTP/1.1 200 OK\r\n"
-                             "Content-Type: text/html; charset=utf-8\r\n"
-                             "Connection: close\r\n"
-                             "Content-Length: " + std::to_string(fsize) + "\r\n\r\n";
-        send(clientSocket, header.c_str(), (int)header.length(), 0);
-        if (fsize > 0) {
-            send(clientSocket, content.data(), (int)fsize, 0);
-        }
-        closesocket(clientSocket);
+        auto sendBody = [&](long long offset, long long length) {
+            return SendAll(clientSocket, asset->body.data() + offset, (size_t)length);
+        };
+        return SendFileResponse(clientSocket, request, "text/html; charset=utf-8", "Cache-Control: no-cache\r\n",
+                                asset->size, asset->mtime, sendBody, keepAlive);
     }
 
     void ServeMjpegStream(SOCKET clientSocket, int cameraId) {
@@ -706,7 +1168,9 @@ private:
         {
             std::lock_guard<std::mutex> lock(clientsMutex);
             clientSockets.push_back(clientSocket);
+            g_metrics.Gauge("parking_stream_clients", "Connected MJPEG viewers").set((double)clientSockets.size());
         }
+        MetricHistogram& encodeSeconds = g_metrics.Histogram("parking_jpeg_encode_seconds", "MJPEG imencode time per frame per viewer", CameraLabel(cameraId));
         
         // HTTP Stream Header
         std::string httpHeader = "HTTP/1.1 200 OK\r\n"
@@ -721,6 +1185,7 @@ private:
 
         while (isRunning) {
             cv::Mat frameToSend;
+            FrameTimestamps frameTs;
             {
                 std::unique_lock<std::mutex> lock(frameMutex);
                 if (frameCVs.find(cameraId) == frameCVs.end()) {
@@ -745,11 +1210,18 @@ private:
                 
                 // Copy frame to avoid holding lock during encoding
                 frameToSend = latestFrames[cameraId].clone();
+                frameTs = latestTimestamps[cameraId];
                 newFrameAvailable[cameraId] = false;
             }
 
             if (!frameToSend.empty()) {
-                cv::imencode(".jpg", frameToSend, buffer, params);
+                long long encodeStart = cv::getTickCount();
+                {
+                    TraceSpan encodeSpan("imencode", "streaming", cameraId);
+                    cv::imencode(".jpg", frameToSend, buffer, params);
+                }
+                encodeSeconds.observe((cv::getTickCount() - encodeStart) / cv::getTickFrequency());
+                TraceSpan sendSpan("mjpeg.send", "streaming", cameraId);
                 
                 std::string frameHeader = "--mjpegstream\r\n"
                                           "Content-Type: image/jpeg\r\n"
@@ -758,6 +1230,10 @@ private:
                 // Send Header
                 int bytesSent = send(clientSocket, frameHeader.c_str(), (int)frameHeader.length(), 0);
                 if (bytesSent == SOCKET_ERROR) break;
+                if (frameTs.seq > 0) {
+                    frameTs.mark(STAGE_FIRST_BYTE);
+                    g_latencyRegistry.Get(cameraId).recordFirstByte(frameTs);
+                }
                 
                 // Send Image Data
                 bytesSent = send(clientSocket, (const char*)buffer.data(), (int)buffer.size(), 0);
@@ -777,12 +1253,219 @@ private:
             if (it != clientSockets.end()) {
                 clientSockets.erase(it);
             }
+            g_metrics.Gauge("parking_stream_clients", "Connected MJPEG viewers").set((double)clientSockets.size());
         }
         closesocket(clientSocket);
     }
 
+    // [WEBSOCKET] /api/{id}/ws: JPEG frames + their metadata on one connection, paced by client credit
+    // (protocol in WebSocketChannel.h). Unlike /video, nothing is pushed faster than the client draws.
+    void ServeWebSocket(SOCKET clientSocket, const std::string& request, int cameraId) {
+        std::string key = HeaderValue(request, "Sec-WebSocket-Key");
+        std::string upgrade = HeaderValue(request, "Upgrade");
+        std::transform(upgrade.begin(), upgrade.end(), upgrade.begin(), ::tolower);
+        if (key.empty() || upgrade != "websocket") {
+            std::string response = "HTTP/1.1 426 Upgrade Required\r\nUpgrade: websocket\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+            send(clientSocket, response.c_str(), (int)response.length(), 0);
+            closesocket(clientSocket);
+            return;
+        }
+        std::string handshake = "HTTP/1.1 101 Switching Protocols\r\n"
+                                "Upgrade: websocket\r\n"
+                                "Connection: Upgrade\r\n"
+                                "Sec-WebSocket-Accept: " + WebSocketAcceptKey(key) + "\r\n\r\n";
+        if (!SendAll(clientSocket, handshake.data(), handshake.size())) {
+            closesocket(clientSocket);
+            return;
+        }
+
+        MetricGauge& clients = g_metrics.Gauge("parking_ws_clients", "Connected /api/{id}/ws viewers");
+        MetricCounter& framesSent = g_metrics.Counter("parking_ws_frames_total", "Frames sent over /api/{id}/ws", CameraLabel(cameraId));
+        MetricCounter& framesSkipped = g_metrics.Counter("parking_ws_frames_skipped_total", "Frames a /ws viewer had no credit for", CameraLabel(cameraId));
+        clients.set((double)++webSocketClients);
+
+        WebSocketReader reader;
+        WebSocketMessage message;
+        std::vector<unsigned char> metadataMessage;
+        char buffer[4096];
+        int credit = 0;
+        uint64_t lastVersion = 0;
+        bool open = true;
+        while (isRunning && open) {
+            // Client messages: credit, ping, close. Without credit there is nothing else to do, so block here.
+            fd_set readfds;
+            FD_ZERO(&readfds);
+            FD_SET(clientSocket, &readfds);
+            timeval timeout;
+            timeout.tv_sec = 0;
+            timeout.tv_usec = credit > 0 ? 0 : 200000;
+            if (select((int)clientSocket + 1, &readfds, NULL, NULL, &timeout) > 0) {
+                int bytesRead = recv(clientSocket, buffer, sizeof(buffer), 0);
+                if (bytesRead <= 0) break;
+                reader.Feed(buffer, bytesRead);
+                while (reader.Next(message)) {
+                    if (message.opcode == WS_OP_TEXT) {
+                        credit = std::min(WS_MAX_CREDIT, credit + WebSocketCredit(message.payload));
+                    } else if (message.opcode == WS_OP_PING) {
+                        std::string pong = WebSocketFrameHeader(WS_OP_PONG, message.payload.size()) + message.payload;
+                        SendAll(clientSocket, pong.data(), pong.size());
+                    } else if (message.opcode == WS_OP_CLOSE) {
+                        std::string close = WebSocketFrameHeader(WS_OP_CLOSE, 0);
+                        SendAll(clientSocket, close.data(), close.size());
+                        open = false;
+                        break;
+                    }
+                }
+                if (reader.Failed()) break;
+            }
+            if (!open || credit <= 0) continue;
+
+            cv::Mat frame;
+            MetadataFrame metadata;
+            FrameTimestamps frameTs;
+            uint64_t version = 0;
+            {
+                std::unique_lock<std::mutex> lock(frameMutex);
+                if (frameCVs.find(cameraId) == frameCVs.end()) {
+                    frameCVs[cameraId] = std::make_unique<std::condition_variable>();
+                }
+                if (!frameCVs[cameraId]->wait_for(lock, std::chrono::milliseconds(100), [&] { return frameVersions[cameraId] != lastVersion || !isRunning; })) {
+                    continue; // Back to reading the client
+                }
+                if (!isRunning) break;
+                version = frameVersions[cameraId];
+                frame = latestFrames[cameraId]; // SetLatestFrame stores a fresh clone each time, so sharing it is safe
+                metadata = latestMetadata[cameraId];
+                frameTs = latestTimestamps[cameraId];
+            }
+            if (frame.empty()) { lastVersion = version; continue; }
+            if (lastVersion > 0 && version > lastVersion + 1) framesSkipped.inc((long long)(version - lastVersion - 1));
+            lastVersion = version;
+
+            std::shared_ptr<const std::vector<uchar>> jpeg = EncodeShared(cameraId, version, frame);
+            if (!jpeg) continue;
+
+            metadataMessage.assign(1, WS_KIND_METADATA);
+            MetadataTrackWriter::Encode(metadata, metadataMessage);
+            std::string header = WebSocketFrameHeader(WS_OP_BINARY, metadataMessage.size());
+            header.append((const char*)metadataMessage.data(), metadataMessage.size());
+            if (!SendAll(clientSocket, header.data(), header.size())) break;
+
+            long long seq = metadata.seq;
+            header = WebSocketFrameHeader(WS_OP_BINARY, 1 + sizeof(seq) + jpeg->size());
+            header += (char)WS_KIND_JPEG;
+            header.append((const char*)&seq, sizeof(seq));
+            if (!SendAll(clientSocket, header.data(), header.size())) break;
+            if (frameTs.seq > 0) {
+                frameTs.mark(STAGE_FIRST_BYTE);
+                g_latencyRegistry.Get(cameraId).recordFirstByte(frameTs);
+            }
+            // A short send would leave the rest of the frame to be mistaken for the next frame's header
+            if (!SendAll(clientSocket, (const char*)jpeg->data(), jpeg->size())) break;
+            framesSent.inc();
+            credit--;
+        }
+
+        clients.set((double)--webSocketClients);
+        closesocket(clientSocket);
+    }
+
+    // [FMP4] /api/{id}/live.mp4: the camera's shared H.264 encode as one endless fragmented MP4 (see LiveFmp4Stream.h)
+    void ServeFmp4Stream(SOCKET clientSocket, int cameraId) {
+        if (!IsKnownCamera(cameraId)) { // Each stream owns an encoder; don't create one per made-up id
+            std::string body = "Unknown camera";
+            std::string response = "HTTP/1.1 404 Not Found\r\nContent-Type: text/plain\r\nContent-Length: " +
+                                   std::to_string(body.length()) + "\r\nConnection: close\r\n\r\n" + body;
+            SendAll(clientSocket, response.data(), response.size());
+            closesocket(clientSocket);
+            return;
+        }
+        LiveFmp4Stream* stream = g_liveFmp4.Get(cameraId, true);
+        std::shared_ptr<Fmp4Viewer> viewer = stream->Subscribe();
+        std::vector<Fmp4Chunk> batch;
+        // The init segment arrives with the first frame encoded for us; its codecs string goes in the headers
+        bool started = false;
+        for (int waited = 0; viewer && isRunning && waited < 5000 && !viewer->Closed(); waited += 250) {
+            if ((started = viewer->Wait(batch, 250))) break;
+        }
+        if (!started) {
+            if (viewer) stream->Unsubscribe(viewer);
+            std::string body = "No video (camera offline or no H.264 encoder)";
+            std::string response = "HTTP/1.1 503 Service Unavailable\r\nContent-Type: text/plain\r\nContent-Length: " +
+                                   std::to_string(body.length()) + "\r\nConnection: close\r\n\r\n" + body;
+            send(clientSocket, response.c_str(), (int)response.length(), 0);
+            closesocket(clientSocket);
+            return;
+        }
+
+        MetricGauge& viewers = g_metrics.Gauge("parking_fmp4_viewers", "Connected /api/{id}/live.mp4 viewers");
+        viewers.set((double)++fmp4Viewers);
+        std::string header = "HTTP/1.1 200 OK\r\n"
+                             "Content-Type: video/mp4\r\n"
+                             "X-Codecs: " + stream->Codecs() + "\r\n"
+                             "Access-Control-Allow-Origin: *\r\n"
+                             "Access-Control-Expose-Headers: X-Codecs\r\n"
+                             "Cache-Control: no-cache\r\n"
+                             "Connection: close\r\n\r\n";
+        bool ok = send(clientSocket, header.c_str(), (int)header.length(), 0) != SOCKET_ERROR;
+        while (ok && isRunning) {
+            for (const Fmp4Chunk& chunk : batch) {
+                if (send(clientSocket, chunk->data(), (int)chunk->size(), 0) == SOCKET_ERROR) { ok = false; break; }
+            }
+            batch.clear();
+            if (!ok || viewer->Closed()) break;
+            viewer->Wait(batch, 1000);
+        }
+        stream->Unsubscribe(viewer);
+        viewers.set((double)--fmp4Viewers);
+        closesocket(clientSocket);
+    }
+
+    // Listed in cameras.json, or already sending frames to this server
+    bool IsKnownCamera(int cameraId) {
+        {
+            std::lock_guard<std::mutex> lock(frameMutex);
+            auto it = frameVersions.find(cameraId);
+            if (it != frameVersions.end() && it->second > 0) return true;
+        }
+        std::ifstream file(PlatformPath("C:\\camera_ids\\cameras.json"));
+        if (!file.is_open()) return false;
+        try {
+            nlohmann::json cameras = nlohmann::json::parse(file);
+            for (const auto& item : cameras) {
+                if (item.is_object() && item.value("id", 0) == cameraId) return true;
+            }
+        } catch (...) {}
+        return false;
+    }
+
+    // JPEG of frame `version`, encoded by whichever /ws viewer asks first
+    std::shared_ptr<const std::vector<uchar>> EncodeShared(int cameraId, uint64_t version, const cv::Mat& frame) {
+        EncodedFrame* entry;
+        {
+            std::lock_guard<std::mutex> lock(encodeMutex);
+            std::unique_ptr<EncodedFrame>& slot = encodedFrames[cameraId];
+            if (!slot) slot.reset(new EncodedFrame());
+            entry = slot.get();
+        }
+        EncodedFrame& cached = *entry;
+        std::lock_guard<std::mutex> lock(cached.mutex); // Other viewers of the camera wait for this encode rather than repeat it
+        if (cached.version == version && cached.jpeg) return cached.jpeg;
+        auto jpeg = std::make_shared<std::vector<uchar>>();
+        long long encodeStart = cv::getTickCount();
+        {
+            TraceSpan encodeSpan("imencode", "streaming", cameraId);
+            if (!cv::imencode(".jpg", frame, *jpeg, std::vector<int>{cv::IMWRITE_JPEG_QUALITY, 70})) return nullptr;
+        }
+        g_metrics.Histogram("parking_jpeg_encode_seconds", "MJPEG imencode time per frame per viewer", CameraLabel(cameraId))
+            .observe((cv::getTickCount() - encodeStart) / cv::getTickFrequency());
+        cached.version = version;
+        cached.jpeg = jpeg;
+        return cached.jpeg;
+    }
+
 public:
-    MjpegServer(int listenPort = 8080) : isRunning(false), serverSocket(INVALID_SOCKET), port(listenPort) {}
+    MjpegServer(int listenPort = 8080) : serverSocket(INVALID_SOCKET), isRunning(false), port(listenPort) {}
 
     ~MjpegServer() {
         Stop();
@@ -803,8 +1486,8 @@ public:
         }
 
         // Allow port reuse
-        char opt = 1;
-        setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+        int opt = 1;
+        setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR, (const char*)&opt, sizeof(opt));
 
         sockaddr_in serverAddr;
         serverAddr.sin_family = AF_INET;
@@ -864,19 +1547,47 @@ public:
     void SetLatestFrame(int cameraId, const cv::Mat& frame) {
         if (!isRunning) return;
         
+        cv::Mat stored = frame.clone(); // Never written again: viewers and the fMP4 encoder share it
         {
             std::lock_guard<std::mutex> lock(frameMutex);
-            latestFrames[cameraId] = frame.clone();
+            latestFrames[cameraId] = stored;
+            latestMetadata[cameraId] = MetadataFrame();
+            frameVersions[cameraId]++;
             newFrameAvailable[cameraId] = true;
             if (frameCVs.find(cameraId) == frameCVs.end()) {
                 frameCVs[cameraId] = std::make_unique<std::condition_variable>();
             }
         }
         if (frameCVs[cameraId]) frameCVs[cameraId]->notify_all();
+        g_liveFmp4.Push(cameraId, stored); // [FMP4] No-op unless someone watches /api/{id}/live.mp4
 
 		// (Removed debug print here to save resources)
     }
 
+    // [LATENCY] Same as above, plus the frame's pipeline timestamps (PUBLISH is stamped here)
+    // [WEBSOCKET] and the boxes/slots drawn on it, sent alongside the picture on /api/{id}/ws
+    void SetLatestFrame(int cameraId, const cv::Mat& frame, const FrameTimestamps& timestamps, const MetadataFrame* metadata = nullptr) {
+        if (!isRunning) return;
+
+        FrameTimestamps ts = timestamps;
+        ts.mark(STAGE_PUBLISH);
+        g_latencyRegistry.Get(cameraId).recordPipeline(ts);
+        cv::Mat stored = frame.clone(); // Never written again: viewers and the fMP4 encoder share it
+        {
+            std::lock_guard<std::mutex> lock(frameMutex);
+            latestFrames[cameraId] = stored;
+            latestTimestamps[cameraId] = ts;
+            latestMetadata[cameraId] = metadata ? *metadata : MetadataFrame();
+            frameVersions[cameraId]++;
+            newFrameAvailable[cameraId] = true;
+            if (frameCVs.find(cameraId) == frameCVs.end()) {
+                frameCVs[cameraId] = std::make_unique<std::condition_variable>();
+            }
+        }
+        if (frameCVs[cameraId]) frameCVs[cameraId]->notify_all();
+        g_liveFmp4.Push(cameraId, stored); // [FMP4] No-op unless someone watches /api/{id}/live.mp4
+    }
+
     void SetStats(int cameraId, const std::string& json) {
         std::lock_guard<std::mutex> lock(statsMutex);
         latestStatsJson[cameraId] = json;
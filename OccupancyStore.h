@@ -0,0 +1,515 @@
+#pragma once
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Platform.h"
+#include "ParkingSlot.h"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
+
+// ==========================================
+//  [OCCUPANCY] Per-slot occupancy history with minute / hour rollups
+// ==========================================
+// One store per camera under C:\loc_occupancy\camera_N, each table a set of column files
+// (one memory-mapped array per field, so a query touches only the fields it needs):
+//   transitions\  t_ms, slot, status, occupied, prev  - one row per slot state change; `occupied` is the
+//                 camera's occupied-slot count after it, `prev` the row of the same slot's previous change
+//   minute\, hour\  t_ms, occupied_ms, covered_ms, min, max, slots, transitions - one row per bucket
+// Rollups are maintained in place on every Update(): the occupied count is integrated over the time
+// since the previous update into the current minute and hour rows, so a curve over days reads a few
+// thousand rollup rows instead of replaying transitions. Gaps longer than OCCUPANCY_MAX_GAP_MS (daemon
+// stopped, camera offline) are left uncovered rather than extrapolated; covered_ms tells them apart.
+
+const long long OCCUPANCY_MAX_GAP_MS = 60 * 1000;
+const size_t OCCUPANCY_INITIAL_ROWS = 4096;
+const int OCCUPANCY_MAX_POINTS = 10000;
+const long long OCCUPANCY_MAX_SPAN_MS = 366LL * 24 * 3600 * 1000; // Longest range one curve may cover
+
+// Growable array of T in a memory-mapped file laid out as [uint64 count][T...]
+template <typename T>
+class MappedColumn {
+public:
+    MappedColumn() = default;
+    MappedColumn(const MappedColumn&) = delete;
+    MappedColumn& operator=(const MappedColumn&) = delete;
+    ~MappedColumn() { Close(); }
+
+    bool Open(const std::string& path, bool create) {
+        Close();
+        std::string p = PlatformPath(path);
+        long long bytes = 0;
+#ifdef _WIN32
+        file_ = CreateFileA(p.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL,
+                            create ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file_ == INVALID_HANDLE_VALUE) {
+            file_ = NULL;
+            return false;
+        }
+        LARGE_INTEGER size;
+        if (GetFileSizeEx(file_, &size)) bytes = size.QuadPart;
+#else
+        fd_ = open(p.c_str(), O_RDWR | (create ? O_CREAT : 0), 0644);
+        if (fd_ < 0) return false;
+        struct stat sb;
+        if (fstat(fd_, &sb) == 0) bytes = (long long)sb.st_size;
+#endif
+        size_t rows = bytes > (long long)sizeof(uint64_t) ? (size_t)(bytes - sizeof(uint64_t)) / sizeof(T) : 0;
+        if (!Map(std::max(rows, OCCUPANCY_INITIAL_ROWS))) {
+            Close();
+            return false;
+        }
+        if (*count_ > capacity_) *count_ = capacity_; // Header written but the file cut short
+        return true;
+    }
+
+    void Close() {
+#ifdef _WIN32
+        if (base_) UnmapViewOfFile(base_);
+        if (mapping_) CloseHandle(mapping_);
+        if (file_) CloseHandle(file_);
+        mapping_ = NULL;
+        file_ = NULL;
+#else
+        if (base_) munmap(base_, MappedBytes(capacity_));
+        if (fd_ >= 0) close(fd_);
+        fd_ = -1;
+#endif
+        base_ = nullptr;
+        count_ = nullptr;
+        data_ = nullptr;
+        capacity_ = 0;
+    }
+
+    bool IsOpen() const { return base_ != nullptr; }
+    size_t Size() const { return count_ ? (size_t)*count_ : 0; }
+    T& operator[](size_t i) { return data_[i]; }
+    const T& operator[](size_t i) const { return data_[i]; }
+    T& Back() { return data_[Size() - 1]; }
+
+    bool Push(const T& value) {
+        size_t n = Size();
+        if (n >= capacity_ && !Map(capacity_ * 2)) return false;
+        data_[n] = value;
+        *count_ = n + 1;
+        return true;
+    }
+
+    // Drops rows past n (columns of one table are cut to a common length after a crash)
+    void Truncate(size_t n) {
+        if (count_ && n < *count_) *count_ = n;
+    }
+
+private:
+#ifdef _WIN32
+    HANDLE file_ = NULL;
+    HANDLE mapping_ = NULL;
+#else
+    int fd_ = -1;
+#endif
+    void* base_ = nullptr;
+    uint64_t* count_ = nullptr;
+    T* data_ = nullptr;
+    size_t capacity_ = 0;
+
+    static size_t MappedBytes(size_t rows) { return sizeof(uint64_t) + rows * sizeof(T); }
+
+    // (Re)maps the file with room for `rows` rows, growing the file as needed. The new view is set
+    // up before the old one is released, so on failure the column keeps its current rows and capacity.
+    // The disk space is reserved up front: a page of a sparse file that can't be allocated later
+    // would fault on the store instead of failing here.
+    bool Map(size_t rows) {
+        size_t bytes = MappedBytes(rows);
+#ifdef _WIN32
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file_, &size)) return false;
+        if (!base_ && (unsigned long long)size.QuadPart < bytes) {
+            // SetEndOfFile is refused while a view is open; a growing mapping extends (and allocates) it instead
+            LARGE_INTEGER end;
+            end.QuadPart = (LONGLONG)bytes;
+            if (!SetFilePointerEx(file_, end, NULL, FILE_BEGIN) || !SetEndOfFile(file_)) return false;
+        }
+        HANDLE mapping = CreateFileMappingA(file_, NULL, PAGE_READWRITE, (DWORD)((unsigned long long)bytes >> 32), (DWORD)(bytes & 0xFFFFFFFF), NULL);
+        if (!mapping) return false;
+        void* view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, bytes);
+        if (!view) {
+            CloseHandle(mapping);
+            return false;
+        }
+        if (base_) UnmapViewOfFile(base_);
+        if (mapping_) CloseHandle(mapping_);
+        mapping_ = mapping;
+        base_ = view;
+#else
+        struct stat sb;
+        if (fstat(fd_, &sb) != 0) return false;
+        if ((size_t)sb.st_size < bytes && posix_fallocate(fd_, 0, (off_t)bytes) != 0) return false;
+        void* view = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if (view == MAP_FAILED) return false;
+        if (base_) munmap(base_, MappedBytes(capacity_));
+        base_ = view;
+#endif
+        count_ = (uint64_t*)base_;
+        data_ = (T*)((char*)base_ + sizeof(uint64_t));
+        capacity_ = rows;
+        return true;
+    }
+};
+
+// One point of an occupancy curve. For a camera: mean / min / max occupied slots over the step.
+// For a single slot: mean is the fraction of the step it was occupied (0..1).
+struct OccupancyPoint {
+    long long tMs = 0;   // Step start
+    double mean = 0.0;
+    int minOccupied = 0;
+    int maxOccupied = 0;
+    int slots = 0;
+    long long coveredMs = 0; // How much of the step had data
+};
+
+class CameraOccupancy {
+public:
+    // `create` = false opens an existing store only (queries for cameras that never ran)
+    bool Open(const std::string& dir, bool create) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (create) {
+            CreateDirectoryA(dir.c_str(), NULL);
+            for (const char* table : { "transitions", "minute", "hour" }) CreateDirectoryA((dir + "\\" + table).c_str(), NULL);
+        }
+        std::string tr = dir + "\\transitions\\";
+        bool ok = tr_.t.Open(tr + "t_ms.i64", create) && tr_.slot.Open(tr + "slot.i32", create) &&
+                  tr_.status.Open(tr + "status.u8", create) && tr_.occupied.Open(tr + "occupied.u16", create) &&
+                  tr_.prev.Open(tr + "prev.i32", create) &&
+                  OpenRollup(minute_, dir + "\\minute\\", create) && OpenRollup(hour_, dir + "\\hour\\", create);
+        if (!ok) return false;
+
+        size_t rows = std::min({ tr_.t.Size(), tr_.slot.Size(), tr_.status.Size(), tr_.occupied.Size(), tr_.prev.Size() });
+        tr_.t.Truncate(rows);
+        tr_.slot.Truncate(rows);
+        tr_.status.Truncate(rows);
+        tr_.occupied.Truncate(rows);
+        tr_.prev.Truncate(rows);
+        TruncateRollup(minute_);
+        TruncateRollup(hour_);
+
+        // Each slot's latest change: the state carried into the first Update() and the head of its chain
+        for (size_t i = rows; i-- > 0;) {
+            int slot = tr_.slot[i];
+            if (lastRow_.count(slot)) continue;
+            lastRow_[slot] = (int32_t)i;
+            if (tr_.status[i] != (uint8_t)SlotStatus::EMPTY) occupied_++;
+        }
+        return true;
+    }
+
+    // Called once per processed frame with the slot states it produced
+    void Update(long long nowMs, const std::map<int, SlotStatus>& statuses) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (lastMs_ > 0 && nowMs > lastMs_ && nowMs - lastMs_ <= OCCUPANCY_MAX_GAP_MS) {
+            Integrate(minute_, 60 * 1000LL, lastMs_, nowMs);
+            Integrate(hour_, 3600 * 1000LL, lastMs_, nowMs);
+        }
+        lastMs_ = nowMs;
+        slots_ = (int)statuses.size();
+
+        for (const auto& entry : statuses) RecordState(nowMs, entry.first, entry.second);
+        // Slots removed from the template end empty
+        std::vector<int> removed;
+        for (const auto& last : lastRow_) {
+            if (!statuses.count(last.first) && tr_.status[last.second] != (uint8_t)SlotStatus::EMPTY) removed.push_back(last.first);
+        }
+        for (int slot : removed) RecordState(nowMs, slot, SlotStatus::EMPTY);
+    }
+
+    // Curve over [fromMs, toMs) in steps of stepMs, for the whole camera (slotId < 0) or one slot.
+    // Empty for ranges before the epoch or over OCCUPANCY_MAX_SPAN_MS; the step is widened to stay
+    // within OCCUPANCY_MAX_POINTS.
+    // `source` reports what answered it: "hour" / "minute" rollups or raw "transitions".
+    void Curve(long long fromMs, long long toMs, long long stepMs, int slotId,
+               std::vector<OccupancyPoint>& out, std::string& source) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // Bounding the range keeps every fromMs + i * stepMs below in range
+        if (toMs <= fromMs || stepMs <= 0 || fromMs < 0 || toMs > LLONG_MAX - OCCUPANCY_MAX_SPAN_MS) return;
+        unsigned long long span = (unsigned long long)(toMs - fromMs);
+        if (span > (unsigned long long)OCCUPANCY_MAX_SPAN_MS) return;
+        // At most OCCUPANCY_MAX_POINTS steps; a step longer than the range is one point either way
+        unsigned long long minStep = (span + OCCUPANCY_MAX_POINTS - 1) / OCCUPANCY_MAX_POINTS;
+        unsigned long long step = std::min(std::max((unsigned long long)stepMs, minStep), span);
+        stepMs = (long long)step;
+        size_t steps = (size_t)((span + step - 1) / step);
+        out.resize(steps);
+        for (size_t i = 0; i < steps; i++) {
+            out[i].tMs = fromMs + (long long)i * stepMs;
+            out[i].minOccupied = INT_MAX;
+        }
+
+        if (slotId >= 0) {
+            source = "transitions";
+            SlotCurve(fromMs, toMs, stepMs, slotId, out);
+        } else if (stepMs >= 3600 * 1000LL) {
+            source = "hour";
+            RollupCurve(hour_, fromMs, toMs, stepMs, out);
+        } else if (stepMs >= 60 * 1000LL) {
+            source = "minute";
+            RollupCurve(minute_, fromMs, toMs, stepMs, out);
+        } else {
+            source = "transitions";
+            CameraCurve(fromMs, toMs, stepMs, out);
+        }
+        for (OccupancyPoint& p : out) {
+            if (p.minOccupied == INT_MAX) p.minOccupied = 0;
+        }
+    }
+
+private:
+    struct TransitionTable {
+        MappedColumn<int64_t> t;
+        MappedColumn<int32_t> slot;
+        MappedColumn<uint8_t> status;
+        MappedColumn<uint16_t> occupied;
+        MappedColumn<int32_t> prev; // -1 = first change of the slot
+    };
+    struct RollupTable {
+        MappedColumn<int64_t> t;          // Bucket start
+        MappedColumn<int64_t> occupiedMs; // Integral of the occupied-slot count (slot-ms)
+        MappedColumn<int32_t> coveredMs;
+        MappedColumn<uint16_t> minOccupied;
+        MappedColumn<uint16_t> maxOccupied;
+        MappedColumn<uint16_t> slots;
+        MappedColumn<uint32_t> transitions;
+    };
+
+    std::mutex mutex_;
+    TransitionTable tr_;
+    RollupTable minute_;
+    RollupTable hour_;
+    std::map<int, int32_t> lastRow_; // Slot -> row of its latest change
+    int occupied_ = 0;
+    int slots_ = 0;
+    long long lastMs_ = 0;
+
+    static bool OpenRollup(RollupTable& r, const std::string& dir, bool create) {
+        return r.t.Open(dir + "t_ms.i64", create) && r.occupiedMs.Open(dir + "occupied_ms.i64", create) &&
+               r.coveredMs.Open(dir + "covered_ms.i32", create) && r.minOccupied.Open(dir + "min.u16", create) &&
+               r.maxOccupied.Open(dir + "max.u16", create) && r.slots.Open(dir + "slots.u16", create) &&
+               r.transitions.Open(dir + "transitions.u32", create);
+    }
+
+    static void TruncateRollup(RollupTable& r) {
+        size_t rows = std::min({ r.t.Size(), r.occupiedMs.Size(), r.coveredMs.Size(), r.minOccupied.Size(),
+                                 r.maxOccupied.Size(), r.slots.Size(), r.transitions.Size() });
+        r.t.Truncate(rows);
+        r.occupiedMs.Truncate(rows);
+        r.coveredMs.Truncate(rows);
+        r.minOccupied.Truncate(rows);
+        r.maxOccupied.Truncate(rows);
+        r.slots.Truncate(rows);
+        r.transitions.Truncate(rows);
+    }
+
+    // Row of the bucket holding tMs, appended when time has moved past the last one.
+    // A clock step back keeps using the last row rather than reopening an old bucket.
+    // False when a new row could not be written (disk full); no column is left longer than the others.
+    bool Bucket(RollupTable& r, long long bucketMs, long long tMs, size_t& row) {
+        long long start = tMs - ((tMs % bucketMs) + bucketMs) % bucketMs;
+        if (r.t.Size() == 0 || start > r.t.Back()) {
+            size_t rows = r.t.Size();
+            bool ok = r.t.Push(start) && r.occupiedMs.Push(0) && r.coveredMs.Push(0) &&
+                      r.minOccupied.Push((uint16_t)occupied_) && r.maxOccupied.Push((uint16_t)occupied_) &&
+                      r.slots.Push((uint16_t)slots_) && r.transitions.Push(0);
+            if (!ok) {
+                r.t.Truncate(rows);
+                TruncateRollup(r);
+                return false;
+            }
+        }
+        row = r.t.Size() - 1;
+        return true;
+    }
+
+    // Adds (fromMs, toMs] at the current occupied count, split at bucket boundaries
+    void Integrate(RollupTable& r, long long bucketMs, long long fromMs, long long toMs) {
+        long long t = fromMs;
+        while (t < toMs) {
+            size_t row;
+            if (!Bucket(r, bucketMs, t, row)) return;
+            if (t < r.t[row]) { // Clock stepped back: time before the last bucket is not counted again
+                t = std::min(toMs, (long long)r.t[row]);
+                continue;
+            }
+            long long end = std::min(toMs, r.t[row] + bucketMs);
+            r.occupiedMs[row] += (int64_t)occupied_ * (end - t);
+            r.coveredMs[row] += (int32_t)(end - t);
+            r.minOccupied[row] = (uint16_t)std::min<int>(r.minOccupied[row], occupied_);
+            r.maxOccupied[row] = (uint16_t)std::max<int>(r.maxOccupied[row], occupied_);
+            r.slots[row] = (uint16_t)slots_;
+            t = end;
+        }
+    }
+
+    void RecordState(long long nowMs, int slot, SlotStatus status) {
+        auto last = lastRow_.find(slot);
+        bool wasOccupied = last != lastRow_.end() && tr_.status[last->second] != (uint8_t)SlotStatus::EMPTY;
+        bool isOccupied = status != SlotStatus::EMPTY;
+        if (last != lastRow_.end() && tr_.status[last->second] == (uint8_t)status) return;
+        int occupied = occupied_ + (isOccupied ? 1 : 0) - (wasOccupied ? 1 : 0);
+
+        // The in-memory state only moves once the whole row is on the map, so a failed write is
+        // retried by the next frame instead of leaving the count out of step with the table
+        size_t row = tr_.t.Size();
+        bool ok = tr_.t.Push(nowMs) && tr_.slot.Push(slot) && tr_.status.Push((uint8_t)status) &&
+                  tr_.occupied.Push((uint16_t)occupied) && tr_.prev.Push(last != lastRow_.end() ? last->second : -1);
+        if (!ok) {
+            tr_.t.Truncate(row);
+            tr_.slot.Truncate(row);
+            tr_.status.Truncate(row);
+            tr_.occupied.Truncate(row);
+            tr_.prev.Truncate(row);
+            return;
+        }
+        occupied_ = occupied;
+        lastRow_[slot] = (int32_t)row;
+
+        if (wasOccupied == isOccupied) return; // e.g. OCCUPIED_OK -> OCCUPIED_GOOD: same count
+        for (RollupTable* r : { &minute_, &hour_ }) {
+            size_t b;
+            if (!Bucket(*r, r == &minute_ ? 60 * 1000LL : 3600 * 1000LL, nowMs, b)) continue;
+            r->transitions[b]++;
+            r->minOccupied[b] = (uint16_t)std::min<int>(r->minOccupied[b], occupied_);
+            r->maxOccupied[b] = (uint16_t)std::max<int>(r->maxOccupied[b], occupied_);
+        }
+    }
+
+    // Adds a constant `value` held over [a, b) to the steps it overlaps
+    static void Spread(std::vector<OccupancyPoint>& out, long long fromMs, long long stepMs,
+                       long long a, long long b, double value, int count, int slots) {
+        a = std::max(a, fromMs);
+        long long end = fromMs + (long long)out.size() * stepMs;
+        b = std::min(b, end);
+        while (a < b) {
+            size_t i = (size_t)((a - fromMs) / stepMs);
+            long long stepEnd = std::min(b, out[i].tMs + stepMs);
+            OccupancyPoint& p = out[i];
+            p.mean += value * (double)(stepEnd - a); // Normalized by coveredMs at the end
+            p.coveredMs += stepEnd - a;
+            p.minOccupied = std::min(p.minOccupied, count);
+            p.maxOccupied = std::max(p.maxOccupied, count);
+            p.slots = slots;
+            a = stepEnd;
+        }
+    }
+
+    static void Normalize(std::vector<OccupancyPoint>& out) {
+        for (OccupancyPoint& p : out) {
+            if (p.coveredMs > 0) p.mean /= (double)p.coveredMs;
+        }
+    }
+
+    // First row whose time is >= tMs
+    static size_t LowerBound(const MappedColumn<int64_t>& t, long long tMs) {
+        size_t lo = 0, hi = t.Size();
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (t[mid] < tMs) lo = mid + 1; else hi = mid;
+        }
+        return lo;
+    }
+
+    // Rollup rows are attributed to the step their bucket starts in
+    void RollupCurve(RollupTable& r, long long fromMs, long long toMs, long long stepMs, std::vector<OccupancyPoint>& out) {
+        for (size_t row = LowerBound(r.t, fromMs); row < r.t.Size() && r.t[row] < toMs; row++) {
+            if (r.coveredMs[row] <= 0) continue;
+            OccupancyPoint& p = out[(size_t)((r.t[row] - fromMs) / stepMs)];
+            p.mean += (double)r.occupiedMs[row];
+            p.coveredMs += r.coveredMs[row];
+            p.minOccupied = std::min<int>(p.minOccupied, r.minOccupied[row]);
+            p.maxOccupied = std::max<int>(p.maxOccupied, r.maxOccupied[row]);
+            p.slots = r.slots[row];
+        }
+        Normalize(out);
+    }
+
+    // Camera curve from raw transitions (steps under a minute); data is assumed continuous up to the last update
+    void CameraCurve(long long fromMs, long long toMs, long long stepMs, std::vector<OccupancyPoint>& out) {
+        long long end = std::min(toMs, lastMs_);
+        size_t row = LowerBound(tr_.t, fromMs);
+        int count = row > 0 ? tr_.occupied[row - 1] : 0;
+        long long t = fromMs;
+        if (row == 0 && tr_.t.Size() > 0) t = std::max(t, (long long)tr_.t[0]); // Nothing recorded before the first change
+        for (; row < tr_.t.Size() && tr_.t[row] < end; row++) {
+            Spread(out, fromMs, stepMs, t, tr_.t[row], count, count, slots_);
+            t = std::max(t, (long long)tr_.t[row]);
+            count = tr_.occupied[row];
+        }
+        if (tr_.t.Size() > 0) Spread(out, fromMs, stepMs, t, end, count, count, slots_);
+        Normalize(out);
+    }
+
+    // Walks the slot's chain of changes back from its latest one
+    void SlotCurve(long long fromMs, long long toMs, long long stepMs, int slotId, std::vector<OccupancyPoint>& out) {
+        auto last = lastRow_.find(slotId);
+        if (last == lastRow_.end()) return;
+        std::vector<int32_t> rows; // Changes inside the range, newest first, plus the one before it
+        for (int32_t row = last->second; row >= 0; row = tr_.prev[row]) {
+            if (tr_.t[row] >= toMs) continue;
+            rows.push_back(row);
+            if (tr_.t[row] < fromMs) break;
+        }
+        long long end = std::min(toMs, lastMs_);
+        for (size_t i = 0; i < rows.size(); i++) {
+            long long a = tr_.t[rows[i]];
+            long long b = i == 0 ? end : (long long)tr_.t[rows[i - 1]];
+            int occupied = tr_.status[rows[i]] != (uint8_t)SlotStatus::EMPTY ? 1 : 0;
+            Spread(out, fromMs, stepMs, a, b, occupied, occupied, 1);
+        }
+        Normalize(out);
+    }
+};
+
+// Process-wide set of per-camera stores, opened on first use
+class OccupancyStore {
+public:
+    void Update(int cameraId, long long nowMs, const std::map<int, SlotStatus>& statuses) {
+        CameraOccupancy* cam = Get(cameraId, true);
+        if (cam) cam->Update(nowMs, statuses);
+    }
+
+    // False when the camera has no store on disk
+    bool Curve(int cameraId, long long fromMs, long long toMs, long long stepMs, int slotId,
+               std::vector<OccupancyPoint>& out, std::string& source) {
+        CameraOccupancy* cam = Get(cameraId, false);
+        if (!cam) return false;
+        cam->Curve(fromMs, toMs, stepMs, slotId, out, source);
+        return true;
+    }
+
+    static std::string CameraDir(int cameraId) {
+        return "C:\\loc_occupancy\\camera_" + std::to_string(cameraId);
+    }
+
+private:
+    std::mutex mutex_;
+    std::map<int, std::unique_ptr<CameraOccupancy>> cameras_;
+
+    CameraOccupancy* Get(int cameraId, bool create) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = cameras_.find(cameraId);
+        if (it != cameras_.end()) return it->second.get();
+        std::unique_ptr<CameraOccupancy> cam(new CameraOccupancy());
+        if (!cam->Open(CameraDir(cameraId), create)) {
+            if (create) OutputDebugStringA(("[OCCUPANCY] Cannot open store " + CameraDir(cameraId) + "\n").c_str());
+            return nullptr;
+        }
+        CameraOccupancy* raw = cam.get();
+        cameras_[cameraId] = std::move(cam);
+        return raw;
+    }
+};
+
+PLATFORM_SELECTANY OccupancyStore g_occupancy;
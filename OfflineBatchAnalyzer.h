@@ -0,0 +1,630 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <opencv2/dnn.hpp>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include "Platform.h"
+#include "BYTETracker.h"
+#include "ParkingSlot.h"
+#include "OnnxYoloInference.h"
+#include "DetectionCache.h"
+#include "json.hpp"
+
+// ==========================================
+//  [TURBO] Unpaced batch analysis of a recorded video
+// ==========================================
+// Playback mode paces reads to the file's FPS and drops whatever the AI thread can't keep up with.
+// This mode runs three stages back to back on every frame (or every k-th frame):
+//   decode + letterbox  ->  inference + NMS  ->  tracking + parking logic + logs
+// Bounded queues between the stages keep all three busy without ever dropping a frame, so the run
+// is deterministic and as fast as the slowest stage. Frame-count thresholds are in video frames
+// and scaled by the stride, so a stride only changes how often the scene is sampled.
+
+const int BATCH_QUEUE_DEPTH = 4;                  // Letterboxed blobs waiting for inference (~5 MB each)
+const int BATCH_WRONG_SLOT_STILL_FRAMES = 30;     // Same rules as playback mode, in video frames
+const int BATCH_OVERSTAY_STILL_FRAMES = 300;
+const int BATCH_TRACKER_MAX_LOST_FRAMES = 90;
+
+struct BatchAnalysisOptions {
+    std::string videoPath;
+    std::string modelPath = "models/test/yolo26s.onnx";
+    std::string templatePath;  // Empty = detection/tracking only, no occupancy log
+    std::string outputDir;     // Empty = C:\smart_parking_offline\<video>_<timestamp>
+    int stride = 1;            // Analyze every k-th frame (1 = all), counted from frame 0 of the file
+    int gpuId = 0;
+    bool useGpu = true;
+    int inputSize = 640;
+    float confThreshold = 0.25f;
+    float nmsThreshold = 0.45f;
+    bool useDetectionCache = true; // Replay cached detections of an earlier run, store this run's otherwise
+
+    // Segment runs (OfflineJobRunner): analyze frames [startFrame, endFrame) only, endFrame < 0 = to the end
+    long long startFrame = 0;
+    long long endFrame = -1;
+    long long anchorFrame = -1;  // Remember every track's box at this frame for stitching
+    double timeOffsetSec = 0;    // Added to video timestamps (position of this file in a DVR series)
+    std::string sourceName;      // Written with each record when non-empty
+};
+
+// Log records. Frames are indices in the source file; times are seconds from the start of the job.
+struct BatchEvent {
+    long long frame = 0;
+    double videoTimeSec = 0;
+    std::string source;
+    std::string type;        // "Overstay" or "Wrong Slot", same names as playback mode
+    int carId = -1;
+    int classId = -1;
+    cv::Rect bbox;
+};
+
+struct BatchOccupancyChange {
+    long long frame = 0;
+    double videoTimeSec = 0;
+    std::string source;
+    int slotId = -1;
+    SlotStatus status = SlotStatus::EMPTY;
+    float occupancy = 0;
+    int trackId = -1;
+};
+
+// First/last sighting of a track, kept for stitching IDs across segments
+struct BatchTrackSpan {
+    int classId = -1;
+    long long firstFrame = -1;
+    long long lastFrame = -1;
+    cv::Rect firstBox, lastBox, anchorBox;
+};
+
+struct BatchSink {
+    std::function<void(const BatchEvent&)> onEvent;
+    std::function<void(const BatchOccupancyChange&)> onOccupancy;
+};
+
+inline const char* BatchSlotStatusName(SlotStatus status) {
+    switch (status) {
+    case SlotStatus::EMPTY: return "EMPTY";
+    case SlotStatus::OCCUPIED_GOOD: return "OCCUPIED_GOOD";
+    case SlotStatus::OCCUPIED_OK: return "OCCUPIED_OK";
+    case SlotStatus::OCCUPIED_BAD: return "OCCUPIED_BAD";
+    case SlotStatus::ILLEGAL: return "ILLEGAL";
+    }
+    return "UNKNOWN";
+}
+
+inline std::string FormatBatchVideoTime(double seconds) {
+    long long ms = (long long)(seconds * 1000.0 + 0.5);
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%02lld:%02lld:%02lld.%03lld", ms / 3600000, (ms / 60000) % 60, (ms / 1000) % 60, ms % 1000);
+    return buf;
+}
+
+inline std::string BatchEventJson(const BatchEvent& ev) {
+    nlohmann::json line = {
+        {"frame", ev.frame}, {"video_time_s", ev.videoTimeSec}, {"time", FormatBatchVideoTime(ev.videoTimeSec)},
+        {"type", ev.type}, {"car_id", ev.carId}, {"class_id", ev.classId},
+        {"bbox", { ev.bbox.x, ev.bbox.y, ev.bbox.width, ev.bbox.height }}
+    };
+    if (!ev.source.empty()) line["source"] = ev.source;
+    return line.dump();
+}
+
+inline std::string BatchOccupancyJson(const BatchOccupancyChange& ch) {
+    nlohmann::json line = {
+        {"frame", ch.frame}, {"video_time_s", ch.videoTimeSec}, {"time", FormatBatchVideoTime(ch.videoTimeSec)},
+        {"slot_id", ch.slotId}, {"status", BatchSlotStatusName(ch.status)},
+        {"occupancy", ch.occupancy}, {"track_id", ch.trackId}
+    };
+    if (!ch.source.empty()) line["source"] = ch.source;
+    return line.dump();
+}
+
+struct BatchAnalysisReport {
+    bool ok = false;
+    std::string error;
+    std::string outputDir;
+    double videoFps = 0;
+    long long framesTotal = 0;     // From the container, may be an estimate
+    long long framesDecoded = 0;
+    long long framesAnalyzed = 0;
+    long long events = 0;
+    long long occupancyChanges = 0;
+    double wallSeconds = 0;
+    double decodeBusySeconds = 0;
+    double inferenceBusySeconds = 0;
+    double trackingBusySeconds = 0;
+    bool cancelled = false;
+    bool fromCache = false;        // Detections were replayed; framesDecoded then counts frames covered
+
+    double DecodedFps() const { return wallSeconds > 0 ? framesDecoded / wallSeconds : 0; }
+    double AnalyzedFps() const { return wallSeconds > 0 ? framesAnalyzed / wallSeconds : 0; }
+    double RealtimeFactor() const { return (wallSeconds > 0 && videoFps > 0) ? (framesDecoded / videoFps) / wallSeconds : 0; }
+
+    const char* Bottleneck() const {
+        if (inferenceBusySeconds >= decodeBusySeconds && inferenceBusySeconds >= trackingBusySeconds) return "inference";
+        return decodeBusySeconds >= trackingBusySeconds ? "decode" : "tracking";
+    }
+
+    std::string ToJson() const {
+        nlohmann::json j;
+        j["ok"] = ok;
+        if (!error.empty()) j["error"] = error;
+        j["cancelled"] = cancelled;
+        j["detections_from_cache"] = fromCache;
+        j["output_dir"] = outputDir;
+        j["video_fps"] = videoFps;
+        j["frames_total"] = framesTotal;
+        j["frames_decoded"] = framesDecoded;
+        j["frames_analyzed"] = framesAnalyzed;
+        j["events"] = events;
+        j["occupancy_changes"] = occupancyChanges;
+        j["wall_s"] = wallSeconds;
+        j["decoded_fps"] = DecodedFps();
+        j["analyzed_fps"] = AnalyzedFps();
+        j["realtime_factor"] = RealtimeFactor();
+        j["busy_s"] = { {"decode", decodeBusySeconds}, {"inference", inferenceBusySeconds}, {"tracking", trackingBusySeconds} };
+        j["bottleneck"] = Bottleneck();
+        return j.dump(2);
+    }
+};
+
+// Blocking FIFO with a fixed capacity; Close() wakes everyone and lets Pop drain what is left
+template <typename T>
+class BatchQueue {
+public:
+    explicit BatchQueue(size_t capacity) : capacity_(capacity) {}
+
+    bool Push(T item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notFull_.wait(lock, [&]() { return closed_ || items_.size() < capacity_; });
+        if (closed_) return false;
+        items_.push_back(std::move(item));
+        notEmpty_.notify_one();
+        return true;
+    }
+
+    bool Pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notEmpty_.wait(lock, [&]() { return closed_ || !items_.empty(); });
+        if (items_.empty()) return false;
+        item = std::move(items_.front());
+        items_.pop_front();
+        notFull_.notify_one();
+        return true;
+    }
+
+    void Close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        notEmpty_.notify_all();
+        notFull_.notify_all();
+    }
+
+private:
+    size_t capacity_;
+    std::deque<T> items_;
+    bool closed_ = false;
+    std::mutex mutex_;
+    std::condition_variable notEmpty_;
+    std::condition_variable notFull_;
+};
+
+class OfflineBatchAnalyzer {
+public:
+    // Progress, readable from any thread while Run() is busy
+    std::atomic<long long> framesDecoded{ 0 };
+    std::atomic<long long> framesAnalyzed{ 0 };
+    std::atomic<long long> framesTotal{ 0 };
+
+    void Cancel() { cancel_ = true; }
+
+    // An analyzer is single-use: one Run() or Analyze() per instance.
+    // Run() analyzes the whole video and writes events.jsonl, occupancy.jsonl and report.json.
+    BatchAnalysisReport Run(const BatchAnalysisOptions& options) {
+        BatchAnalysisReport report;
+        std::string outputDir = options.outputDir.empty() ? DefaultOutputDir(options.videoPath) : options.outputDir;
+        CreateDirectoryA(outputDir.c_str(), NULL);
+        std::ofstream eventsFile(PlatformPath(outputDir + "\\events.jsonl"));
+        std::ofstream occupancyFile(PlatformPath(outputDir + "\\occupancy.jsonl"));
+        if (!eventsFile.is_open() || !occupancyFile.is_open()) {
+            report.error = "Cannot write to " + outputDir;
+            return report;
+        }
+
+        BatchSink sink;
+        sink.onEvent = [&](const BatchEvent& ev) { eventsFile << BatchEventJson(ev) << "\n"; };
+        sink.onOccupancy = [&](const BatchOccupancyChange& ch) { occupancyFile << BatchOccupancyJson(ch) << "\n"; };
+        report = Analyze(options, sink);
+        report.outputDir = outputDir;
+
+        std::ofstream reportFile(PlatformPath(outputDir + "\\report.json"));
+        reportFile << report.ToJson() << "\n";
+        return report;
+    }
+
+    // Blocks until the frame range is analyzed (or Cancel() is called); records go to `sink`.
+    // `sharedModel` is a session reused across runs (loaded on first need); null = one for this run.
+    BatchAnalysisReport Analyze(const BatchAnalysisOptions& options, const BatchSink& sink, std::map<int, BatchTrackSpan>* tracks = nullptr,
+                                OnnxYoloInference* sharedModel = nullptr) {
+        BatchAnalysisReport report;
+        opts_ = options;
+        if (opts_.stride < 1) opts_.stride = 1;
+        if (opts_.startFrame < 0) opts_.startFrame = 0;
+
+        cv::VideoCapture cap(PlatformPath(opts_.videoPath), cv::CAP_FFMPEG);
+        if (!cap.isOpened()) cap.open(PlatformPath(opts_.videoPath));
+        if (!cap.isOpened()) {
+            report.error = "Cannot open video: " + opts_.videoPath;
+            return report;
+        }
+        report.videoFps = cap.get(cv::CAP_PROP_FPS);
+        if (report.videoFps <= 0 || report.videoFps > 240) report.videoFps = 30.0;
+        long long fileFrames = (long long)cap.get(cv::CAP_PROP_FRAME_COUNT);
+        long long lastFrame = (opts_.endFrame >= 0 && (fileFrames <= 0 || opts_.endFrame < fileFrames)) ? opts_.endFrame : fileFrames;
+        framesTotal = lastFrame > opts_.startFrame ? lastFrame - opts_.startFrame : 0;
+        report.framesTotal = framesTotal.load();
+        if (opts_.startFrame > 0) cap.set(cv::CAP_PROP_POS_FRAMES, (double)opts_.startFrame);
+
+        // [DET CACHE] Same video, model and thresholds as an earlier run: no decode, no inference
+        std::string cacheDir = opts_.useDetectionCache
+            ? DetectionCacheDir(opts_.videoPath, opts_.modelPath, opts_.inputSize, opts_.confThreshold, opts_.nmsThreshold) : "";
+        DetectionCacheReader cached;
+        DetectionCacheWriter cacheWriter;
+        report.fromCache = cached.Open(cacheDir, opts_.startFrame, opts_.endFrame, opts_.stride);
+
+        OnnxYoloInference ownModel;
+        OnnxYoloInference& model = sharedModel ? *sharedModel : ownModel;
+        if (!report.fromCache && !model.isLoaded() && !model.loadModel(opts_.modelPath, opts_.useGpu, opts_.gpuId)) {
+            report.error = "Cannot load model: " + opts_.modelPath;
+            return report;
+        }
+
+        parking_.reset();
+        if (!opts_.templatePath.empty()) {
+            parking_.reset(new ParkingManager());
+            if (!parking_->loadTemplate(opts_.templatePath)) {
+                report.error = "Cannot load parking template: " + opts_.templatePath;
+                return report;
+            }
+        }
+
+        OutputDebugStringA(("[TURBO] Analyzing " + opts_.videoPath + " from frame " + std::to_string(opts_.startFrame) +
+            " (stride " + std::to_string(opts_.stride) + ")\n").c_str());
+        auto wallStart = std::chrono::steady_clock::now();
+
+        BatchQueue<PreparedFrame> prepared(BATCH_QUEUE_DEPTH);
+        BatchQueue<DetectedFrame> detected(BATCH_QUEUE_DEPTH * 4);
+        std::atomic<long long> decodeBusyUs(0), inferenceBusyUs(0);
+
+        std::thread decoder, inference;
+        if (report.fromCache) {
+            decoder = std::thread([&]() {
+                ReplayStage(cached, detected, decodeBusyUs);
+                detected.Close();
+            });
+        }
+        else {
+            decoder = std::thread([&]() {
+                DecodeStage(cap, prepared, decodeBusyUs);
+                prepared.Close();
+            });
+            inference = std::thread([&]() {
+                InferenceStage(model, prepared, detected, inferenceBusyUs, cacheDir.empty() ? nullptr : &cacheWriter);
+                detected.Close();
+                prepared.Close(); // Unblock the decoder if inference bailed out early
+            });
+        }
+
+        long long trackingBusyUs = TrackingStage(detected, sink, tracks, report);
+        if (cancel_) {
+            prepared.Close();
+            detected.Close();
+        }
+        decoder.join();
+        if (inference.joinable()) inference.join();
+        if (!report.fromCache && !cancel_ && !cacheDir.empty()) {
+            cacheWriter.Commit(cacheDir, opts_.startFrame, decodeEnd_, decodeHitEof_, opts_.stride);
+        }
+
+        report.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+        report.framesDecoded = framesDecoded.load();
+        report.framesAnalyzed = framesAnalyzed.load();
+        report.decodeBusySeconds = decodeBusyUs.load() / 1e6;
+        report.inferenceBusySeconds = inferenceBusyUs.load() / 1e6;
+        report.trackingBusySeconds = trackingBusyUs / 1e6;
+        report.cancelled = cancel_.load();
+        report.ok = !report.cancelled;
+
+        char buf[256];
+        snprintf(buf, sizeof(buf), "[TURBO] %lld frames decoded, %lld analyzed in %.1f s (%.1f FPS analyzed, %.1fx realtime, bottleneck: %s)\n",
+            report.framesDecoded, report.framesAnalyzed, report.wallSeconds, report.AnalyzedFps(), report.RealtimeFactor(), report.Bottleneck());
+        OutputDebugStringA(buf);
+        return report;
+    }
+
+private:
+    struct PreparedFrame {
+        long long index = 0;
+        cv::Size frameSize;
+        cv::Mat blob;
+        float ratio = 1.0f;
+        int dw = 0, dh = 0;
+    };
+
+    struct DetectedFrame {
+        long long index = 0;
+        cv::Size frameSize;
+        std::vector<cv::Rect> boxes;
+        std::vector<int> classIds;
+        std::vector<float> confs;
+    };
+
+    BatchAnalysisOptions opts_;
+    std::atomic<bool> cancel_{ false };
+    long long decodeEnd_ = 0;     // First frame the decoder did not reach
+    bool decodeHitEof_ = false;
+    std::unique_ptr<ParkingManager> parking_;
+
+    static long long ElapsedUs(std::chrono::steady_clock::time_point since) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - since).count();
+    }
+
+    // Skipped frames are only grabbed (no color conversion); the codec still has to decode them
+    void DecodeStage(cv::VideoCapture& cap, BatchQueue<PreparedFrame>& out, std::atomic<long long>& busyUs) {
+        cv::Mat frame, letterboxed;
+        long long index = opts_.startFrame;
+        for (; !cancel_ && (opts_.endFrame < 0 || index < opts_.endFrame); index++) {
+            auto start = std::chrono::steady_clock::now();
+            bool analyze = (index % opts_.stride) == 0;
+            bool ok = analyze ? cap.read(frame) : cap.grab();
+            if (!ok || (analyze && frame.empty())) {
+                decodeHitEof_ = true;
+                break;
+            }
+            framesDecoded++;
+            if (!analyze) {
+                busyUs += ElapsedUs(start);
+                continue;
+            }
+
+            PreparedFrame item;
+            item.index = index;
+            item.frameSize = frame.size();
+            Letterbox(frame, letterboxed, item.ratio, item.dw, item.dh);
+            cv::dnn::blobFromImage(letterboxed, item.blob, 1.0 / 255.0, cv::Size(opts_.inputSize, opts_.inputSize), cv::Scalar(), true, false);
+            busyUs += ElapsedUs(start);
+            if (!out.Push(std::move(item))) break;
+        }
+        decodeEnd_ = index;
+    }
+
+    // Stands in for decode + inference when the detections are cached. framesDecoded follows the
+    // frame position so progress reads the same as a normal run.
+    void ReplayStage(DetectionCacheReader& cache, BatchQueue<DetectedFrame>& out, std::atomic<long long>& busyUs) {
+        for (size_t i = 0; i < cache.FrameCount() && !cancel_; i++) {
+            long long index = cache.FrameIndex(i);
+            if (opts_.endFrame >= 0 && index >= opts_.endFrame) break;
+            if (index < opts_.startFrame || index % opts_.stride != 0) continue;
+
+            auto start = std::chrono::steady_clock::now();
+            DetectedFrame item;
+            item.index = cache.Frame(i, item.boxes, item.classIds, item.confs);
+            item.frameSize = cache.FrameSize();
+            framesDecoded = index - opts_.startFrame + 1;
+            busyUs += ElapsedUs(start);
+            if (!out.Push(std::move(item))) break;
+        }
+    }
+
+    void InferenceStage(OnnxYoloInference& model, BatchQueue<PreparedFrame>& in, BatchQueue<DetectedFrame>& out, std::atomic<long long>& busyUs,
+                        DetectionCacheWriter* cacheWriter) {
+        PreparedFrame item;
+        while (!cancel_ && in.Pop(item)) {
+            auto start = std::chrono::steady_clock::now();
+            DetectedFrame result;
+            result.index = item.index;
+            result.frameSize = item.frameSize;
+
+            std::vector<cv::Mat> outputs;
+            if (model.forward(item.blob, outputs) && !outputs.empty() && !outputs[0].empty()) {
+                std::vector<cv::Rect> boxes;
+                std::vector<int> classIds;
+                std::vector<float> confs;
+                DecodeDetections(outputs[0], item.ratio, item.dw, item.dh, boxes, classIds, confs);
+
+                std::vector<int> keep;
+                cv::dnn::NMSBoxes(boxes, confs, opts_.confThreshold, opts_.nmsThreshold, keep);
+                for (int idx : keep) {
+                    result.boxes.push_back(boxes[idx]);
+                    result.classIds.push_back(classIds[idx]);
+                    result.confs.push_back(confs[idx]);
+                }
+                if (cacheWriter) {
+                    cacheWriter->SetFrameSize(result.frameSize);
+                    cacheWriter->Add(result.index, result.boxes, result.classIds, result.confs);
+                }
+            }
+            else if (cacheWriter) {
+                cacheWriter->Invalidate();
+            }
+            busyUs += ElapsedUs(start);
+            if (!out.Push(std::move(result))) break;
+        }
+    }
+
+    // Runs on the caller's thread. Frames arrive in order: each stage is a single thread.
+    long long TrackingStage(BatchQueue<DetectedFrame>& in, const BatchSink& sink, std::map<int, BatchTrackSpan>* tracks, BatchAnalysisReport& report) {
+        int stride = opts_.stride;
+        int maxLost = std::max(5, BATCH_TRACKER_MAX_LOST_FRAMES / stride);
+        int wrongSlotFrames = std::max(1, BATCH_WRONG_SLOT_STILL_FRAMES / stride);
+        int overstayFrames = std::max(1, BATCH_OVERSTAY_STILL_FRAMES / stride);
+        BYTETracker tracker(maxLost, 0.25f);
+
+        std::map<int, SlotStatus> lastStatus;
+        std::set<std::pair<int, std::string>> reported; // (car id, type), same dedupe as the live modes
+        long long busyUs = 0;
+        bool slotsFitted = false;
+
+        DetectedFrame item;
+        while (!cancel_ && in.Pop(item)) {
+            auto start = std::chrono::steady_clock::now();
+            double videoSec = opts_.timeOffsetSec + item.index / report.videoFps;
+            std::vector<TrackedObject> tracked = tracker.update(item.boxes, item.classIds, item.confs);
+
+            if (tracks) {
+                for (const auto& car : tracked) {
+                    BatchTrackSpan& span = (*tracks)[car.id];
+                    if (span.firstFrame < 0) {
+                        span.firstFrame = item.index;
+                        span.firstBox = car.bbox;
+                        span.classId = car.classId;
+                    }
+                    span.lastFrame = item.index;
+                    span.lastBox = car.bbox;
+                    if (item.index == opts_.anchorFrame) span.anchorBox = car.bbox;
+                }
+            }
+
+            if (parking_) {
+                if (!slotsFitted) {
+                    parking_->fitSlotsToFrame(item.frameSize);
+                    slotsFitted = true;
+                }
+                parking_->updateSlotStatus(tracked);
+                for (const auto& slot : parking_->getSlots()) {
+                    auto it = lastStatus.find(slot.id);
+                    if (it != lastStatus.end() && it->second == slot.status) continue;
+                    lastStatus[slot.id] = slot.status;
+
+                    BatchOccupancyChange ch;
+                    ch.frame = item.index;
+                    ch.videoTimeSec = videoSec;
+                    ch.source = opts_.sourceName;
+                    ch.slotId = slot.id;
+                    ch.status = slot.status;
+                    ch.occupancy = slot.occupancyPercent;
+                    ch.trackId = slot.occupiedByTrackId;
+                    if (sink.onOccupancy) sink.onOccupancy(ch);
+                    report.occupancyChanges++;
+                }
+
+                for (const auto& car : tracked) {
+                    std::string type;
+                    if (car.framesStill > overstayFrames) type = "Overstay";
+                    else if (car.framesStill > wrongSlotFrames && !InAnySlot(car)) type = "Wrong Slot";
+                    if (type.empty() || !reported.insert({ car.id, type }).second) continue;
+
+                    BatchEvent ev;
+                    ev.frame = item.index;
+                    ev.videoTimeSec = videoSec;
+                    ev.source = opts_.sourceName;
+                    ev.type = type;
+                    ev.carId = car.id;
+                    ev.classId = car.classId;
+                    ev.bbox = car.bbox;
+                    if (sink.onEvent) sink.onEvent(ev);
+                    report.events++;
+                }
+            }
+            framesAnalyzed++;
+            busyUs += ElapsedUs(start);
+        }
+        return busyUs;
+    }
+
+    bool InAnySlot(const TrackedObject& car) {
+        cv::Point center = (car.bbox.tl() + car.bbox.br()) * 0.5;
+        for (const auto& slot : parking_->getSlots()) {
+            if (cv::pointPolygonTest(slot.polygon, center, false) >= 0) return true;
+        }
+        return false;
+    }
+
+    void Letterbox(const cv::Mat& source, cv::Mat& destination, float& ratio, int& dw, int& dh) {
+        int size = opts_.inputSize;
+        ratio = std::min((float)size / source.cols, (float)size / source.rows);
+        int newW = (int)std::round(source.cols * ratio);
+        int newH = (int)std::round(source.rows * ratio);
+        dw = (size - newW) / 2;
+        dh = (size - newH) / 2;
+
+        destination.create(size, size, CV_8UC3);
+        destination.setTo(cv::Scalar(114, 114, 114));
+        cv::Mat roi = destination(cv::Rect(dw, dh, newW, newH));
+        cv::resize(source, roi, cv::Size(newW, newH));
+    }
+
+    // Same output handling as ProcessFrame in playback mode (yolo26s end-to-end or YOLOv8 layout)
+    void DecodeDetections(const cv::Mat& output, float ratio, int dw, int dh,
+                          std::vector<cv::Rect>& boxes, std::vector<int>& classIds, std::vector<float>& confs) {
+        cv::Mat data2d = output.reshape(1, output.size[1]);
+        if (data2d.cols > data2d.rows) {
+            cv::Mat transposed;
+            cv::transpose(data2d, transposed);
+            data2d = transposed;
+        }
+
+        int rows = data2d.rows;
+        int dimensions = data2d.cols;
+        const float* data = (const float*)data2d.data;
+        for (int i = 0; i < rows; i++, data += dimensions) {
+            float left, top, width, height, conf;
+            int cls;
+            if (dimensions == 6) {
+                // [x1, y1, x2, y2, conf, class_id] in letterbox pixels
+                conf = data[4];
+                cls = (int)data[5];
+                left = (data[0] - dw) / ratio;
+                top = (data[1] - dh) / ratio;
+                width = (data[2] - data[0]) / ratio;
+                height = (data[3] - data[1]) / ratio;
+            }
+            else if (dimensions > 4) {
+                // [cx, cy, w, h, class scores...]
+                cv::Mat scores(1, dimensions - 4, CV_32FC1, (void*)(data + 4));
+                cv::Point classId;
+                double maxScore;
+                cv::minMaxLoc(scores, 0, &maxScore, 0, &classId);
+                conf = (float)maxScore;
+                cls = classId.x;
+                left = (data[0] - 0.5f * data[2] - dw) / ratio;
+                top = (data[1] - 0.5f * data[3] - dh) / ratio;
+                width = data[2] / ratio;
+                height = data[3] / ratio;
+            }
+            else continue;
+
+            bool isVehicle = (cls == 0 || cls == 1 || cls == 2 || cls == 3 || cls == 5 || cls == 7);
+            if (conf <= opts_.confThreshold || !isVehicle || width <= 0 || height <= 0) continue;
+            boxes.push_back(cv::Rect((int)left, (int)top, (int)width, (int)height));
+            confs.push_back(conf);
+            classIds.push_back(cls);
+        }
+    }
+
+    static std::string DefaultOutputDir(const std::string& videoPath) {
+        size_t slash = videoPath.find_last_of("\\/");
+        std::string name = slash == std::string::npos ? videoPath : videoPath.substr(slash + 1);
+        size_t dot = name.find_last_of('.');
+        if (dot != std::string::npos) name = name.substr(0, dot);
+
+        SYSTEMTIME st;
+        GetLocalTime(&st);
+        char stamp[32];
+        sprintf_s(stamp, "%04d%02d%02d_%02d%02d%02d", st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond);
+        CreateDirectoryA("C:\\smart_parking_offline", NULL);
+        return "C:\\smart_parking_offline\\" + name + "_" + stamp;
+    }
+};
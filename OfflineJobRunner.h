@@ -0,0 +1,399 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Platform.h"
+#include "OfflineBatchAnalyzer.h"
+
+// ==========================================
+//  [JOB] Parallel segment analysis of long recordings / DVR folders
+// ==========================================
+// The input (one video, or a folder of clips such as C:\locvideo\<date>\camera_N) is cut into
+// time segments that run as independent OfflineBatchAnalyzer pipelines on a worker pool. Each worker
+// loads one ONNX session and reuses it for every segment it picks up.
+// Inside one file each segment starts early so its tracker and slot state are warm by the time it
+// owns frames; the warm-up records are discarded. Track IDs are then stitched across
+// boundaries by box IoU (at a shared anchor frame, or last/first sighting between DVR clips) and
+// slot states are carried over, so the merged logs read like one continuous run.
+// All clips of a job must come from the same camera.
+
+const double JOB_STITCH_MIN_IOU = 0.5;
+const double JOB_CLIP_GAP_SECONDS = 2.0; // Between DVR clips: tracks seen this close to the cut are candidates
+const long long JOB_WARMUP_MARGIN_FRAMES = 60; // On top of the Overstay threshold: time for tracks to lock on
+
+struct OfflineJobOptions {
+    std::string inputPath;          // A video file or a folder (searched recursively)
+    std::string outputDir;          // Empty = C:\smart_parking_offline\<name>_<timestamp>
+    BatchAnalysisOptions analysis;  // Model, template, stride, GPU and thresholds for every segment
+    double segmentSeconds = 600;
+    double overlapSeconds = 0;      // Warm-up before each cut; 0 = derived from the Overstay threshold and the file's fps
+    int workers = 0;                // 0 = 2 on GPU (sessions share the device), one per core on CPU
+};
+
+struct OfflineJobReport {
+    bool ok = false;
+    bool cancelled = false;
+    std::string error;
+    std::string outputDir;
+    int sources = 0;
+    int workers = 0;
+    double videoSeconds = 0;
+    double wallSeconds = 0;
+    long long framesDecoded = 0;   // Including overlap warm-up
+    long long framesAnalyzed = 0;
+    long long events = 0;
+    long long occupancyChanges = 0;
+    long long stitchedTracks = 0;
+    std::vector<BatchAnalysisReport> segments;
+
+    double RealtimeFactor() const { return wallSeconds > 0 ? videoSeconds / wallSeconds : 0; }
+
+    std::string ToJson() const {
+        nlohmann::json j;
+        j["ok"] = ok;
+        if (!error.empty()) j["error"] = error;
+        j["cancelled"] = cancelled;
+        j["output_dir"] = outputDir;
+        j["sources"] = sources;
+        j["workers"] = workers;
+        j["video_s"] = videoSeconds;
+        j["wall_s"] = wallSeconds;
+        j["realtime_factor"] = RealtimeFactor();
+        j["frames_decoded"] = framesDecoded;
+        j["frames_analyzed"] = framesAnalyzed;
+        j["analyzed_fps"] = wallSeconds > 0 ? framesAnalyzed / wallSeconds : 0;
+        j["events"] = events;
+        j["occupancy_changes"] = occupancyChanges;
+        j["stitched_tracks"] = stitchedTracks;
+        j["segments"] = nlohmann::json::array();
+        for (const auto& seg : segments) j["segments"].push_back(nlohmann::json::parse(seg.ToJson()));
+        return j.dump(2);
+    }
+};
+
+class OfflineJobRunner {
+public:
+    void Cancel() {
+        cancel_ = true;
+        std::lock_guard<std::mutex> lock(analyzersMutex_);
+        for (auto& a : analyzers_) a->Cancel();
+    }
+
+    // Progress over all segments, valid while Run() is busy
+    long long FramesDecoded() {
+        std::lock_guard<std::mutex> lock(analyzersMutex_);
+        long long n = 0;
+        for (const auto& a : analyzers_) n += a->framesDecoded.load();
+        return n;
+    }
+    long long FramesTotal() const { return framesTotal_.load(); }
+
+    // Single-use, like OfflineBatchAnalyzer. Blocks until every segment is done and the logs are written.
+    OfflineJobReport Run(const OfflineJobOptions& options) {
+        OfflineJobReport report;
+        auto wallStart = std::chrono::steady_clock::now();
+
+        std::vector<std::string> files = CollectVideos(options.inputPath);
+        if (files.empty()) {
+            report.error = "No video found at " + options.inputPath;
+            return report;
+        }
+        report.sources = (int)files.size();
+
+        // ---- Plan the segments ----
+        int stride = std::max(1, options.analysis.stride);
+        double timeOffset = 0;
+        for (size_t f = 0; f < files.size(); f++) {
+            double fps = 30.0;
+            long long frameCount = 0;
+            {
+                cv::VideoCapture probe(PlatformPath(files[f]), cv::CAP_FFMPEG);
+                if (!probe.isOpened()) probe.open(PlatformPath(files[f]));
+                if (!probe.isOpened()) {
+                    OutputDebugStringA(("[JOB] Skipping unreadable clip " + files[f] + "\n").c_str());
+                    continue;
+                }
+                double probedFps = probe.get(cv::CAP_PROP_FPS);
+                if (probedFps > 0 && probedFps <= 240) fps = probedFps;
+                frameCount = (long long)probe.get(cv::CAP_PROP_FRAME_COUNT);
+            }
+
+            long long segFrames = std::max(1LL, (long long)(options.segmentSeconds * fps));
+            // Still-frame thresholds count video frames whatever the stride, so a car has to be seen for
+            // BATCH_OVERSTAY_STILL_FRAMES before the cut to be flagged on time (20 s at 15 fps)
+            long long overlapFrames = options.overlapSeconds > 0 ? (long long)(options.overlapSeconds * fps)
+                : BATCH_OVERSTAY_STILL_FRAMES + JOB_WARMUP_MARGIN_FRAMES;
+            long long segCount = frameCount > 0 ? (frameCount + segFrames - 1) / segFrames : 1;
+            for (long long k = 0; k < segCount; k++) {
+                Segment seg;
+                seg.fileIndex = (int)f;
+                seg.fps = fps;
+                seg.ownedStart = k * segFrames;
+                seg.options = options.analysis;
+                seg.options.videoPath = files[f];
+                seg.options.sourceName = FileName(files[f]);
+                seg.options.timeOffsetSec = timeOffset;
+                seg.options.startFrame = std::max(0LL, seg.ownedStart - overlapFrames);
+                seg.options.endFrame = (k + 1 < segCount) ? (k + 1) * segFrames : -1; // Last one runs to the real end
+                if (k > 0) seg.options.anchorFrame = ((seg.ownedStart - 1) / stride) * stride;
+                segments_.push_back(seg);
+                framesTotal_ += (frameCount > 0 ? std::min(frameCount, (k + 1) * segFrames) : 0) - seg.options.startFrame;
+            }
+            if (frameCount > 0) timeOffset += frameCount / fps;
+        }
+        report.videoSeconds = timeOffset;
+        if (segments_.empty()) {
+            report.error = "No readable video at " + options.inputPath;
+            return report;
+        }
+
+        int workers = options.workers > 0 ? options.workers
+            : (options.analysis.useGpu ? 2 : (int)std::max(1u, std::thread::hardware_concurrency()));
+        workers = std::min(workers, (int)segments_.size());
+        report.workers = workers;
+        {
+            std::lock_guard<std::mutex> lock(analyzersMutex_);
+            for (size_t i = 0; i < segments_.size(); i++) analyzers_.emplace_back(new OfflineBatchAnalyzer());
+            if (cancel_) for (auto& a : analyzers_) a->Cancel();
+        }
+
+        OutputDebugStringA(("[JOB] " + std::to_string(files.size()) + " file(s), " + std::to_string(segments_.size()) +
+            " segment(s) on " + std::to_string(workers) + " worker(s)\n").c_str());
+
+        // ---- Run them on the pool ----
+        std::atomic<size_t> next(0);
+        std::vector<std::thread> pool;
+        for (int w = 0; w < workers; w++) {
+            pool.emplace_back([&]() {
+                OnnxYoloInference model; // Loaded by the first segment that isn't served from the detection cache
+                for (size_t i = next++; i < segments_.size() && !cancel_; i = next++) {
+                    Segment& seg = segments_[i];
+                    BatchSink sink;
+                    sink.onEvent = [&seg](const BatchEvent& ev) { seg.events.push_back(ev); };
+                    sink.onOccupancy = [&seg](const BatchOccupancyChange& ch) { seg.occupancy.push_back(ch); };
+                    seg.report = analyzers_[i]->Analyze(seg.options, sink, &seg.tracks, &model);
+                    seg.done = true;
+                }
+            });
+        }
+        for (auto& t : pool) t.join();
+
+        // ---- Merge ----
+        report.outputDir = options.outputDir.empty() ? DefaultJobOutputDir(options.inputPath) : options.outputDir;
+        CreateDirectoryA(report.outputDir.c_str(), NULL);
+        std::ofstream eventsFile(PlatformPath(report.outputDir + "\\events.jsonl"));
+        std::ofstream occupancyFile(PlatformPath(report.outputDir + "\\occupancy.jsonl"));
+        if (!eventsFile.is_open() || !occupancyFile.is_open()) {
+            report.error = "Cannot write to " + report.outputDir;
+            return report;
+        }
+        Merge(eventsFile, occupancyFile, report);
+
+        for (const auto& seg : segments_) {
+            report.segments.push_back(seg.report);
+            report.framesDecoded += seg.report.framesDecoded;
+            report.framesAnalyzed += seg.report.framesAnalyzed;
+            if (!seg.done || !seg.report.ok) {
+                if (report.error.empty() && !seg.report.error.empty()) report.error = seg.report.error;
+                report.cancelled = report.cancelled || seg.report.cancelled || !seg.done;
+            }
+        }
+        report.cancelled = report.cancelled || cancel_.load();
+        report.ok = !report.cancelled && report.error.empty();
+        report.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+
+        std::ofstream reportFile(PlatformPath(report.outputDir + "\\report.json"));
+        reportFile << report.ToJson() << "\n";
+
+        char buf[256];
+        snprintf(buf, sizeof(buf), "[JOB] %.0f s of video in %.1f s (%.1fx realtime), %lld events, %lld tracks stitched\n",
+            report.videoSeconds, report.wallSeconds, report.RealtimeFactor(), report.events, report.stitchedTracks);
+        OutputDebugStringA(buf);
+        return report;
+    }
+
+private:
+    struct Segment {
+        int fileIndex = 0;
+        double fps = 30.0;
+        long long ownedStart = 0;  // Records before this frame belong to the previous segment
+        BatchAnalysisOptions options;
+        BatchAnalysisReport report;
+        std::vector<BatchEvent> events;
+        std::vector<BatchOccupancyChange> occupancy;
+        std::map<int, BatchTrackSpan> tracks;
+        bool done = false;
+    };
+
+    std::atomic<bool> cancel_{ false };
+    std::atomic<long long> framesTotal_{ 0 };
+    std::vector<Segment> segments_;
+    std::vector<std::unique_ptr<OfflineBatchAnalyzer>> analyzers_; // Filled once before the pool starts
+    std::mutex analyzersMutex_;
+
+    // Walks the segments in time order, rewriting local track IDs to job-wide ones
+    void Merge(std::ofstream& eventsFile, std::ofstream& occupancyFile, OfflineJobReport& report) {
+        int nextGlobalId = 1;
+        std::map<int, int> prevIds;              // Previous segment: local -> global
+        std::map<int, SlotStatus> slotStatus;    // Merged state so far
+        std::set<std::pair<int, std::string>> reported;
+
+        for (size_t i = 0; i < segments_.size(); i++) {
+            Segment& seg = segments_[i];
+            std::map<int, int> ids;
+            if (i > 0 && !prevIds.empty()) {
+                for (const auto& m : MatchTracks(segments_[i - 1], seg)) {
+                    ids[m.second] = prevIds[m.first];
+                    report.stitchedTracks++;
+                }
+            }
+            for (const auto& t : seg.tracks) {
+                if (!ids.count(t.first)) ids[t.first] = nextGlobalId++;
+            }
+            auto globalId = [&ids](int local) {
+                auto it = ids.find(local);
+                return it != ids.end() ? it->second : local;
+            };
+
+            // Slot state at the cut: the last warm-up status wins if it differs from what we have
+            std::map<int, BatchOccupancyChange> warm;
+            for (const auto& ch : seg.occupancy) {
+                if (ch.frame < seg.ownedStart) warm[ch.slotId] = ch;
+            }
+            for (auto& w : warm) {
+                BatchOccupancyChange ch = w.second;
+                ch.frame = seg.ownedStart;
+                ch.videoTimeSec = seg.options.timeOffsetSec + seg.ownedStart / seg.fps;
+                EmitOccupancy(ch, globalId, slotStatus, occupancyFile, report);
+            }
+            for (const auto& ch : seg.occupancy) {
+                if (ch.frame >= seg.ownedStart) EmitOccupancy(ch, globalId, slotStatus, occupancyFile, report);
+            }
+
+            for (BatchEvent ev : seg.events) {
+                if (ev.frame < seg.ownedStart) continue;
+                ev.carId = globalId(ev.carId);
+                if (!reported.insert({ ev.carId, ev.type }).second) continue; // Already raised before the cut
+                eventsFile << BatchEventJson(ev) << "\n";
+                report.events++;
+            }
+            prevIds = ids;
+        }
+    }
+
+    template <typename IdMap>
+    static void EmitOccupancy(BatchOccupancyChange ch, const IdMap& globalId, std::map<int, SlotStatus>& slotStatus,
+                              std::ofstream& out, OfflineJobReport& report) {
+        auto it = slotStatus.find(ch.slotId);
+        if (it != slotStatus.end() && it->second == ch.status) return;
+        slotStatus[ch.slotId] = ch.status;
+        if (ch.trackId >= 0) ch.trackId = globalId(ch.trackId);
+        out << BatchOccupancyJson(ch) << "\n";
+        report.occupancyChanges++;
+    }
+
+    // Pairs (previous local id, current local id), greedy by IoU
+    static std::vector<std::pair<int, int>> MatchTracks(const Segment& prev, const Segment& cur) {
+        std::vector<std::pair<int, cv::Rect>> a, b;
+        if (prev.fileIndex == cur.fileIndex) {
+            // Same file: both segments analyzed the anchor frame
+            for (const auto& t : prev.tracks) {
+                if (t.second.lastFrame == cur.options.anchorFrame) a.push_back({ t.first, t.second.lastBox });
+            }
+            for (const auto& t : cur.tracks) {
+                if (t.second.anchorBox.area() > 0) b.push_back({ t.first, t.second.anchorBox });
+            }
+        }
+        else {
+            // Consecutive DVR clips: last sighting before the cut vs first sighting after it
+            long long prevEnd = 0;
+            for (const auto& t : prev.tracks) prevEnd = std::max(prevEnd, t.second.lastFrame);
+            long long prevGap = (long long)(JOB_CLIP_GAP_SECONDS * prev.fps);
+            long long curGap = (long long)(JOB_CLIP_GAP_SECONDS * cur.fps);
+            for (const auto& t : prev.tracks) {
+                if (t.second.lastFrame >= prevEnd - prevGap) a.push_back({ t.first, t.second.lastBox });
+            }
+            for (const auto& t : cur.tracks) {
+                if (t.second.firstFrame <= cur.options.startFrame + curGap) b.push_back({ t.first, t.second.firstBox });
+            }
+        }
+
+        struct Candidate { double iou; int prevId; int curId; };
+        std::vector<Candidate> candidates;
+        for (const auto& pa : a) {
+            for (const auto& pb : b) {
+                double inter = (pa.second & pb.second).area();
+                double uni = pa.second.area() + pb.second.area() - inter;
+                double iou = uni > 0 ? inter / uni : 0;
+                if (iou >= JOB_STITCH_MIN_IOU) candidates.push_back({ iou, pa.first, pb.first });
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const Candidate& x, const Candidate& y) { return x.iou > y.iou; });
+
+        std::set<int> usedPrev, usedCur;
+        std::vector<std::pair<int, int>> matches;
+        for (const auto& c : candidates) {
+            if (usedPrev.count(c.prevId) || usedCur.count(c.curId)) continue;
+            usedPrev.insert(c.prevId);
+            usedCur.insert(c.curId);
+            matches.push_back({ c.prevId, c.curId });
+        }
+        return matches;
+    }
+
+    static bool IsVideoFile(const std::string& name) {
+        size_t dot = name.find_last_of('.');
+        if (dot == std::string::npos) return false;
+        std::string ext = name.substr(dot + 1);
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)tolower(c); });
+        return ext == "mp4" || ext == "avi" || ext == "mkv" || ext == "mov" || ext == "webm";
+    }
+
+    // A folder is searched recursively; DVR names (date folders, HHMMSS clips) sort chronologically
+    static std::vector<std::string> CollectVideos(const std::string& path) {
+        std::vector<std::string> files;
+        std::vector<std::string> subdirs = PlatformListDirectory(path, true);
+        std::vector<std::string> names = PlatformListDirectory(path, false);
+        if (subdirs.empty() && names.empty()) {
+            if (IsVideoFile(path)) files.push_back(path);
+            return files;
+        }
+        for (const auto& name : names) {
+            if (IsVideoFile(name)) files.push_back(path + "\\" + name);
+        }
+        for (const auto& dir : subdirs) {
+            std::vector<std::string> nested = CollectVideos(path + "\\" + dir);
+            files.insert(files.end(), nested.begin(), nested.end());
+        }
+        std::sort(files.begin(), files.end());
+        return files;
+    }
+
+    static std::string FileName(const std::string& path) {
+        size_t slash = path.find_last_of("\\/");
+        return slash == std::string::npos ? path : path.substr(slash + 1);
+    }
+
+    static std::string DefaultJobOutputDir(const std::string& inputPath) {
+        std::string trimmed = inputPath;
+        while (trimmed.size() > 1 && (trimmed.back() == '\\' || trimmed.back() == '/')) trimmed.pop_back();
+        std::string name = FileName(trimmed);
+        size_t dot = name.find_last_of('.');
+        if (dot != std::string::npos && dot > 0) name = name.substr(0, dot);
+
+        SYSTEMTIME st;
+        GetLocalTime(&st);
+        char stamp[32];
+        sprintf_s(stamp, "%04d%02d%02d_%02d%02d%02d", st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond);
+        CreateDirectoryA("C:\\smart_parking_offline", NULL);
+        return "C:\\smart_parking_offline\\" + name + "_" + stamp;
+    }
+};
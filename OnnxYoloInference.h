@@ -3,8 +3,9 @@
 #include <vector>
 #include <string>
 #include <onnxruntime_cxx_api.h>
+#include "Platform.h"
 
-__declspec(selectany) int g_selectedGpuId = 0;
+PLATFORM_SELECTANY int g_selectedGpuId = 0;
 
 class OnnxYoloInference {
 public:
@@ -21,6 +22,18 @@ public:
             session_options.SetIntraOpNumThreads(1);
             session_options.SetInterOpNumThreads(1);
             session_options.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
+
+            // [TRACE] ORT writes <prefix>_<timestamp>.json; collected by endProfiling()
+            profilingActive_ = false;
+            if (!profilingPrefix_.empty()) {
+#ifdef _WIN32
+                std::wstring widePrefix(profilingPrefix_.begin(), profilingPrefix_.end());
+                session_options.EnableProfiling(widePrefix.c_str());
+#else
+                session_options.EnableProfiling(profilingPrefix_.c_str());
+#endif
+                profilingActive_ = true;
+            }
             
             if (useGPU) {
                 try {
@@ -81,6 +94,32 @@ public:
         }
     }
     
+    // Must be called before loadModel(); empty disables profiling
+    void setProfilingPrefix(const std::string& prefix) { profilingPrefix_ = prefix; }
+    bool isProfiling() const { return profilingActive_ && session_; }
+    bool isLoaded() const { return session_ != nullptr; }
+
+    // Stops ORT profiling (it cannot be restarted without reloading the model) and returns the
+    // profile file path; outStartNs receives ORT's profiling start time
+    std::string endProfiling(long long& outStartNs) {
+        outStartNs = 0;
+        if (!isProfiling()) return "";
+        try {
+            outStartNs = (long long)session_->GetProfilingStartTimeNs();
+            Ort::AllocatorWithDefaultOptions allocator;
+            std::string path = session_->EndProfilingAllocated(allocator).get();
+            profilingActive_ = false;
+            return path;
+        }
+        catch (const Ort::Exception& e) {
+            char msg[512];
+            sprintf_s(msg, "[ONNX ERROR] EndProfiling failed: %s\n", e.what());
+            OutputDebugStringA(msg);
+            profilingActive_ = false;
+            return "";
+        }
+    }
+
     bool forward(const cv::Mat& blob, std::vector<cv::Mat>& outputs) {
         if (!session_) return false;
         
@@ -142,4 +181,6 @@ private:
     std::string output_name_;
     std::vector<int64_t> input_dims_;
     std::vector<int64_t> output_dims_;
+    std::string profilingPrefix_;
+    bool profilingActive_ = false;
 };
@@ -0,0 +1,243 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Platform.h"
+#include "ParkingSlot.h"
+#include "EventLog.h"
+
+// ==========================================
+//  [SESSIONS] Per-slot parking sessions: arrival, departure, dwell, turnover
+// ==========================================
+// Fed with the arrivals/departures ParkingManager::updateSlotStatus reports. An arrival opens a
+// session for the slot; the matching departure closes it, appends one record to the
+// "parking_sessions" event log (C:\loc_json\parking_sessions\YYYYMMDD\camera_N, served by
+// /api/{id}/sessions) and folds its dwell into the slot's running statistics:
+// count, total / min / max and mean / stddev (Welford), all O(1) per transition.
+// Statistics cover the current local day and restart at midnight; a session is counted on the day
+// it ends. Sessions that open within PARKING_SESSION_WARMUP_MS of tracking starting are marked
+// "partial": the vehicle was most likely parked before the camera came up. Likewise, sessions still
+// open when tracking stops (disconnect, reconnect) are closed then and marked partial, and the
+// warm-up window starts over with the next frame. Slot states survive a reconnect without a new
+// arrival, so the first frame after one opens a (partial) session for every slot it finds occupied.
+
+const long long PARKING_SESSION_WARMUP_MS = 10 * 1000;
+
+inline const char* VehicleClassName(int classId) {
+    switch (classId) {
+    case 2: return "car";
+    case 3: return "motorcycle";
+    case 5: return "bus";
+    case 7: return "truck";
+    default: return "unknown";
+    }
+}
+
+class ParkingSessionTracker {
+public:
+    explicit ParkingSessionTracker(int cameraId) : cameraId_(cameraId) {}
+
+    // Called every processed frame with the frame's transitions and every slot's status after them;
+    // slotTypes: slot id -> "Car" / "Motorcycle", used to label the records
+    void Apply(long long nowMs, const std::vector<SlotTransition>& transitions, const std::map<int, SlotStatus>& statuses,
+               const std::map<int, std::string>& slotTypes) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        bool restarted = startMs_ == 0;
+        if (startMs_ == 0) startMs_ = nowMs;
+        if (firstMs_ == 0) firstMs_ = nowMs;
+        if (!restarted && transitions.empty() && slots_.size() >= slotTypes.size()) return; // The per-frame common case
+        RollDay(nowMs);
+        for (const auto& type : slotTypes) slots_[type.first].type = type.second; // Idle slots are listed too
+        if (restarted) {
+            // Vehicles still parked from before the restart: their arrival was reported to the last run
+            for (const auto& status : statuses) {
+                if (status.second == SlotStatus::EMPTY) continue;
+                bool reported = false;
+                for (const SlotTransition& t : transitions) reported = reported || t.slotId == status.first;
+                SlotStats& s = slots_[status.first];
+                if (reported || s.occupied) continue;
+                s.occupied = true;
+                s.trackId = -1;
+                s.classId = -1;
+                s.sinceMs = nowMs;
+                s.partial = true;
+            }
+        }
+        for (const SlotTransition& t : transitions) {
+            SlotStats& s = slots_[t.slotId];
+            auto type = slotTypes.find(t.slotId);
+            if (type != slotTypes.end()) s.type = type->second;
+            if (t.arrival) {
+                if (s.occupied) Close(t.slotId, s, nowMs); // Missed departure: never leave a session open twice
+                s.occupied = true;
+                s.trackId = t.trackId;
+                s.classId = t.classId;
+                s.sinceMs = nowMs;
+                s.partial = nowMs - startMs_ < PARKING_SESSION_WARMUP_MS;
+            } else if (s.occupied) {
+                Close(t.slotId, s, nowMs);
+            }
+        }
+    }
+
+    // Tracking stopped: the departures of open sessions will not be seen, so they end here
+    void Reset(long long nowMs) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        RollDay(nowMs);
+        for (auto& entry : slots_) {
+            if (!entry.second.occupied) continue;
+            entry.second.partial = true;
+            Close(entry.first, entry.second, nowMs);
+        }
+        startMs_ = 0;
+    }
+
+    // {"camera_id":N,"date":"YYYYMMDD","slots":[{...per-slot statistics...}]}
+    std::string StatsJson(long long nowMs) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        RollDay(nowMs);
+        long long dayElapsedMs = std::max(1LL, nowMs - std::max(dayStartMs_, firstMs_));
+        std::ostringstream out;
+        out << "{\"camera_id\":" << cameraId_ << ",\"date\":\"" << day_ << "\",\"observed_ms\":" << dayElapsedMs << ",\"slots\":[";
+        bool first = true;
+        for (const auto& entry : slots_) {
+            const SlotStats& s = entry.second;
+            long long openMs = s.occupied ? nowMs - std::max(s.sinceMs, dayStartMs_) : 0;
+            double stddev = s.sessions > 1 ? std::sqrt(s.m2 / (s.sessions - 1)) : 0.0;
+            if (!first) out << ",";
+            first = false;
+            out << "{\"slot_id\":" << entry.first
+                << ",\"slot_type\":\"" << s.type << "\""
+                << ",\"occupied\":" << (s.occupied ? "true" : "false")
+                << ",\"track_id\":" << (s.occupied ? s.trackId : -1)
+                << ",\"occupied_since_ms\":" << (s.occupied ? s.sinceMs : 0)
+                << ",\"sessions\":" << s.sessions
+                << ",\"turnover_per_hour\":" << s.sessions * 3600000.0 / dayElapsedMs
+                << ",\"total_dwell_ms\":" << s.totalMs
+                << ",\"mean_dwell_ms\":" << (long long)s.mean
+                << ",\"stddev_dwell_ms\":" << (long long)stddev
+                << ",\"min_dwell_ms\":" << (s.sessions ? s.minMs : 0)
+                << ",\"max_dwell_ms\":" << s.maxMs
+                << ",\"utilization\":" << std::min(1.0, (double)(s.totalDayMs + openMs) / dayElapsedMs)
+                << ",\"last_departure_ms\":" << s.lastDepartureMs << "}";
+        }
+        out << "]}";
+        return out.str();
+    }
+
+private:
+    struct SlotStats {
+        std::string type = "Car";
+        // Open session
+        bool occupied = false;
+        int trackId = -1;
+        int classId = -1;
+        long long sinceMs = 0;
+        bool partial = false;
+        // Today's closed sessions
+        int sessions = 0;
+        long long totalMs = 0;
+        long long minMs = 0;
+        long long maxMs = 0;
+        double mean = 0.0;
+        double m2 = 0.0;        // Welford sum of squared deviations
+        long long totalDayMs = 0; // Occupied time inside today (sessions crossing midnight are clipped)
+        long long lastDepartureMs = 0;
+    };
+
+    int cameraId_;
+    std::mutex mutex_;
+    std::map<int, SlotStats> slots_;
+    long long startMs_ = 0; // Tracking (re)started: the warm-up window runs from here
+    long long firstMs_ = 0; // First frame ever: start of the observed time in the statistics
+    std::string day_;
+    long long dayStartMs_ = 0;
+
+    void RollDay(long long nowMs) {
+        SYSTEMTIME st;
+        GetLocalTime(&st);
+        char day[16];
+        sprintf_s(day, sizeof(day), "%04d%02d%02d", st.wYear, st.wMonth, st.wDay);
+        if (day_ == day) return;
+        day_ = day;
+        dayStartMs_ = nowMs - ((st.wHour * 60LL + st.wMinute) * 60LL + st.wSecond) * 1000LL - st.wMilliseconds;
+        for (auto& entry : slots_) {
+            SlotStats& s = entry.second;
+            s.sessions = 0;
+            s.totalMs = s.minMs = s.maxMs = 0;
+            s.mean = s.m2 = 0.0;
+            s.totalDayMs = 0;
+        }
+    }
+
+    void Close(int slotId, SlotStats& s, long long nowMs) {
+        long long durationMs = std::max(0LL, nowMs - s.sinceMs);
+        s.occupied = false;
+        s.lastDepartureMs = nowMs;
+        s.sessions++;
+        s.totalMs += durationMs;
+        s.totalDayMs += nowMs - std::max(s.sinceMs, dayStartMs_);
+        s.minMs = s.sessions == 1 ? durationMs : std::min(s.minMs, durationMs);
+        s.maxMs = std::max(s.maxMs, durationMs);
+        double delta = durationMs - s.mean;
+        s.mean += delta / s.sessions;
+        s.m2 += delta * (durationMs - s.mean);
+
+        std::ostringstream line;
+        line << "{\"event_type\":\"session\",\"camera_id\":\"camera_" << cameraId_ << "\""
+             << ",\"slot_id\":" << slotId
+             << ",\"slot_type\":\"" << s.type << "\""
+             << ",\"track_id\":" << s.trackId
+             << ",\"class_id\":" << s.classId
+             << ",\"class\":\"" << VehicleClassName(s.classId) << "\""
+             << ",\"start_ms\":" << s.sinceMs
+             << ",\"end_ms\":" << nowMs
+             << ",\"duration_ms\":" << durationMs
+             << ",\"partial\":" << (s.partial ? "true" : "false")
+             << ",\"epoch_ms\":" << nowMs << "}";
+        g_eventLog.Append("parking_sessions", cameraId_, nowMs, "session", line.str());
+    }
+};
+
+// Process-wide per-camera trackers, so the web server can read statistics without the camera
+class ParkingSessionStore {
+public:
+    void Apply(int cameraId, long long nowMs, const std::vector<SlotTransition>& transitions, const std::map<int, SlotStatus>& statuses,
+               const std::map<int, std::string>& slotTypes) {
+        Get(cameraId, true)->Apply(nowMs, transitions, statuses, slotTypes);
+    }
+
+    void Reset(int cameraId, long long nowMs) {
+        ParkingSessionTracker* tracker = Get(cameraId, false);
+        if (tracker) tracker->Reset(nowMs);
+    }
+
+    // False when the camera has not reported any slot state yet
+    bool StatsJson(int cameraId, long long nowMs, std::string& out) {
+        ParkingSessionTracker* tracker = Get(cameraId, false);
+        if (!tracker) return false;
+        out = tracker->StatsJson(nowMs);
+        return true;
+    }
+
+private:
+    std::mutex mutex_;
+    std::map<int, std::unique_ptr<ParkingSessionTracker>> trackers_;
+
+    ParkingSessionTracker* Get(int cameraId, bool create) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = trackers_.find(cameraId);
+        if (it != trackers_.end()) return it->second.get();
+        if (!create) return nullptr;
+        ParkingSessionTracker* tracker = new ParkingSessionTracker(cameraId);
+        trackers_[cameraId].reset(tracker);
+        return tracker;
+    }
+};
+
+PLATFORM_SELECTANY ParkingSessionStore g_parkingSessions;
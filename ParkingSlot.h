@@ -3,6 +3,8 @@
 #include <vector>
 #include <string>
 #include <fstream>
+#include "Platform.h"
+#include "BYTETracker.h" // TrackedObject
 
 // Parking slot status
 enum class SlotStatus {
@@ -26,11 +28,11 @@ struct ParkingSlot {
     int framesOccupied;              // Stabilization: frames continuously occupied
     int framesEmpty;                 // Stabilization: frames continuously empty
     
-    ParkingSlot() : id(-1), type("Car"), status(SlotStatus::EMPTY), occupiedByTrackId(-1), occupancyPercent(0.0f), 
+    ParkingSlot() : id(-1), status(SlotStatus::EMPTY), occupiedByTrackId(-1), occupancyPercent(0.0f), type("Car"), 
                     tempOccupiedBy(-1), tempClassId(-1), framesOccupied(0), framesEmpty(0) {}
     
     ParkingSlot(int _id, const std::vector<cv::Point>& _poly, const std::string& _type = "Car") 
-        : id(_id), polygon(_poly), type(_type), status(SlotStatus::EMPTY), occupiedByTrackId(-1), occupancyPercent(0.0f),
+        : id(_id), polygon(_poly), status(SlotStatus::EMPTY), occupiedByTrackId(-1), occupancyPercent(0.0f), type(_type),
           tempOccupiedBy(-1), tempClassId(-1), framesOccupied(0), framesEmpty(0) {}
     
     // Get bounding box of polygon
@@ -161,11 +163,23 @@ struct ParkingTemplate {
     }
 };
 
+// Arrival / departure reported by ParkingManager::updateSlotStatus
+struct SlotTransition {
+    int slotId;
+    bool arrival;      // EMPTY -> occupied (false: occupied -> EMPTY)
+    int trackId;       // The arriving occupant, or the one that left
+    int classId;       // Occupant class on arrival, -1 on departure
+    SlotStatus status; // Status after the change
+};
+
 // Parking Manager
 class ParkingManager {
 private:
     std::vector<ParkingSlot> slots;
     cv::Mat templateFrame;  // First frame for template creation
+    cv::Size slotSpaceSize; // Image size the slot polygons are currently expressed in (0 = unknown)
+    std::vector<std::vector<cv::Point>> templatePolygons; // Slot polygons as loaded, at templateSize
+    cv::Size templateSize;  // Image size the template was drawn on (0 = no template loaded)
     
     // [OPTIMIZED] Check if a car's center is inside the slot
     bool isCarInSlot(const cv::Rect& carBbox, const ParkingSlot& slot) const {
@@ -173,6 +187,15 @@ private:
         cv::Point center(carBbox.x + carBbox.width / 2, carBbox.y + carBbox.height / 2);
         return cv::pointPolygonTest(slot.polygon, center, false) >= 0;
     }
+    
+    // Take the current polygons as the unscaled reference for fitSlotsToFrame
+    void rebaseTemplate() {
+        templatePolygons.clear();
+        templateSize = slotSpaceSize;
+        if (templateSize.width <= 0 || templateSize.height <= 0) return;
+        templatePolygons.reserve(slots.size());
+        for (const auto& slot : slots) templatePolygons.push_back(slot.polygon);
+    }
 
 public:
     // Set template frame (first frame of video)
@@ -184,11 +207,15 @@ public:
     void addSlot(const std::vector<cv::Point>& polygon, const std::string& type = "Car") {
         int newId = (int)slots.size() + 1;
         slots.push_back(ParkingSlot(newId, polygon, type));
+        // New slots are drawn in the current space, so that becomes the reference
+        rebaseTemplate();
     }
     
     // Clear all slots
     void clearSlots() {
         slots.clear();
+        templatePolygons.clear();
+        templateSize = cv::Size();
     }
     
     // Get slots
@@ -222,11 +249,39 @@ public:
         ParkingTemplate templ;
         if (!templ.loadFromFile(filename)) return false;
         slots = templ.slots;
+        slotSpaceSize = templ.imageSize;
+        rebaseTemplate();
         return true;
     }
     
-    // Update slot status based on tracked objects
-    void updateSlotStatus(const std::vector<TrackedObject>& trackedObjects) {
+    // Rescale slot polygons to the frame size they will be tested against
+    // (templates are drawn on native-resolution frames, processing may run downscaled).
+    // Always scales from the loaded template so repeated size changes don't accumulate rounding.
+    void fitSlotsToFrame(const cv::Size& frameSize) {
+        if (frameSize.width <= 0 || frameSize.height <= 0) return;
+        if (slotSpaceSize == frameSize) return;
+        if (templateSize.width <= 0 || templateSize.height <= 0 || templatePolygons.size() != slots.size()) {
+            slotSpaceSize = frameSize;
+            rebaseTemplate();
+            return;
+        }
+        
+        double sx = (double)frameSize.width / templateSize.width;
+        double sy = (double)frameSize.height / templateSize.height;
+        for (size_t i = 0; i < slots.size(); i++) {
+            const auto& src = templatePolygons[i];
+            auto& dst = slots[i].polygon;
+            dst.resize(src.size());
+            for (size_t j = 0; j < src.size(); j++) {
+                dst[j].x = cvRound(src[j].x * sx);
+                dst[j].y = cvRound(src[j].y * sy);
+            }
+        }
+        slotSpaceSize = frameSize;
+    }
+    
+    // Update slot status based on tracked objects; arrivals/departures are appended to `transitions` if given
+    void updateSlotStatus(const std::vector<TrackedObject>& trackedObjects, std::vector<SlotTransition>* transitions = nullptr) {
         // First reset transient info for this specific frame
         for (auto& slot : slots) {
             slot.occupancyPercent = 0.0f; // Reset transient
@@ -239,7 +294,6 @@ public:
                 continue;
             }
             
-            bool foundSlot = false;
             int bestSlotIdx = -1;
             
             // Find best matching slot (first slot that contains the center)
@@ -282,8 +336,10 @@ public:
                 } else {
                     slot.status = SlotStatus::OCCUPIED_GOOD;
                 }
+                if (transitions) transitions->push_back(SlotTransition{ slot.id, true, slot.occupiedByTrackId, slot.tempClassId, slot.status });
             } 
             else if (slot.status != SlotStatus::EMPTY && slot.framesEmpty >= 3) {
+                if (transitions) transitions->push_back(SlotTransition{ slot.id, false, slot.occupiedByTrackId, -1, SlotStatus::EMPTY });
                 slot.status = SlotStatus::EMPTY;
                 slot.occupiedByTrackId = -1;
             }
@@ -354,7 +410,7 @@ public:
         }
         
         // Draw statistics
-        int emptyCount = 0, occupiedCount = 0, illegalCount = 0;
+        int emptyCount = 0, occupiedCount = 0;
         for (const auto& slot : slots) {
             if (slot.status == SlotStatus::EMPTY) emptyCount++;
             else if (slot.status != SlotStatus::ILLEGAL) occupiedCount++;
@@ -0,0 +1,403 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <cstdio>
+#include <cstring>
+#include "Platform.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+}
+
+// ==========================================
+//  [PASSTHROUGH] DVR recording without decode or encode
+// ==========================================
+// The camera's compressed packets (H.264/H.265 as sent) are remuxed into 60 s clips under
+// C:\locvideo\YYYYMMDD\camera_N\HHMMSS.mp4, next to the annotated .webm clips of the other mode.
+// Clips are fragmented MP4 (readable even if the process dies mid-clip) and are cut on keyframes
+// only; a stream the MP4 muxer rejects (e.g. no out-of-band SPS/PPS) is written as Matroska.
+// Push() runs on the capture thread and only takes a reference to the packet; all disk I/O
+// happens on the recorder's own thread.
+//
+// [EVENT REC] In event mode nothing is written until Trigger(): the last EVENT_PREROLL_SECONDS of
+// packets (from a keyframe) wait in a bounded in-memory ring, and a trigger flushes them plus
+// everything up to EVENT_POSTROLL_SECONDS after the last trigger into HHMMSS_event.mp4.
+
+enum class RecordingMode {
+    ANNOTATED = 0,   // Rendered frames re-encoded to 10 FPS VP8 WebM (overlays burned in)
+    PASSTHROUGH = 1, // Camera packets remuxed at full quality and frame rate
+    EVENT = 2        // Camera packets kept in memory, written only around violations
+};
+
+inline RecordingMode ParseRecordingMode(const std::string& name) {
+    if (name == "passthrough") return RecordingMode::PASSTHROUGH;
+    if (name == "event") return RecordingMode::EVENT;
+    return RecordingMode::ANNOTATED;
+}
+
+const int PASSTHROUGH_QUEUE_PACKETS = 512;    // ~17 s at 30 FPS before packets are dropped
+const double PASSTHROUGH_CLIP_SECONDS = 60.0; // Same length as the annotated DVR clips
+const double EVENT_PREROLL_SECONDS = 10.0;
+const double EVENT_POSTROLL_SECONDS = 10.0;   // Extended by every trigger while the clip is open
+const size_t EVENT_RING_MAX_BYTES = 64u << 20; // Hard cap per camera (a 4K stream at 16 Mbps is ~20 MB)
+
+// Where an event can be watched: the clip and the trigger's offset into it
+struct EventClipRef {
+    std::string relPath; // Relative to C:\locvideo, empty if the stream has not delivered a keyframe yet
+    double seekSeconds = 0.0;
+};
+
+class PassthroughRecorder {
+public:
+    PassthroughRecorder(int cameraId, const AVCodecParameters* codecpar, AVRational timeBase)
+        : cameraId_(cameraId), timeBase_(timeBase) {
+        codecpar_ = avcodec_parameters_alloc();
+        if (codecpar_) avcodec_parameters_copy(codecpar_, codecpar);
+    }
+
+    ~PassthroughRecorder() {
+        Stop();
+        avcodec_parameters_free(&codecpar_);
+    }
+
+    // Before Start()
+    void SetEventMode(double preRollSeconds, double postRollSeconds) {
+        eventMode_ = true;
+        preRollUs_ = (long long)(preRollSeconds * 1e6);
+        postRollUs_ = (long long)(postRollSeconds * 1e6);
+    }
+    bool IsEventMode() const { return eventMode_; }
+
+    void Start() {
+        if (running_.exchange(true)) return;
+        worker_ = std::thread(&PassthroughRecorder::WriterLoop, this);
+    }
+
+    // Writes whatever is queued, then closes the current clip
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex_);
+            running_ = false;
+            queueCv_.notify_all();
+        }
+        if (worker_.joinable()) worker_.join();
+        for (QueuedPacket& q : ring_) av_packet_free(&q.packet);
+        ring_.clear();
+        ringBytes_ = 0;
+    }
+
+    // Capture thread: never blocks on the writer. After an overflow everything up to the next
+    // keyframe is dropped so the clip never contains undecodable frames.
+    void Push(const AVPacket* packet) {
+        bool isKey = (packet->flags & AV_PKT_FLAG_KEY) != 0;
+        std::lock_guard<std::mutex> lock(queueMutex_);
+        if (!running_) return;
+        long long nowUs = SteadyNowUs();
+        if (eventMode_) {
+            if (!eventActive_) {
+                PushPreRoll(packet, isKey, nowUs);
+                return;
+            }
+            if (isKey && nowUs >= postRollUntilUs_) {
+                // Post-roll is over: close the clip and let this keyframe start the next pre-roll
+                eventActive_ = false;
+                queue_.push_back(QueuedPacket{ nullptr, nowUs, "" });
+                queueCv_.notify_one();
+                PushPreRoll(packet, isKey, nowUs);
+                return;
+            }
+        }
+        if (waitForKey_ && !isKey) return;
+        if ((int)queue_.size() >= PASSTHROUGH_QUEUE_PACKETS) {
+            packetsDropped_++;
+            waitForKey_ = true;
+            return;
+        }
+        AVPacket* ref = av_packet_clone(packet); // Ref-counted: the payload is not copied
+        if (!ref) return;
+        waitForKey_ = false;
+        queue_.push_back(QueuedPacket{ ref, nowUs, "" });
+        queueCv_.notify_one();
+    }
+
+    // [EVENT REC] Starts (or extends) an event clip and returns where the trigger lands in it.
+    // The clip's name is fixed here so the event record can point at it before it is written.
+    EventClipRef Trigger() {
+        EventClipRef ref;
+        if (!eventMode_) return ref;
+        std::string newRelPath = ClipBaseRelPath() + "_event" + (ContainerForEvents() == std::string("mp4") ? ".mp4" : ".mkv");
+        std::lock_guard<std::mutex> lock(queueMutex_);
+        if (!running_) return ref;
+        long long nowUs = SteadyNowUs();
+        postRollUntilUs_ = nowUs + postRollUs_;
+        if (!eventActive_) {
+            if (ring_.empty()) return ref;
+            eventActive_ = true;
+            eventClipRelPath_ = newRelPath;
+            eventClipStartUs_ = ring_.front().arrivalUs;
+            ring_.front().openClip = eventClipRelPath_;
+            queue_.insert(queue_.end(), ring_.begin(), ring_.end()); // Bounded by the ring caps
+            ring_.clear();
+            ringBytes_ = 0;
+            waitForKey_ = false;
+            queueCv_.notify_one();
+            OutputDebugStringA(("[EVENT REC] Camera " + std::to_string(cameraId_) + ": event clip " + eventClipRelPath_ + "\n").c_str());
+        }
+        ref.relPath = eventClipRelPath_;
+        ref.seekSeconds = (nowUs - eventClipStartUs_) / 1e6;
+        return ref;
+    }
+
+    // Path relative to C:\locvideo and position of the newest written packet, for event records
+    std::string CurrentClipRelPath() const {
+        std::lock_guard<std::mutex> lock(clipMutex_);
+        return clipRelPath_;
+    }
+    double CurrentClipSeconds() const { return clipSeconds_.load(); }
+    long long PacketsDropped() const { return packetsDropped_.load(); }
+
+    // [METADATA] Called on the writer thread with each new clip's relative path and the steady-clock
+    // time (us) its first keyframe arrived, and with an empty path when a clip closes without a
+    // successor (event mode, Stop). Set before Start().
+    std::function<void(const std::string& relPath, long long startUs)> onClipChanged;
+
+private:
+    int cameraId_;
+    AVCodecParameters* codecpar_ = nullptr;
+    AVRational timeBase_;
+
+    std::thread worker_;
+    std::atomic<bool> running_{ false };
+    std::mutex queueMutex_;
+    std::condition_variable queueCv_;
+    struct QueuedPacket {
+        AVPacket* packet;     // nullptr: close the current clip (end of an event)
+        long long arrivalUs;
+        std::string openClip; // Event mode: start this clip with this packet
+    };
+    std::deque<QueuedPacket> queue_;
+    bool waitForKey_ = true; // Clips start on a keyframe
+    std::atomic<long long> packetsDropped_{ 0 };
+
+    // [EVENT REC] Guarded by queueMutex_
+    bool eventMode_ = false;
+    long long preRollUs_ = 0;
+    long long postRollUs_ = 0;
+    std::deque<QueuedPacket> ring_; // Always starts on a keyframe
+    size_t ringBytes_ = 0;
+    bool eventActive_ = false;
+    long long postRollUntilUs_ = 0;
+    std::string eventClipRelPath_;
+    long long eventClipStartUs_ = 0;
+
+    // Writer-thread state
+    AVFormatContext* outCtx_ = nullptr;
+    int64_t clipStartTs_ = AV_NOPTS_VALUE; // Input time base
+    int64_t lastDts_ = AV_NOPTS_VALUE;
+    std::chrono::steady_clock::time_point clipOpened_;
+
+    mutable std::mutex clipMutex_;
+    std::string clipRelPath_;
+    std::atomic<double> clipSeconds_{ 0.0 };
+
+    void WriterLoop() {
+        while (true) {
+            QueuedPacket item;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex_);
+                queueCv_.wait(lock, [&]() { return !running_ || !queue_.empty(); });
+                if (queue_.empty()) break;
+                item = queue_.front();
+                queue_.pop_front();
+            }
+
+            AVPacket* packet = item.packet;
+            if (!packet) {
+                CloseClip();
+                if (onClipChanged) onClipChanged("", 0);
+                continue;
+            }
+            bool opened = false;
+            if (!item.openClip.empty()) {
+                CloseClip();
+                opened = OpenClipAt(item.openClip, ContainerForEvents());
+            } else if (!eventMode_ && (packet->flags & AV_PKT_FLAG_KEY) && (!outCtx_ || ClipSeconds(packet) >= PASSTHROUGH_CLIP_SECONDS)) {
+                CloseClip();
+                opened = OpenClip();
+            }
+            if (opened && onClipChanged) onClipChanged(CurrentClipRelPath(), item.arrivalUs);
+            if (outCtx_) WritePacket(packet);
+            av_packet_free(&packet);
+        }
+        bool hadClip = outCtx_ != nullptr;
+        CloseClip();
+        if (hadClip && onClipChanged) onClipChanged("", 0);
+    }
+
+    // [EVENT REC] Capture thread, queueMutex_ held
+    void PushPreRoll(const AVPacket* packet, bool isKey, long long nowUs) {
+        if (ring_.empty() && !isKey) return;
+        AVPacket* ref = av_packet_clone(packet);
+        if (!ref) return;
+        ring_.push_back(QueuedPacket{ ref, nowUs, "" });
+        ringBytes_ += (size_t)packet->size;
+
+        // Drop whole GOPs from the front while the next GOP alone still covers the pre-roll
+        long long cutoffUs = nowUs - preRollUs_;
+        while (true) {
+            size_t next = 1;
+            while (next < ring_.size() && !(ring_[next].packet->flags & AV_PKT_FLAG_KEY)) next++;
+            if (next >= ring_.size()) break;
+            if (ring_[next].arrivalUs > cutoffUs && ringBytes_ <= EVENT_RING_MAX_BYTES) break;
+            for (size_t i = 0; i < next; i++) {
+                ringBytes_ -= (size_t)ring_.front().packet->size;
+                av_packet_free(&ring_.front().packet);
+                ring_.pop_front();
+            }
+        }
+    }
+
+    // The event record names the clip before it is opened, so event clips skip the MP4 -> MKV
+    // retry: MP4 needs the parameter sets out of band
+    const char* ContainerForEvents() const {
+        return codecpar_ && codecpar_->extradata_size > 0 ? "mp4" : "matroska";
+    }
+
+    static long long SteadyNowUs() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    double ClipSeconds(const AVPacket* packet) const {
+        int64_t ts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+        if (ts == AV_NOPTS_VALUE || clipStartTs_ == AV_NOPTS_VALUE) {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - clipOpened_).count();
+        }
+        return (ts - clipStartTs_) * av_q2d(timeBase_);
+    }
+
+    // YYYYMMDD/camera_N/HHMMSS for a clip starting now; creates the folders
+    std::string ClipBaseRelPath() const {
+        SYSTEMTIME st;
+        GetLocalTime(&st);
+        char dateFolder[128];
+        sprintf_s(dateFolder, sizeof(dateFolder), "C:\\locvideo\\%04d%02d%02d", st.wYear, st.wMonth, st.wDay);
+        char cameraFolder[160];
+        sprintf_s(cameraFolder, sizeof(cameraFolder), "%s\\camera_%d", dateFolder, cameraId_);
+        CreateDirectoryA("C:\\locvideo", NULL);
+        CreateDirectoryA(dateFolder, NULL);
+        CreateDirectoryA(cameraFolder, NULL);
+
+        char baseRel[96];
+        sprintf_s(baseRel, sizeof(baseRel), "%04d%02d%02d/camera_%d/%02d%02d%02d",
+            st.wYear, st.wMonth, st.wDay, cameraId_, st.wHour, st.wMinute, st.wSecond);
+        return baseRel;
+    }
+
+    bool OpenClip() {
+        if (!codecpar_) return false;
+        std::string baseRel = ClipBaseRelPath();
+        return OpenClipAt(baseRel + ".mp4", "mp4") || OpenClipAt(baseRel + ".mkv", "matroska");
+    }
+
+    bool OpenClipAt(const std::string& relPath, const char* format) {
+        if (!codecpar_ || !OpenMuxer(format, relPath)) {
+            OutputDebugStringA(("[PASSTHROUGH] Camera " + std::to_string(cameraId_) + ": cannot open " + relPath + "\n").c_str());
+            return false;
+        }
+
+        clipStartTs_ = AV_NOPTS_VALUE;
+        lastDts_ = AV_NOPTS_VALUE;
+        clipOpened_ = std::chrono::steady_clock::now();
+        clipSeconds_ = 0.0;
+        {
+            std::lock_guard<std::mutex> lock(clipMutex_);
+            clipRelPath_ = relPath;
+        }
+        OutputDebugStringA(("[PASSTHROUGH] New clip: C:\\locvideo\\" + relPath + "\n").c_str());
+        return true;
+    }
+
+    bool OpenMuxer(const char* format, const std::string& relPath) {
+        std::string path = "C:\\locvideo\\" + relPath;
+        std::replace(path.begin(), path.end(), '/', '\\');
+        path = PlatformPath(path);
+
+        AVFormatContext* ctx = nullptr;
+        if (avformat_alloc_output_context2(&ctx, nullptr, format, path.c_str()) < 0 || !ctx) return false;
+        AVStream* stream = avformat_new_stream(ctx, nullptr);
+        if (!stream || avcodec_parameters_copy(stream->codecpar, codecpar_) < 0) {
+            avformat_free_context(ctx);
+            return false;
+        }
+        stream->codecpar->codec_tag = 0; // Let the muxer pick its own tag (avc1/hvc1...)
+        stream->time_base = timeBase_;
+
+        if (avio_open(&ctx->pb, path.c_str(), AVIO_FLAG_WRITE) < 0) {
+            avformat_free_context(ctx);
+            return false;
+        }
+        AVDictionary* opts = nullptr;
+        if (strcmp(format, "mp4") == 0) av_dict_set(&opts, "movflags", "frag_keyframe+empty_moov+default_base_moof", 0);
+        int ret = avformat_write_header(ctx, &opts);
+        av_dict_free(&opts);
+        if (ret < 0) {
+            avio_closep(&ctx->pb);
+            avformat_free_context(ctx);
+            remove(path.c_str());
+            return false;
+        }
+        outCtx_ = ctx;
+        return true;
+    }
+
+    void WritePacket(AVPacket* packet) {
+        int64_t pts = packet->pts;
+        int64_t dts = packet->dts;
+        if (dts == AV_NOPTS_VALUE) dts = pts;
+        if (pts == AV_NOPTS_VALUE) pts = dts;
+        if (pts == AV_NOPTS_VALUE) {
+            // No timestamps from the camera: fall back to arrival time
+            int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - clipOpened_).count();
+            pts = dts = av_rescale_q(us, AVRational{ 1, 1000000 }, timeBase_) + (clipStartTs_ == AV_NOPTS_VALUE ? 0 : clipStartTs_);
+        }
+        if (clipStartTs_ == AV_NOPTS_VALUE) clipStartTs_ = dts;
+
+        // Each clip starts at 0; the muxer needs strictly increasing dts
+        dts -= clipStartTs_;
+        pts -= clipStartTs_;
+        if (lastDts_ != AV_NOPTS_VALUE && dts <= lastDts_) dts = lastDts_ + 1;
+        if (pts < dts) pts = dts;
+        lastDts_ = dts;
+
+        packet->pts = pts;
+        packet->dts = dts;
+        packet->stream_index = 0;
+        packet->pos = -1;
+        av_packet_rescale_ts(packet, timeBase_, outCtx_->streams[0]->time_base);
+        clipSeconds_ = pts * av_q2d(timeBase_);
+
+        int ret = av_interleaved_write_frame(outCtx_, packet);
+        if (ret < 0) {
+            char errBuf[AV_ERROR_MAX_STRING_SIZE] = { 0 };
+            av_strerror(ret, errBuf, sizeof(errBuf));
+            OutputDebugStringA(("[PASSTHROUGH] Write failed: " + std::string(errBuf) + "\n").c_str());
+        }
+    }
+
+    void CloseClip() {
+        if (!outCtx_) return;
+        av_write_trailer(outCtx_);
+        avio_closep(&outCtx_->pb);
+        avformat_free_context(outCtx_);
+        outCtx_ = nullptr;
+    }
+};
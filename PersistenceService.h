@@ -0,0 +1,287 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Platform.h"
+#include "MetricsRegistry.h"
+#ifndef _WIN32
+#include <fcntl.h>
+#endif
+
+// ==========================================
+//  [PERSIST] Asynchronous snapshot / event / stats writes
+// ==========================================
+// Violation snapshots, event records and parking stats used to be written on the processing
+// thread (mkdirs, JPEG encode + write, JSON dump + write). They are now queued here and written
+// by a small worker pool, so a burst of violations costs the frame loop one queue push each.
+//  - The queue is bounded; when it is full the job is dropped and counted, the caller never waits.
+//  - Directories are created once per process (cached), with every missing parent.
+//  - Durability is batched: at most one sync per PERSIST_SYNC_INTERVAL_MS, covering exactly the files
+//    written since the last one (fsync of each file and its directory on POSIX, FlushFileBuffers on Windows).
+// Metrics: parking_persist_queue_depth, parking_persist_jobs_total / _dropped_total and
+// parking_persist_write_seconds, labelled by kind.
+
+const int PERSIST_WORKERS = 2;
+const int PERSIST_QUEUE_JOBS = 256;
+const int PERSIST_SYNC_INTERVAL_MS = 1000;
+
+enum class PersistKind { SNAPSHOT = 0, EVENT, STATS, COUNT };
+
+inline const char* PersistKindName(PersistKind kind) {
+    static const char* names[] = { "snapshot", "event", "stats" };
+    return names[(int)kind];
+}
+
+class PersistenceService {
+public:
+    ~PersistenceService() { Stop(); }
+
+    // JPEG-encoded on a worker; `image` must not be written to afterwards (clone if unsure)
+    bool SubmitImage(PersistKind kind, const std::string& path, const cv::Mat& image, const std::vector<int>& params = std::vector<int>()) {
+        Job job;
+        job.kind = kind;
+        job.path = path;
+        job.image = image;
+        job.imageParams = params;
+        return Submit(std::move(job));
+    }
+
+    // `render` runs on a worker, so JSON serialization stays off the caller's thread too
+    bool SubmitText(PersistKind kind, const std::string& path, std::function<std::string()> render) {
+        Job job;
+        job.kind = kind;
+        job.path = path;
+        job.render = std::move(render);
+        return Submit(std::move(job));
+    }
+
+    // Arbitrary write work (e.g. appending an event log's pending records); returns success
+    bool SubmitTask(PersistKind kind, const std::string& label, std::function<bool()> task) {
+        Job job;
+        job.kind = kind;
+        job.path = label;
+        job.task = std::move(task);
+        return Submit(std::move(job));
+    }
+
+    // Tasks call this for every file they wrote, so the next sync covers it
+    void MarkWritten(const std::string& path) {
+        std::lock_guard<std::mutex> lock(unsyncedMutex_);
+        unsynced_.insert(path);
+        dirty_ = true;
+    }
+
+    // C:\a\b\c -> creates C:\a, C:\a\b, C:\a\b\c once per process
+    void EnsureDirectory(const std::string& dir) {
+        std::lock_guard<std::mutex> lock(dirMutex_);
+        if (knownDirs_.count(dir)) return;
+        size_t pos = dir.find('\\', 3); // Skip the drive root
+        while (true) {
+            std::string prefix = pos == std::string::npos ? dir : dir.substr(0, pos);
+            if (!knownDirs_.count(prefix)) {
+                CreateDirectoryA(prefix.c_str(), NULL); // Fails harmlessly when it already exists
+                knownDirs_.insert(prefix);
+            }
+            if (pos == std::string::npos) break;
+            pos = dir.find('\\', pos + 1);
+        }
+    }
+
+    // Blocks until everything queued so far is on disk (shutdown, offline tools)
+    void Flush() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        idleCv_.wait(lock, [&]() { return queue_.empty() && busy_ == 0; });
+    }
+
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            running_ = false;
+            cv_.notify_all();
+        }
+        for (std::thread& t : workers_) {
+            if (t.joinable()) t.join();
+        }
+        workers_.clear();
+        SyncIfDirty(true);
+    }
+
+    size_t QueueDepth() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return queue_.size();
+    }
+
+private:
+    struct Job {
+        PersistKind kind = PersistKind::EVENT;
+        std::string path;
+        cv::Mat image;
+        std::vector<int> imageParams;
+        std::function<std::string()> render;
+        std::function<bool()> task;
+    };
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::condition_variable idleCv_;
+    std::deque<Job> queue_;
+    std::vector<std::thread> workers_;
+    bool running_ = true;
+    bool started_ = false;
+    int busy_ = 0;
+
+    std::mutex dirMutex_;
+    std::set<std::string> knownDirs_;
+
+    std::atomic<bool> dirty_{ false }; // unsynced_ is not empty
+    std::atomic<long long> lastSyncMs_{ 0 };
+    std::mutex syncMutex_;
+    std::mutex unsyncedMutex_;
+    std::set<std::string> unsynced_;
+
+    MetricGauge* queueDepth_ = nullptr;
+    MetricCounter* jobs_[(int)PersistKind::COUNT] = {};
+    MetricCounter* dropped_[(int)PersistKind::COUNT] = {};
+    MetricHistogram* writeSeconds_[(int)PersistKind::COUNT] = {};
+
+    bool Submit(Job&& job) {
+        int kind = (int)job.kind;
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) return false;
+        if (!started_) StartLocked();
+        if ((int)queue_.size() >= PERSIST_QUEUE_JOBS) {
+            dropped_[kind]->inc();
+            OutputDebugStringA(("[PERSIST] Queue full, dropped " + std::string(PersistKindName(job.kind)) + " " + job.path + "\n").c_str());
+            return false;
+        }
+        queue_.push_back(std::move(job));
+        queueDepth_->set((double)queue_.size());
+        cv_.notify_one();
+        return true;
+    }
+
+    // Workers start with the first job, so processes that never persist anything spawn no threads
+    void StartLocked() {
+        started_ = true;
+        queueDepth_ = &g_metrics.Gauge("parking_persist_queue_depth", "Write jobs waiting for the persistence workers");
+        for (int k = 0; k < (int)PersistKind::COUNT; k++) {
+            std::string label = std::string("kind=\"") + PersistKindName((PersistKind)k) + "\"";
+            jobs_[k] = &g_metrics.Counter("parking_persist_jobs_total", "Files written by the persistence workers", label);
+            dropped_[k] = &g_metrics.Counter("parking_persist_dropped_total", "Write jobs dropped because the queue was full", label);
+            writeSeconds_[k] = &g_metrics.Histogram("parking_persist_write_seconds", "Encode + write time per persisted file", label);
+        }
+        for (int i = 0; i < PERSIST_WORKERS; i++) workers_.emplace_back(&PersistenceService::WorkerLoop, this);
+    }
+
+    void WorkerLoop() {
+        while (true) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait_for(lock, std::chrono::milliseconds(PERSIST_SYNC_INTERVAL_MS), [&]() { return !running_ || !queue_.empty(); });
+                if (queue_.empty()) {
+                    if (!running_) break;
+                    lock.unlock();
+                    SyncIfDirty(false);
+                    continue;
+                }
+                job = std::move(queue_.front());
+                queue_.pop_front();
+                queueDepth_->set((double)queue_.size());
+                busy_++;
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            bool ok = Write(job);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            writeSeconds_[(int)job.kind]->observe(seconds);
+            if (ok) {
+                jobs_[(int)job.kind]->inc();
+                if (!job.task) MarkWritten(job.path);
+            } else {
+                OutputDebugStringA(("[PERSIST] Failed to write " + job.path + "\n").c_str());
+            }
+            SyncIfDirty(false);
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            busy_--;
+            if (queue_.empty() && busy_ == 0) idleCv_.notify_all();
+        }
+    }
+
+    bool Write(const Job& job) {
+        if (job.task) return job.task();
+        size_t slash = job.path.find_last_of('\\');
+        if (slash != std::string::npos) EnsureDirectory(job.path.substr(0, slash));
+
+        std::vector<uchar> bytes;
+        std::string text;
+        const void* data = nullptr;
+        size_t size = 0;
+        if (!job.image.empty()) {
+            if (!cv::imencode(".jpg", job.image, bytes, job.imageParams)) return false;
+            data = bytes.data();
+            size = bytes.size();
+        } else {
+            text = job.render ? job.render() : std::string();
+            data = text.data();
+            size = text.size();
+        }
+
+        FILE* f = nullptr;
+        if (fopen_s(&f, job.path.c_str(), "wb") != 0 || !f) return false;
+        bool ok = fwrite(data, 1, size, f) == size;
+        return fclose(f) == 0 && ok;
+    }
+
+    void SyncIfDirty(bool force) {
+        if (!dirty_.load()) return;
+        long long nowMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        if (!force && nowMs - lastSyncMs_.load() < PERSIST_SYNC_INTERVAL_MS) return;
+        std::unique_lock<std::mutex> lock(syncMutex_, std::try_to_lock);
+        if (!lock.owns_lock()) return; // Another worker is syncing this batch
+        std::set<std::string> files;
+        {
+            std::lock_guard<std::mutex> unsyncedLock(unsyncedMutex_);
+            files.swap(unsynced_);
+            dirty_ = false;
+        }
+        lastSyncMs_ = nowMs;
+        std::set<std::string> dirs;
+        for (const std::string& path : files) {
+            SyncPath(path);
+            size_t slash = path.find_last_of('\\');
+            if (slash != std::string::npos) dirs.insert(path.substr(0, slash));
+        }
+#ifndef _WIN32
+        for (const std::string& dir : dirs) SyncPath(dir); // New files' directory entries
+#endif
+    }
+
+    static void SyncPath(const std::string& path) {
+#ifdef _WIN32
+        HANDLE h = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                               NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (h == INVALID_HANDLE_VALUE) return;
+        FlushFileBuffers(h);
+        CloseHandle(h);
+#else
+        int fd = open(PlatformPath(path).c_str(), O_RDONLY);
+        if (fd < 0) return;
+        fsync(fd);
+        close(fd);
+#endif
+    }
+};
+
+PLATFORM_SELECTANY PersistenceService g_persistence;
@@ -0,0 +1,159 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+
+// ==========================================
+//  [PORTABLE] Windows API surface used by the engine headers
+// ==========================================
+// The engine (CameraInstance, OnnxYoloInference, BYTETracker, ParkingManager, MjpegServer) is
+// shared between the WinForms app and the headless daemon. On Windows this header only pulls in
+// <windows.h>; elsewhere it provides just enough of the Win32/Winsock names the engine uses.
+// Sockets are included by MjpegServer.h itself (winsock2.h must come before windows.h).
+
+#ifdef _WIN32
+#include <windows.h>
+
+#define PLATFORM_SELECTANY __declspec(selectany)
+
+#else // ---- POSIX ----
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#define PLATFORM_SELECTANY inline // C++17 inline variable: one definition across translation units
+
+// Windows-style absolute paths ("C:\\loc_json\\...") are rooted at PARKING_DATA_ROOT
+inline const std::string& PlatformDataRoot() {
+    static const std::string root = []() {
+        const char* env = std::getenv("PARKING_DATA_ROOT");
+        std::string r = (env && env[0]) ? env : "/var/lib/smart_parking";
+        while (r.size() > 1 && r.back() == '/') r.pop_back();
+        return r;
+    }();
+    return root;
+}
+
+struct SYSTEMTIME {
+    unsigned short wYear, wMonth, wDayOfWeek, wDay, wHour, wMinute, wSecond, wMilliseconds;
+};
+
+inline void GetLocalTime(SYSTEMTIME* st) {
+    timeval tv;
+    gettimeofday(&tv, nullptr);
+    tm local;
+    localtime_r(&tv.tv_sec, &local);
+    st->wYear = (unsigned short)(local.tm_year + 1900);
+    st->wMonth = (unsigned short)(local.tm_mon + 1);
+    st->wDayOfWeek = (unsigned short)local.tm_wday;
+    st->wDay = (unsigned short)local.tm_mday;
+    st->wHour = (unsigned short)local.tm_hour;
+    st->wMinute = (unsigned short)local.tm_min;
+    st->wSecond = (unsigned short)local.tm_sec;
+    st->wMilliseconds = (unsigned short)(tv.tv_usec / 1000);
+}
+
+inline void OutputDebugStringA(const char* msg) {
+    fputs(msg, stderr);
+}
+
+template <size_t N, typename... Args>
+inline int sprintf_s(char (&buffer)[N], const char* format, Args... args) {
+    return snprintf(buffer, N, format, args...);
+}
+
+template <typename... Args>
+inline int sprintf_s(char* buffer, size_t size, const char* format, Args... args) {
+    return snprintf(buffer, size, format, args...);
+}
+
+// ---- Winsock names ----
+typedef int SOCKET;
+typedef struct sockaddr SOCKADDR;
+#define INVALID_SOCKET (-1)
+#define SOCKET_ERROR (-1)
+#define MAKEWORD(a, b) ((unsigned short)(((unsigned char)(a)) | ((unsigned short)((unsigned char)(b))) << 8))
+
+struct WSADATA { int unused; };
+
+inline int WSAStartup(unsigned short, WSADATA*) {
+    signal(SIGPIPE, SIG_IGN); // A viewer closing its tab must not kill the daemon
+    return 0;
+}
+inline int WSACleanup() { return 0; }
+inline int closesocket(SOCKET s) { return close(s); }
+#endif
+
+// Maps the engine's Windows paths to the host filesystem (identity on Windows)
+inline std::string PlatformPath(const std::string& path) {
+#ifdef _WIN32
+    return path;
+#else
+    std::string p = path;
+    std::replace(p.begin(), p.end(), '\\', '/');
+    if (p.size() >= 2 && p[1] == ':' && isalpha((unsigned char)p[0])) p = PlatformDataRoot() + p.substr(2);
+    return p;
+#endif
+}
+
+#ifndef _WIN32
+inline int fopen_s(FILE** file, const char* path, const char* mode) {
+    *file = fopen(PlatformPath(path).c_str(), mode);
+    return *file ? 0 : errno;
+}
+
+// Creates the directory and any missing parents (the Windows code creates each level itself,
+// but PARKING_DATA_ROOT may not exist yet)
+inline bool CreateDirectoryA(const char* path, void*) {
+    std::string p = PlatformPath(path);
+    for (size_t pos = 1; pos <= p.size(); pos++) {
+        if (pos == p.size() || p[pos] == '/') {
+            mkdir(p.substr(0, pos).c_str(), 0755);
+        }
+    }
+    struct stat st;
+    return stat(p.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+#endif
+
+// Names of the entries in `dir` (no "." / ".."): subdirectories or regular files
+inline std::vector<std::string> PlatformListDirectory(const std::string& dir, bool directories) {
+    std::vector<std::string> names;
+#ifdef _WIN32
+    WIN32_FIND_DATAA findData;
+    HANDLE hFind = FindFirstFileA((dir + "\\*").c_str(), &findData);
+    if (hFind == INVALID_HANDLE_VALUE) return names;
+    do {
+        std::string name = findData.cFileName;
+        if (name == "." || name == "..") continue;
+        bool isDir = (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+        if (isDir == directories) names.push_back(name);
+    } while (FindNextFileA(hFind, &findData));
+    FindClose(hFind);
+#else
+    std::string p = PlatformPath(dir);
+    DIR* d = opendir(p.c_str());
+    if (!d) return names;
+    while (dirent* entry = readdir(d)) {
+        std::string name = entry->d_name;
+        if (name == "." || name == "..") continue;
+        struct stat st;
+        if (stat((p + "/" + name).c_str(), &st) != 0) continue;
+        if (S_ISDIR(st.st_mode) == directories) names.push_back(name);
+    }
+    closedir(d);
+#endif
+    return names;
+}
@@ -0,0 +1,316 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include "json.hpp"
+#include "Platform.h"
+
+// ==========================================
+//  [TRACE] Scoped-span tracer with Chrome/Perfetto JSON export
+// ==========================================
+// TRACE_SPAN("name") records one complete event ("ph":"X") into a ring buffer owned by the
+// calling thread. When tracing is off a span is a single relaxed atomic load.
+// Names and categories must be string literals (only the pointer is stored).
+
+const int TRACE_EVENTS_PER_THREAD = 4096;
+const int TRACE_MAX_THREADS = 128; // Beyond this, the longest-idle buffer is recycled
+const int TRACE_LOOKUP_SLOTS = 512; // Thread-id hash -> buffer cache in front of the registry
+const double TRACE_MAX_CAPTURE_SECONDS = 10.0; // Longest a capture request holds its connection thread
+
+struct TraceEvent {
+    const char* name = nullptr;
+    const char* category = nullptr;
+    long long tsUs = 0;  // steady clock
+    long long durUs = 0;
+    int arg = -1;        // Camera id, -1 = none
+};
+
+// External profile (e.g. ONNX Runtime) merged into a dump. Timestamps are absolute
+// system-clock microseconds, converted to the trace clock by the recorder.
+struct ExternalTraceEvent {
+    std::string name;
+    std::string category;
+    long long systemTsUs = 0;
+    long long durUs = 0;
+    int tid = 0;
+};
+using ExternalTraceSource = std::function<std::vector<ExternalTraceEvent>()>;
+
+class TraceRecorder {
+public:
+    static long long NowUs() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    bool IsEnabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    // Continuous tracing (?mode=on|off). Captures running at the time keep it on until they end.
+    void SetEnabled(bool on) {
+        std::lock_guard<std::mutex> lock(enableMutex_);
+        continuous_ = on;
+        enabled_.store(continuous_ || activeCaptures_ > 0);
+    }
+    bool IsContinuous() {
+        std::lock_guard<std::mutex> lock(enableMutex_);
+        return continuous_;
+    }
+
+    // Timed capture: tracing stays on while any capture is open, and an open capture never
+    // turns off continuous tracing when it ends
+    void BeginCapture() {
+        std::lock_guard<std::mutex> lock(enableMutex_);
+        activeCaptures_++;
+        enabled_.store(true);
+    }
+    void EndCapture() {
+        std::lock_guard<std::mutex> lock(enableMutex_);
+        if (activeCaptures_ > 0) activeCaptures_--;
+        enabled_.store(continuous_ || activeCaptures_ > 0);
+    }
+
+    void Record(const char* name, const char* category, long long startUs, long long endUs, int arg) {
+        // The registry is only locked on a thread's first span, after its buffer was recycled, or when
+        // another thread took its lookup slot. Hash of the thread id rather than thread_local: this
+        // header is also pulled into /clr code
+        std::thread::id self = std::this_thread::get_id();
+        std::atomic<ThreadBuffer*>& slot = lookup_[std::hash<std::thread::id>()(self) % TRACE_LOOKUP_SLOTS];
+        ThreadBuffer* buf = slot.load(std::memory_order_acquire);
+        std::unique_lock<std::mutex> lock;
+        for (;;) {
+            if (!buf) {
+                buf = GetThreadBuffer();
+                slot.store(buf, std::memory_order_release);
+            }
+            lock = std::unique_lock<std::mutex>(buf->mutex);
+            if (buf->owner == self) break;
+            lock.unlock(); // Slot shared with another thread, or the buffer was handed on
+            buf = nullptr;
+        }
+        TraceEvent& e = buf->events[buf->next % TRACE_EVENTS_PER_THREAD];
+        e.name = name;
+        e.category = category;
+        e.tsUs = startUs;
+        e.durUs = endUs - startUs;
+        e.arg = arg;
+        buf->next++;
+        buf->lastWriteUs.store(endUs, std::memory_order_relaxed);
+    }
+
+    // Label the calling thread in the trace viewer (cheap; only stored, no buffer needed)
+    void SetThreadName(const std::string& name) {
+        std::lock_guard<std::mutex> lock(registryMutex_);
+        threadNames_[std::this_thread::get_id()] = name;
+    }
+
+    // Returns the token to pass to RemoveExternalSource before whatever the source captures goes away
+    int AddExternalSource(ExternalTraceSource source) {
+        std::lock_guard<std::mutex> lock(sourcesMutex_);
+        int token = nextSourceToken_++;
+        externalSources_[token] = source;
+        return token;
+    }
+
+    // Waits for a dump that is running the source to finish with it
+    void RemoveExternalSource(int token) {
+        std::lock_guard<std::mutex> lock(sourcesMutex_);
+        externalSources_.erase(token);
+    }
+
+    // Chrome trace JSON with every event that started within the last `seconds`
+    std::string DumpChromeJson(double seconds) {
+        long long nowUs = NowUs();
+        long long fromUs = nowUs - (long long)(seconds * 1e6);
+        long long systemNowUs = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        long long systemToSteadyUs = nowUs - systemNowUs;
+
+        std::vector<ThreadBuffer*> buffers;
+        {
+            std::lock_guard<std::mutex> lock(registryMutex_);
+            for (auto& b : buffers_) buffers.push_back(b.get());
+        }
+
+        std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        bool first = true;
+        char buf[512];
+
+        for (ThreadBuffer* b : buffers) {
+            std::lock_guard<std::mutex> lock(b->mutex);
+            if (b->next == 0) continue;
+            snprintf(buf, sizeof(buf), "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",", b->tid, EscapeJson(b->threadName).c_str());
+            out += buf;
+            first = false;
+
+            long long count = b->next < TRACE_EVENTS_PER_THREAD ? b->next : TRACE_EVENTS_PER_THREAD;
+            for (long long i = b->next - count; i < b->next; i++) {
+                const TraceEvent& e = b->events[i % TRACE_EVENTS_PER_THREAD];
+                if (e.tsUs < fromUs || !e.name) continue;
+                if (e.arg >= 0) {
+                    snprintf(buf, sizeof(buf), ",{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":1,\"tid\":%d,\"args\":{\"camera\":%d}}",
+                        e.name, e.category, e.tsUs, e.durUs, b->tid, e.arg);
+                } else {
+                    snprintf(buf, sizeof(buf), ",{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":1,\"tid\":%d}",
+                        e.name, e.category, e.tsUs, e.durUs, b->tid);
+                }
+                out += buf;
+            }
+        }
+
+        std::lock_guard<std::mutex> sourcesLock(sourcesMutex_);
+        for (auto& source : externalSources_) {
+            std::vector<ExternalTraceEvent> events;
+            try { events = source.second(); } catch (...) {}
+            for (const auto& e : events) {
+                long long ts = e.systemTsUs + systemToSteadyUs;
+                if (ts < fromUs) continue;
+                snprintf(buf, sizeof(buf), "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":2,\"tid\":%d}",
+                    first ? "" : ",", EscapeJson(e.name).c_str(), EscapeJson(e.category).c_str(), ts, e.durUs, e.tid);
+                out += buf;
+                first = false;
+            }
+        }
+        if (!externalSources_.empty()) {
+            out += std::string(first ? "" : ",") + "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":2,\"args\":{\"name\":\"onnxruntime\"}}";
+            first = false;
+        }
+        out += std::string(first ? "" : ",") + "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"parking pipeline\"}}";
+        out += "]}";
+        return out;
+    }
+
+private:
+    struct ThreadBuffer {
+        std::mutex mutex;
+        std::thread::id owner;
+        int tid = 0;
+        std::string threadName;
+        std::vector<TraceEvent> events;
+        long long next = 0;
+        std::atomic<long long> lastWriteUs{ 0 }; // Read without the buffer lock when picking one to recycle
+    };
+
+    std::atomic<bool> enabled_{ false };
+    std::mutex enableMutex_; // Serializes changes to enabled_ from the two sources below
+    bool continuous_ = false;
+    int activeCaptures_ = 0;
+    std::atomic<ThreadBuffer*> lookup_[TRACE_LOOKUP_SLOTS] = {};
+    std::mutex registryMutex_;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers_; // Never freed, only recycled
+    std::map<std::thread::id, ThreadBuffer*> byThread_;
+    std::map<std::thread::id, std::string> threadNames_;
+    std::mutex sourcesMutex_; // Held while sources run, so RemoveExternalSource can't race a dump
+    std::map<int, ExternalTraceSource> externalSources_;
+    int nextSourceToken_ = 1;
+    int nextTid_ = 1;
+
+    ThreadBuffer* GetThreadBuffer() {
+        std::thread::id self = std::this_thread::get_id();
+        std::lock_guard<std::mutex> lock(registryMutex_);
+        auto it = byThread_.find(self);
+        if (it != byThread_.end()) return it->second;
+
+        ThreadBuffer* buf = nullptr;
+        if ((int)buffers_.size() < TRACE_MAX_THREADS) {
+            buffers_.emplace_back(new ThreadBuffer());
+            buf = buffers_.back().get();
+            buf->events.resize(TRACE_EVENTS_PER_THREAD);
+        } else {
+            // Short-lived HTTP threads come and go; hand the stalest buffer to the newcomer
+            for (auto& b : buffers_) {
+                if (!buf || b->lastWriteUs.load(std::memory_order_relaxed) < buf->lastWriteUs.load(std::memory_order_relaxed)) buf = b.get();
+            }
+            byThread_.erase(buf->owner);
+        }
+
+        std::lock_guard<std::mutex> bufLock(buf->mutex);
+        buf->owner = self;
+        buf->tid = nextTid_++;
+        buf->next = 0;
+        buf->lastWriteUs.store(NowUs(), std::memory_order_relaxed);
+        auto nameIt = threadNames_.find(self);
+        buf->threadName = nameIt != threadNames_.end() ? nameIt->second : "thread " + std::to_string(buf->tid);
+        byThread_[self] = buf;
+        return buf;
+    }
+
+    static std::string EscapeJson(const std::string& s) {
+        std::string out;
+        out.reserve(s.size());
+        for (char c : s) {
+            if (c == '"' || c == '\\') { out += '\\'; out += c; }
+            else if ((unsigned char)c < 0x20) out += ' ';
+            else out += c;
+        }
+        return out;
+    }
+};
+
+PLATFORM_SELECTANY TraceRecorder g_traceRecorder;
+
+class TraceSpan {
+public:
+    TraceSpan(const char* name, const char* category = "pipeline", int arg = -1)
+        : name_(name), category_(category), arg_(arg), startUs_(0) {
+        if (g_traceRecorder.IsEnabled()) startUs_ = TraceRecorder::NowUs();
+    }
+    ~TraceSpan() { end(); }
+
+    // Close the span before the end of its scope (for spans that declare variables used later)
+    void end() {
+        if (startUs_ != 0) g_traceRecorder.Record(name_, category_, startUs_, TraceRecorder::NowUs(), arg_);
+        startUs_ = 0;
+    }
+private:
+    const char* name_;
+    const char* category_;
+    int arg_;
+    long long startUs_;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SPAN(name) TraceSpan TRACE_CONCAT(_traceSpan_, __LINE__)(name)
+#define TRACE_SPAN_CAM(name, cameraId) TraceSpan TRACE_CONCAT(_traceSpan_, __LINE__)(name, "pipeline", cameraId)
+
+// Reads an ONNX Runtime profile (JSON array of complete events, ts relative to the session's
+// profiling start) into external events.
+// ORT stamps its start with high_resolution_clock, which is steady_clock on MSVC and
+// system_clock on libstdc++, so the start is mapped to the system clock when it isn't one.
+inline std::vector<ExternalTraceEvent> LoadOrtProfile(const std::string& path, long long profilingStartNs, int tidOffset) {
+    std::vector<ExternalTraceEvent> events;
+    std::ifstream file(path);
+    if (!file.is_open()) return events;
+    try {
+        nlohmann::json j = nlohmann::json::parse(file);
+        if (!j.is_array()) return events;
+        long long startUs = profilingStartNs / 1000;
+        long long systemNowUs = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        const long long oneDayUs = 86400LL * 1000000LL;
+        if (startUs < systemNowUs - oneDayUs || startUs > systemNowUs + oneDayUs) {
+            startUs += systemNowUs - TraceRecorder::NowUs();
+        }
+        for (const auto& e : j) {
+            if (!e.contains("ts") || !e.contains("dur")) continue;
+            ExternalTraceEvent ev;
+            ev.name = e.value("name", std::string("ort"));
+            ev.category = e.value("cat", std::string("ort"));
+            ev.systemTsUs = startUs + e["ts"].get<long long>();
+            ev.durUs = e["dur"].get<long long>();
+            ev.tid = tidOffset + (e.contains("tid") && e["tid"].is_number() ? e["tid"].get<int>() % 1000 : 0);
+            events.push_back(ev);
+        }
+    }
+    catch (...) {}
+    return events;
+}
@@ -0,0 +1,305 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "Platform.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+}
+
+#ifdef _MSC_VER
+#pragma comment(lib, "avformat.lib")
+#pragma comment(lib, "avcodec.lib")
+#pragma comment(lib, "avutil.lib")
+#endif
+
+// ==========================================
+//  [SEEK INDEX] Keyframe / timestamp index of a recorded video
+// ==========================================
+// A background thread demuxes the file once (packets only, nothing is decoded) and keeps every
+// video frame's pts in display order plus the positions of the keyframes. The result is cached
+// next to the video as <video>.kfidx (or under C:\smart_parking_offline\seek_index when that
+// folder is read-only) and reused while the file's size and mtime are unchanged.
+
+const uint32_t SEEK_INDEX_MAGIC = 0x5844494B; // "KIDX"
+const uint32_t SEEK_INDEX_VERSION = 1;
+const int SEEK_INDEX_MIN_SKIP = 16; // Fast-forward seeks only past this many frames, grab() is cheaper below
+
+class VideoSeekIndex {
+public:
+    ~VideoSeekIndex() { Stop(); }
+
+    // Drops the current index and starts indexing `path` on a background thread
+    void StartBackground(const std::string& path) {
+        Stop();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pts_.clear();
+            keyframes_.clear();
+            fps_ = 0;
+        }
+        ready_ = false;
+        cancel_ = false;
+        worker_ = std::thread([this, path]() {
+            bool ok = Load(path) || Build(path);
+            if (ok) ready_ = true;
+            OutputDebugStringA(("[SEEK INDEX] " + path + (ok ? ": " + std::to_string(FrameCount()) + " frames, " +
+                std::to_string(KeyframeCount()) + " keyframes\n" : ": indexing failed\n")).c_str());
+        });
+    }
+
+    void Stop() {
+        cancel_ = true;
+        if (worker_.joinable()) worker_.join();
+    }
+
+    bool IsReady() const { return ready_.load(); }
+
+    long long FrameCount() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return (long long)pts_.size();
+    }
+
+    long long KeyframeCount() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return (long long)keyframes_.size();
+    }
+
+    double Fps() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return fps_;
+    }
+
+    // Presentation time of `frame` in seconds from the first frame
+    double TimestampSec(long long frame) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (pts_.empty()) return 0;
+        frame = std::max(0LL, std::min(frame, (long long)pts_.size() - 1));
+        return (pts_[(size_t)frame] - pts_[0]) * timeBase_;
+    }
+
+    // Last frame shown at or before `sec`
+    long long FrameAtTime(double sec) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (pts_.empty()) return 0;
+        int64_t target = pts_[0] + (int64_t)(sec / timeBase_ + 0.5);
+        auto it = std::upper_bound(pts_.begin(), pts_.end(), target);
+        return it == pts_.begin() ? 0 : (long long)(it - pts_.begin()) - 1;
+    }
+
+    // Nearest keyframe at or before `frame` (0 when the index isn't ready)
+    long long KeyframeAtOrBefore(long long frame) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = std::upper_bound(keyframes_.begin(), keyframes_.end(), (int64_t)frame);
+        return it == keyframes_.begin() ? 0 : (long long)*(it - 1);
+    }
+
+private:
+    std::thread worker_;
+    std::atomic<bool> cancel_{ false };
+    std::atomic<bool> ready_{ false };
+    mutable std::mutex mutex_;
+    std::vector<int64_t> pts_;       // Display order, stream time base
+    std::vector<int64_t> keyframes_; // Ascending frame indices
+    double timeBase_ = 0;
+    double fps_ = 0;
+
+    struct FileStamp {
+        int64_t size = 0;
+        int64_t mtime = 0;
+    };
+
+    static bool Stamp(const std::string& path, FileStamp& stamp) {
+#ifdef _WIN32
+        struct _stat64 st;
+        if (_stat64(path.c_str(), &st) != 0) return false;
+#else
+        struct stat st;
+        if (stat(PlatformPath(path).c_str(), &st) != 0) return false;
+#endif
+        stamp.size = (int64_t)st.st_size;
+        stamp.mtime = (int64_t)st.st_mtime;
+        return true;
+    }
+
+    static std::string FallbackCachePath(const std::string& path, const FileStamp& stamp) {
+        size_t slash = path.find_last_of("\\/");
+        std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+        return "C:\\smart_parking_offline\\seek_index\\" + name + "_" + std::to_string(stamp.size) + ".kfidx";
+    }
+
+    static int InterruptCallback(void* opaque) {
+        return static_cast<VideoSeekIndex*>(opaque)->cancel_.load() ? 1 : 0;
+    }
+
+    bool Build(const std::string& path) {
+        AVFormatContext* fmtCtx = avformat_alloc_context();
+        if (!fmtCtx) return false;
+        fmtCtx->interrupt_callback.callback = &VideoSeekIndex::InterruptCallback;
+        fmtCtx->interrupt_callback.opaque = this;
+        if (avformat_open_input(&fmtCtx, PlatformPath(path).c_str(), nullptr, nullptr) < 0) return false;
+        if (avformat_find_stream_info(fmtCtx, nullptr) < 0) {
+            avformat_close_input(&fmtCtx);
+            return false;
+        }
+        int videoStream = av_find_best_stream(fmtCtx, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+        if (videoStream < 0) {
+            avformat_close_input(&fmtCtx);
+            return false;
+        }
+        AVStream* stream = fmtCtx->streams[videoStream];
+        // Other streams are dropped by the demuxer instead of being read and thrown away
+        for (unsigned i = 0; i < fmtCtx->nb_streams; i++) {
+            if ((int)i != videoStream) fmtCtx->streams[i]->discard = AVDISCARD_ALL;
+        }
+
+        // Packets arrive in decode order; remember each one's pts and key flag and sort afterwards
+        std::vector<std::pair<int64_t, bool>> frames;
+        AVPacket* packet = av_packet_alloc();
+        int64_t lastTs = 0;
+        while (packet && !cancel_ && av_read_frame(fmtCtx, packet) >= 0) {
+            if (packet->stream_index == videoStream) {
+                int64_t ts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+                if (ts == AV_NOPTS_VALUE) ts = lastTs + 1;
+                lastTs = ts;
+                frames.push_back({ ts, (packet->flags & AV_PKT_FLAG_KEY) != 0 });
+            }
+            av_packet_unref(packet);
+        }
+        av_packet_free(&packet);
+
+        AVRational rate = stream->avg_frame_rate.num > 0 ? stream->avg_frame_rate : stream->r_frame_rate;
+        double timeBase = av_q2d(stream->time_base);
+        avformat_close_input(&fmtCtx);
+        if (cancel_ || frames.empty()) return false;
+
+        std::stable_sort(frames.begin(), frames.end(),
+            [](const std::pair<int64_t, bool>& a, const std::pair<int64_t, bool>& b) { return a.first < b.first; });
+        std::vector<int64_t> pts;
+        std::vector<int64_t> keyframes;
+        pts.reserve(frames.size());
+        for (size_t i = 0; i < frames.size(); i++) {
+            pts.push_back(frames[i].first);
+            if (frames[i].second) keyframes.push_back((int64_t)i);
+        }
+        if (keyframes.empty() || keyframes[0] != 0) keyframes.insert(keyframes.begin(), 0);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pts_.swap(pts);
+            keyframes_.swap(keyframes);
+            timeBase_ = timeBase;
+            fps_ = (rate.num > 0 && rate.den > 0) ? av_q2d(rate) : 0.0;
+        }
+        Save(path);
+        return true;
+    }
+
+    // Layout: magic, version, size, mtime, time base, fps, frame count, keyframe count, pts[], keyframes[]
+    bool Save(const std::string& path) {
+        FileStamp stamp;
+        if (!Stamp(path, stamp)) return false;
+        FILE* f = nullptr;
+        if (fopen_s(&f, (path + ".kfidx").c_str(), "wb") != 0 || !f) {
+            CreateDirectoryA("C:\\smart_parking_offline", NULL);
+            CreateDirectoryA("C:\\smart_parking_offline\\seek_index", NULL);
+            f = nullptr;
+            if (fopen_s(&f, FallbackCachePath(path, stamp).c_str(), "wb") != 0 || !f) return false;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint64_t frameCount = pts_.size();
+        uint64_t keyCount = keyframes_.size();
+        bool ok = fwrite(&SEEK_INDEX_MAGIC, sizeof(uint32_t), 1, f) == 1
+            && fwrite(&SEEK_INDEX_VERSION, sizeof(uint32_t), 1, f) == 1
+            && fwrite(&stamp.size, sizeof(int64_t), 1, f) == 1
+            && fwrite(&stamp.mtime, sizeof(int64_t), 1, f) == 1
+            && fwrite(&timeBase_, sizeof(double), 1, f) == 1
+            && fwrite(&fps_, sizeof(double), 1, f) == 1
+            && fwrite(&frameCount, sizeof(uint64_t), 1, f) == 1
+            && fwrite(&keyCount, sizeof(uint64_t), 1, f) == 1
+            && fwrite(pts_.data(), sizeof(int64_t), pts_.size(), f) == pts_.size()
+            && fwrite(keyframes_.data(), sizeof(int64_t), keyframes_.size(), f) == keyframes_.size();
+        fclose(f);
+        return ok;
+    }
+
+    bool Load(const std::string& path) {
+        FileStamp stamp;
+        if (!Stamp(path, stamp)) return false;
+        std::string indexPath = path + ".kfidx";
+        FILE* f = nullptr;
+        if (fopen_s(&f, indexPath.c_str(), "rb") != 0 || !f) {
+            f = nullptr;
+            indexPath = FallbackCachePath(path, stamp);
+            if (fopen_s(&f, indexPath.c_str(), "rb") != 0 || !f) return false;
+        }
+        FileStamp indexStamp;
+        if (!Stamp(indexPath, indexStamp)) {
+            fclose(f);
+            return false;
+        }
+
+        uint32_t magic = 0, version = 0;
+        FileStamp cached;
+        double timeBase = 0, fps = 0;
+        uint64_t frameCount = 0, keyCount = 0;
+        bool ok = fread(&magic, sizeof(uint32_t), 1, f) == 1 && magic == SEEK_INDEX_MAGIC
+            && fread(&version, sizeof(uint32_t), 1, f) == 1 && version == SEEK_INDEX_VERSION
+            && fread(&cached.size, sizeof(int64_t), 1, f) == 1 && cached.size == stamp.size
+            && fread(&cached.mtime, sizeof(int64_t), 1, f) == 1 && cached.mtime == stamp.mtime
+            && fread(&timeBase, sizeof(double), 1, f) == 1 && timeBase > 0
+            && fread(&fps, sizeof(double), 1, f) == 1
+            && fread(&frameCount, sizeof(uint64_t), 1, f) == 1 && frameCount > 0
+            && fread(&keyCount, sizeof(uint64_t), 1, f) == 1 && keyCount > 0 && keyCount <= frameCount;
+
+        // A corrupt count must not size the arrays beyond what the file can hold
+        const uint64_t headerBytes = 2 * sizeof(uint32_t) + 6 * sizeof(int64_t);
+        uint64_t entries = (uint64_t)indexStamp.size > headerBytes ? ((uint64_t)indexStamp.size - headerBytes) / sizeof(int64_t) : 0;
+        ok = ok && frameCount <= entries && keyCount <= entries - frameCount;
+
+        std::vector<int64_t> pts;
+        std::vector<int64_t> keyframes;
+        if (ok) {
+            pts.resize((size_t)frameCount);
+            keyframes.resize((size_t)keyCount);
+            ok = fread(pts.data(), sizeof(int64_t), pts.size(), f) == pts.size()
+                && fread(keyframes.data(), sizeof(int64_t), keyframes.size(), f) == keyframes.size();
+        }
+        fclose(f);
+        if (!ok) return false;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        pts_.swap(pts);
+        keyframes_.swap(keyframes);
+        timeBase_ = timeBase;
+        fps_ = fps;
+        return true;
+    }
+};
+
+// Positions `cap` exactly on `frame`: a keyframe seek followed by grab() up to the target, so
+// only the frames in between are decoded and none of them is converted. Without a ready index
+// the backend's own seek is used. Returns the index of the frame the next read() returns, which
+// falls short of `frame` when grabbing stops early.
+inline long long SeekToFrame(cv::VideoCapture& cap, const VideoSeekIndex& index, long long frame) {
+    if (!index.IsReady()) {
+        cap.set(cv::CAP_PROP_POS_FRAMES, (double)frame);
+        return (long long)cap.get(cv::CAP_PROP_POS_FRAMES);
+    }
+    frame = std::max(0LL, std::min(frame, index.FrameCount() - 1));
+    long long position = index.KeyframeAtOrBefore(frame);
+    cap.set(cv::CAP_PROP_POS_FRAMES, (double)position);
+    while (position < frame && cap.grab()) position++;
+    return position;
+}
@@ -0,0 +1,183 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "Platform.h"
+
+// ==========================================
+//  [WEBSOCKET] Framing for the /api/{id}/ws live channel (RFC 6455, server side)
+// ==========================================
+// One connection carries the picture and what the AI saw in it, paired by frame sequence:
+//   server -> client, binary: uint8 kind, then
+//     WS_KIND_METADATA  the frame's metadata record, same layout as a .meta record (see MetadataTrack.h)
+//                       with t_ms = epoch ms the frame was rendered
+//     WS_KIND_JPEG      int64 seq, JPEG bytes
+//   The metadata message of a frame always comes right before its picture.
+//   client -> server, text: {"credit":N} allows N more frames. Nothing is sent without credit, so a
+//   client that acknowledges each frame as it draws it never has more than N frames in flight; frames
+//   produced meanwhile are skipped and the next one sent is always the newest.
+// Little-endian throughout, like the .meta files.
+
+const uint8_t WS_KIND_METADATA = 1;
+const uint8_t WS_KIND_JPEG = 2;
+const int WS_MAX_CREDIT = 64;
+const size_t WS_MAX_CLIENT_MESSAGE = 64 * 1024; // Client messages are small control/credit messages
+
+const uint8_t WS_OP_CONTINUATION = 0x0;
+const uint8_t WS_OP_TEXT = 0x1;
+const uint8_t WS_OP_BINARY = 0x2;
+const uint8_t WS_OP_CLOSE = 0x8;
+const uint8_t WS_OP_PING = 0x9;
+const uint8_t WS_OP_PONG = 0xA;
+
+// SHA-1 of `data`, only used for the handshake's Sec-WebSocket-Accept
+inline void WebSocketSha1(const std::string& data, unsigned char digest[20]) {
+    uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+    std::string msg = data;
+    uint64_t bitLength = (uint64_t)data.size() * 8;
+    msg += (char)0x80;
+    while (msg.size() % 64 != 56) msg += (char)0;
+    for (int i = 7; i >= 0; i--) msg += (char)((bitLength >> (i * 8)) & 0xFF);
+
+    auto rol = [](uint32_t v, int n) { return (v << n) | (v >> (32 - n)); };
+    for (size_t chunk = 0; chunk < msg.size(); chunk += 64) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; i++) {
+            const unsigned char* p = (const unsigned char*)msg.data() + chunk + i * 4;
+            w[i] = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+        }
+        for (int i = 16; i < 80; i++) w[i] = rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; i++) {
+            uint32_t f, k;
+            if (i < 20) { f = (b & c) | (~b & d); k = 0x5A827999; }
+            else if (i < 40) { f = b ^ c ^ d; k = 0x6ED9EBA1; }
+            else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+            else { f = b ^ c ^ d; k = 0xCA62C1D6; }
+            uint32_t t = rol(a, 5) + f + e + k + w[i];
+            e = d; d = c; c = rol(b, 30); b = a; a = t;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+    }
+    for (int i = 0; i < 5; i++) {
+        digest[i * 4] = (unsigned char)(h[i] >> 24);
+        digest[i * 4 + 1] = (unsigned char)(h[i] >> 16);
+        digest[i * 4 + 2] = (unsigned char)(h[i] >> 8);
+        digest[i * 4 + 3] = (unsigned char)h[i];
+    }
+}
+
+inline std::string WebSocketBase64(const unsigned char* data, size_t size) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    for (size_t i = 0; i < size; i += 3) {
+        uint32_t v = (uint32_t)data[i] << 16;
+        if (i + 1 < size) v |= (uint32_t)data[i + 1] << 8;
+        if (i + 2 < size) v |= data[i + 2];
+        out += alphabet[(v >> 18) & 63];
+        out += alphabet[(v >> 12) & 63];
+        out += i + 1 < size ? alphabet[(v >> 6) & 63] : '=';
+        out += i + 2 < size ? alphabet[v & 63] : '=';
+    }
+    return out;
+}
+
+// Sec-WebSocket-Accept for the client's Sec-WebSocket-Key
+inline std::string WebSocketAcceptKey(const std::string& clientKey) {
+    unsigned char digest[20];
+    WebSocketSha1(clientKey + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11", digest);
+    return WebSocketBase64(digest, sizeof(digest));
+}
+
+// Header of an unmasked, unfragmented server frame whose payload is `payloadSize` bytes
+inline std::string WebSocketFrameHeader(uint8_t opcode, size_t payloadSize) {
+    std::string header;
+    header += (char)(0x80 | opcode);
+    if (payloadSize < 126) {
+        header += (char)payloadSize;
+    } else if (payloadSize <= 0xFFFF) {
+        header += (char)126;
+        header += (char)(payloadSize >> 8);
+        header += (char)(payloadSize & 0xFF);
+    } else {
+        header += (char)127;
+        for (int i = 7; i >= 0; i--) header += (char)(((uint64_t)payloadSize >> (i * 8)) & 0xFF);
+    }
+    return header;
+}
+
+struct WebSocketMessage {
+    uint8_t opcode = 0;
+    std::string payload;
+};
+
+// Reassembles client frames (masked, possibly fragmented or split across recv calls) into messages
+class WebSocketReader {
+public:
+    void Feed(const char* data, size_t size) { buffer_.append(data, size); }
+
+    // False when no complete message is buffered yet; check Failed() for protocol errors
+    bool Next(WebSocketMessage& out) {
+        while (!failed_) {
+            if (buffer_.size() < 2) return false;
+            const unsigned char* p = (const unsigned char*)buffer_.data();
+            bool fin = (p[0] & 0x80) != 0;
+            uint8_t opcode = p[0] & 0x0F;
+            bool masked = (p[1] & 0x80) != 0;
+            uint64_t length = p[1] & 0x7F;
+            size_t at = 2;
+            if (length == 126) {
+                if (buffer_.size() < 4) return false;
+                length = ((uint64_t)p[2] << 8) | p[3];
+                at = 4;
+            } else if (length == 127) {
+                if (buffer_.size() < 10) return false;
+                length = 0;
+                for (int i = 0; i < 8; i++) length = (length << 8) | p[2 + i];
+                at = 10;
+            }
+            // partial_ never exceeds the limit, and comparing this way round can't wrap on a 64-bit length
+            if (!masked || length > WS_MAX_CLIENT_MESSAGE - partial_.size()) { failed_ = true; return false; }
+            if (buffer_.size() < at + 4 + length) return false;
+
+            const unsigned char* mask = p + at;
+            std::string payload(buffer_, at + 4, (size_t)length);
+            for (size_t i = 0; i < payload.size(); i++) payload[i] ^= mask[i % 4];
+            buffer_.erase(0, at + 4 + (size_t)length);
+
+            if (opcode >= WS_OP_CLOSE) { // Control frames may arrive between fragments
+                out.opcode = opcode;
+                out.payload.swap(payload);
+                return true;
+            }
+            if (opcode != WS_OP_CONTINUATION) partialOpcode_ = opcode;
+            partial_ += payload;
+            if (!fin) continue;
+            out.opcode = partialOpcode_;
+            out.payload.swap(partial_);
+            partial_.clear();
+            return true;
+        }
+        return false;
+    }
+
+    bool Failed() const { return failed_; }
+
+private:
+    std::string buffer_;
+    std::string partial_;
+    uint8_t partialOpcode_ = WS_OP_TEXT;
+    bool failed_ = false;
+};
+
+// {"credit":N} -> N (0 when the message is something else)
+inline int WebSocketCredit(const std::string& text) {
+    size_t pos = text.find("\"credit\"");
+    if (pos == std::string::npos) return 0;
+    pos = text.find(':', pos);
+    if (pos == std::string::npos) return 0;
+    return std::max(0, std::min(WS_MAX_CREDIT, atoi(text.c_str() + pos + 1)));
+}
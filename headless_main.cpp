@@ -0,0 +1,169 @@
+// ===================== Headless daemon =====================
+// Runs the camera pipelines and the web server without the WinForms UI (Linux edge servers,
+// benchmarks). Cameras come from C:\camera_ids\cameras.json (under PARKING_DATA_ROOT off Windows):
+//   [{"id": 1, "name": "Gate", "rtspUrl": "rtsp://...", "template": "parking_templates/gate.xml"}]
+// The HTTP API can still connect/disconnect cameras and upload templates at runtime.
+// With --analyze it instead runs a recording (or a DVR folder) through the unpaced batch pipeline
+// on a pool of segment workers, writes the logs and exits.
+#include "CameraInstance.h"
+#include "OfflineJobRunner.h"
+#include <csignal>
+#include <cstring>
+
+static std::atomic<bool> g_daemonRunning(true);
+static OfflineJobRunner* g_batchJob = nullptr;
+
+static void HandleStopSignal(int) {
+    g_daemonRunning = false;
+    if (g_batchJob) g_batchJob->Cancel();
+}
+
+static void PrintUsage() {
+    printf("Usage: parking_daemon [--port N] [--model path.onnx] [--gpu N]\n"
+           "       parking_daemon --analyze video.mp4|folder [--template slots.xml] [--stride K] [--workers N]\n"
+           "                      [--segment-min M] [--cpu] [--no-cache] [--out dir] [--model ...] [--gpu N]\n"
+           "  --port      HTTP port for the dashboard and API (default 8080)\n"
+           "  --model     ONNX model (default models/test/yolo26s.onnx)\n"
+           "  --gpu       CUDA device id, falls back to CPU when CUDA is unavailable (default 0)\n"
+           "  --analyze   Analyze a recording or a folder of clips as fast as possible, write the logs and exit\n"
+           "  --template  Parking template for --analyze (without one only detection and tracking run)\n"
+           "  --stride    Analyze every K-th frame (default 1 = every frame)\n"
+           "  --workers   Segments analyzed in parallel (default 2 on GPU, one per core with --cpu)\n"
+           "  --segment-min  Segment length in minutes (default 10)\n"
+           "  --cpu       Run inference on the CPU (one single-threaded session per worker)\n"
+           "  --no-cache  Run the model even when an earlier run's detections are cached\n"
+           "  --out       Output folder for --analyze (default under C:\\smart_parking_offline)\n"
+           "Environment: PARKING_DATA_ROOT (default /var/lib/smart_parking on Linux)\n");
+}
+
+int main(int argc, char** argv) {
+    int port = 8080;
+    std::string modelPath = "models/test/yolo26s.onnx";
+    OfflineJobOptions batch;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--port" && hasValue) port = atoi(argv[++i]);
+        else if (arg == "--model" && hasValue) modelPath = argv[++i];
+        else if (arg == "--gpu" && hasValue) g_selectedGpuId = atoi(argv[++i]);
+        else if (arg == "--analyze" && hasValue) batch.inputPath = argv[++i];
+        else if (arg == "--template" && hasValue) batch.analysis.templatePath = argv[++i];
+        else if (arg == "--stride" && hasValue) batch.analysis.stride = atoi(argv[++i]);
+        else if (arg == "--workers" && hasValue) batch.workers = atoi(argv[++i]);
+        else if (arg == "--segment-min" && hasValue) batch.segmentSeconds = atof(argv[++i]) * 60.0;
+        else if (arg == "--cpu") batch.analysis.useGpu = false;
+        else if (arg == "--no-cache") batch.analysis.useDetectionCache = false;
+        else if (arg == "--out" && hasValue) batch.outputDir = argv[++i];
+        else if (arg == "--help" || arg == "-h") { PrintUsage(); return 0; }
+        else {
+            fprintf(stderr, "Unknown or incomplete option: %s\n", arg.c_str());
+            PrintUsage();
+            return 2;
+        }
+    }
+
+    signal(SIGINT, HandleStopSignal);
+    signal(SIGTERM, HandleStopSignal);
+
+    if (!batch.inputPath.empty()) {
+        batch.analysis.modelPath = modelPath;
+        batch.analysis.gpuId = g_selectedGpuId;
+        OfflineJobRunner job;
+        g_batchJob = &job;
+        OfflineJobReport report = job.Run(batch);
+        g_batchJob = nullptr;
+        printf("%s\n", report.ToJson().c_str());
+        return report.ok ? 0 : 1;
+    }
+
+    g_globalWebServer = new MjpegServer(port);
+    g_globalWebServer->onGetFrame = [](int cameraId) {
+        cv::Mat frame;
+        long long seq;
+        GetCam(cameraId)->GetProcessedFrameOnline(frame, seq);
+        return frame.clone();
+    };
+    g_globalWebServer->onGetRawFrame = [](int cameraId) {
+        // [REDUCED RES] Template editing needs native resolution; fall back to the processing frame
+        cv::Mat frame = GetCam(cameraId)->GetFullResFrame_Online();
+        if (!frame.empty()) return frame;
+        long long seq;
+        GetCam(cameraId)->GetRawFrameOnline(frame, seq);
+        return frame.clone();
+    };
+    g_globalWebServer->onSaveTemplate = [](int cameraId, std::string xmlContent) {
+        return SaveParkingTemplateXml_Online(cameraId, xmlContent);
+    };
+    g_globalWebServer->onConnectOnline = [modelPath](int cameraId, std::string ip, std::string port, std::string path) {
+        DumpLog("[CONNECT] Received connect request for cam " + std::to_string(cameraId) + ": " + ip + ":" + port + path);
+        return StartCameraFromUrls_Online(cameraId, CandidateStreamUrls_Online(ip, port, path), modelPath);
+    };
+    g_globalWebServer->onDisconnect = [](int cameraId) {
+        DumpLog("[DISCONNECT] Received disconnect request for cam " + std::to_string(cameraId) + ".");
+        GetCam(cameraId)->StopProcessing();
+    };
+
+    if (!g_globalWebServer->Start()) {
+        DumpLog("[DAEMON] ERROR: could not listen on port " + std::to_string(port));
+        return 1;
+    }
+    DumpLog("[DAEMON] Web server listening on port " + std::to_string(port));
+
+    // Cameras connect in parallel; an unreachable one must not hold up the others
+    std::vector<std::thread> connectThreads;
+    std::vector<CameraConfig> cameras = CameraManager::LoadCameras();
+    if (cameras.empty()) {
+        DumpLog("[DAEMON] No cameras configured, waiting for /api/{id}/connect_online");
+    }
+    for (const CameraConfig& cfg : cameras) {
+        CameraInstance* cam = GetCam(cfg.id);
+        if (!cfg.templatePath.empty() && !cam->LoadParkingTemplate_Online(cfg.templatePath)) {
+            DumpLog("[DAEMON] WARNING: could not load template " + cfg.templatePath + " for camera " + std::to_string(cfg.id));
+        }
+        if (cfg.rtspUrl.empty()) continue;
+        connectThreads.emplace_back([cfg, modelPath]() {
+            StartCameraFromUrls_Online(cfg.id, std::vector<std::string>{ cfg.rtspUrl }, modelPath);
+        });
+    }
+
+    // Same job as StreamingThreadFunc in main.cpp: hand each new processed frame to the web server
+    std::map<int, long long> lastSeqs;
+    while (g_daemonRunning.load()) {
+        std::vector<CameraInstance*> cams;
+        {
+            std::lock_guard<std::mutex> lock(g_camerasMutex);
+            for (auto& entry : g_cameras) cams.push_back(entry.second);
+        }
+        for (CameraInstance* cam : cams) {
+            cv::Mat outFrame;
+            long long displaySeq = 0;
+            FrameTimestamps frameTs;
+            MetadataFrame frameMeta;
+            cam->GetProcessedFrameOnline(outFrame, displaySeq, &frameTs, &frameMeta);
+
+            if (!outFrame.empty() && displaySeq != lastSeqs[cam->camera_id]) {
+                g_globalWebServer->SetLatestFrame(cam->camera_id, outFrame, frameTs, &frameMeta);
+                lastSeqs[cam->camera_id] = displaySeq;
+            } else if (outFrame.empty()) {
+                cv::Mat raw;
+                long long rawSeq = 0;
+                cam->GetRawFrameOnline(raw, rawSeq);
+                if (!raw.empty()) g_globalWebServer->SetLatestFrame(cam->camera_id, raw);
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(33)); // ~30 FPS
+    }
+
+    DumpLog("[DAEMON] Shutting down...");
+    for (auto& t : connectThreads) {
+        if (t.joinable()) t.join();
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_camerasMutex);
+        for (auto& entry : g_cameras) entry.second->StopProcessing();
+    }
+    g_persistence.Stop(); // Writes out queued snapshots and event records
+    g_globalWebServer->Stop();
+    return 0;
+}
@@ -26,12 +26,14 @@ void StreamingThreadFunc() {
         for (int i = 1; i <= 4; ++i) {            
             cv::Mat outFrame;
             long long displaySeq = 0;
+            FrameTimestamps frameTs;
+            MetadataFrame frameMeta;
 
-            GetCam(i)->GetProcessedFrameOnline(outFrame, displaySeq);
+            GetCam(i)->GetProcessedFrameOnline(outFrame, displaySeq, &frameTs, &frameMeta);
 
             if (!outFrame.empty() && displaySeq != lastSeqs[i]) {
                 if (g_globalWebServer) {
-                    g_globalWebServer->SetLatestFrame(i, outFrame);
+                    g_globalWebServer->SetLatestFrame(i, outFrame, frameTs, &frameMeta);
                 }
                 lastSeqs[i] = displaySeq;
             } else if (outFrame.empty()) {
@@ -56,36 +58,16 @@ inline cv::Mat GetProcessedFrameWrapperMain(int cameraId) {
 }
 
 inline cv::Mat GetRawFrameWrapperMain(int cameraId) {
-    cv::Mat frame;
+    // [REDUCED RES] Template editing needs native resolution; fall back to the processing frame
+    cv::Mat frame = GetCam(cameraId)->GetFullResFrame_Online();
+    if (!frame.empty()) return frame;
     long long seq;
     GetCam(cameraId)->GetRawFrameOnline(frame, seq);
     return frame.clone();
 }
 
 inline bool TriggerSaveTemplateHeadlessWrapperMain(int cameraId, std::string xmlContent) {
-    std::string templateName = "web_template_" + std::to_string(cameraId);
-    size_t nameStart = xmlContent.find("<name>");
-    if (nameStart != std::string::npos) {
-        size_t nameEnd = xmlContent.find("</name>", nameStart);
-        if (nameEnd != std::string::npos) {
-            templateName = xmlContent.substr(nameStart + 6, nameEnd - nameStart - 6);
-            templateName.erase(std::remove(templateName.begin(), templateName.end(), '\"'), templateName.end());
-        }
-    }
-    
-    std::string filename = "parking_templates/" + templateName + ".xml";
-    DumpLog("[API] Extracted template name: " + templateName + " -> Saving to: " + filename);
-    std::ofstream out(filename);
-    if (!out) {
-        DumpLog("[API] ERROR: Could not open " + filename + " for writing!");
-        return false;
-    }
-    out << xmlContent;
-    out.close();
-    
-    bool loadResult = GetCam(cameraId)->LoadParkingTemplate_Online(filename);
-    DumpLog("[API] LoadParkingTemplate_Online returned: " + std::string(loadResult ? "true" : "false"));
-    return loadResult;
+    return SaveParkingTemplateXml_Online(cameraId, xmlContent);
 }
 
 
@@ -26,6 +26,8 @@
 #include <thread>
 #include <chrono>
 #include <atomic>
+#include "OfflineJobRunner.h" // [TURBO] Unpaced, segmented batch analysis
+#include "VideoSeekIndex.h" // [SEEK INDEX] Frame-accurate seeking and fast-forward
 
 // ==========================================
 //  PART 1: GLOBAL VARIABLES & SETTINGS
@@ -73,10 +75,14 @@ __declspec(selectany) long long g_frameSeq_offline = 0;
 __declspec(selectany) std::mutex g_frameMutex_offline;
 __declspec(selectany) std::mutex g_captureMutex_offline;
 __declspec(selectany) double g_videoFPS = 30.0;
+__declspec(selectany) VideoSeekIndex g_seekIndex_offline;
+__declspec(selectany) std::atomic<long long> g_playbackFrame_offline(0); // Index of the next frame read() returns
+__declspec(selectany) std::atomic<double> g_playbackSpeed_offline(1.0); // 0.25x .. 32x
 
 __declspec(selectany) std::mutex g_aiMutex_offline;
 __declspec(selectany) bool g_modelReady_offline = false;
 __declspec(selectany) std::atomic<bool> g_parkingEnabled_offline(false);
+__declspec(selectany) std::string g_templatePath_offline; // [TURBO] Batch analysis loads its own copy
 
 // *** [PHASE 3] DRAWING CACHE & BUFFERS ***
 struct CachedLabel {
@@ -201,6 +207,7 @@ static bool LoadParkingTemplate(const std::string& filename) {
 	bool s2 = g_pm_display->loadTemplate(filename);
 	if (s1 && s2) {
 		g_parkingEnabled_offline = true;
+		g_templatePath_offline = filename;
 		return true;
 	}
 	return false;
@@ -233,9 +240,11 @@ static void OpenCamera(const std::string& filename) {
 	if (g_cap_offline->isOpened()) {
 		g_videoFPS = g_cap_offline->get(cv::CAP_PROP_FPS);
 		if (g_videoFPS <= 0 || g_videoFPS > 60) g_videoFPS = 30.0;
+		g_seekIndex_offline.StartBackground(filename);
 	}
 
 	g_frameSeq_offline = 0;
+	g_playbackFrame_offline = 0;
 	g_appState = AppState();
 	ResetParkingCache();
 }
@@ -590,8 +599,12 @@ namespace ConsoleApplication3 {
 			// [UI FIX] Disable Upload buttons until template is loaded
 			btnUploadImage->Enabled = false;
 			btnUploadVideo->Enabled = false;
+			btnTurboAnalyze->Enabled = false;
+			btnTurboFolder->Enabled = false;
 			btnUploadImage->BackColor = System::Drawing::Color::Gray;
 			btnUploadVideo->BackColor = System::Drawing::Color::Gray;
+			btnTurboAnalyze->BackColor = System::Drawing::Color::Gray;
+			btnTurboFolder->BackColor = System::Drawing::Color::Gray;
 
 			BackgroundWorker^ modelLoader = gcnew BackgroundWorker();
 			modelLoader->DoWork += gcnew DoWorkEventHandler(this, &OfflineUploadForm::LoadModel_DoWork);
@@ -610,6 +623,9 @@ namespace ConsoleApplication3 {
 	private: System::Windows::Forms::Timer^ timer1;
 
 	private: BackgroundWorker^ processingWorker;
+	private: BackgroundWorker^ turboWorker;
+	private: System::Windows::Forms::Timer^ turboProgressTimer;
+	private: OfflineJobRunner* turboJob = nullptr;
 	private: Thread^ readerThread;
 
 	private: System::ComponentModel::IContainer^ components;
@@ -624,6 +640,7 @@ namespace ConsoleApplication3 {
 
 	private: System::Windows::Forms::Button^ btnPlayPause;
 	private: System::Windows::Forms::TrackBar^ trackBar1;
+	private: System::Windows::Forms::ComboBox^ cmbPlaybackSpeed;
 	private: System::Windows::Forms::Button^ btnNextFrame;
 	private: System::Windows::Forms::Button^ btnOfflineMode;
 	private: System::Windows::Forms::Button^ btnPrevFrame;
@@ -631,6 +648,8 @@ namespace ConsoleApplication3 {
 
 	private: System::Windows::Forms::Button^ btnUploadImage;
 	private: System::Windows::Forms::Button^ btnUploadVideo;
+	private: System::Windows::Forms::Button^ btnTurboAnalyze;
+	private: System::Windows::Forms::Button^ btnTurboFolder;
 	private: System::Windows::Forms::Button^ btnLoadParkingTemplate;
 	private: System::Windows::Forms::CheckBox^ chkParkingMode;
 
@@ -680,14 +699,19 @@ namespace ConsoleApplication3 {
 			   this->components = (gcnew System::ComponentModel::Container());
 			   this->timer1 = (gcnew System::Windows::Forms::Timer(this->components));
 			   this->processingWorker = (gcnew System::ComponentModel::BackgroundWorker());
+			   this->turboWorker = (gcnew System::ComponentModel::BackgroundWorker());
+			   this->turboProgressTimer = (gcnew System::Windows::Forms::Timer(this->components));
 			   this->btnPrevFrame = (gcnew System::Windows::Forms::Button());
 			   this->btnNextFrame = (gcnew System::Windows::Forms::Button());
 			   this->btnOfflineMode = (gcnew System::Windows::Forms::Button());
 			   this->btnPlayPause = (gcnew System::Windows::Forms::Button());
 			   this->trackBar1 = (gcnew System::Windows::Forms::TrackBar());
+			   this->cmbPlaybackSpeed = (gcnew System::Windows::Forms::ComboBox());
 			   this->lblLogs = (gcnew System::Windows::Forms::Label());
 			   this->btnUploadImage = (gcnew System::Windows::Forms::Button());
 			   this->btnUploadVideo = (gcnew System::Windows::Forms::Button());
+			   this->btnTurboAnalyze = (gcnew System::Windows::Forms::Button());
+			   this->btnTurboFolder = (gcnew System::Windows::Forms::Button());
 			   this->btnLoadParkingTemplate = (gcnew System::Windows::Forms::Button());
 			   this->chkParkingMode = (gcnew System::Windows::Forms::CheckBox());
 			   this->splitContainer1 = (gcnew System::Windows::Forms::SplitContainer());
@@ -722,6 +746,16 @@ namespace ConsoleApplication3 {
 			   this->processingWorker->WorkerSupportsCancellation = true;
 			   this->processingWorker->DoWork += gcnew System::ComponentModel::DoWorkEventHandler(this, &OfflineUploadForm::processingWorker_DoWork);
 			   // 
+			   // turboWorker
+			   // 
+			   this->turboWorker->DoWork += gcnew System::ComponentModel::DoWorkEventHandler(this, &OfflineUploadForm::turboWorker_DoWork);
+			   this->turboWorker->RunWorkerCompleted += gcnew System::ComponentModel::RunWorkerCompletedEventHandler(this, &OfflineUploadForm::turboWorker_Completed);
+			   // 
+			   // turboProgressTimer
+			   // 
+			   this->turboProgressTimer->Interval = 500;
+			   this->turboProgressTimer->Tick += gcnew System::EventHandler(this, &OfflineUploadForm::turboProgressTimer_Tick);
+			   // 
 			   // btnPrevFrame
 			   // 
 			   this->btnPrevFrame->BackColor = System::Drawing::Color::Yellow;
@@ -731,6 +765,7 @@ namespace ConsoleApplication3 {
 			   this->btnPrevFrame->TabIndex = 0;
 			   this->btnPrevFrame->Text = L"<";
 			   this->btnPrevFrame->UseVisualStyleBackColor = false;
+			   this->btnPrevFrame->Click += gcnew System::EventHandler(this, &OfflineUploadForm::btnPrevFrame_Click);
 			   // 
 			   // btnNextFrame
 			   // 
@@ -741,6 +776,7 @@ namespace ConsoleApplication3 {
 			   this->btnNextFrame->TabIndex = 1;
 			   this->btnNextFrame->Text = L">";
 			   this->btnNextFrame->UseVisualStyleBackColor = false;
+			   this->btnNextFrame->Click += gcnew System::EventHandler(this, &OfflineUploadForm::btnNextFrame_Click);
 			   // 
 			   // btnOfflineMode
 			   // 
@@ -776,6 +812,20 @@ namespace ConsoleApplication3 {
 			   this->trackBar1->MouseDown += gcnew System::Windows::Forms::MouseEventHandler(this, &OfflineUploadForm::trackBar1_MouseDown);
 			   this->trackBar1->MouseUp += gcnew System::Windows::Forms::MouseEventHandler(this, &OfflineUploadForm::trackBar1_MouseUp);
 			   // 
+			   // cmbPlaybackSpeed
+			   // 
+			   this->cmbPlaybackSpeed->DropDownStyle = System::Windows::Forms::ComboBoxStyle::DropDownList;
+			   this->cmbPlaybackSpeed->FormattingEnabled = true;
+			   this->cmbPlaybackSpeed->Items->AddRange(gcnew cli::array< System::Object^  >(8) {
+				   L"0.25x", L"0.5x", L"1x", L"2x", L"4x", L"8x", L"16x", L"32x"
+			   });
+			   this->cmbPlaybackSpeed->Location = System::Drawing::Point(490, 58);
+			   this->cmbPlaybackSpeed->Name = L"cmbPlaybackSpeed";
+			   this->cmbPlaybackSpeed->Size = System::Drawing::Size(58, 21);
+			   this->cmbPlaybackSpeed->TabIndex = 7;
+			   this->cmbPlaybackSpeed->SelectedIndex = 2;
+			   this->cmbPlaybackSpeed->SelectedIndexChanged += gcnew System::EventHandler(this, &OfflineUploadForm::cmbPlaybackSpeed_SelectedIndexChanged);
+			   // 
 			   // lblLogs
 			   // 
 			   this->lblLogs->AutoSize = true;
@@ -815,6 +865,34 @@ namespace ConsoleApplication3 {
 			   this->btnUploadVideo->UseVisualStyleBackColor = false;
 			   this->btnUploadVideo->Click += gcnew System::EventHandler(this, &OfflineUploadForm::btnUploadVideo_Click);
 			   // 
+			   // btnTurboAnalyze
+			   // 
+			   this->btnTurboAnalyze->BackColor = System::Drawing::Color::FromArgb(static_cast<System::Int32>(static_cast<System::Byte>(255)), static_cast<System::Int32>(static_cast<System::Byte>(224)),
+				   static_cast<System::Int32>(static_cast<System::Byte>(192)));
+			   this->btnTurboAnalyze->Font = (gcnew System::Drawing::Font(L"Microsoft Sans Serif", 11.25F, System::Drawing::FontStyle::Bold, System::Drawing::GraphicsUnit::Point,
+				   static_cast<System::Byte>(0)));
+			   this->btnTurboAnalyze->Location = System::Drawing::Point(228, 220);
+			   this->btnTurboAnalyze->Name = L"btnTurboAnalyze";
+			   this->btnTurboAnalyze->Size = System::Drawing::Size(179, 52);
+			   this->btnTurboAnalyze->TabIndex = 8;
+			   this->btnTurboAnalyze->Text = L"Turbo Analyze ⚡";
+			   this->btnTurboAnalyze->UseVisualStyleBackColor = false;
+			   this->btnTurboAnalyze->Click += gcnew System::EventHandler(this, &OfflineUploadForm::btnTurboAnalyze_Click);
+			   // 
+			   // btnTurboFolder
+			   // 
+			   this->btnTurboFolder->BackColor = System::Drawing::Color::FromArgb(static_cast<System::Int32>(static_cast<System::Byte>(255)), static_cast<System::Int32>(static_cast<System::Byte>(224)),
+				   static_cast<System::Int32>(static_cast<System::Byte>(192)));
+			   this->btnTurboFolder->Font = (gcnew System::Drawing::Font(L"Microsoft Sans Serif", 9.75F, System::Drawing::FontStyle::Bold, System::Drawing::GraphicsUnit::Point,
+				   static_cast<System::Byte>(0)));
+			   this->btnTurboFolder->Location = System::Drawing::Point(228, 278);
+			   this->btnTurboFolder->Name = L"btnTurboFolder";
+			   this->btnTurboFolder->Size = System::Drawing::Size(179, 36);
+			   this->btnTurboFolder->TabIndex = 9;
+			   this->btnTurboFolder->Text = L"Analyze DVR Folder 📁";
+			   this->btnTurboFolder->UseVisualStyleBackColor = false;
+			   this->btnTurboFolder->Click += gcnew System::EventHandler(this, &OfflineUploadForm::btnTurboFolder_Click);
+			   // 
 			   // btnLoadParkingTemplate
 			   // 
 			   this->btnLoadParkingTemplate->BackColor = System::Drawing::Color::LightGreen;
@@ -850,6 +928,7 @@ namespace ConsoleApplication3 {
 			   this->splitContainer1->Panel1->Controls->Add(this->label1);
 			   this->splitContainer1->Panel1->Controls->Add(this->btnOfflineMode);
 			   this->splitContainer1->Panel1->Controls->Add(this->trackBar1);
+			   this->splitContainer1->Panel1->Controls->Add(this->cmbPlaybackSpeed);
 			   this->splitContainer1->Panel1->Controls->Add(this->btnPlayPause);
 			   this->splitContainer1->Panel1->Controls->Add(this->btnNextFrame);
 			   this->splitContainer1->Panel1->Controls->Add(this->btnPrevFrame);
@@ -866,6 +945,8 @@ namespace ConsoleApplication3 {
 			   this->splitContainer1->Panel2->Controls->Add(this->chkParkingMode);
 			   this->splitContainer1->Panel2->Controls->Add(this->pnlViolationContainer);
 			   this->splitContainer1->Panel2->Controls->Add(this->btnUploadVideo);
+			   this->splitContainer1->Panel2->Controls->Add(this->btnTurboAnalyze);
+			   this->splitContainer1->Panel2->Controls->Add(this->btnTurboFolder);
 			   this->splitContainer1->Panel2->Controls->Add(this->btnUploadImage);
 			   this->splitContainer1->Size = System::Drawing::Size(1443, 759);
 			   this->splitContainer1->SplitterDistance = 1009;
@@ -1067,6 +1148,7 @@ namespace ConsoleApplication3 {
 
 		long long nextTick = cv::getTickCount();
 		double tickFreq = cv::getTickFrequency();
+		double owedFrames = 0; // [SPEED] Fractional source frames carried to the next tick
 
 		while (!shouldStop) {
 			long long currentTick = cv::getTickCount();
@@ -1078,13 +1160,32 @@ namespace ConsoleApplication3 {
 			}
 
 			if (currentTick >= nextTick) {
+				// [SPEED] Below 1x the ticks are stretched. Above 1x the display keeps the video's frame
+				// rate and each tick advances several source frames: the skipped ones are grab()bed
+				// (never converted), or jumped over with a keyframe seek when the index has one ahead.
+				double speed = g_playbackSpeed_offline.load();
+				owedFrames += std::max(1.0, speed);
+				long long advance = std::max(1LL, (long long)owedFrames);
+				owedFrames -= (double)advance;
+
 				cv::Mat tempFrame;
 				bool success = false;
 
 				{
 					std::lock_guard<std::mutex> lock(g_captureMutex_offline);
 					if (g_cap_offline && g_cap_offline->isOpened()) {
+						long long position = g_playbackFrame_offline.load();
+						long long target = position + advance - 1;
+						if (advance > 1 && g_seekIndex_offline.IsReady() &&
+							g_seekIndex_offline.KeyframeAtOrBefore(target) > position + SEEK_INDEX_MIN_SKIP) {
+							position = SeekToFrame(*g_cap_offline, g_seekIndex_offline, target);
+						}
+						else {
+							while (position < target && g_cap_offline->grab()) position++;
+						}
+						// Count from the frames actually reached, not the ones asked for
 						success = g_cap_offline->read(tempFrame);
+						if (success) g_playbackFrame_offline = position + 1;
 					}
 					else {
 						break;
@@ -1126,7 +1227,7 @@ namespace ConsoleApplication3 {
 						}
 					}
 
-					nextTick += (long long)(ticksPerFrame * tickFreq / 1000.0);
+					nextTick += (long long)(ticksPerFrame / std::min(1.0, speed) * tickFreq / 1000.0);
 					if (cv::getTickCount() > nextTick) nextTick = cv::getTickCount();
 				}
 				else {
@@ -1177,12 +1278,10 @@ namespace ConsoleApplication3 {
 			}
 
 			if (!isTrackBarDragging && isProcessing) {
-				std::lock_guard<std::mutex> lock(g_captureMutex_offline);
-				if (g_cap_offline && g_cap_offline->isOpened()) {
-					long long currentFrame = (long long)g_cap_offline->get(cv::CAP_PROP_POS_FRAMES);
-					if (currentFrame <= trackBar1->Maximum) {
-						trackBar1->Value = (int)currentFrame;
-					}
+				UpdateTrackBarRange();
+				long long currentFrame = std::max(0LL, g_playbackFrame_offline.load() - 1);
+				if (currentFrame <= trackBar1->Maximum) {
+					trackBar1->Value = (int)currentFrame;
 				}
 			}
 
@@ -1435,6 +1534,95 @@ namespace ConsoleApplication3 {
 
 	private: System::Void OfflineUploadForm_FormClosing(System::Object^ sender, FormClosingEventArgs^ e) {
 		StopProcessing();
+		if (turboJob) turboJob->Cancel();
+	}
+
+	// [TURBO] Analyze a whole recording as fast as the hardware allows (no playback, no drops).
+	// Long files are split into segments that run in parallel (OfflineJobRunner).
+	private: System::Void btnTurboAnalyze_Click(System::Object^ sender, System::EventArgs^ e) {
+		if (turboWorker->IsBusy) {
+			if (turboJob) turboJob->Cancel();
+			return;
+		}
+		if (!CheckTurboTemplate()) return;
+
+		OpenFileDialog^ ofd = gcnew OpenFileDialog();
+		ofd->Filter = "Video Files|*.mp4;*.avi;*.mkv;*.mov";
+		if (ofd->ShowDialog() != System::Windows::Forms::DialogResult::OK) return;
+		StartTurboJob(ofd->FileName);
+	}
+
+	// [JOB] Every clip under a DVR folder (e.g. C:\locvideo\<date>\camera_N), stitched into one log
+	private: System::Void btnTurboFolder_Click(System::Object^ sender, System::EventArgs^ e) {
+		if (turboWorker->IsBusy) {
+			if (turboJob) turboJob->Cancel();
+			return;
+		}
+		if (!CheckTurboTemplate()) return;
+
+		FolderBrowserDialog^ fbd = gcnew FolderBrowserDialog();
+		fbd->Description = "Select one camera's recording folder";
+		fbd->SelectedPath = "C:\\locvideo";
+		if (fbd->ShowDialog() != System::Windows::Forms::DialogResult::OK) return;
+		StartTurboJob(fbd->SelectedPath);
+	}
+
+	private: bool CheckTurboTemplate() {
+		if (!g_parkingEnabled_offline.load() || g_templatePath_offline.empty()) {
+			MessageBox::Show("Please load a parking template first.", "Template Required", MessageBoxButtons::OK, MessageBoxIcon::Warning);
+			return false;
+		}
+		return true;
+	}
+
+	private: void StartTurboJob(System::String^ inputPath) {
+		StopProcessing(); // Frees the GPU for the batch run
+		turboJob = new OfflineJobRunner();
+		turboWorker->RunWorkerAsync(inputPath);
+		btnTurboAnalyze->Text = L"Cancel ⏹";
+		btnTurboFolder->Text = L"Cancel ⏹";
+		turboProgressTimer->Start();
+	}
+
+	private: System::Void turboWorker_DoWork(System::Object^ sender, DoWorkEventArgs^ e) {
+		OfflineJobOptions options;
+		options.inputPath = msclr::interop::marshal_as<std::string>(safe_cast<System::String^>(e->Argument));
+		options.analysis.templatePath = g_templatePath_offline;
+		options.analysis.gpuId = g_selectedGpuId;
+		OfflineJobReport report = turboJob->Run(options);
+
+		char summary[512];
+		if (report.ok) {
+			sprintf_s(summary, "Analyzed %.0f s of video in %.1f s (%.1fx realtime)\n%d file(s), %d segment(s) on %d worker(s)\n%lld events, %lld occupancy changes\n\nSaved to %s",
+				report.videoSeconds, report.wallSeconds, report.RealtimeFactor(), report.sources, (int)report.segments.size(),
+				report.workers, report.events, report.occupancyChanges, report.outputDir.c_str());
+		}
+		else if (report.cancelled) {
+			sprintf_s(summary, "Cancelled.\nPartial logs: %s", report.outputDir.c_str());
+		}
+		else {
+			sprintf_s(summary, "Analysis failed: %s", report.error.c_str());
+		}
+		e->Result = gcnew System::String(summary);
+	}
+
+	private: System::Void turboWorker_Completed(System::Object^ sender, RunWorkerCompletedEventArgs^ e) {
+		turboProgressTimer->Stop();
+		delete turboJob;
+		turboJob = nullptr;
+		btnTurboAnalyze->Text = L"Turbo Analyze ⚡";
+		btnTurboFolder->Text = L"Analyze DVR Folder 📁";
+		this->Text = L"Offline Mode - Ready";
+		if (e->Error != nullptr) MessageBox::Show("Analysis failed: " + e->Error->Message, "Turbo Analyze", MessageBoxButtons::OK, MessageBoxIcon::Error);
+		else MessageBox::Show(safe_cast<System::String^>(e->Result), "Turbo Analyze", MessageBoxButtons::OK, MessageBoxIcon::Information);
+	}
+
+	private: System::Void turboProgressTimer_Tick(System::Object^ sender, System::EventArgs^ e) {
+		if (!turboJob) return;
+		long long done = turboJob->FramesDecoded();
+		long long total = turboJob->FramesTotal();
+		int percent = total > 0 ? (int)std::min(100LL, done * 100 / total) : 0;
+		this->Text = System::String::Format(L"Offline Mode - Turbo analysis {0}% ({1} / {2} frames)", percent, done, total);
 	}
 
 	private: System::Void btnPlayPause_Click(System::Object^ sender, System::EventArgs^ e) {
@@ -1469,8 +1657,12 @@ namespace ConsoleApplication3 {
 				// [UI FIX] Enable upload buttons after successful template load
 				btnUploadImage->Enabled = true;
 				btnUploadVideo->Enabled = true;
+				btnTurboAnalyze->Enabled = !turboWorker->IsBusy;
+				btnTurboFolder->Enabled = !turboWorker->IsBusy;
 				btnUploadImage->BackColor = System::Drawing::Color::FromArgb(255, 255, 192);
 				btnUploadVideo->BackColor = System::Drawing::Color::FromArgb(255, 255, 192);
+				btnTurboAnalyze->BackColor = System::Drawing::Color::FromArgb(255, 224, 192);
+				btnTurboFolder->BackColor = System::Drawing::Color::FromArgb(255, 224, 192);
 				
 				MessageBox::Show(
 					"[OK] Template loaded successfully!\n\n" +
@@ -1671,21 +1863,63 @@ namespace ConsoleApplication3 {
 		std::lock_guard<std::mutex> lock(g_captureMutex_offline);
 		if (g_cap_offline && g_cap_offline->isOpened()) {
 			long long framePos = trackBar1->Value;
-			g_cap_offline->set(cv::CAP_PROP_POS_FRAMES, (double)framePos);
+			g_playbackFrame_offline = SeekToFrame(*g_cap_offline, g_seekIndex_offline, framePos);
 			StartProcessing();
 		}
 	}
 
 	private: System::Void trackBar1_Scroll(System::Object^ sender, System::EventArgs^ e) {
 		if (isTrackBarDragging) {
-			std::lock_guard<std::mutex> lock(g_captureMutex_offline);
-			if (g_cap_offline && g_cap_offline->isOpened()) {
-				long long framePos = trackBar1->Value;
-				g_cap_offline->set(cv::CAP_PROP_POS_FRAMES, (double)framePos);
+			cv::Mat preview;
+			{
+				std::lock_guard<std::mutex> lock(g_captureMutex_offline);
+				if (g_cap_offline && g_cap_offline->isOpened()) {
+					// [SEEK INDEX] While dragging, preview the keyframe under the thumb (one decode each);
+					// the exact frame is sought on release
+					long long framePos = trackBar1->Value;
+					if (g_seekIndex_offline.IsReady()) framePos = g_seekIndex_offline.KeyframeAtOrBefore(framePos);
+					g_cap_offline->set(cv::CAP_PROP_POS_FRAMES, (double)framePos);
+					g_cap_offline->read(preview);
+				}
 			}
+			if (!preview.empty()) UpdatePictureBox(preview);
 		}
 	}
 
+	private: System::Void btnPrevFrame_Click(System::Object^ sender, System::EventArgs^ e) {
+		StepFrame(-1);
+	}
+
+	private: System::Void btnNextFrame_Click(System::Object^ sender, System::EventArgs^ e) {
+		StepFrame(1);
+	}
+
+	// Pauses and shows the frame `delta` away from the one on screen
+	private: void StepFrame(long long delta) {
+		if (isProcessing) {
+			StopProcessing();
+			btnPlayPause->Text = L"▶";
+		}
+		cv::Mat frame;
+		long long target = 0;
+		{
+			std::lock_guard<std::mutex> lock(g_captureMutex_offline);
+			if (!g_cap_offline || !g_cap_offline->isOpened()) return;
+			target = std::max(0LL, g_playbackFrame_offline.load() - 1 + delta);
+			if (target != g_playbackFrame_offline.load()) target = SeekToFrame(*g_cap_offline, g_seekIndex_offline, target);
+			if (!g_cap_offline->read(frame)) return;
+			g_playbackFrame_offline = target + 1;
+		}
+		UpdatePictureBox(frame);
+		UpdateTrackBarRange();
+		if (target <= trackBar1->Maximum) trackBar1->Value = (int)target;
+	}
+
+	private: System::Void cmbPlaybackSpeed_SelectedIndexChanged(System::Object^ sender, System::EventArgs^ e) {
+		System::String^ text = cmbPlaybackSpeed->SelectedItem->ToString()->TrimEnd('x');
+		g_playbackSpeed_offline = System::Double::Parse(text, System::Globalization::CultureInfo::InvariantCulture);
+	}
+
 	private: void InitializeTrackBar() {
 		std::lock_guard<std::mutex> lock(g_captureMutex_offline);
 		if (g_cap_offline && g_cap_offline->isOpened()) {
@@ -1697,6 +1931,17 @@ namespace ConsoleApplication3 {
 		}
 	}
 
+	// CAP_PROP_FRAME_COUNT is only an estimate from the container's duration; switch to the
+	// indexed count once the background indexer has finished
+	private: void UpdateTrackBarRange() {
+		if (!g_seekIndex_offline.IsReady()) return;
+		long long indexed = g_seekIndex_offline.FrameCount();
+		if (indexed <= 0 || indexed == totalFrames) return;
+		totalFrames = indexed;
+		if (trackBar1->Value > totalFrames - 1) trackBar1->Value = (int)(totalFrames - 1);
+		trackBar1->Maximum = (int)(totalFrames - 1);
+	}
+
 		   static cv::Mat CreateViolationVisualization(cv::Mat fullFrame, cv::Rect carBox) {
 			   if (fullFrame.empty()) return cv::Mat();
 
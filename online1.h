@@ -19,1027 +19,10 @@
 using json = nlohmann::json;
 
 #pragma managed(push, off)
-#include <opencv2/opencv.hpp>
-#include <opencv2/dnn.hpp>
-#include <cstdlib>
-#include <algorithm>
-#include <cmath>
-#include <mutex>
-#include <set>
-#include <chrono> // [PHASE 1] Add for future use
-#include <atomic> // [PHASE 1] Add for atomic operations
-#include "OnnxYoloInference.h" // [GPU] ONNX Runtime GPU acceleration
-
-// ==========================================
-//  LAYER 1: SHARED CONSTANTS & STRUCTS
-// ==========================================
-#include <fstream>
-
-const int YOLO_INPUT_SIZE = 640;
-const float CONF_THRESHOLD = 0.25f;
-const float NMS_THRESHOLD = 0.45f;
-const int VIOLATION_CHECK_INTERVAL_MS_ONLINE = 500;
-
-struct OnlineAppState {
-	std::vector<TrackedObject> cars;
-	std::set<int> violatingCarIds;
-	std::map<int, SlotStatus> slotStatuses;
-	std::map<int, float> slotOccupancy;
-	std::map<int, std::string> slotTypes; // [NEW] Track Car/Motorcycle
-	long long frameSequence = -1;
-};
-
-struct CachedLabel_Online {
-	std::string text;
-	cv::Size size;
-	int baseline;
-	bool isViolating;
-	int classId;
-	
-	CachedLabel_Online() : baseline(0), isViolating(false), classId(-1) {}
-};
-
-struct FPSMonitor_Online {
-	double alpha = 0.1;
-	double avgFPS = 0.0;
-	long long lastTick = 0;
-	
-	void update() {
-		long long currentTick = cv::getTickCount();
-		if (lastTick != 0) {
-			double timeSec = (currentTick - lastTick) / cv::getTickFrequency();
-			if (timeSec > 0) {
-				double fps = 1.0 / timeSec;
-				if (avgFPS == 0) avgFPS = fps;
-				else avgFPS = avgFPS * (1.0 - alpha) + fps * alpha;
-			}
-		}
-		lastTick = currentTick;
-	}
-};
-
-// ==========================================
-//  [PHASE 14] MULTI-CAMERA INFRASTRUCTURE
-// ==========================================
-struct CameraConfig {
-	int id;
-	std::string name;
-	std::string rtspUrl;
-};
-
-class CameraManager {
-public:
-	static std::vector<CameraConfig> LoadCameras() {
-		std::vector<CameraConfig> cameras;
-		std::ifstream file("C:\\camera_ids\\cameras.json");
-		if (!file.is_open()) return cameras;
-
-		try {
-			json j;
-			file >> j;
-			for (const auto& item : j) {
-				CameraConfig cam;
-				cam.id = item.value("id", 0);
-				cam.name = item.value("name", "");
-				cam.rtspUrl = item.value("rtspUrl", "");
-				if (cam.id > 0) cameras.push_back(cam);
-			}
-		} catch (...) {
-			// Catch JSON parsing errors
-		}
-		return cameras;
-	}
-
-	static void SaveCameras(const std::vector<CameraConfig>& cameras) {
-		CreateDirectoryA("C:\\camera_ids", NULL);
-		json j = json::array();
-		for (const auto& cam : cameras) {
-			j.push_back({
-				{"id", cam.id},
-				{"name", cam.name},
-				{"rtspUrl", cam.rtspUrl}
-			});
-		}
-		std::ofstream file("C:\\camera_ids\\cameras.json");
-		if (file.is_open()) {
-			file << j.dump(4);
-		}
-	}
-};
-
-extern MjpegServer* g_globalWebServer;
-const int NETWORK_BUFFER_SIZE = 5;    // Network jitter buffer
-
-// CAMERA INSTANCE CLASS DEFINITION REPLACED
-
-
-__declspec(selectany) std::mutex g_aiMutex_online;
-extern int g_selectedGpuId;
-const int MAX_FRAME_LAG_ONLINE = 10; // Relaxed from 3 to 10 frames
-
-class CameraInstance {
-public:
-    int camera_id = 0;
-    CameraConfig config;
-    
-    CameraInstance(const CameraConfig& cfg) : config(cfg) {
-        camera_id = cfg.id;
-    }
-    ~CameraInstance() {
-        StopProcessing();
-        if (g_cap) {
-            if (g_cap->isOpened()) g_cap->release();
-            delete g_cap;
-            g_cap = nullptr;
-        }
-		if (g_onnx_net) { delete g_onnx_net; g_onnx_net = nullptr; }
-		if (g_tracker) { delete g_tracker; g_tracker = nullptr; }
-		if (g_pm_logic_online) { delete g_pm_logic_online; g_pm_logic_online = nullptr; }
-		if (g_pm_display_online) { delete g_pm_display_online; g_pm_display_online = nullptr; }
-		if (g_mjpegServer_online) { delete g_mjpegServer_online; g_mjpegServer_online = nullptr; }
-    }
-
-	OnlineAppState g_onlineState;
-	std::mutex g_onlineStateMutex;
-
-	// ==========================================
-	//  LAYER 2: LOGIC & BACKEND
-	// ==========================================
-
-	// cv::dnn::Net* g_net = nullptr; // [DEPRECATED] Old OpenCV DNN
-	OnnxYoloInference* g_onnx_net = nullptr; // [GPU] New ONNX Runtime
-	std::vector<std::string> g_classes;
-	std::vector<cv::Scalar> g_colors;
-	BYTETracker* g_tracker = nullptr;
-
-	ParkingManager* g_pm_logic_online = nullptr;
-
-	cv::VideoCapture* g_cap = nullptr;
-	cv::Mat g_latestRawFrame;
-	long long g_frameSeq_online = 0;
-	std::mutex g_frameMutex;
-	std::atomic<int> g_connectionAttemptId_online{0}; // [NEW] Prevent race conditions on multiple connect clicks
-	double g_cameraFPS = 30.0;
-
-	// *** [NEW] PROCESSED FRAME SHARING ***
-	cv::Mat g_processedFrame_online;
-	long long g_processedSeq_online = 0;
-	std::mutex g_processedMutex_online;
-	int g_droppedFrames_online = 0;
-	int g_processedFramesCount_online = 0;
-	std::chrono::steady_clock::time_point g_lastViolationCheck_online;
-
-	// *** Threading for Headless Mode (Multi-camera safety) ***
-	std::thread* readerThread_online = nullptr;
-	std::thread* processingThread_online = nullptr;
-	std::atomic<bool> isProcessing{false};
-	std::atomic<bool> shouldStop{false};
-	long long lastProcessedSeq = -1;
-	bool g_modelReady = false; // [PHASE 14] Model ready flag moved to instance
-
-	inline void CameraReaderLoop() {
-		while (!shouldStop) {
-			cv::Mat tempFrame;
-			bool success = false;
-
-			if (g_cap && g_cap->isOpened()) {
-				success = g_cap->read(tempFrame);
-				if (success && !tempFrame.empty()) {
-					long long currentSeq;
-					{
-						std::lock_guard<std::mutex> lock(g_frameMutex);
-						g_latestRawFrame = tempFrame;
-						g_frameSeq_online++;
-						currentSeq = g_frameSeq_online;
-					}
-					std::this_thread::sleep_for(std::chrono::milliseconds(5));
-					continue;
-				}
-			} else {
-				break;
-			}
-		}
-	}
-
-	inline void ProcessingLoopHeadless();
-
-	inline void StartProcessing() {
-		shouldStop = false;
-		isProcessing = true;
-		
-		g_droppedFrames_online = 0;
-		g_processedFramesCount_online = 0;
-		g_lastViolationCheck_online = std::chrono::steady_clock::now();
-		
-		{
-			std::lock_guard<std::mutex> lock(g_onlineStateMutex);
-			g_onlineState = OnlineAppState();
-		}
-		ResetParkingCache_Online();
-
-		if (processingThread_online == nullptr) {
-			processingThread_online = new std::thread(&CameraInstance::ProcessingLoopHeadless, this);
-		}
-		if (readerThread_online == nullptr) {
-			readerThread_online = new std::thread(&CameraInstance::CameraReaderLoop, this);
-		}
-	}
-
-	inline void StopProcessing() {
-		shouldStop = true;
-		isProcessing = false;
-		
-		if (readerThread_online) {
-			if (readerThread_online->joinable()) readerThread_online->join();
-			delete readerThread_online;
-			readerThread_online = nullptr;
-		}
-		if (processingThread_online) {
-			if (processingThread_online->joinable()) processingThread_online->join();
-			delete processingThread_online;
-			processingThread_online = nullptr;
-		}
-
-		if (g_mjpegServer_online) {
-			g_mjpegServer_online->Stop();
-			delete g_mjpegServer_online;
-			g_mjpegServer_online = nullptr;
-		}
-
-		StopVideoRecordingThread_Online();
-	}
-
-	// ============================================================
-	//  [PHASE 1] VIDEO DVR RECORDING (60-SECOND CHUNKS)
-	// ============================================================
-	cv::VideoWriter* g_videoWriter_online = nullptr;
-	std::mutex g_videoWriterMutex_online;
-	std::string g_currentVideoRelPath = ""; 
-	long long g_videoClipStartTick = 0;
-	int g_videoFramesWritten = 0;
-	double lastClipActualFps = 0.0;
-	const int VIDEO_CLIP_SECONDS = 60; 
-
-	// *** Async Video Recording (Frame Duplication System) ***
-	std::atomic<bool> g_videoRecordingRunning{false};
-	std::thread* g_videoRecordingThread = nullptr;
-	std::mutex g_videoCurrentFrameMutex;
-	cv::Mat g_videoCurrentFrame; 
-	std::atomic<bool> g_parkingEnabled_online{false}; 
-	bool templateSet_online = false;  
-
-	// ==========================================
-	//  LAYER 3: PRESENTATION (Frontend)
-	// ==========================================
-	// [FIX] Move these variables to public area
-	public: 
-	ParkingManager* g_pm_display_online = nullptr;
-	cv::Mat g_cachedParkingOverlay_online;
-	std::map<int, SlotStatus> g_lastDrawnStatus_online;
-	cv::Mat g_drawingBuffer_online; 
-
-	// Memory pool
-	std::map<int, CachedLabel_Online> g_labelCache_online;
-	cv::Mat g_redOverlayBuffer_online;
-	FPSMonitor_Online g_fpsMonitor_online;
-
-	// *** [NEW] MJPEG SERVER ***
-	MjpegServer* g_mjpegServer_online = nullptr;
-
-	// --- Helper Functions ---
-
-	void ResetParkingCache_Online() {
-		g_cachedParkingOverlay_online = cv::Mat();
-		g_lastDrawnStatus_online.clear();
-		g_labelCache_online.clear(); // [PHASE 3] Clear label cache
-		g_redOverlayBuffer_online = cv::Mat(); // [PHASE 3] Clear red overlay buffer
-	}
-
-	cv::Mat GetRawFrame() {
-		std::lock_guard<std::mutex> lock(g_frameMutex);
-		return g_latestRawFrame.clone();
-	}
-
-	cv::Mat GetProcessedFrame(long long& seq) {
-		std::lock_guard<std::mutex> lock(g_processedMutex_online);
-		seq = g_processedSeq_online;
-		return g_processedFrame_online.clone();
-	}
-
-	void OpenGlobalCamera(int cameraIndex = 0) {
-		cv::VideoCapture* temp_cap = new cv::VideoCapture(cameraIndex);
-		double temp_fps = 30.0;
-		if (temp_cap->isOpened()) {
-			temp_fps = temp_cap->get(cv::CAP_PROP_FPS);
-			if (temp_fps <= 0) temp_fps = 30.0;
-		}
-
-		{
-			std::lock_guard<std::mutex> lock(g_frameMutex);
-			if (g_cap) { delete g_cap; g_cap = nullptr; }
-			g_cap = temp_cap;
-			g_frameSeq_online = 0;
-			g_cameraFPS = temp_fps;
-		}
-
-		ResetParkingCache_Online();
-		
-		std::lock_guard<std::mutex> slock(g_onlineStateMutex);
-		g_onlineState = OnlineAppState();
-	}
-
-	void OpenGlobalCameraFromIP(const std::string& rtspUrl, int attemptId = -1) {
-		cv::VideoCapture* temp_cap = nullptr;
-		double temp_fps = 30.0;
-
-		bool isNetwork = rtspUrl.find("http://") == 0 || rtspUrl.find("rtsp://") == 0 || rtspUrl.find("https://") == 0;
-		if (isNetwork) {
-			OutputDebugStringA(("[OPENCV] Opening network stream with timeout (Auto Backend) for camera " + std::to_string(camera_id) + ": " + rtspUrl + "\n").c_str());
-			temp_cap = new cv::VideoCapture();
-			
-			// [FIX] Set connection timeout to prevent hanging (5 seconds)
-			temp_cap->set(cv::CAP_PROP_OPEN_TIMEOUT_MSEC, 5000); // 5 second timeout
-			
-			bool opened = temp_cap->open(rtspUrl);
-			
-			if (attemptId != -1 && attemptId != g_connectionAttemptId_online.load()) {
-				delete temp_cap; return;
-			}
-
-			if (!opened || !temp_cap->isOpened()) {
-				OutputDebugStringA(("[OPENCV] Auto Backend failed or timeout for camera " + std::to_string(camera_id) + ". Trying CAP_FFMPEG explicitly...\n").c_str());
-				delete temp_cap;
-				
-				if (attemptId != -1 && attemptId != g_connectionAttemptId_online.load()) return;
-				
-				temp_cap = new cv::VideoCapture();
-				temp_cap->set(cv::CAP_PROP_OPEN_TIMEOUT_MSEC, 5000);
-				temp_cap->open(rtspUrl, cv::CAP_FFMPEG);
-			}
-		} else {
-			OutputDebugStringA(("[OPENCV] Opening local stream for camera " + std::to_string(camera_id) + ": " + rtspUrl + "\n").c_str());
-			temp_cap = new cv::VideoCapture(rtspUrl);
-		}
-		
-		if (attemptId != -1 && attemptId != g_connectionAttemptId_online.load()) {
-			if (temp_cap) delete temp_cap;
-			return;
-		}
-
-		// [FIX] Network stream optimization
-		if (temp_cap && temp_cap->isOpened()) {
-			OutputDebugStringA(("[OPENCV] Stream opened successfully for camera " + std::to_string(camera_id) + "! Backend API used: " + temp_cap->getBackendName() + "\n").c_str());
-			temp_cap->set(cv::CAP_PROP_BUFFERSIZE, NETWORK_BUFFER_SIZE); // Reduce latency
-			temp_fps = temp_cap->get(cv::CAP_PROP_FPS);
-			if (temp_fps <= 0) temp_fps = 30.0;
-		} else {
-			OutputDebugStringA(("[OPENCV ERROR] Failed to open stream (connection timeout or invalid URL) for camera " + std::to_string(camera_id) + ": " + rtspUrl + "\n").c_str());
-		}
-		
-		{
-			std::lock_guard<std::mutex> lock(g_frameMutex);
-			if (g_cap) { delete g_cap; g_cap = nullptr; }
-			g_cap = temp_cap;
-			g_frameSeq_online = 0;
-			g_cameraFPS = temp_fps;
-		}
-
-		ResetParkingCache_Online();
-		
-		std::lock_guard<std::mutex> slock(g_onlineStateMutex);
-		g_onlineState = OnlineAppState();
-	}
-
-	void InitGlobalModel(const std::string& modelPath) {
-		// Use the global ai mutex, it is defined far below
-		g_modelReady = false;
-		if (g_onnx_net) { delete g_onnx_net; g_onnx_net = nullptr; }
-		if (g_tracker) { delete g_tracker; g_tracker = nullptr; }
-
-		try {
-			// Use ONNX Runtime with GPU acceleration and user-selected Device ID
-			g_onnx_net = new OnnxYoloInference();
-			if (!g_onnx_net->loadModel(modelPath, true, g_selectedGpuId)) { // true = use GPU, pass ID
-				delete g_onnx_net;
-				g_onnx_net = nullptr;
-				OutputDebugStringA(("[ERROR] Failed to load ONNX model with GPU for camera " + std::to_string(camera_id) + "\n").c_str());
-				return;
-			}
-			
-			g_tracker = new BYTETracker(90, 0.25f);
-			
-			OutputDebugStringA(("[INFO] Online mode with ONNX Runtime GPU + ByteTrack for camera " + std::to_string(camera_id) + "\n").c_str());
-
-			g_classes = {
-				"person", "bicycle", "Car", "Motorcycle", "airplane", "bus", "train", "Van"
-			}; // index 2=Car, 3=Motorcycle, 7=Van
-
-			g_colors.clear();
-			for (size_t i = 0; i < g_classes.size(); i++) {
-				g_colors.push_back(cv::Scalar(rand() % 255, rand() % 255, rand() % 255));
-			}
-			g_modelReady = true;
-		}
-		catch (...) {
-			if (g_onnx_net) { delete g_onnx_net; g_onnx_net = nullptr; }
-			if (g_tracker) { delete g_tracker; g_tracker = nullptr; }
-		}
-	}
-
-	// [NEW] โหลด Parking Template
-	bool LoadParkingTemplate_Online(const std::string& filename) {
-		ResetParkingCache_Online();
-		templateSet_online = false; // [FIX] Force the engine to register the new template frame geometry
-
-		if (!g_pm_logic_online) g_pm_logic_online = new ParkingManager();
-		if (!g_pm_display_online) g_pm_display_online = new ParkingManager();
-
-		bool s1 = g_pm_logic_online->loadTemplate(filename);
-		bool s2 = g_pm_display_online->loadTemplate(filename);
-
-		if (s1 && s2) {
-			g_parkingEnabled_online.store(true); // [PHASE 1 FIX] Use atomic store
-			return true;
-		}
-		return false;
-	}
-
-// ==========================================
-//  LAYER 3: PRESENTATION (Frontend)
-// ==========================================
-
-// *** [NEW] PROCESSED FRAME SHARING (Pipeline Output) moved to CameraInstance ***
-
-// *** [PHASE 2] PERFORMANCE OPTIMIZATION ***
-// We initialize g_lastViolationCheck_online below where the definition runs.
-
-// *** [PHASE 3] MEMORY OPTIMIZATION ***
-
-// --- Helper Functions ---
-
-inline cv::Mat CameraInstance::FormatToLetterbox(const cv::Mat& source, int width, int height, float& ratio, int& dw, int& dh) {
-	if (source.empty()) return cv::Mat();
-
-	float r = (std::min)((float)width / source.cols, (float)height / source.rows);
-	int new_unpad_w = (int)round(source.cols * r);
-	int new_unpad_h = (int)round(source.rows * r);
-
-	dw = (width - new_unpad_w) / 2;
-    dh = (height - new_unpad_h) / 2;
-
-	cv::Mat resized;
-	if (source.cols != new_unpad_w || source.rows != new_unpad_h) {
-		cv::resize(source, resized, cv::Size(new_unpad_w, new_unpad_h));
-	}
-	else {
-		resized = source.clone();
-	}
-
-	cv::Mat result(height, width, CV_8UC3, cv::Scalar(114, 114, 114));
-	resized.copyTo(result(cv::Rect(dw, dh, new_unpad_w, new_unpad_h)));
-	ratio = r;
-	return result;
-}
-
-// [FIX] Moved the stray code away because it was causing compile errors.
-	
-/*
-	cv::Mat result = fullFrame.clone();
-	result = result * 0.3;
-	
-	cv::Rect safeBbox = carBox & cv::Rect(0, 0, fullFrame.cols, fullFrame.rows);
-	if (safeBbox.area() > 0) {
-		cv::Mat carROI = fullFrame(safeBbox).clone();
-		carROI.copyTo(result(safeBbox));
-		cv::rectangle(result, safeBbox, cv::Scalar(0, 255, 255), 3);
-	}
-	
-	return result;
-}
-*/
-
-// *** WORKER PROCESS (AI Thread) ***
-
-inline void CameraInstance::ProcessFrameOnline(const cv::Mat& inputFrame, long long frameSeq) {
-	{
-		std::lock_guard<std::mutex> lock(g_aiMutex_online);
-		if (inputFrame.empty() || !g_onnx_net || !g_modelReady || !g_tracker) return;
-	}
-
-	try {
-		cv::Mat workingImage = inputFrame.clone();
-		float ratio; int dw, dh;
-		cv::Mat input_image = FormatToLetterbox(workingImage, YOLO_INPUT_SIZE, YOLO_INPUT_SIZE, ratio, dw, dh);
-		if (input_image.empty()) return;
-
-		cv::Mat blob;
-		cv::dnn::blobFromImage(input_image, blob, 1.0 / 255.0, cv::Size(YOLO_INPUT_SIZE, YOLO_INPUT_SIZE), cv::Scalar(), true, false);
-
-		std::vector<cv::Mat> outputs;
-		{
-			std::lock_guard<std::mutex> lock(g_aiMutex_online);
-			if (!g_onnx_net->forward(blob, outputs)) return; // [GPU] ONNX Runtime inference
-		}
-
-		if (outputs.empty() || outputs[0].empty()) return;
-
-		cv::Mat output_data = outputs[0];
-		int rows = output_data.size[1];
-		int dimensions = output_data.size[2];
-
-		if (output_data.dims == 3) {
-			output_data = output_data.reshape(1, rows);
-			// Only transpose if we have a format like YOLOv8 (e.g., 84x8400)
-			if (dimensions > rows) {
-				cv::transpose(output_data, output_data);
-			}
-			rows = output_data.rows;
-			dimensions = output_data.cols;
-		}
-		else {
-			output_data = output_data.reshape(1, output_data.size[1]);
-			if (output_data.cols > output_data.rows) {
-				cv::Mat output_t;
-				cv::transpose(output_data, output_t);
-				output_data = output_t;
-			}
-			rows = output_data.rows;
-			dimensions = output_data.cols;
-		}
-
-		float* data = (float*)output_data.data;
-		std::vector<int> class_ids;
-		std::vector<float> confs;
-		std::vector<cv::Rect> boxes;
-
-		// Check output format: yolo26s uses [cx, cy, w, h, conf, class] (6 cols)
-		bool is_yolo26s_format = (dimensions == 6);
-
-		for (int i = 0; i < rows; i++) {
-			if (is_yolo26s_format) {
-				// yolo26s format: [x1, y1, x2, y2, conf, class_id] (Absolute Coordinates)
-				float x1_lb = data[0];
-				float y1_lb = data[1];
-				float x2_lb  = data[2];
-				float y2_lb  = data[3];
-				float conf  = data[4];
-				int cls     = (int)data[5];
-
-				// Only detect: Car (2), Motorcycle (3), Van/Truck (7)
-				bool is_vehicle = (cls == 2 || cls == 3 || cls == 7);
-
-				if (conf > CONF_THRESHOLD && is_vehicle) {
-					// Convert from letterbox corner coordinates back to original image coordinates
-					float left   = (x1_lb - dw) / ratio;
-					float top    = (y1_lb - dh) / ratio;
-					float right  = (x2_lb - dw) / ratio;
-					float bottom = (y2_lb - dh) / ratio;
-
-					float width  = right - left;
-					float height = bottom - top;
-
-					// Sanity check
-					if (width > 0 && height > 0) {
-						boxes.push_back(cv::Rect((int)left, (int)top, (int)width, (int)height));
-						confs.push_back(conf);
-						class_ids.push_back(cls);
-					}
-				}
-			}
-			else {
-				// Standard YOLO format: [x_center, y_center, w, h, class_0_conf, class_1_conf, ...]
-				int num_classes = dimensions - 4;
-				if (num_classes > 0) {
-					float* classes_scores = data + 4;
-					cv::Mat scores(1, num_classes, CV_32FC1, classes_scores);
-					cv::Point class_id;
-					double max_class_score;
-					cv::minMaxLoc(scores, 0, &max_class_score, 0, &class_id);
-
-					// Only detect: Car (2), Motorcycle (3), Van/Truck (7)
-					bool is_vehicle = (class_id.x == 2 || class_id.x == 3 || class_id.x == 7);
-
-					if (max_class_score > CONF_THRESHOLD && is_vehicle) {
-						float x = data[0]; 
-						float y = data[1]; 
-						float w = data[2]; 
-						float h = data[3];
-
-						float left = (float)((x - 0.5 * w - dw) / ratio);
-						float top = (float)((y - 0.5 * h - dh) / ratio);
-						float width = w / ratio;
-						float height = h / ratio;
-
-						if (width > 0 && height > 0) {
-							boxes.push_back(cv::Rect((int)left, (int)top, (int)width, (int)height));
-							confs.push_back((float)max_class_score);
-							class_ids.push_back(class_id.x);
-						}
-					}
-				}
-			}
-			data += dimensions;
-		}
-
-		std::vector<int> nms;
-		cv::dnn::NMSBoxes(boxes, confs, CONF_THRESHOLD, NMS_THRESHOLD, nms);
-
-		std::vector<cv::Rect> nms_boxes;
-		std::vector<int> nms_class_ids;
-		std::vector<float> nms_confs;
-		
-		for (int idx : nms) {
-			nms_boxes.push_back(boxes[idx]);
-			nms_class_ids.push_back(class_ids[idx]);
-			nms_confs.push_back(confs[idx]);
-		}
-
-		std::vector<TrackedObject> trackedObjs;
-		{
-			std::lock_guard<std::mutex> lock(g_aiMutex_online);
-			trackedObjs = g_tracker->update(nms_boxes, nms_class_ids, nms_confs);
-		}
-
-		std::map<int, SlotStatus> calculatedStatuses;
-		std::map<int, float> calculatedOccupancy;
-		std::map<int, std::string> calculatedTypes;
-		std::set<int> violations;
-
-		bool parkingEnabled = g_parkingEnabled_online.load(); // [PHASE 1 FIX] Use atomic load
-		if (parkingEnabled && g_pm_logic_online) {
-			if (!templateSet_online) {
-				g_pm_logic_online->setTemplateFrame(inputFrame);
-				templateSet_online = true;
-			}
-
-			g_pm_logic_online->updateSlotStatus(trackedObjs);
-
-			for (const auto& slot : g_pm_logic_online->getSlots()) {
-				calculatedStatuses[slot.id] = slot.status;
-				calculatedOccupancy[slot.id] = slot.occupancyPercent;
-				calculatedTypes[slot.id] = slot.type;
-			}
-
-			// ตรวจจับรถจอดผิด (จอดนอกช่อง หรือ จอดผิดประเภท)
-			for (const auto& car : trackedObjs) {
-				if (car.framesStill > 30) {
-					bool inAnySlot = false;
-                    bool inWrongTypeSlot = false;
-                    
-					for (const auto& slot : g_pm_logic_online->getSlots()) {
-						cv::Point center = (car.bbox.tl() + car.bbox.br()) * 0.5;
-						if (cv::pointPolygonTest(slot.polygon, center, false) >= 0) {
-							inAnySlot = true;
-                            if (slot.status == SlotStatus::ILLEGAL && slot.occupiedByTrackId == car.id) {
-                                inWrongTypeSlot = true;
-                            }
-							break;
-						}
-					}
-                    
-                    // Violation if either not in any slot OR parked in a wrong-type slot
-					if (!inAnySlot || inWrongTypeSlot) {
-						violations.insert(car.id);
-					}
-				}
-			}
-		}
-
-		{
-			std::lock_guard<std::mutex> stateLock(g_onlineStateMutex);
-			g_onlineState.cars = trackedObjs;
-			g_onlineState.slotStatuses = calculatedStatuses;
-			g_onlineState.slotOccupancy = calculatedOccupancy;
-			g_onlineState.slotTypes = calculatedTypes;
-			g_onlineState.violatingCarIds = violations;
-			g_onlineState.frameSequence = frameSeq;
-		}
-	}
-	catch (...) {}
-}
-
-// *** DRAWING FUNCTION (UI Thread) - เหมือนออฟไลน์ ***
-
-inline void CameraInstance::DrawSceneOnline(const cv::Mat& frame, long long displaySeq, cv::Mat& outResult) {
-	if (frame.empty()) return;
-
-	// [PHASE 3] Update FPS
-	g_fpsMonitor_online.update();
-
-	if (g_drawingBuffer_online.size() != frame.size() || g_drawingBuffer_online.type() != frame.type()) {
-		g_drawingBuffer_online.create(frame.size(), frame.type());
-	}
-	frame.copyTo(g_drawingBuffer_online);
-	outResult = g_drawingBuffer_online;
-
-	OnlineAppState state;
-	{
-		std::lock_guard<std::mutex> lock(g_onlineStateMutex);
-		state = g_onlineState;
-	}
-
-	bool isFuture = (state.frameSequence > displaySeq);
-
-	// Parking Layer
-	bool parkingEnabled = g_parkingEnabled_online.load(); // [PHASE 1 FIX] Use atomic load
-	if (parkingEnabled && g_pm_display_online) {
-		bool statusChanged = (state.slotStatuses != g_lastDrawnStatus_online);
-		bool noCache = g_cachedParkingOverlay_online.empty() || g_cachedParkingOverlay_online.size() != outResult.size();
-
-		if (statusChanged || noCache) {
-			g_cachedParkingOverlay_online = cv::Mat::zeros(outResult.size(), CV_8UC3);
-			if (!state.slotStatuses.empty()) {
-				auto& displaySlots = g_pm_display_online->getSlots();
-				for (auto& slot : displaySlots) {
-					if (state.slotStatuses.count(slot.id)) {
-						slot.status = state.slotStatuses[slot.id];
-						slot.occupancyPercent = state.slotOccupancy[slot.id];
-					}
-				}
-			}
-			g_cachedParkingOverlay_online = g_pm_display_online->drawSlots(g_cachedParkingOverlay_online);
-			g_lastDrawnStatus_online = state.slotStatuses;
-		}
-
-		if (!g_cachedParkingOverlay_online.empty()) {
-			cv::add(outResult, g_cachedParkingOverlay_online, outResult);
-		}
-	}
-
-	// Car Layer
-	if (!isFuture) {
-		// [PHASE 3] Track cars in current frame for GC
-		std::set<int> currentFrameCarIds;
-		
-		for (const auto& obj : state.cars) {
-			if (obj.classId >= 0 && obj.classId < g_classes.size()) {
-				currentFrameCarIds.insert(obj.id);
-				
-				cv::Rect box = obj.bbox;
-				bool isViolating = (state.violatingCarIds.count(obj.id) > 0);
-
-				if (isViolating) {
-					cv::Rect roi = box & cv::Rect(0, 0, outResult.cols, outResult.rows);
-					if (roi.area() > 0) {
-						cv::Mat roiMat = outResult(roi);
-						cv::Mat redBuf(roi.size(), CV_8UC3, cv::Scalar(0, 0, 255));
-						cv::addWeighted(roiMat, 0.6, redBuf, 0.4, 0, roiMat);
-					}
-					cv::rectangle(outResult, box, cv::Scalar(0, 0, 255), 2);
-				}
-				else {
-					cv::rectangle(outResult, box, g_colors[obj.classId], 2);
-				}
-
-				// [PHASE 3] Label Caching Logic
-				bool needsUpdate = false;
-				auto it = g_labelCache_online.find(obj.id);
-				
-				if (it == g_labelCache_online.end()) {
-					needsUpdate = true;
-				}
-				else {
-					CachedLabel_Online& cached = it->second;
-					if (cached.isViolating != isViolating || cached.classId != obj.classId) {
-						needsUpdate = true;
-					}
-					if (cached.text.empty()) needsUpdate = true;
-				}
-				
-				if (needsUpdate) {
-					CachedLabel_Online cl;
-					cl.isViolating = isViolating;
-					cl.classId = obj.classId;
-					cl.text = "ID:" + std::to_string(obj.id);
-					if (isViolating) cl.text += " [VIOLATION]";
-					else if (!parkingEnabled) cl.text += " " + g_classes[obj.classId];
-					
-					cl.size = cv::getTextSize(cl.text, cv::FONT_HERSHEY_SIMPLEX, 0.5, 1, &cl.baseline);
-					g_labelCache_online[obj.id] = cl;
-				}
-				
-				// Draw using Cache
-				CachedLabel_Online& labelInfo = g_labelCache_online[obj.id];
-				cv::Scalar labelBg = isViolating ? cv::Scalar(0, 0, 255) : g_colors[obj.classId];
-
-				cv::rectangle(outResult, cv::Point(box.x, box.y - labelInfo.size.height - 5), 
-							  cv::Point(box.x + labelInfo.size.width, box.y), labelBg, -1);
-				cv::putText(outResult, labelInfo.text, cv::Point(box.x, box.y - 5), 
-							cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(255, 255, 255), 1);
-			}
-		}
-		
-		// [PHASE 3] Cache Garbage Collection
-		if (g_labelCache_online.size() > 100 && g_labelCache_online.size() > currentFrameCarIds.size() * 2) {
-			auto it = g_labelCache_online.begin();
-			while (it != g_labelCache_online.end()) {
-				if (currentFrameCarIds.find(it->first) == currentFrameCarIds.end()) {
-					it = g_labelCache_online.erase(it);
-				}
-				else {
-					++it;
-				}
-			}
-		}
-	}
-
-	// [PHASE 3] Draw Stats (Obj count + FPS)
-	std::string stats = "Obj: " + std::to_string(state.cars.size()) + " | FPS: " + std::to_string((int)g_fpsMonitor_online.avgFPS);
-	cv::putText(outResult, stats, cv::Point(10, 25), cv::FONT_HERSHEY_SIMPLEX, 0.7, cv::Scalar(0, 255, 0), 2);
-}
-
-// ============================================================
-//  [PHASE 1] [UNMANAGED] VIDEO RECORDING (DVR) & FPS SYNC
-// ============================================================
-
-inline void CameraInstance::StartNewVideoClip_Online(int width, int height) {
-	if (width <= 0 || height <= 0) return;
-	SYSTEMTIME st;
-	GetLocalTime(&st);
-
-	// Date folder: C:\locvideo\YYYYMMDD\camera_{ID}
-	char dateFolder[128];
-	sprintf_s(dateFolder, sizeof(dateFolder),
-		"C:\\locvideo\\%04d%02d%02d\\camera_%d", st.wYear, st.wMonth, st.wDay, camera_id);
-	CreateDirectoryA("C:\\locvideo", NULL);
-	
-	char parentFolder[64];
-	sprintf_s(parentFolder, sizeof(parentFolder), "C:\\locvideo\\%04d%02d%02d", st.wYear, st.wMonth, st.wDay);
-	CreateDirectoryA(parentFolder, NULL);
-	
-	CreateDirectoryA(dateFolder, NULL);
-
-	// Filename: HHMMSS.webm (start time of clip)
-	char relPath[128];
-	sprintf_s(relPath, sizeof(relPath),
-		"%04d%02d%02d/camera_%d/%02d%02d%02d.webm",
-		st.wYear, st.wMonth, st.wDay, camera_id,
-		st.wHour, st.wMinute, st.wSecond);
-
-	std::string fullPath = std::string("C:\\locvideo\\") + relPath;
-	std::replace(fullPath.begin(), fullPath.end(), '/', '\\');
-
-	std::lock_guard<std::mutex> lock(g_videoWriterMutex_online);
-	if (g_videoWriter_online) {
-		g_videoWriter_online->release();
-		delete g_videoWriter_online;
-		g_videoWriter_online = nullptr;
-	}
-
-	// We force the writer to expect strictly 10.0 FPS
-	cv::VideoWriter* writer2 = new cv::VideoWriter(
-		fullPath,
-		cv::VideoWriter::fourcc('V', 'P', '8', '0'),
-		10.0,
-		cv::Size(width, height));
-
-	if (writer2->isOpened()) {
-		g_videoWriter_online = writer2;
-		g_currentVideoRelPath = std::string(relPath);
-		g_videoClipStartTick = cv::getTickCount();
-		g_videoFramesWritten = 0; // reset counter for new clip
-		OutputDebugStringA(("[VIDEO] New clip (10 FPS DVR): " + fullPath + "\n").c_str());
-	}
-	else {
-		delete writer2;
-		OutputDebugStringA("[VIDEO] Failed to open VideoWriter!\n");
-	}
-}
-
-inline void CameraInstance::StopVideoRecording_Online() {
-	std::lock_guard<std::mutex> lock(g_videoWriterMutex_online);
-	if (g_videoWriter_online) {
-		g_videoWriter_online->release();
-		delete g_videoWriter_online;
-		g_videoWriter_online = nullptr;
-	}
-	g_currentVideoRelPath = "";
-}
-
-inline void CameraInstance::VideoRecordingThreadFunc_Online(int width, int height) {
-	const int targetFPS = 10;
-	const int frameDelayMs = 1000 / targetFPS; // 100ms per frame
-
-	StartNewVideoClip_Online(width, height);
-	
-	auto nextFrameTime = std::chrono::steady_clock::now();
-
-	cv::Mat lastValidFrame;
-
-	while (g_videoRecordingRunning.load()) {
-		cv::Mat frameToWrite;
-		{
-			std::lock_guard<std::mutex> lock(g_videoCurrentFrameMutex);
-			if (!g_videoCurrentFrame.empty()) {
-				frameToWrite = g_videoCurrentFrame.clone(); 
-				lastValidFrame = frameToWrite.clone();
-			} else if (!lastValidFrame.empty()) {
-				frameToWrite = lastValidFrame.clone(); // Duplicate last frame to pad the timeline
-			}
-		}
-
-		bool needsNewClip = false;
-		if (!frameToWrite.empty()) {
-			std::lock_guard<std::mutex> vl(g_videoWriterMutex_online);
-			if (g_videoWriter_online && g_videoWriter_online->isOpened()) {
-				g_videoWriter_online->write(frameToWrite);
-				g_videoFramesWritten++;
-
-				// Force split strictly by clock time
-				double secondsElapsed = ((double)cv::getTickCount() - (double)g_videoClipStartTick) / cv::getTickFrequency();
-				if (secondsElapsed >= VIDEO_CLIP_SECONDS) {
-					needsNewClip = true;
-				}
-			}
-		}
-
-		if (needsNewClip) {
-			StartNewVideoClip_Online(width, height);
-			nextFrameTime = std::chrono::steady_clock::now(); // Reset anchor for the next brand new clip
-		}
-
-		// ALWAYS advance the clock by exactly 100ms and wait. This forces frame duplication if AI is slow
-		nextFrameTime += std::chrono::milliseconds(frameDelayMs);
-		auto now = std::chrono::steady_clock::now();
-		if (now < nextFrameTime) {
-			std::this_thread::sleep_until(nextFrameTime);
-		}
-	}
-
-	StopVideoRecording_Online();
-}
-
-inline void CameraInstance::StartVideoRecordingThread_Online(int width, int height) {
-	if (g_videoRecordingThread) return;
-	g_videoRecordingRunning.store(true);
-	g_videoRecordingThread = new std::thread(&CameraInstance::VideoRecordingThreadFunc_Online, this, width, height);
-}
-
-inline void CameraInstance::StopVideoRecordingThread_Online() {
-	g_videoRecordingRunning.store(false);
-	if (g_videoRecordingThread && g_videoRecordingThread->joinable()) {
-		g_videoRecordingThread->join();
-	}
-	delete g_videoRecordingThread;
-	g_videoRecordingThread = nullptr;
-}
-
-// *** GET RAW FRAME ***
-inline void CameraInstance::GetRawFrameOnline(cv::Mat& outFrame, long long& outSeq) {
-	std::lock_guard<std::mutex> lock(g_frameMutex);
-	extern void DumpLog(const std::string& msg);
-	
-	if (!g_latestRawFrame.empty()) {
-		outFrame = g_latestRawFrame; // [FIX] Shallow copy for speed (AI thread clones if needed)
-		outSeq = g_frameSeq_online;
-	}
-}
-
-// *** [NEW] GET PROCESSED FRAME (For UI) ***
-inline void CameraInstance::GetProcessedFrameOnline(cv::Mat& outFrame, long long& outSeq) {
-	std::lock_guard<std::mutex> lock(g_processedMutex_online);
-	if (!g_processedFrame_online.empty()) {
-		outFrame = g_processedFrame_online; // [FIX] Shallow copy for speed
-		outSeq = g_processedSeq_online;
-	}
-}
-
-// *** [NEW] CREATE VIOLATION VISUALIZATION ***
-inline cv::Mat CameraInstance::CreateViolationVisualization(cv::Mat fullFrame, cv::Rect carBox) {
-	if (fullFrame.empty()) return cv::Mat();
-	
-	cv::Mat result = fullFrame.clone();
-	result = result * 0.3;
-	
-	cv::Rect safeBbox = carBox & cv::Rect(0, 0, fullFrame.cols, fullFrame.rows);
-	if (safeBbox.area() > 0) {
-		cv::Mat carROI = fullFrame(safeBbox).clone();
-		carROI.copyTo(result(safeBbox));
-		cv::rectangle(result, safeBbox, cv::Scalar(0, 255, 255), 3);
-	}
-	
-	return result;
-}
-
-}; // ---- END OF CameraInstance CLASS ----
-
+#include "CameraInstance.h" // [PORTABLE] Native engine, shared with the headless daemon
 #pragma managed(pop)
 
-
-__declspec(selectany) std::map<int, CameraInstance*> g_cameras;
-__declspec(selectany) int g_activeCameraId = 1;
-
-static CameraInstance* GetCam(int id = -1) {
-    if (id == -1) id = g_activeCameraId;
-    if (g_cameras.find(id) == g_cameras.end()) {
-        std::vector<CameraConfig> confs = CameraManager::LoadCameras();
-        CameraConfig curr;
-        curr.id = id;
-        for (auto& c : confs) if(c.id == id) curr = c;
-        g_cameras[id] = new CameraInstance(curr);
-    }
-    return g_cameras[id];
-}
+inline void OnViolationRecorded_Managed(int cameraId, const ViolationEvent& ev);
 
 namespace ConsoleApplication3 {
 
@@ -1066,7 +49,6 @@ namespace ConsoleApplication3 {
 			isProcessing = false;
 			shouldStop = false;
 			violationsList_online = gcnew System::Collections::Generic::List<ViolationRecord_Online^>();
-			violatingCarTimers_online = gcnew System::Collections::Generic::Dictionary<int, System::DateTime>();
 
 			// [UI FIX] Disable Live Camera until template is loaded
 			btnLiveCamera->Enabled = false;
@@ -1074,6 +56,7 @@ namespace ConsoleApplication3 {
 
 			// Assign self to static property for web api
 			UploadForm::Instance = this;
+			g_onViolationRecorded = &OnViolationRecorded_Managed; // Engine records violations, we only show them
 
 			BackgroundWorker^ modelLoader = gcnew BackgroundWorker();
 			modelLoader->DoWork += gcnew DoWorkEventHandler(this, &UploadForm::LoadModel_DoWork);
@@ -1082,90 +65,16 @@ namespace ConsoleApplication3 {
 		}
 
 	public: bool StartCameraHeadless(int cameraId, String^ ip, String^ port, String^ path) {
-		int currentAttemptId = ++GetCam(cameraId)->g_connectionAttemptId_online;
-		
-		// [FIX CRASH] Stop any existing reader threads to prevent AccessViolation
-		// when GetCam(cameraId)->OpenGlobalCameraFromIP deletes GetCam(cameraId)->g_cap while the thread is still reading.
-		StopProcessingPublic(cameraId);
-		
-		if (!path->StartsWith("/")) {
-			path = "/" + path;
-		}
-		array<String^>^ urlFormats = gcnew array<String^> {
-			String::Format("http://{0}:{1}{2}", ip, port, path),
-			String::Format("http://{0}:{1}/videofeed", ip, port),
-			String::Format("http://{0}:{1}/video", ip, port),
-			String::Format("rtsp://{0}:{1}", ip, port)
-		};
-
-		bool connected = false;
-		for each (String^ streamUrl in urlFormats) {
-			if (currentAttemptId != GetCam(cameraId)->g_connectionAttemptId_online.load()) {
-				DumpLog("[INFO] Aborting previous connection attempt because a new one started.");
-				return false;
-			}
-			
-			std::string url = msclr::interop::marshal_as<std::string>(streamUrl);
-			DumpLog("[INFO] Headless trying to connect: " + url);
-			
-			// [FIX] Use attempt ID to allow early abort
-			GetCam(cameraId)->OpenGlobalCameraFromIP(url, currentAttemptId);
-			
-			for(int i = 0; i < 5; i++) {
-				if (currentAttemptId != GetCam(cameraId)->g_connectionAttemptId_online.load()) return false;
-				Threading::Thread::Sleep(100);
-			}
-
-			if (GetCam(cameraId)->g_cap && GetCam(cameraId)->g_cap->isOpened()) {
-				cv::Mat testFrame;
-				bool canRead = false;
-				for (int i = 0; i < 10; ++i) {
-					if (currentAttemptId != GetCam(cameraId)->g_connectionAttemptId_online.load()) {
-						// Abort! Another thread will clean up GetCam(cameraId)->g_cap if needed, or it's holding valid stream.
-						return false;
-					}
-					{
-						std::lock_guard<std::mutex> lock(GetCam(cameraId)->g_frameMutex);
-						if (GetCam(cameraId)->g_cap && GetCam(cameraId)->g_cap->read(testFrame) && !testFrame.empty()) { 
-                            canRead = true; 
-                            GetCam(cameraId)->g_latestRawFrame = testFrame.clone();
-                            GetCam(cameraId)->g_frameSeq_online++;
-                        }
-					}
-					if (canRead) {
-						connected = true;
-						DumpLog("[SUCCESS] Headless Connected successfully!");
-						break;
-					}
-					Threading::Thread::Sleep(100);
-				}
-				if (!connected) {
-					DumpLog("[WARNING] Camera opened but failed to read first frame after 1 second.");
-				}
-				if (connected) break;
-			}
-			{
-				if (!connected) {
-                    std::lock_guard<std::mutex> lock(GetCam(cameraId)->g_frameMutex);
-                    if (GetCam(cameraId)->g_cap) { delete GetCam(cameraId)->g_cap; GetCam(cameraId)->g_cap = nullptr; }
-                }
-			}
-		}
+		std::vector<std::string> urls = CandidateStreamUrls_Online(
+			msclr::interop::marshal_as<std::string>(ip),
+			msclr::interop::marshal_as<std::string>(port),
+			msclr::interop::marshal_as<std::string>(path));
 
+		bool connected = StartCameraFromUrls_Online(cameraId, urls, "models/test/yolo26s.onnx");
 		if (connected) {
-			// If this camera was dynamically created/restarted from web config,
-			// the AI model won't be loaded yet. Initialize it now before processing starts.
-			if (!GetCam(cameraId)->g_modelReady || !GetCam(cameraId)->g_onnx_net) {
-				DumpLog("[INFO] Initializing AI model for camera " + std::to_string(cameraId));
-				GetCam(cameraId)->InitGlobalModel("models/test/yolo26s.onnx");
-			}
-			GetCam(cameraId)->StartProcessing();
 			timer1->Start(); // Ensure UI tick still runs
-			return true;
-		} else {
-			DumpLog("[ERROR] Headless could not connect to camera (timeout or invalid IP).");
-			return false;
 		}
+		return connected;
 	}
 
 	protected:
@@ -1229,7 +138,6 @@ private: System::Windows::Forms::Label^ label1;
 	private: System::Windows::Forms::Label^ lblViolationTitle_online;
 	private: System::Windows::Forms::Label^ lblViolationCount_online;
 	private: System::Windows::Forms::Button^ btnClearViolations_online;
-	private: System::Collections::Generic::Dictionary<int, System::DateTime>^ violatingCarTimers_online;
 
 	// [NEW] Background mode controls
 	private: System::Windows::Forms::Button^ btnRunInBackground;
@@ -1683,11 +591,12 @@ private: System::Windows::Forms::Label^ label1;
 				if (!isBackgroundMode) {
 					UpdatePictureBox(finalFrame);
 				}
-				// Violation checks always run — needed for logging even in background mode
-				bool parkingEnabled = GetCam()->g_parkingEnabled_online.load();
-				if (parkingEnabled) {
-					CheckViolations_Online(g_activeCameraId, finalFrame);
-				}
+			}
+
+			// Violations themselves are detected by the camera's processing thread
+			for each(ViolationRecord_Online^ record in violationsList_online) {
+				System::TimeSpan duration = System::DateTime::Now - record->captureTime;
+				record->durationSeconds = (int)duration.TotalSeconds;
 			}
 
 			// *** [NEW] UPDATE LOGS WITH CURRENT DATETIME ***
@@ -1762,64 +671,6 @@ private: System::Windows::Forms::Label^ label1;
 		}
 		catch (...) {}
 	}
-	// Called from ProcessingLoopHeadless to keep the web dashboard fed with parking stats
-	// This is needed because timer1_Tick (WinForms UI timer) may not fire in headless mode.
-	private: void UpdateWebStats(int cameraId) {
-		if (!GetCam(cameraId)->g_mjpegServer_online) return;
-		OnlineAppState state;
-		{
-			std::lock_guard<std::mutex> lock(GetCam(cameraId)->g_onlineStateMutex);
-			state = GetCam(cameraId)->g_onlineState;
-		}
-		if (state.slotStatuses.empty()) return;
-
-		int emptyCount = 0, occupiedCount = 0, carEmpty = 0, carNormal = 0, motoEmpty = 0, motoNormal = 0;
-		for (const auto& slotEntry : state.slotStatuses) {
-			int slotId = slotEntry.first;
-			std::string type = "Car";
-			if (state.slotTypes.find(slotId) != state.slotTypes.end())
-				type = state.slotTypes.at(slotId);
-			if (slotEntry.second == SlotStatus::EMPTY) {
-				emptyCount++;
-				if (type == "Motorcycle") motoEmpty++; else carEmpty++;
-			} else {
-				occupiedCount++;
-				if (type == "Motorcycle") motoNormal++; else carNormal++;
-			}
-		}
-		int violationCount = (int)state.violatingCarIds.size();
-
-		std::string json = "{\"empty\":" + std::to_string(emptyCount) +
-		                   ",\"normal\":" + std::to_string(occupiedCount) +
-		                   ",\"carEmpty\":" + std::to_string(carEmpty) +
-		                   ",\"carNormal\":" + std::to_string(carNormal) +
-		                   ",\"motoEmpty\":" + std::to_string(motoEmpty) +
-		                   ",\"motoNormal\":" + std::to_string(motoNormal) +
-		                   ",\"violation\":" + std::to_string(violationCount) + ",\"logs\":[";
-		bool first = true;
-		int logCount = 0;
-		// Send up to the 5 most recent logs
-		for (int i = violationsList_online->Count - 1; i >= 0; i--) {
-			if (logCount >= 5) break;
-			ViolationRecord_Online^ rec = violationsList_online[i];
-			if (!first) json += ",";
-			System::String^ ts = rec->captureTime.ToString("HH:mm:ss");
-			System::String^ vt = rec->violationType;
-			std::string timeStr = msclr::interop::marshal_as<std::string>(ts);
-			std::string typeStr = msclr::interop::marshal_as<std::string>(vt);
-			json += "{\"id\":" + std::to_string(rec->carId) + ",\"time\":\"" + timeStr + "\",\"type\":\"" + typeStr + "\"}";
-			first = false;
-			logCount++;
-		}
-		json += "]}";
-
-		static std::map<int, std::string> last_sent_jsons;
-		if (json != last_sent_jsons[cameraId]) {
-			last_sent_jsons[cameraId] = json;
-			GetCam(cameraId)->g_mjpegServer_online->SetStats(cameraId, json);
-		}
-	}
-
 	// Called by web API disconnect — stops camera threads but keeps the web server running
 	public: void StopProcessingPublic(int cameraId) {
 		GetCam(cameraId)->shouldStop = true;
@@ -2235,233 +1086,41 @@ private: System::Void UploadForm_FormClosing(System::Object^ sender, FormClosing
 	StopProcessing(1);
 }
 
-	// ==========================================================
-	// [PHASE 3] JSON REGISTRY & MONGOENGINE EXPORT (1 FILE PER EVENT/CHANGE)
-	// ==========================================================
-	private: void SaveAnomalyEventJson(int cameraId, int carId, System::String^ violationType, long long epochMs, std::string snapshotPath) {
-		SYSTEMTIME st;
-		GetLocalTime(&st);
-		char dateFolder[256];
-		sprintf_s(dateFolder, sizeof(dateFolder), "C:\\loc_json\\anomaly_events\\%04d%02d%02d\\camera_%d", st.wYear, st.wMonth, st.wDay, cameraId);
-		CreateDirectoryA("C:\\loc_json", NULL);
-		CreateDirectoryA("C:\\loc_json\\anomaly_events", NULL);
-		
-		char parentFolder[128];
-		sprintf_s(parentFolder, sizeof(parentFolder), "C:\\loc_json\\anomaly_events\\%04d%02d%02d", st.wYear, st.wMonth, st.wDay);
-		CreateDirectoryA(parentFolder, NULL);
-
-		CreateDirectoryA(dateFolder, NULL);
-
-		// [1 File Per Event]
-		std::string jsonPath = std::string(dateFolder) + "\\event_" + std::to_string(epochMs) + "_car_" + std::to_string(carId) + ".json";
-		
-		// Calculate seconds into the clip for media_seek_time_seconds based on exact frame count (10 FPS)
-		int seekSeconds = 0;
-		{
-			std::lock_guard<std::mutex> vl(GetCam(cameraId)->g_videoWriterMutex_online);
-			seekSeconds = GetCam(cameraId)->g_videoFramesWritten / 10;
-		}
-		if (seekSeconds < 0) seekSeconds = 0;
-
-		// Format timestamp as ISO-8601 string for MongoEngine DateTimeField
-		char timeBuf[64];
-		sprintf_s(timeBuf, sizeof(timeBuf), "%04d-%02d-%02dT%02d:%02d:%02d", 
-                  st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond);
-
-		// Dynamic Camera ID string representation
-		std::string camId = "camera_" + std::to_string(cameraId);
-
-		// Replace backslashes with forward slashes for cross-platform JSON API usage
-		std::replace(snapshotPath.begin(), snapshotPath.end(), '\\', '/');
-		std::string videoPath = "C:/locvideo/" + GetCam(cameraId)->g_currentVideoRelPath;
-
-		json newEvent = {
-			{"camera_id", camId},
-			{"timestamp", std::string(timeBuf)},
-			{"event_type", msclr::interop::marshal_as<std::string>(violationType)},
-			{"confidence", 0.95},
-			{"media_snapshot_url", snapshotPath},
-			{"media_video_url", videoPath},
-			{"media_seek_time_seconds", seekSeconds},
-			{"is_reviewed", false}
-		};
-
-		std::ofstream outFile(jsonPath);
-		if (outFile.is_open()) {
-			outFile << newEvent.dump(4);
-			outFile.close();
-		}
-	}
-
-	private: void SaveParkingAreaJson(int cameraId) {
-		OnlineAppState state;
-		{
-			std::lock_guard<std::mutex> lock(GetCam(cameraId)->g_onlineStateMutex);
-			state = GetCam(cameraId)->g_onlineState;
-		}
-
-		int carEmptyCount = 0;
-		int carOccupiedCount = 0;
-		int motoEmptyCount = 0;
-		int motoOccupiedCount = 0;
-
-		for (const auto& slotEntry : state.slotStatuses) {
-			int slotId = slotEntry.first;
-			std::string type = "Car";
-			if (state.slotTypes.find(slotId) != state.slotTypes.end()) {
-				type = state.slotTypes[slotId];
-			}
-
-			if (type == "Motorcycle") {
-				if (slotEntry.second == SlotStatus::EMPTY) motoEmptyCount++;
-				else motoOccupiedCount++;
-			} else {
-				if (slotEntry.second == SlotStatus::EMPTY) carEmptyCount++;
-				else carOccupiedCount++;
-			}
-		}
-		
-		int totalSlots = carEmptyCount + carOccupiedCount + motoEmptyCount + motoOccupiedCount;
-		int violationCount = (int)state.violatingCarIds.size();
-
-		// Track state changes to prevent bloat
-		static int lastCarEmpty = -1;
-		static int lastCarOccupied = -1;
-		static int lastMotoEmpty = -1;
-		static int lastMotoOccupied = -1;
-		static int lastViolation = -1;
-
-		if (carEmptyCount == lastCarEmpty && carOccupiedCount == lastCarOccupied && 
-			motoEmptyCount == lastMotoEmpty && motoOccupiedCount == lastMotoOccupied && 
-			violationCount == lastViolation) {
-			return; // No change in numbers, do not generate a file
-		}
-
-		lastCarEmpty = carEmptyCount;
-		lastCarOccupied = carOccupiedCount;
-		lastMotoEmpty = motoEmptyCount;
-		lastMotoOccupied = motoOccupiedCount;
-		lastViolation = violationCount;
-
-		SYSTEMTIME st;
-		GetLocalTime(&st);
-		char dateFolder[256];
-		sprintf_s(dateFolder, sizeof(dateFolder), "C:\\loc_json\\parking_areas\\%04d%02d%02d\\camera_%d", st.wYear, st.wMonth, st.wDay, cameraId);
-		CreateDirectoryA("C:\\loc_json", NULL);
-		CreateDirectoryA("C:\\loc_json\\parking_areas", NULL);
-		
-		char parentFolder[128];
-		sprintf_s(parentFolder, sizeof(parentFolder), "C:\\loc_json\\parking_areas\\%04d%02d%02d", st.wYear, st.wMonth, st.wDay);
-		CreateDirectoryA(parentFolder, NULL);
-		
-		CreateDirectoryA(dateFolder, NULL);
-
-		long long epoch = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-		std::string jsonPath = std::string(dateFolder) + "\\stats_" + std::to_string(epoch) + ".json";
-
-		char timeBuf[64];
-		sprintf_s(timeBuf, sizeof(timeBuf), "%04d-%02d-%02dT%02d:%02d:%02d", 
-                  st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond);
-
-		std::string camId = "camera_" + std::to_string(cameraId);
-
-		// MongoEngine ParkingArea representation
-		json areaStats = {
-			{"name", "Main Zone A"},
-			{"description", "Front Parking Monitoring"},
-			{"camera_id", camId},
-			{"total_slots", totalSlots},
-			{"total_car_slots", carEmptyCount + carOccupiedCount},
-			{"available_car_slots", carEmptyCount},
-			{"occupied_car_slots", carOccupiedCount},
-			{"total_motorcycle_slots", motoEmptyCount + motoOccupiedCount},
-			{"available_motorcycle_slots", motoEmptyCount},
-			{"occupied_motorcycle_slots", motoOccupiedCount},
-			{"violation_slots", violationCount},
-			{"created_date", std::string(timeBuf)},
-			{"updated_date", std::string(timeBuf)}
-		};
-
-		std::ofstream outFile(jsonPath);
-		if (outFile.is_open()) {
-			outFile << areaStats.dump(4);
-			outFile.close();
-		}
-	}
-
 	// *** [NEW] VIOLATION ALERTS METHODS ***
-	private: void AddViolationRecord_Online(int cameraId, int carId, cv::Mat& frameCapture, System::String^ violationType, 
-									 cv::Mat fullFrame, cv::Rect carBox) {
-		DumpLog("[VIOLATION] AddViolationRecord_Online called! carId=" + std::to_string(carId) + " frameEmpty=" + std::string(frameCapture.empty() ? "yes" : "no") + " fullEmpty=" + std::string(fullFrame.empty() ? "yes" : "no"));
-		if (frameCapture.empty()) return;
-
-		Bitmap^ screenshot = gcnew Bitmap(frameCapture.cols, frameCapture.rows, System::Drawing::Imaging::PixelFormat::Format24bppRgb);
-		System::Drawing::Rectangle rect(0, 0, frameCapture.cols, frameCapture.rows);
-		System::Drawing::Imaging::BitmapData^ bmpData = screenshot->LockBits(rect, System::Drawing::Imaging::ImageLockMode::WriteOnly, screenshot->PixelFormat);
-
-		for (int y = 0; y < frameCapture.rows; y++) {
-			memcpy((unsigned char*)bmpData->Scan0.ToPointer() + y * bmpData->Stride, frameCapture.data + y * frameCapture.step, frameCapture.cols * 3);
-		}
-		screenshot->UnlockBits(bmpData);
-
-		cv::Mat visualizationMat = GetCam(cameraId)->CreateViolationVisualization(fullFrame, carBox);
-		Bitmap^ visualizationBitmap = nullptr;
-		if (!visualizationMat.empty()) {
-			visualizationBitmap = gcnew Bitmap(visualizationMat.cols, visualizationMat.rows, System::Drawing::Imaging::PixelFormat::Format24bppRgb);
-			System::Drawing::Rectangle visRect(0, 0, visualizationMat.cols, visualizationMat.rows);
-			System::Drawing::Imaging::BitmapData^ visBmpData = visualizationBitmap->LockBits(visRect, System::Drawing::Imaging::ImageLockMode::WriteOnly, visualizationBitmap->PixelFormat);
-
-			for (int y = 0; y < visualizationMat.rows; y++) {
-				memcpy((unsigned char*)visBmpData->Scan0.ToPointer() + y * visBmpData->Stride, visualizationMat.data + y * visualizationMat.step, visualizationMat.cols * 3);
-			}
-			visualizationBitmap->UnlockBits(visBmpData);
-
-			// ==========================================================
-			// [PHASE 2] SAVE DARKENED SNAPSHOT TO DISK (WITH DATE FOLDER)
-			// ==========================================================
-			SYSTEMTIME st;
-			GetLocalTime(&st);
-			char dateFolder[256];
-			sprintf_s(dateFolder, sizeof(dateFolder),
-				"C:\\smart_parking_violations\\%04d%02d%02d\\camera_%d", st.wYear, st.wMonth, st.wDay, cameraId);
-
-			char parentFolder[128];
-			sprintf_s(parentFolder, sizeof(parentFolder), "C:\\smart_parking_violations\\%04d%02d%02d", st.wYear, st.wMonth, st.wDay);
-
-			CreateDirectoryA("C:\\smart_parking_violations", NULL);
-			CreateDirectoryA(parentFolder, NULL);
-			CreateDirectoryA(dateFolder, NULL);
-
-			long long epoch = std::chrono::duration_cast<std::chrono::milliseconds>(
-				std::chrono::system_clock::now().time_since_epoch()
-			).count();
-			
-			std::string violationFileName = "camera_" + std::to_string(cameraId) + "_event_" + std::to_string(epoch) + "_car_" + std::to_string(carId) + ".jpg";
-			std::string violationFilePath = std::string(dateFolder) + "\\" + violationFileName;
-			
-			cv::imwrite(violationFilePath, visualizationMat);
-			OutputDebugStringA(("[SNAPSHOT] Saved violation snapshot: " + violationFilePath + "\n").c_str());
+	// Called on the camera's processing thread once the engine has saved the snapshot and JSON
+	public: void AddViolationRecord_Online(int cameraId, const ViolationEvent& ev) {
+		DumpLog("[VIOLATION] AddViolationRecord_Online called! cam=" + std::to_string(cameraId) + " carId=" + std::to_string(ev.carId) + " frameEmpty=" + std::string(ev.crop.empty() ? "yes" : "no") + " visEmpty=" + std::string(ev.visualization.empty() ? "yes" : "no"));
+		if (ev.crop.empty()) return;
 
-			// [PHASE 3] Trigger JSON generation
-			SaveAnomalyEventJson(cameraId, carId, violationType, epoch, violationFilePath);
-			SaveParkingAreaJson(cameraId);
-		}
+		Bitmap^ screenshot = MatToBitmap_Online(ev.crop);
+		Bitmap^ visualizationBitmap = ev.visualization.empty() ? nullptr : MatToBitmap_Online(ev.visualization);
 
 		ViolationRecord_Online^ record = gcnew ViolationRecord_Online();
-		record->carId = carId;
+		record->carId = ev.carId;
 		record->screenshot = screenshot;
 		record->visualizationBitmap = visualizationBitmap;
-		record->violationType = violationType;
+		record->violationType = msclr::interop::marshal_as<System::String^>(ev.type);
 		record->captureTime = System::DateTime::Now;
 		record->durationSeconds = 0;
 
-		std::string vTypeStr = msclr::interop::marshal_as<std::string>(violationType);
-		DumpLog("[LOG-APPEND] Adding Violation Record for Car ID: " + std::to_string(carId) + " | Type: " + vTypeStr + " | Current List Size: " + std::to_string(violationsList_online->Count));
+		DumpLog("[LOG-APPEND] Adding Violation Record for Car ID: " + std::to_string(ev.carId) + " | Type: " + ev.type + " | Current List Size: " + std::to_string(violationsList_online->Count));
 
 		violationsList_online->Add(record);
 		RefreshViolationPanel_Online();
 	}
 
+	private: Bitmap^ MatToBitmap_Online(const cv::Mat& mat) {
+		Bitmap^ bmp = gcnew Bitmap(mat.cols, mat.rows, System::Drawing::Imaging::PixelFormat::Format24bppRgb);
+		System::Drawing::Rectangle rect(0, 0, mat.cols, mat.rows);
+		System::Drawing::Imaging::BitmapData^ bmpData = bmp->LockBits(rect, System::Drawing::Imaging::ImageLockMode::WriteOnly, bmp->PixelFormat);
+
+		for (int y = 0; y < mat.rows; y++) {
+			memcpy((unsigned char*)bmpData->Scan0.ToPointer() + y * bmpData->Stride, mat.data + y * mat.step, mat.cols * 3);
+		}
+		bmp->UnlockBits(bmpData);
+		return bmp;
+	}
+
 	private: void RefreshViolationPanel_Online() {
 		if (this->InvokeRequired) {
 			this->Invoke(gcnew System::Action(this, &UploadForm::RefreshViolationPanel_Online));
@@ -2534,80 +1193,9 @@ private: System::Void UploadForm_FormClosing(System::Object^ sender, FormClosing
 		}
 	}
 
-	public: void CheckViolations_Online(int cameraId, cv::Mat& currentFrame) {
-			// [PHASE 2] Throttle violation checks to 500ms
-		auto now = std::chrono::steady_clock::now();
-		auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - GetCam(cameraId)->g_lastViolationCheck_online).count();
-		
-		if (elapsed < VIOLATION_CHECK_INTERVAL_MS_ONLINE) {
-			return;
-		}
-		GetCam(cameraId)->g_lastViolationCheck_online = now;
-
-		OnlineAppState state;
-		{
-			std::lock_guard<std::mutex> lock(GetCam(cameraId)->g_onlineStateMutex);
-			state = GetCam(cameraId)->g_onlineState;
-		}
-
-		for each(auto car in state.cars) {
-			if (car.framesStill > 300) {
-				if (!violatingCarTimers_online->ContainsKey(car.id)) {
-					violatingCarTimers_online->Add(car.id, System::DateTime::Now);
-					
-					cv::Rect safeBbox = car.bbox & cv::Rect(0, 0, currentFrame.cols, currentFrame.rows);
-					if (safeBbox.area() > 0) {
-						cv::Mat croppedFrame = currentFrame(safeBbox).clone();
-						AddViolationRecord_Online(cameraId, car.id, croppedFrame, L"Overstay", currentFrame, car.bbox);
-					}
-				}
-			}
-		}
-
-		for each(int violatingId in state.violatingCarIds) {
-			// Determine specific violation type
-			System::String^ specificViolation = L"Wrong Parking"; // Default: parked outside slots
-			
-			for (const auto& slot : GetCam(cameraId)->g_pm_logic_online->getSlots()) {
-				if (slot.status == SlotStatus::ILLEGAL && slot.occupiedByTrackId == violatingId) {
-					specificViolation = L"Wrong Vehicle Type";
-					break;
-				}
-			}
-
-			bool already_captured = false;
-			for each(ViolationRecord_Online^ record in violationsList_online) {
-				if (record->carId == violatingId && record->violationType == specificViolation) {
-					already_captured = true;
-					break;
-				}
-			}
-
-			if (!already_captured) {
-				for each(auto car in state.cars) {
-					if (car.id == violatingId) {
-						cv::Rect safeBbox = car.bbox & cv::Rect(0, 0, currentFrame.cols, currentFrame.rows);
-						if (safeBbox.area() > 0) {
-							cv::Mat croppedFrame = currentFrame(safeBbox).clone(); // [FIX] Clone only when capturing
-							AddViolationRecord_Online(cameraId, violatingId, croppedFrame, specificViolation, currentFrame, car.bbox);
-						}
-						break;
-					}
-				}
-			}
-		}
-
-		for each(ViolationRecord_Online^ record in violationsList_online) {
-			System::TimeSpan duration = System::DateTime::Now - record->captureTime;
-			record->durationSeconds = (int)duration.TotalSeconds;
-		}
-
-		UpdateWebStats(cameraId);
-	}
-
 	private: System::Void btnClearViolations_online_Click(System::Object^ sender, System::EventArgs^ e) {
 		violationsList_online->Clear();
-		violatingCarTimers_online->Clear();
+		for (auto& entry : g_cameras) entry.second->ClearViolationHistory_Online();
 		RefreshViolationPanel_Online();
 	}
 
@@ -2668,58 +1256,8 @@ private: System::Void UploadForm_FormClosing(System::Object^ sender, FormClosing
 	};
 } // End of namespace ConsoleApplication3
 
-inline void CameraInstance::ProcessingLoopHeadless() {
-	lastProcessedSeq = -1;
-	while (!shouldStop) {
-		try {
-			cv::Mat frameToProcess;
-			long long seq = 0;
-			GetRawFrameOnline(frameToProcess, seq);
-
-			if (!frameToProcess.empty() && seq > lastProcessedSeq) {
-				ProcessFrameOnline(frameToProcess, seq);
-				
-				cv::Mat renderedFrame;
-				DrawSceneOnline(frameToProcess, seq, renderedFrame);
-
-				if (!renderedFrame.empty()) {
-					{
-						std::lock_guard<std::mutex> lock(g_processedMutex_online);
-						g_processedFrame_online = renderedFrame;
-						g_processedSeq_online = seq;
-						g_processedFramesCount_online++;
-					}
-
-					// [PHASE 3] Allow background headless AI threads to process violations natively
-					if (ConsoleApplication3::UploadForm::Instance != nullptr && g_parkingEnabled_online.load()) {
-						ConsoleApplication3::UploadForm::Instance->CheckViolations_Online(camera_id, frameToProcess);
-					}
-
-					if (g_mjpegServer_online) {
-						g_mjpegServer_online->SetLatestFrame(camera_id, renderedFrame);
-					}
-
-					cv::Mat scaledFrame;
-					double maxW = 1280.0;
-					if (renderedFrame.cols > maxW) {
-						double scale = maxW / renderedFrame.cols;
-						cv::resize(renderedFrame, scaledFrame, cv::Size(), scale, scale);
-					} else {
-						scaledFrame = renderedFrame;
-					}
-
-					StartVideoRecordingThread_Online(scaledFrame.cols, scaledFrame.rows);
-
-					{
-						std::lock_guard<std::mutex> vidLock(g_videoCurrentFrameMutex);
-						g_videoCurrentFrame = scaledFrame.clone();
-					}
-				}
-				lastProcessedSeq = seq;
-			} else {
-				std::this_thread::sleep_for(std::chrono::milliseconds(2));
-			}
-		}
-		catch (...) { std::this_thread::sleep_for(std::chrono::milliseconds(5)); }
+inline void OnViolationRecorded_Managed(int cameraId, const ViolationEvent& ev) {
+	if (ConsoleApplication3::UploadForm::Instance != nullptr) {
+		ConsoleApplication3::UploadForm::Instance->AddViolationRecord_Online(cameraId, ev);
 	}
 }
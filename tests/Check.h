@@ -0,0 +1,37 @@
+#pragma once
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include "Platform.h"
+
+// Minimal checks for the header-level tests: a failed CHECK is reported and counted, and the
+// test's exit code (CheckResult) tells ctest whether any failed.
+
+inline int& CheckFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            CheckFailures()++; \
+        } \
+    } while (0)
+
+inline int CheckResult(const char* name) {
+    if (CheckFailures() == 0) printf("%s: all checks passed\n", name);
+    else fprintf(stderr, "%s: %d check(s) failed\n", name, CheckFailures());
+    return CheckFailures() == 0 ? 0 : 1;
+}
+
+// An empty folder for one test, as a "C:\..." path (rooted at PARKING_DATA_ROOT off Windows)
+inline std::string CheckScratchDir(const std::string& name) {
+    std::string dir = "C:\\parking_tests\\" + name;
+    std::error_code ec;
+    std::filesystem::remove_all(PlatformPath(dir), ec);
+    std::filesystem::create_directories(PlatformPath(dir), ec);
+    return dir;
+}
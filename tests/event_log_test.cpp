@@ -0,0 +1,152 @@
+// [EVENT LOG] Segment writes, the in-memory index, and rebuilding it from damaged segments
+#include "EventLog.h"
+#include "Check.h"
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+static std::string g_root;
+
+static std::string Record(long long epochMs, const std::string& type) {
+    return "{\"epoch_ms\":" + std::to_string(epochMs) + ",\"event_type\":\"" + type + "\"}";
+}
+
+static void AppendTo(const std::shared_ptr<EventLog>& log, long long epochMs, const std::string& type) {
+    log->Append(epochMs, type, Record(epochMs, type));
+}
+
+static void WriteRaw(const std::string& path, const std::string& bytes) {
+    FILE* f = nullptr;
+    fopen_s(&f, path.c_str(), "ab");
+    fwrite(bytes.data(), 1, bytes.size(), f);
+    fclose(f);
+}
+
+// Matching records, newest first, each read back from its segment
+static std::vector<std::string> Lines(const std::shared_ptr<EventLog>& log, const EventLogQuery& q = EventLogQuery()) {
+    std::vector<std::pair<long long, std::string>> records;
+    log->Query(q, records);
+    std::vector<std::string> lines;
+    for (const auto& record : records) lines.push_back(record.second);
+    return lines;
+}
+
+static void TestAppendAndQuery() {
+    // The log's folder and its parents do not exist yet
+    auto log = std::make_shared<EventLog>(g_root + "\\append\\20250101\\camera_1");
+    AppendTo(log, 1000, "Overstay");
+    AppendTo(log, 2000, "WrongSlot");
+    AppendTo(log, 3000, "Overstay");
+    AppendTo(log, 2500, "Overstay"); // Clock stepped back: indexed in time order
+    CHECK(log->Generation() == 4);
+
+    std::vector<std::string> lines = Lines(log);
+    CHECK(lines.size() == 4);
+    if (lines.size() == 4) {
+        CHECK(lines[0] == Record(3000, "Overstay"));
+        CHECK(lines[1] == Record(2500, "Overstay"));
+        CHECK(lines[3] == Record(1000, "Overstay"));
+    }
+    CHECK(!log->HasPending());
+
+    EventLogQuery q;
+    q.type = "WrongSlot";
+    CHECK(Lines(log, q).size() == 1);
+    q.type = "NoSuchType";
+    CHECK(Lines(log, q).empty());
+    q = EventLogQuery();
+    q.fromMs = 2000;
+    q.toMs = 2500;
+    CHECK(Lines(log, q).size() == 2);
+    q = EventLogQuery();
+    q.limit = 1;
+    CHECK(Lines(log, q).size() == 1);
+
+    // Only the records added since a generation
+    std::vector<std::pair<long long, std::string>> since;
+    uint32_t generation = log->Generation();
+    AppendTo(log, 4000, "Overstay");
+    log->Query(EventLogQuery(), since, generation);
+    CHECK(since.size() == 1 && since[0].first == 4000);
+}
+
+static void TestLimitKeepsMillisecond() {
+    auto log = std::make_shared<EventLog>(g_root + "\\limit");
+    AppendTo(log, 1000, "A");
+    AppendTo(log, 2000, "A");
+    AppendTo(log, 2000, "B");
+    AppendTo(log, 2000, "C");
+    EventLogQuery q;
+    q.limit = 2;
+    CHECK(Lines(log, q).size() == 3); // Never ends a page halfway through a millisecond
+}
+
+static void TestReload() {
+    std::string dir = g_root + "\\reload";
+    {
+        auto log = std::make_shared<EventLog>(dir);
+        for (int i = 0; i < 50; i++) AppendTo(log, 1000 + i, i % 2 ? "Odd" : "Even");
+    } // Written out on destruction
+
+    auto log = std::make_shared<EventLog>(dir);
+    CHECK(log->Generation() == 50);
+    std::vector<std::string> lines = Lines(log);
+    CHECK(lines.size() == 50);
+    if (lines.size() == 50) CHECK(lines[0] == Record(1049, "Odd") && lines[49] == Record(1000, "Even"));
+    EventLogQuery q;
+    q.type = "Odd";
+    CHECK(Lines(log, q).size() == 25);
+}
+
+static void TestDamagedSegments() {
+    std::string dir = g_root + "\\damaged";
+    CreateDirectoryA(dir.c_str(), NULL);
+    EventLog probe(dir);
+    // Segment 0: a valid line, lines without a usable epoch_ms, then one cut short by a crash
+    WriteRaw(probe.SegmentPath(0), Record(1000, "Overstay") + "\n"
+        + "{\"event_type\":\"Overstay\"}\n"
+        + "{\"epoch_ms\":\"soon\",\"event_type\":\"Overstay\"}\n"
+        + "not json at all\n"
+        + Record(2000, "Overstay") + "\n"
+        + "{\"epoch_ms\":30");
+
+    auto log = std::make_shared<EventLog>(dir);
+    std::vector<std::string> lines = Lines(log);
+    CHECK(lines.size() == 2);
+    if (lines.size() == 2) CHECK(lines[0] == Record(2000, "Overstay") && lines[1] == Record(1000, "Overstay"));
+
+    // New records go to a fresh segment instead of merging with the torn line
+    AppendTo(log, 3000, "Overstay");
+    std::vector<EventLogRef> refs;
+    log->Select(EventLogQuery(), refs);
+    CHECK(refs.size() == 3);
+    if (refs.size() == 3) CHECK(refs[0].segment == 1 && refs[0].offset == 0);
+    lines = Lines(log);
+    CHECK(lines.size() == 3 && lines[0] == Record(3000, "Overstay"));
+
+    // ...and the rebuilt index agrees
+    auto reopened = std::make_shared<EventLog>(dir);
+    CHECK(Lines(reopened) == lines);
+}
+
+static void TestReaderOnMissingSegment() {
+    auto log = std::make_shared<EventLog>(g_root + "\\missing");
+    EventLogRef ref;
+    ref.log = log;
+    ref.segment = 7;
+    ref.length = 10;
+    EventLogReader reader;
+    std::string line;
+    CHECK(!reader.Read(ref, line));
+}
+
+int main() {
+    g_root = CheckScratchDir("event_log");
+    TestAppendAndQuery();
+    TestLimitKeepsMillisecond();
+    TestReload();
+    TestDamagedSegments();
+    TestReaderOnMissingSegment();
+    return CheckResult("event_log_test");
+}
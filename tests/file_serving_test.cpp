@@ -0,0 +1,151 @@
+// [FILES] Range parsing, path confinement, validators, sendfile ranges and the static asset cache
+#include "FileServing.h"
+#include "Check.h"
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#ifndef _WIN32
+#include <sys/socket.h>
+#endif
+
+typedef std::vector<std::pair<long long, long long>> Ranges;
+
+static Ranges Parse(const std::string& header, long long size, int expected) {
+    Ranges ranges;
+    CHECK(ParseByteRanges(header, size, ranges) == expected);
+    return ranges;
+}
+
+static void TestByteRanges() {
+    CHECK(Parse("bytes=0-99", 1000, 1) == Ranges({ { 0, 99 } }));
+    CHECK(Parse("bytes=0-99, 200-,-50", 1000, 1) == Ranges({ { 0, 99 }, { 200, 999 }, { 950, 999 } }));
+    CHECK(Parse("bytes=500-5000", 1000, 1) == Ranges({ { 500, 999 } }));  // Last byte clamped to the file
+    CHECK(Parse("bytes=-5000", 1000, 1) == Ranges({ { 0, 999 } }));       // Suffix longer than the file
+    CHECK(Parse("bytes=2000-,0-0", 1000, 1) == Ranges({ { 0, 0 } }));     // Unsatisfiable ones are dropped
+    CHECK(Parse("bytes=,,0-1,", 1000, 1) == Ranges({ { 0, 1 } }));
+
+    // Nothing satisfiable: 416
+    Parse("bytes=2000-", 1000, -1);
+    Parse("bytes=1000-1000", 1000, -1);
+    Parse("bytes=0-10", 0, -1);
+    Parse("bytes=-0", 1000, -1);
+
+    // Ignored: not a byte range, malformed, backwards or too many
+    Parse("", 1000, 0);
+    Parse("items=0-1", 1000, 0);
+    Parse("bytes=", 1000, 0);
+    Parse("bytes=5", 1000, 0);
+    Parse("bytes=5-2", 1000, 0);
+    Parse("bytes=-", 1000, 0);
+    Parse("bytes=a-b", 1000, 0);
+    Parse("bytes=+1-2", 1000, 0);
+    Parse("bytes=0x10-20", 1000, 0);
+    std::string many = "bytes=";
+    for (int i = 0; i <= HTTP_MAX_RANGES; i++) many += std::to_string(i) + "-" + std::to_string(i) + ",";
+    Parse(many, 1000, 0);
+
+    // Numbers that do not fit in 64 bits are refused rather than wrapped or thrown
+    Parse("bytes=0-99999999999999999999", 1000, 0);
+    Parse("bytes=99999999999999999999-", 1000, 0);
+    Parse("bytes=-99999999999999999999", 1000, 0);
+    Parse("bytes=0-18446744073709551616", 1000, 0);
+    Parse("bytes=999999999999999999-", 1000, -1);
+    CHECK(Parse("bytes=0-999999999999999999", 1000, 1) == Ranges({ { 0, 999 } }));
+    CHECK(Parse("bytes=-999999999999999999", 1000, 1) == Ranges({ { 0, 999 } }));
+}
+
+static void TestConfinedPath() {
+    CHECK(IsConfinedPath("C:\\locvideo\\20250101\\camera_1\\120000.mp4"));
+    CHECK(IsConfinedPath("C:\\smart_parking_violations\\a.b.jpg"));
+    CHECK(!IsConfinedPath("C:\\locvideo\\..\\camera_ids\\cameras.json"));
+    CHECK(!IsConfinedPath("C:\\locvideo\\20250101\\.."));
+    CHECK(!IsConfinedPath("C:..\\etc\\passwd"));
+    CHECK(!IsConfinedPath("C:\\locvideo\\D:\\secret"));
+    CHECK(!IsConfinedPath("C:\\locvideo\\clip.mp4:stream"));
+    const char withNul[] = "C:\\locvideo\\clip.mp4\0.jpg";
+    CHECK(!IsConfinedPath(std::string(withNul, sizeof(withNul) - 1)));
+}
+
+static void TestValidators() {
+    CHECK(HttpDate(0) == "Thu, 01 Jan 1970 00:00:00 GMT");
+    CHECK(HttpDate(784111777) == "Sun, 06 Nov 1994 08:49:37 GMT");
+    CHECK(FileETag(255, 16) == "\"ff-10\"");
+}
+
+static std::string WriteFile(const std::string& path, size_t size, char seed) {
+    std::string body(size, '\0');
+    for (size_t i = 0; i < size; i++) body[i] = (char)(seed + i * 7);
+    FILE* f = nullptr;
+    fopen_s(&f, path.c_str(), "wb");
+    fwrite(body.data(), 1, body.size(), f);
+    fclose(f);
+    return body;
+}
+
+#ifndef _WIN32
+static void TestSendRange(const std::string& dir) {
+    std::string path = dir + "\\clip.bin";
+    std::string body = WriteFile(path, 300000, 1);
+    ServedFile file;
+    CHECK(file.Open(path));
+    CHECK(file.Size() == 300000 && file.ModifiedTime() > 0);
+
+    int sockets[2];
+    CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) == 0);
+    std::string received;
+    std::thread reader([&]() {
+        char buffer[8192];
+        ssize_t got;
+        while ((got = recv(sockets[1], buffer, sizeof(buffer), 0)) > 0) received.append(buffer, (size_t)got);
+    });
+    CHECK(file.SendRange(sockets[0], 1000, 5000));
+    CHECK(file.SendRange(sockets[0], 299990, 10));
+    shutdown(sockets[0], SHUT_WR);
+    reader.join();
+    close(sockets[0]);
+    close(sockets[1]);
+    CHECK(received == body.substr(1000, 5000) + body.substr(299990, 10));
+
+    ServedFile folder;
+    CHECK(!folder.Open(dir)); // Only regular files are served
+    CHECK(!folder.Open(dir + "\\missing.bin"));
+}
+#endif
+
+static void TestStaticAssetCache(const std::string& dir) {
+    StaticAssetCache cache;
+    std::string path = dir + "\\page.html";
+    std::string body = WriteFile(path, 1000, 'a');
+    auto first = cache.Get(path);
+    CHECK(first && first->body == body && first->size == 1000);
+    CHECK(first && first->etag == FileETag(first->size, first->mtime) && first->lastModified == HttpDate(first->mtime));
+    CHECK(cache.Get(path) == first); // Served from memory within the recheck interval
+
+    // Changed on disk: picked up once the interval has passed
+    body = WriteFile(path, 2000, 'b');
+    std::this_thread::sleep_for(std::chrono::milliseconds(STATIC_CACHE_RECHECK_MS + 100));
+    auto second = cache.Get(path);
+    CHECK(second && second != first && second->body == body);
+    CHECK(first && first->body.size() == 1000); // Holders of the old copy keep it
+
+    std::string large = dir + "\\large.html";
+    WriteFile(large, 1000, 'c');
+    CHECK(cache.Get(large, 100) == nullptr); // Over the size limit
+    CHECK(cache.Get(large) != nullptr);
+    CHECK(cache.Get(dir + "\\missing.html") == nullptr);
+}
+
+int main() {
+    std::string dir = CheckScratchDir("file_serving");
+    TestByteRanges();
+    TestConfinedPath();
+    TestValidators();
+#ifndef _WIN32
+    TestSendRange(dir);
+#endif
+    TestStaticAssetCache(dir);
+    return CheckResult("file_serving_test");
+}
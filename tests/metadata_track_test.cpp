@@ -0,0 +1,130 @@
+// [METADATA] .meta/.midx round trip, time range queries and damaged tracks
+#include "MetadataTrack.h"
+#include "Check.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static std::string g_dir;
+
+static MetadataFrame MakeFrame(int i) {
+    MetadataFrame frame;
+    frame.tMs = i * 100LL;
+    frame.seq = i;
+    MetadataBox box;
+    box.trackId = i;
+    box.classId = 2;
+    box.x = i;
+    box.y = -5;
+    box.w = 40000; // Clamped to int16
+    box.h = 20;
+    box.violating = i % 2 == 1;
+    frame.boxes.push_back(box);
+    MetadataSlot slot;
+    slot.slotId = 7;
+    slot.status = 2;
+    slot.occupancy = 150; // Clamped to 100
+    frame.slots.push_back(slot);
+    return frame;
+}
+
+// 100 frames, 100 ms apart
+static std::string WriteTrack(const std::string& name) {
+    std::string path = g_dir + "\\" + name + ".meta";
+    MetadataTrackHeader header;
+    header.cameraId = 3;
+    header.frameWidth = 640;
+    header.frameHeight = 360;
+    header.clipStartEpochMs = 1700000000000LL;
+    MetadataTrackWriter writer;
+    CHECK(writer.Open(path, header));
+    for (int i = 0; i < 100; i++) writer.Append(MakeFrame(i));
+    writer.Close();
+    return path;
+}
+
+static void AppendBytes(const std::string& path, const void* data, size_t size) {
+    FILE* f = nullptr;
+    fopen_s(&f, path.c_str(), "ab");
+    fwrite(data, 1, size, f);
+    fclose(f);
+}
+
+static size_t QueryAll(const std::string& path) {
+    MetadataTrackHeader header;
+    std::vector<MetadataFrame> frames;
+    CHECK(MetadataTrackReader::Query(path, 0, 1LL << 60, header, frames));
+    return frames.size();
+}
+
+static void TestRoundTrip() {
+    std::string path = WriteTrack("roundtrip");
+    MetadataTrackHeader header;
+    std::vector<MetadataFrame> frames;
+    CHECK(MetadataTrackReader::Query(path, 2500, 3000, header, frames)); // Starts from an index point
+    CHECK(header.cameraId == 3 && header.frameWidth == 640 && header.frameHeight == 360);
+    CHECK(header.clipStartEpochMs == 1700000000000LL);
+    CHECK(frames.size() == 6);
+    if (frames.size() != 6) return;
+    CHECK(frames.front().tMs == 2500 && frames.back().tMs == 3000);
+    const MetadataFrame& f = frames[0];
+    CHECK(f.seq == 25 && f.boxes.size() == 1 && f.slots.size() == 1);
+    CHECK(f.boxes[0].trackId == 25 && f.boxes[0].classId == 2 && f.boxes[0].violating);
+    CHECK(f.boxes[0].x == 25 && f.boxes[0].y == -5 && f.boxes[0].w == 32767 && f.boxes[0].h == 20);
+    CHECK(f.slots[0].slotId == 7 && f.slots[0].status == 2 && f.slots[0].occupancy == 100);
+    CHECK(QueryAll(path) == 100);
+    CHECK(MetadataPathForClip("C:\\locvideo\\20250101\\camera_1\\120000.mp4") == "C:\\locvideo\\20250101\\camera_1\\120000.meta");
+    CHECK(MetadataPathForClip("clips.d/120000", ".midx") == "clips.d/120000.midx");
+}
+
+static void TestCorruptSizes() {
+    // A size past METADATA_MAX_RECORD_BYTES: never allocated, the frames before it still returned
+    std::string path = WriteTrack("huge_size");
+    uint32_t size = 0xFFFFFFF0u;
+    AppendBytes(path, &size, sizeof(size));
+    CHECK(QueryAll(path) == 100);
+
+    // Within the maximum but past the end of the file
+    path = WriteTrack("past_end");
+    size = 1000;
+    AppendBytes(path, &size, sizeof(size));
+    std::vector<unsigned char> partial(200, 0);
+    AppendBytes(path, partial.data(), partial.size());
+    CHECK(QueryAll(path) == 100);
+
+    // Smaller than a record header
+    path = WriteTrack("too_small");
+    size = 4;
+    AppendBytes(path, &size, sizeof(size));
+    AppendBytes(path, partial.data(), 4);
+    CHECK(QueryAll(path) == 100);
+
+    // Box and slot counts larger than the record holds
+    path = WriteTrack("bad_counts");
+    std::vector<unsigned char> record;
+    MetadataFrame frame = MakeFrame(100);
+    MetadataTrackWriter::Encode(frame, record);
+    uint16_t boxes = 0xFFFF;
+    memcpy(record.data() + 4 + 16, &boxes, sizeof(boxes));
+    AppendBytes(path, record.data(), record.size());
+    CHECK(QueryAll(path) == 100);
+}
+
+static void TestNotATrack() {
+    std::string path = g_dir + "\\garbage.meta";
+    AppendBytes(path, "garbage that is long enough for a header", 40);
+    MetadataTrackHeader header;
+    std::vector<MetadataFrame> frames;
+    CHECK(!MetadataTrackReader::Query(path, 0, 1000, header, frames));
+    CHECK(!MetadataTrackReader::Query(g_dir + "\\missing.meta", 0, 1000, header, frames));
+}
+
+int main() {
+    g_dir = CheckScratchDir("metadata_track");
+    TestRoundTrip();
+    TestCorruptSizes();
+    TestNotATrack();
+    return CheckResult("metadata_track_test");
+}
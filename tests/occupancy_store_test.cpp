@@ -0,0 +1,195 @@
+// [OCCUPANCY] Mapped columns, rollup curves and the ranges a request may ask for
+#include "OccupancyStore.h"
+#include "Check.h"
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#ifndef _WIN32
+#include <csignal>
+#include <sys/resource.h>
+#endif
+
+static std::string g_dir;
+static const long long T0 = 1700000000000LL - 1700000000000LL % 3600000; // An hour boundary
+
+static void WriteCount(const std::string& path, uint64_t count) {
+    FILE* f = nullptr;
+    fopen_s(&f, path.c_str(), "r+b");
+    fwrite(&count, sizeof(count), 1, f);
+    fclose(f);
+}
+
+static void TestColumnGrowsAndPersists() {
+    std::string path = g_dir + "\\grow.i64";
+    {
+        MappedColumn<int64_t> column;
+        CHECK(column.Open(path, true));
+        for (size_t i = 0; i < OCCUPANCY_INITIAL_ROWS * 3; i++) CHECK(column.Push((int64_t)i * 7));
+        CHECK(column.Size() == OCCUPANCY_INITIAL_ROWS * 3);
+        CHECK(column.Back() == (int64_t)(OCCUPANCY_INITIAL_ROWS * 3 - 1) * 7);
+    }
+    MappedColumn<int64_t> column;
+    CHECK(column.Open(path, false));
+    CHECK(column.Size() == OCCUPANCY_INITIAL_ROWS * 3);
+    CHECK(column[12000] == 12000 * 7);
+    column.Truncate(10);
+    CHECK(column.Size() == 10);
+    column.Truncate(20); // Never grows
+    CHECK(column.Size() == 10);
+
+    MappedColumn<int32_t> missing;
+    CHECK(!missing.Open(g_dir + "\\missing.i32", false));
+    CHECK(!missing.IsOpen() && missing.Size() == 0);
+}
+
+static void TestCorruptCount() {
+    std::string path = g_dir + "\\corrupt.i32";
+    {
+        MappedColumn<int32_t> column;
+        CHECK(column.Open(path, true));
+        for (int i = 0; i < 100; i++) column.Push(i);
+    }
+    // A count far past the rows the file holds is cut to its capacity, never trusted for indexing
+    WriteCount(path, UINT64_MAX);
+    MappedColumn<int32_t> column;
+    CHECK(column.Open(path, false));
+    CHECK(column.Size() == OCCUPANCY_INITIAL_ROWS);
+    CHECK(column[99] == 99);
+    column.Truncate(100);
+    CHECK(column.Push(100) && column.Size() == 101 && column[100] == 100);
+}
+
+#ifndef _WIN32
+// The file cannot grow: the column keeps its rows and capacity, and stays usable
+static void TestFailedGrowKeepsRows() {
+    std::string path = g_dir + "\\limited.i64";
+    MappedColumn<int64_t> column;
+    CHECK(column.Open(path, true));
+    for (size_t i = 0; i < OCCUPANCY_INITIAL_ROWS; i++) CHECK(column.Push((int64_t)i));
+
+    signal(SIGXFSZ, SIG_IGN);
+    struct rlimit saved;
+    getrlimit(RLIMIT_FSIZE, &saved);
+    struct rlimit limited = saved;
+    limited.rlim_cur = 64 * 1024; // Room for the initial rows, not for twice as many
+    setrlimit(RLIMIT_FSIZE, &limited);
+    bool pushed = column.Push(-1);
+    setrlimit(RLIMIT_FSIZE, &saved);
+
+    CHECK(!pushed);
+    CHECK(column.IsOpen());
+    CHECK(column.Size() == OCCUPANCY_INITIAL_ROWS);
+    CHECK(column.Back() == (int64_t)OCCUPANCY_INITIAL_ROWS - 1);
+    column.Truncate(10);
+    CHECK(column.Size() == 10 && column[9] == 9);
+    CHECK(column.Push(42) && column.Back() == 42);
+}
+#endif
+
+// Two hours at 2 FPS: slot 0 occupied every other minute, slot 1 always, slots 2 and 3 never
+static void Feed(CameraOccupancy& store, long long fromMs, long long toMs) {
+    std::map<int, SlotStatus> statuses;
+    for (long long t = fromMs; t < toMs; t += 500) {
+        long long minute = (t - T0) / 60000;
+        statuses[0] = minute % 2 ? SlotStatus::OCCUPIED_GOOD : SlotStatus::EMPTY;
+        statuses[1] = SlotStatus::OCCUPIED_OK;
+        statuses[2] = SlotStatus::EMPTY;
+        statuses[3] = SlotStatus::EMPTY;
+        store.Update(t, statuses);
+    }
+}
+
+static bool Near(double a, double b, double tolerance) { return std::fabs(a - b) <= tolerance; }
+
+static void TestCurves() {
+    std::string dir = g_dir + "\\camera";
+    {
+        CameraOccupancy store;
+        CHECK(store.Open(dir, true));
+        Feed(store, T0, T0 + 2 * 3600000);
+
+        std::vector<OccupancyPoint> points;
+        std::string source;
+        store.Curve(T0, T0 + 2 * 3600000, 3600000, -1, points, source);
+        CHECK(source == "hour" && points.size() == 2);
+        for (const OccupancyPoint& p : points) {
+            CHECK(Near(p.mean, 1.5, 0.01));
+            CHECK(p.minOccupied == 1 && p.maxOccupied == 2 && p.slots == 4);
+            CHECK(p.coveredMs > 3590000);
+        }
+
+        points.clear();
+        store.Curve(T0, T0 + 4 * 60000, 60000, -1, points, source);
+        CHECK(source == "minute" && points.size() == 4);
+        if (points.size() == 4) CHECK(Near(points[2].mean, 1.0, 0.01) && Near(points[3].mean, 2.0, 0.01));
+
+        points.clear();
+        store.Curve(T0 + 60000, T0 + 120000, 30000, -1, points, source);
+        CHECK(source == "transitions" && points.size() == 2);
+        if (points.size() == 2) CHECK(Near(points[0].mean, 2.0, 0.01) && Near(points[1].mean, 2.0, 0.01));
+
+        points.clear();
+        store.Curve(T0, T0 + 4 * 60000, 60000, 0, points, source); // Fraction of each minute slot 0 was taken
+        CHECK(source == "transitions" && points.size() == 4);
+        if (points.size() == 4) CHECK(Near(points[0].mean, 0.0, 0.01) && Near(points[1].mean, 1.0, 0.01) && Near(points[3].mean, 1.0, 0.01));
+    }
+
+    // Reopened from disk: same rollups, and the slot states carry over into the next update
+    CameraOccupancy store;
+    CHECK(store.Open(dir, false));
+    std::vector<OccupancyPoint> points;
+    std::string source;
+    store.Curve(T0, T0 + 2 * 3600000, 3600000, -1, points, source);
+    CHECK(points.size() == 2 && Near(points[1].mean, 1.5, 0.01));
+    Feed(store, T0 + 2 * 3600000, T0 + 2 * 3600000 + 60000);
+    points.clear();
+    store.Curve(T0 + 2 * 3600000, T0 + 2 * 3600000 + 60000, 60000, 1, points, source);
+    CHECK(points.size() == 1 && Near(points[0].mean, 1.0, 0.01));
+}
+
+// Ranges straight from the query string: nothing may overflow or allocate past OCCUPANCY_MAX_POINTS
+static void TestRequestedRanges() {
+    CameraOccupancy store;
+    CHECK(store.Open(g_dir + "\\ranges", true));
+    Feed(store, T0, T0 + 10 * 60000);
+    std::vector<OccupancyPoint> points;
+    std::string source;
+    auto count = [&](long long fromMs, long long toMs, long long stepMs) {
+        points.clear();
+        store.Curve(fromMs, toMs, stepMs, -1, points, source);
+        return points.size();
+    };
+
+    CHECK(count(LLONG_MIN, LLONG_MAX, 1) == 0);
+    CHECK(count(-1000, 1000, 1) == 0);
+    CHECK(count(0, LLONG_MAX, 3600000) == 0);
+    CHECK(count(LLONG_MAX - 10, LLONG_MAX, 1) == 0);
+    CHECK(count(T0, T0 + OCCUPANCY_MAX_SPAN_MS + 1, 3600000) == 0);
+    CHECK(count(T0, T0 - 1, 1000) == 0);
+    CHECK(count(T0, T0 + 1000, 0) == 0);
+    CHECK(count(T0, T0 + 1000, -5) == 0);
+
+    // A long range at a fine step is widened to OCCUPANCY_MAX_POINTS points
+    CHECK(count(T0, T0 + 300LL * 24 * 3600000, 1) == (size_t)OCCUPANCY_MAX_POINTS);
+    CHECK(points.size() > 1 && points[1].tMs - points[0].tMs == 2592000);
+    CHECK(count(T0, T0 + OCCUPANCY_MAX_SPAN_MS, 1) <= (size_t)OCCUPANCY_MAX_POINTS);
+
+    // A step longer than the range is a single point
+    CHECK(count(T0, T0 + 10, LLONG_MAX) == 1);
+    CHECK(points.size() == 1 && points[0].tMs == T0);
+    CHECK(count(0, OCCUPANCY_MAX_SPAN_MS, LLONG_MAX) == 1);
+}
+
+int main() {
+    g_dir = CheckScratchDir("occupancy");
+    TestColumnGrowsAndPersists();
+    TestCorruptCount();
+#ifndef _WIN32
+    TestFailedGrowKeepsRows();
+#endif
+    TestCurves();
+    TestRequestedRanges();
+    return CheckResult("occupancy_store_test");
+}
@@ -0,0 +1,114 @@
+// [SEEK INDEX] Cached .kfidx files: a valid one is used as is, a corrupt one is never trusted
+#include "VideoSeekIndex.h"
+#include "Check.h"
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+static std::string g_video;
+
+// A "video" the demuxer cannot open, so only a cached index can make VideoSeekIndex ready
+static void WriteVideo() {
+    FILE* f = nullptr;
+    fopen_s(&f, g_video.c_str(), "wb");
+    fputs("not a video", f);
+    fclose(f);
+}
+
+// Header as Save() writes it, then `pts` and `keyframes`; frameCount / keyCount may lie about them
+static void WriteIndex(uint64_t frameCount, uint64_t keyCount, const std::vector<int64_t>& pts, const std::vector<int64_t>& keyframes) {
+    struct stat st;
+    stat(PlatformPath(g_video).c_str(), &st);
+    int64_t size = (int64_t)st.st_size, mtime = (int64_t)st.st_mtime;
+    double timeBase = 1.0 / 90000, fps = 25;
+    FILE* f = nullptr;
+    fopen_s(&f, (g_video + ".kfidx").c_str(), "wb");
+    fwrite(&SEEK_INDEX_MAGIC, sizeof(uint32_t), 1, f);
+    fwrite(&SEEK_INDEX_VERSION, sizeof(uint32_t), 1, f);
+    fwrite(&size, sizeof(int64_t), 1, f);
+    fwrite(&mtime, sizeof(int64_t), 1, f);
+    fwrite(&timeBase, sizeof(double), 1, f);
+    fwrite(&fps, sizeof(double), 1, f);
+    fwrite(&frameCount, sizeof(uint64_t), 1, f);
+    fwrite(&keyCount, sizeof(uint64_t), 1, f);
+    if (!pts.empty()) fwrite(pts.data(), sizeof(int64_t), pts.size(), f);
+    if (!keyframes.empty()) fwrite(keyframes.data(), sizeof(int64_t), keyframes.size(), f);
+    fclose(f);
+}
+
+static bool LoadsIndex(VideoSeekIndex& index) {
+    index.StartBackground(g_video);
+    index.Stop(); // Joins the worker
+    return index.IsReady();
+}
+
+static void TestValidIndex() {
+    std::vector<int64_t> pts;
+    for (int i = 0; i < 100; i++) pts.push_back(i * 3600);
+    WriteIndex(100, 4, pts, { 0, 25, 50, 75 });
+    VideoSeekIndex index;
+    CHECK(LoadsIndex(index));
+    CHECK(index.FrameCount() == 100);
+    CHECK(index.KeyframeCount() == 4);
+    CHECK(index.KeyframeAtOrBefore(60) == 50);
+    CHECK(index.KeyframeAtOrBefore(24) == 0);
+    CHECK(index.FrameAtTime(1.0) == 25);
+    CHECK(std::fabs(index.TimestampSec(50) - 2.0) < 1e-9);
+}
+
+static void TestCorruptCounts() {
+    std::vector<int64_t> pts(10, 0);
+    std::vector<int64_t> keys(1, 0);
+    VideoSeekIndex index;
+
+    // Counts far beyond the file: rejected before anything is allocated for them
+    WriteIndex(1ULL << 40, 1, pts, keys);
+    CHECK(!LoadsIndex(index));
+    WriteIndex(10, 1ULL << 62, pts, keys);
+    CHECK(!LoadsIndex(index));
+    WriteIndex(UINT64_MAX, UINT64_MAX, pts, keys);
+    CHECK(!LoadsIndex(index));
+
+    // One entry more than the file holds
+    WriteIndex(11, 1, pts, keys);
+    CHECK(!LoadsIndex(index));
+    WriteIndex(10, 2, pts, keys);
+    CHECK(!LoadsIndex(index));
+
+    // Zero counts and more keyframes than frames
+    WriteIndex(0, 0, pts, keys);
+    CHECK(!LoadsIndex(index));
+    WriteIndex(1, 2, std::vector<int64_t>(1, 0), std::vector<int64_t>(2, 0));
+    CHECK(!LoadsIndex(index));
+
+    // Truncated arrays
+    WriteIndex(10, 1, std::vector<int64_t>(5, 0), {});
+    CHECK(!LoadsIndex(index));
+
+    WriteIndex(10, 1, pts, keys);
+    CHECK(LoadsIndex(index));
+    CHECK(index.FrameCount() == 10);
+}
+
+static void TestStaleIndex() {
+    std::vector<int64_t> pts(10, 0);
+    WriteIndex(10, 1, pts, { 0 });
+    FILE* f = nullptr;
+    fopen_s(&f, g_video.c_str(), "ab"); // The video changed size since it was indexed
+    fputs(" any more", f);
+    fclose(f);
+    VideoSeekIndex index;
+    CHECK(!LoadsIndex(index));
+    WriteVideo();
+}
+
+int main() {
+    g_video = CheckScratchDir("seek_index") + "\\clip.mp4";
+    WriteVideo();
+    TestValidIndex();
+    TestCorruptCounts();
+    TestStaleIndex();
+    return CheckResult("video_seek_index_test");
+}
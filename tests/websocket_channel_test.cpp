@@ -0,0 +1,141 @@
+// [WEBSOCKET] Handshake key, server frame headers and the client frame reader
+#include "WebSocketChannel.h"
+#include "Check.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+static const unsigned char MASK[4] = { 0x12, 0x34, 0x56, 0x78 };
+
+// A masked client frame; `lengthBytes` picks the 7-bit, 16-bit or 64-bit length form
+static std::string ClientFrame(uint8_t firstByte, const std::string& payload, int lengthBytes = 0) {
+    std::string frame;
+    frame += (char)firstByte;
+    if (lengthBytes == 0) lengthBytes = payload.size() < 126 ? 1 : payload.size() <= 0xFFFF ? 2 : 8;
+    if (lengthBytes == 1) {
+        frame += (char)(0x80 | payload.size());
+    } else if (lengthBytes == 2) {
+        frame += (char)(0x80 | 126);
+        frame += (char)(payload.size() >> 8);
+        frame += (char)(payload.size() & 0xFF);
+    } else {
+        frame += (char)(0x80 | 127);
+        for (int i = 7; i >= 0; i--) frame += (char)(((uint64_t)payload.size() >> (i * 8)) & 0xFF);
+    }
+    frame.append((const char*)MASK, 4);
+    for (size_t i = 0; i < payload.size(); i++) frame += (char)(payload[i] ^ MASK[i % 4]);
+    return frame;
+}
+
+// Header of a masked frame claiming `length` payload bytes, with none of them following
+static std::string ClaimedFrame(uint8_t firstByte, uint64_t length) {
+    std::string frame;
+    frame += (char)firstByte;
+    frame += (char)(0x80 | 127);
+    for (int i = 7; i >= 0; i--) frame += (char)((length >> (i * 8)) & 0xFF);
+    frame.append((const char*)MASK, 4);
+    return frame;
+}
+
+static void TestAcceptKey() {
+    // RFC 6455, section 1.3
+    CHECK(WebSocketAcceptKey("dGhlIHNhbXBsZSBub25jZQ==") == "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=");
+}
+
+static void TestFrameHeader() {
+    std::string h = WebSocketFrameHeader(WS_OP_BINARY, 125);
+    CHECK(h.size() == 2 && (unsigned char)h[0] == 0x82 && (unsigned char)h[1] == 125);
+    h = WebSocketFrameHeader(WS_OP_BINARY, 126);
+    CHECK(h.size() == 4 && (unsigned char)h[1] == 126 && (unsigned char)h[2] == 0 && (unsigned char)h[3] == 126);
+    h = WebSocketFrameHeader(WS_OP_TEXT, 0xFFFF);
+    CHECK(h.size() == 4 && (unsigned char)h[0] == 0x81 && (unsigned char)h[2] == 0xFF && (unsigned char)h[3] == 0xFF);
+    h = WebSocketFrameHeader(WS_OP_BINARY, 0x10000);
+    CHECK(h.size() == 10 && (unsigned char)h[1] == 127);
+    CHECK(h.substr(2) == std::string("\0\0\0\0\0\x01\0\0", 8));
+    h = WebSocketFrameHeader(WS_OP_BINARY, (size_t)3000000000u);
+    CHECK(h.substr(2) == std::string("\0\0\0\0\xB2\xD0\x5E\0", 8));
+}
+
+static void TestReaderReassembles() {
+    // A fragmented text message with a ping between its fragments, fed one byte at a time
+    std::string stream = ClientFrame(WS_OP_TEXT, "{\"cre") + ClientFrame(0x80 | WS_OP_PING, "hi") +
+                         ClientFrame(0x80 | WS_OP_CONTINUATION, "dit\":5}");
+    WebSocketReader reader;
+    WebSocketMessage message;
+    std::vector<WebSocketMessage> messages;
+    for (char c : stream) {
+        reader.Feed(&c, 1);
+        while (reader.Next(message)) messages.push_back(message);
+    }
+    CHECK(!reader.Failed());
+    CHECK(messages.size() == 2);
+    if (messages.size() == 2) {
+        CHECK(messages[0].opcode == WS_OP_PING && messages[0].payload == "hi");
+        CHECK(messages[1].opcode == WS_OP_TEXT && WebSocketCredit(messages[1].payload) == 5);
+    }
+
+    // 16-bit and 64-bit lengths, and a message exactly at the limit
+    std::string medium(300, 'm');
+    std::string frame = ClientFrame(0x80 | WS_OP_BINARY, medium);
+    reader.Feed(frame.data(), frame.size());
+    CHECK(reader.Next(message) && message.opcode == WS_OP_BINARY && message.payload == medium);
+    std::string small = ClientFrame(0x80 | WS_OP_TEXT, "x", 8);
+    reader.Feed(small.data(), small.size());
+    CHECK(reader.Next(message) && message.payload == "x");
+    std::string full(WS_MAX_CLIENT_MESSAGE, 'f');
+    frame = ClientFrame(0x80 | WS_OP_BINARY, full);
+    reader.Feed(frame.data(), frame.size());
+    CHECK(reader.Next(message) && message.payload.size() == WS_MAX_CLIENT_MESSAGE);
+    CHECK(!reader.Next(message) && !reader.Failed());
+}
+
+static bool Rejects(const std::string& bytes) {
+    WebSocketReader reader;
+    WebSocketMessage message;
+    reader.Feed(bytes.data(), bytes.size());
+    return !reader.Next(message) && reader.Failed();
+}
+
+static void TestReaderRejects() {
+    // Unmasked client frame
+    std::string unmasked = ClientFrame(0x80 | WS_OP_TEXT, "hello");
+    unmasked[1] = (char)(unmasked[1] & 0x7F);
+    CHECK(Rejects(unmasked));
+
+    // Lengths over the limit are refused from the header, before any payload arrives
+    CHECK(Rejects(ClaimedFrame(0x80 | WS_OP_BINARY, WS_MAX_CLIENT_MESSAGE + 1)));
+    CHECK(Rejects(ClaimedFrame(0x80 | WS_OP_BINARY, 1ULL << 40)));
+    CHECK(Rejects(ClaimedFrame(0x80 | WS_OP_BINARY, UINT64_MAX)));
+    CHECK(Rejects(ClaimedFrame(0x80 | WS_OP_BINARY, 0x8000000000000000ULL)));
+
+    // Fragments that only add up to too much, including a length that wraps 2^64 with what is buffered
+    std::string first = ClientFrame(WS_OP_TEXT, std::string(10, 'a'));
+    CHECK(Rejects(first + ClaimedFrame(0x80 | WS_OP_CONTINUATION, UINT64_MAX - 4)));
+    CHECK(Rejects(first + ClaimedFrame(0x80 | WS_OP_CONTINUATION, WS_MAX_CLIENT_MESSAGE - 9)));
+    std::string fits = first + ClientFrame(0x80 | WS_OP_CONTINUATION, std::string(WS_MAX_CLIENT_MESSAGE - 10, 'b'));
+    CHECK(!Rejects(fits));
+
+    // Once failed, the reader stays failed
+    WebSocketReader reader;
+    WebSocketMessage message;
+    std::string bad = ClaimedFrame(0x80 | WS_OP_BINARY, UINT64_MAX) + ClientFrame(0x80 | WS_OP_TEXT, "ok");
+    reader.Feed(bad.data(), bad.size());
+    CHECK(!reader.Next(message) && !reader.Next(message) && reader.Failed());
+}
+
+static void TestCredit() {
+    CHECK(WebSocketCredit("{\"credit\":3}") == 3);
+    CHECK(WebSocketCredit("{ \"credit\" : 12 }") == 12);
+    CHECK(WebSocketCredit("{\"credit\":100000}") == WS_MAX_CREDIT);
+    CHECK(WebSocketCredit("{\"credit\":-4}") == 0);
+    CHECK(WebSocketCredit("{\"other\":3}") == 0);
+}
+
+int main() {
+    TestAcceptKey();
+    TestFrameHeader();
+    TestReaderReassembles();
+    TestReaderRejects();
+    TestCredit();
+    return CheckResult("websocket_channel_test");
+}